@@ -128,7 +128,7 @@ class BuildSystem:
             
             cmd = [
                 "gcc", "-c", str(c_file), "-o", str(obj_file), 
-                "-fPIC", "-Wall", "-Wextra", "-g"
+                "-fPIC", "-Wall", "-Wextra", "-g", "-pthread"
             ] + include_flags
             
             print(f"  Compiling: {c_file.name}")
@@ -225,7 +225,7 @@ class BuildSystem:
         ] + include_flags
         
         if lib_path:
-            cmd.append(str(lib_path))
+            cmd.extend([str(lib_path), "-pthread"])
             print(f"Linking against library: {lib_path}")
         
         try:
@@ -295,7 +295,7 @@ class BuildSystem:
 
         cmd = ["gcc"] + [str(obj) for obj in ordered_objs] + ["-o", str(test_exe)]
         if lib_path:
-            cmd.append(str(lib_path))
+            cmd.extend([str(lib_path), "-pthread"])
 
         print("Linking test executable...")
         try:
@@ -24,6 +24,7 @@ DOC = """\
  */"""
 
 FUNC_TEMP = "Node_TypeConvert_{ST}_to_{DT}"
+CAST_TEMP = "_TC_Cast_{ST}_to_{DT}"
 FUNC_HEADER = "Type Convert Methods For {DT}"
 COPY_FUNC = "Node_Copy"
 
@@ -40,6 +41,9 @@ class TCFunction:
     def get_func_name(self):
         return FUNC_TEMP.format(DT = self.dst_t, ST = self.src_t)
 
+    def get_cast_name(self):
+        return CAST_TEMP.format(DT = self.dst_t, ST = self.src_t)
+
 class TCFunctionList:
     def __init__(self, src_types : List[int], dst_type : int):
         src_types = src_types if src_types else alldtypes
@@ -68,8 +72,8 @@ def get_templates(fp : str):
 def get_functions(f_template : str, fl : TCFunctionList):
     code = ""
     for f in fl.functions:
-        code += f.get_doc()
-        code += f_template.replace("%DT%", f.dst_t)\
+        code += f_template.replace("%DOC%", f.get_doc())\
+                            .replace("%DT%", f.dst_t)\
                             .replace("%NDT%", f.dst_nt)\
                             .replace("%ST%", f.src_t)\
                             .replace("%NST%", f.src_nt)
@@ -77,25 +81,31 @@ def get_functions(f_template : str, fl : TCFunctionList):
 
 def get_array(a_template : str, fl_list : List[TCFunctionList]):
     all_ = []
+    casts = []
     for fl in fl_list:
         all_.append(f"\n\t//To {fl.dst_t}\n")
+        casts.append(f"\n\t//To {fl.dst_t}\n")
         dst_type = fl.dst_ti
         iter_ = iter(fl.functions)
         i = 0
         while i < NR_NUM_NUMIRC_DT:
             if i == dst_type:
                 text = COPY_FUNC
+                cast = "NULL"
             else:
                 try:
                     f = next(iter_)
                     text = f.get_func_name() 
+                    cast = f.get_cast_name()
                 except:
                     break
             all_.append("\t" + text + ",\n")
+            casts.append("\t" + cast + ",\n")
             i+=1
 
     code = "".join(all_)
     code = a_template.replace("%METHODS%", code)
+    code = code.replace("%CASTS%", "".join(casts))
 
     return code
 
@@ -4,6 +4,9 @@
 /* Maximum number of dimensions supported for arrays */
 #define NR_NODE_MAX_NDIM 32
 
+/* Dimensions whose shape and strides are stored inside the Node itself */
+#define NR_NODE_INLINE_NDIM 6
+
 /*
     Compiler-Specific Definitions
     ----------------------------
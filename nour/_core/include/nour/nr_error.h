@@ -41,11 +41,13 @@ typedef struct
 }NError;
 
 /*
-    Global error state variable.
-    Thread-local storage ensures thread safety.
+    Error state of the calling thread.
+    Every thread has its own copy, so independent calls on different
+    threads never see each other's errors. Use NError_Fetch and
+    NError_Restore to hand an error over to another thread.
     Initialized to no error state.
 */
-extern NError __NR_NERROR_GLOBAL_ERROR_VAR__;
+extern NR_TLS NError __NR_NERROR_GLOBAL_ERROR_VAR__;
 
 #define NERROR_CONTEXT __NR_NERROR_GLOBAL_ERROR_VAR__.context
 #define NERROR_TYPE __NR_NERROR_GLOBAL_ERROR_VAR__.type
@@ -26,6 +26,7 @@ typedef struct
     int nin;              // Number of input nodes
     int nout;             // Number of output nodes
     NR_DTYPE outtype;         // Desired output data type (not used and would be deleted)
+    NR_DTYPE intype;          // Promoted input dtype, inputs keep theirs under NFUNC_FLAG_CAST_IN_LOOP
     void* extra;              // Additional parameters
 
     int __ref_count;        // Internal reference count for memory management
@@ -36,15 +37,55 @@ typedef struct
 /* Function pointer type for PyNour operations */
 typedef int (*NFuncFunc) (NFuncArgs*);
 
+/*
+ * Gradient of a recorded call (see src/ngrad.h). It gets
+ *  - in_nodes: the inputs of the call, its output, then the gradient of
+ *    the output (nin = call nin + 2),
+ *  - out_nodes: one NULL slot per input of the call (nout = call nin),
+ *  - extra: what GradFunc.save kept of the call's extra, or NULL,
+ * and stores a new reference to the gradient of every input that needs
+ * one (NGrad_Needed) in out_nodes. A gradient may keep the broadcast
+ * shape and any float dtype; the engine sums and casts it to its input.
+ */
 typedef int (*GradFuncFunc) (NFuncArgs*);
 
+/* Keeps what the gradient needs of args->extra, which only lives during the call */
+typedef int (*GradSaveFunc) (NFuncArgs* args, void** saved);
+
 typedef struct
 {
-    GradFuncFunc grad_func_float32;
-    GradFuncFunc grad_func_float64;
+    GradFuncFunc grad_func_float32;     // Picked when the output gradient is float32
+    GradFuncFunc grad_func_float64;     // Picked otherwise
+    GradSaveFunc save;                  // Optional, called when the call is recorded
+    void (*release) (void* saved);      // Frees what `save` kept
+    int saved_is_extra;                 // `save` keeps all of extra, so the call can be
+                                        // replayed with it (see Node_Checkpoint)
 }GradFunc;
 
 
+/*
+ * Dtypes and kernel NFunc_Call resolves for one signature of input dtypes.
+ * `in_dtype` is NR_NONE when the signature is rejected; NFunc_Call then
+ * takes the checking path, which raises the error.
+ */
+typedef struct
+{
+    NR_DTYPE in_dtype;
+    NR_DTYPE out_dtype;
+    NFuncFunc func;         // Kernel of the signature, or NFunc.func
+}NFuncDispatchEntry;
+
+/*
+ * Dispatch table of a 1 or 2 input NFunc, indexed by
+ * `dtype0 * NR_NUM_NUMIRC_DT + dtype1` (dtype1 is 0 with one input). It is
+ * filled once, by the first NFunc_Call of the function.
+ */
+typedef struct
+{
+    int state;              // 0: empty, 1: being filled, 2: ready
+    NFuncDispatchEntry entries[NR_NUM_NUMIRC_DT * NR_NUM_NUMIRC_DT];
+}NFuncDispatch;
+
 typedef struct
 {
     const char* name;       // Name of the function
@@ -61,13 +102,20 @@ typedef struct
 
     NFuncFunc func;          // Pointer to the function implementation
     GradFunc* grad_func;      // Pointer to the gradient function (if applicable)    
+
+    const NFuncFunc* kernels;   // Optional kernel per dtype (NR_NUM_NUMIRC_DT entries, NULL if unsupported)
+                                // that `func` dispatches to, called directly through `dispatch`
+    NFuncDispatch* dispatch;    // Optional cache of the dtype resolution (1 or 2 input functions)
 } NFunc;
 
+/* Call recorded on its output node; keeps a reference to every input */
 typedef struct
 {
     const NFunc* nfunc;
     NFuncArgs* args;
     int out_idx;
+    void* saved;            // See GradFunc.save
+    int replayable;         // The call can run again from args and saved (no other extra)
 } NFuncFuncInfo;
 
 #define NFUNC_FLAG_GRADIENT 0x1             // Function supports gradient computation
@@ -79,5 +127,6 @@ typedef struct
 #define NFUNC_FLAG_OUT_DTYPES_NOT_SAME 0x40 // If there are multiple output nodes, their dtypes may differ
 #define NFUNC_FLAG_NO_USER_OUT_NODES 0x80   // Function does not allow user-provided output nodes
 #define NFUNC_FLAG_NO_DATA 0x100            // Function does not modify node data buffer (shape/strides metadata only)
+#define NFUNC_FLAG_CAST_IN_LOOP 0x200       // Kernels cast inputs to `intype` block by block, no promoted copies are made
 
 #endif
\ No newline at end of file
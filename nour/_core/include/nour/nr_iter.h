@@ -19,6 +19,8 @@
        NITER_MODE_NONE (0): No iteration mode set
        NITER_MODE_CONTIGUOUS (1): For contiguous memory blocks
        NITER_MODE_STRIDED (2): For strided memory access
+       NITER_MODE_INNER_CONTIGUOUS (3): Multi-operand layout whose inner rows
+                                        are contiguous or broadcast
 
     3. Constants:
        NR_MULTIITER_MAX_NITER: Maximum number of simultaneous iterators (32)
@@ -64,6 +66,34 @@
 #define NITER_MODE_CONTIGUOUS 1
 #define NITER_MODE_STRIDED 2
 
+/*
+ * Layout of a whole NMultiIter / NInnerIter (their `iter_mode`), after
+ * broadcasting and coalescing:
+ *  - NITER_MODE_CONTIGUOUS: one row where every operand is contiguous,
+ *    the loop can index all operands with the same flat index.
+ *  - NITER_MODE_INNER_CONTIGUOUS: along the innermost axis every operand
+ *    is either contiguous or broadcast (stride 0), like a row vector added
+ *    to a matrix. Each row can run a contiguous / scalar vector loop.
+ *  - NITER_MODE_STRIDED: anything else, or item sizes are unknown.
+ */
+#define NITER_MODE_INNER_CONTIGUOUS 3
+
+/*
+ * visiting orders of NMultiIter
+ *  - NITER_ORDER_C: C order of the (broadcast) shape. Required whenever the
+ *    loop pairs the iterator with something outside of it, like a linear
+ *    output index.
+ *  - NITER_ORDER_K: any order. Axes are sorted by stride so transposed
+ *    operands still collapse into few long axes. Only valid when every
+ *    array the loop reads or writes is one of the iterated operands.
+ *
+ * In both orders size-1 axes are dropped and adjacent axes that all
+ * operands can step over with one stride are merged, so `nd_m1` may be
+ * smaller than the node's ndim and `coords` don't map to node axes.
+ */
+#define NITER_ORDER_C 0
+#define NITER_ORDER_K 1
+
 /*
     Thanks to NumPy - this iterator system was inspired by their implementation
 */
@@ -157,6 +187,8 @@ typedef struct
     int idx;                                        // current index
     int end;                                        // end index
     void* current[NR_NODE_MAX_NDIM];                // current position
+    int iter_mode;                                  // layout of all the operands
+    nr_intp inner_size;                             // items along the innermost axis
 }NMultiIter;
 
 // Initialize the multi-iterator
@@ -219,6 +251,94 @@ typedef struct
 // Get the current item
 #define NMultiIter_ITEM(mit_ptr, i) (NIter_ITEM((mit_ptr)->iters + i))
 
+/*
+========================================
+            NInnerIter structure
+========================================
+*/
+
+/*
+ * NInnerIter walks one or more operands a whole inner row at a time.
+ * Every step hands out a pointer per operand, the byte stride of each
+ * operand along the innermost (coalesced) axis and the number of items in
+ * the row, so kernels run a plain strided loop and the carry over the
+ * outer axes is paid once per row instead of once per item:
+ *
+ *     NInnerIter_ITER(&it);
+ *     while (NInnerIter_NOTDONE(&it)) {
+ *         char** ptrs = NInnerIter_PTRS(&it);
+ *         nr_intp* strides = NInnerIter_STRIDES(&it);
+ *         nr_intp count = NInnerIter_COUNT(&it);
+ *         ... loop over `count` items ...
+ *         NInnerIter_NEXT(&it);
+ *     }
+ *
+ * Operands are broadcast to a common shape and coalesced like NMultiIter
+ * (see NITER_ORDER_C / NITER_ORDER_K), so the inner row is as long as the
+ * layouts allow. Broadcast operands get a 0 inner stride.
+ */
+typedef struct
+{
+    int nop;                                                    // number of operands
+    int nd_m1;                                                  // number of outer dimensions - 1
+    char* data[NR_MULTIITER_MAX_NITER];                         // first item of each operand
+    char* ptrs[NR_MULTIITER_MAX_NITER];                         // start of the current row
+    nr_intp inner_strides[NR_MULTIITER_MAX_NITER];              // strides along the row
+    nr_intp inner_size;                                         // items in a row
+    nr_intp shape_m1[NR_NODE_MAX_NDIM];                         // outer shape - 1
+    nr_intp strides[NR_MULTIITER_MAX_NITER][NR_NODE_MAX_NDIM];  // outer strides
+    nr_intp backstrides[NR_MULTIITER_MAX_NITER][NR_NODE_MAX_NDIM]; // outer backstrides
+    nr_intp coords[NR_NODE_MAX_NDIM];                           // outer coordinates
+    nr_intp idx;                                                // current row
+    nr_intp end;                                                // number of rows
+
+    nr_intp out_shape[NR_NODE_MAX_NDIM];                        // broadcast shape
+    int out_ndim;                                               // broadcast number of dimensions
+    int iter_mode;                                              // layout of all the operands
+}NInnerIter;
+
+// Initialize the inner loop iterator
+#define NInnerIter_ITER(iit_ptr) do { \
+    (iit_ptr)->idx = 0; \
+    memcpy((iit_ptr)->ptrs, (iit_ptr)->data, (iit_ptr)->nop * sizeof(char*)); \
+    if ((iit_ptr)->nd_m1 >= 0){ \
+        memset((iit_ptr)->coords, 0, ((iit_ptr)->nd_m1 + 1) * sizeof(nr_intp)); \
+    } \
+} while (0)
+
+// Move every operand to the start of the next row
+#define NInnerIter_NEXT(iit_ptr) do { \
+    (iit_ptr)->idx++; \
+    for (int i = (iit_ptr)->nd_m1; i > -1; i--){ \
+        if ((iit_ptr)->coords[i] < (iit_ptr)->shape_m1[i]){ \
+            (iit_ptr)->coords[i]++; \
+            for (int k = 0; k < (iit_ptr)->nop; k++){ \
+                (iit_ptr)->ptrs[k] += (iit_ptr)->strides[k][i]; \
+            } \
+            break; \
+        } \
+        (iit_ptr)->coords[i] = 0; \
+        for (int k = 0; k < (iit_ptr)->nop; k++){ \
+            (iit_ptr)->ptrs[k] -= (iit_ptr)->backstrides[k][i]; \
+        } \
+    } \
+} while (0)
+
+// Point operand `k` at another first item (same layout), before NInnerIter_ITER
+#define NInnerIter_RESET_DATA(iit_ptr, k, ptr) ((iit_ptr)->data[k] = (char*)(ptr))
+
+// Check if the inner loop iterator is done used with a while loop
+#define NInnerIter_NOTDONE(iit_ptr) ((iit_ptr)->idx < (iit_ptr)->end)
+
+// Pointers to the first item of the current row, one per operand
+#define NInnerIter_PTRS(iit_ptr) ((iit_ptr)->ptrs)
+
+// Byte strides along the current row, one per operand
+#define NInnerIter_STRIDES(iit_ptr) ((iit_ptr)->inner_strides)
+
+// Number of items in the current row
+#define NInnerIter_COUNT(iit_ptr) ((iit_ptr)->inner_size)
+
 /*
 ========================================
             NWindowIter structure
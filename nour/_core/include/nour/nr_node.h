@@ -27,6 +27,15 @@ extern char* NR_NODE_NAME;
 #define NR_NODE_SORTED 0x40      // Sorted array
 #define NR_NODE_OWNDATA 0x80     // Owns its data
 #define NR_NODE_TRACK 0x100      // Memory tracking enabled
+#define NR_NODE_LAZY 0x200       // Deferred elementwise result without data yet (see nlazy.h)
+#define NR_NODE_RECOMPUTE 0x400  // Activation released by Node_Checkpoint, no data until recomputed (see ngrad.h)
+#define NR_NODE_NMEMDATA 0x800   // Owned data came from NMem_Alloc and goes back to NMem_Free
+
+/*
+    Releases an external data buffer, see Node_NewExternal.
+    Called once with the buffer and the context given at construction.
+*/
+typedef void (*Node_Deleter)(void* data, void* ctx);
 
 
 /* Core array node structure */
@@ -52,6 +61,15 @@ typedef struct Node
     /* Optional attached operation (computation graph). Forward-declared to avoid circular include. */
     struct NFuncFuncInfo* nfunc_info;
     struct Node* grad;  // Gradient node reference
+
+    // Releases an external buffer when the node goes away (NULL otherwise)
+    Node_Deleter deleter;
+    void* deleter_ctx;
+
+    // Shape followed by strides for nodes with up to NR_NODE_INLINE_NDIM
+    // dimensions, so they need no separate allocation. `shape` points here
+    // for those nodes and at a heap block of the same layout otherwise.
+    nr_intp inline_dims[2 * NR_NODE_INLINE_NDIM];
 } Node;
 
 /* Node access macros */
@@ -78,6 +96,9 @@ typedef struct Node
 #define NODE_IS_SORTED(node)     NR_CHKFLG(node->flags, NR_NODE_SORTED)
 #define NODE_IS_OWNDATA(node)    NR_CHKFLG(node->flags, NR_NODE_OWNDATA)
 #define NODE_IS_TRACK(node)      NR_CHKFLG(node->flags, NR_NODE_TRACK)
+#define NODE_IS_LAZY(node)       NR_CHKFLG(node->flags, NR_NODE_LAZY)
+#define NODE_IS_RECOMPUTE(node)  NR_CHKFLG(node->flags, NR_NODE_RECOMPUTE)
+#define NODE_IS_NMEMDATA(node)   NR_CHKFLG(node->flags, NR_NODE_NMEMDATA)
 
 #define NODE_IS_SCALAR(node) (node->ndim == 0)
 
@@ -8,11 +8,21 @@
 #include "ntools.h"
 #include "nerror.h"
 #include "free.h"
+#include "node_pool.h"
+#include "nmem.h"
+#include "nmap.h"
+#include "nnpy.h"
+#include "nchunk.h"
 #include "tc_methods.h"
 #include "node2str.h"
 #include "shape.h"
 #include "getset.h"
 #include "nfunc.h"
+#include "nlazy.h"
+#include "ngrad.h"
+#include "nthread.h"
 #include "./nmath/nmath.h"
+#include "./nmath/simd.h"
+#include "./nmath/reduce_state.h"
 
 #endif // NOUR__CORE_SRC_CNOUR_H
\ No newline at end of file
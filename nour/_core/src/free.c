@@ -1,7 +1,78 @@
 #include "free.h"
+#include "node_core.h"
+#include "node_pool.h"
+#include "nmem.h"
+#include "nfunc.h"
+#include "nlazy.h"
 #include <stdlib.h>
 #include <stdio.h>
 
+NR_PUBLIC void
+Node_ReleaseData(Node* node){
+    if (node->deleter) {
+        node->deleter(node->data, node->deleter_ctx);
+    }
+    else if (NODE_IS_OWNDATA(node) && node->data) {
+        // buffers NMem never handed out are neither counted nor cached
+        if (NODE_IS_NMEMDATA(node)) {
+            NMem_Free(node->data, Node_NItems(node) * NODE_ITEMSIZE(node));
+        }
+        else {
+            free(node->data);
+        }
+    }
+    node->deleter = NULL;
+    node->deleter_ctx = NULL;
+    node->data = NULL;
+    NR_RMVFLG(node->flags, NR_NODE_OWNDATA | NR_NODE_NMEMDATA);
+}
+
+/*
+ * Nodes whose last reference went away while another node was being
+ * destroyed. Destroying a node drops its references to its base, its
+ * gradient and the inputs of its recorded operation; queueing those
+ * instead of recursing lets the end of a long chain (a deep graph, a
+ * view of a view of ...) go away without deep recursion.
+ */
+#define FREE_PENDING_INLINE 64
+
+NR_PRIVATE NR_TLS Node* __free_pending_inline[FREE_PENDING_INLINE];
+NR_PRIVATE NR_TLS Node** __free_pending = NULL;     // heap queue once the inline one is full
+NR_PRIVATE NR_TLS int __free_npending = 0;
+NR_PRIVATE NR_TLS int __free_cap = 0;
+NR_PRIVATE NR_TLS int __free_active = 0;
+
+NR_PRIVATE void destroy_node(Node* node);
+
+/* Queues `node`, returns 0 when there is no room for it */
+NR_PRIVATE int
+free_pending_push(Node* node){
+    if (__free_npending < FREE_PENDING_INLINE){
+        __free_pending_inline[__free_npending++] = node;
+        return 1;
+    }
+    int i = __free_npending - FREE_PENDING_INLINE;
+    if (i == __free_cap){
+        int cap = __free_cap ? __free_cap * 2 : FREE_PENDING_INLINE;
+        Node** pending = (Node**)realloc(__free_pending, sizeof(Node*) * cap);
+        if (!pending){
+            return 0;
+        }
+        __free_pending = pending;
+        __free_cap = cap;
+    }
+    __free_pending[i] = node;
+    __free_npending++;
+    return 1;
+}
+
+NR_PRIVATE Node*
+free_pending_pop(void){
+    int i = --__free_npending;
+    return i < FREE_PENDING_INLINE ? __free_pending_inline[i]
+                                   : __free_pending[i - FREE_PENDING_INLINE];
+}
+
 NR_PUBLIC void
 Node_Free(Node* node){
     if (!node) return;
@@ -11,24 +82,47 @@ Node_Free(Node* node){
     
     // If still referenced, don't free anything
     if (node->ref_count > 0) return;
-    
-    // Free shape and strides
-    if (node->shape) {
-        free(node->shape);
+
+    if (__free_active){
+        // destroyed by the outermost Node_Free, recursing only without memory
+        if (!free_pending_push(node)){
+            destroy_node(node);
+        }
+        return;
     }
-    if (node->strides) {
-        free(node->strides);
+
+    __free_active = 1;
+    destroy_node(node);
+    while (__free_npending > 0){
+        destroy_node(free_pending_pop());
     }
-    
-    // Free data if this node owns it
-    if (NODE_IS_OWNDATA(node) && node->data) {
-        free(node->data);
+    free(__free_pending);
+    __free_pending = NULL;
+    __free_cap = 0;
+    __free_active = 0;
+}
+
+NR_PRIVATE void
+destroy_node(Node* node){
+    // Drop the recorded operation; lazy nodes also release their inputs
+    if (NODE_IS_LAZY(node)) {
+        NLazy_Release(node);
+    }
+    else if (node->nfunc_info) {
+        _NFuncFuncInfo_Free((NFuncFuncInfo*)node->nfunc_info);
+        node->nfunc_info = NULL;
     }
     
+    // Free data if this node owns it, its size comes from the shape
+    Node_ReleaseData(node);
+
+    // Free shape and strides (a no-op for inline ones)
+    Node_FreeDims(node);
+    
     // If this node references a base, decrement base's ref count
     // and potentially free it
     if (node->base) {
-        Node_Free(node->base);  // Recursive call handles ref_count properly
+        Node_Free(node->base);  // Queued if this was the last reference
     }
 
     // Free gradient node if it exists
@@ -41,6 +135,6 @@ Node_Free(Node* node){
         free((void*)node->name);
     }
 
-    // Finally free the node structure itself
-    free(node);
+    // Finally hand the node structure back to the pool
+    NodePool_Put(node);
 }
\ No newline at end of file
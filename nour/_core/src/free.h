@@ -6,4 +6,14 @@
 NR_PUBLIC void
 Node_Free(Node* node);
 
+/*
+ * Releases the node's data buffer if the node is responsible for it:
+ * owned buffers go back to NMem_Free (free() for the ones taken from the
+ * caller, see NR_OWNDATA_NMEM), external ones to their deleter.
+ * Leaves the node borrowing nothing (data NULL, no ownership). Must be
+ * called while node->shape still describes the buffer.
+ */
+NR_PUBLIC void
+Node_ReleaseData(Node* node);
+
 #endif // NR__CORE__SRC__FREE_H
\ No newline at end of file
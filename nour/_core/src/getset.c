@@ -4,9 +4,12 @@
 #include "nerror.h"
 #include "node_core.h"
 #include "free.h"
+#include "nmem.h"
 #include "niter.h"
 #include "tc_methods.h"
 #include "ntools.h"
+#include "ngrad.h"
+#include "nmath/grad.h"
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -615,9 +618,8 @@ get_flat_bool_indexing(Node* base_node, NIndexRuleSet* rs)
 
     nr_intp nitems = NR_NItems(base_node->ndim, base_node->shape);
     nr_size_t bsize = NDtype_Size(NODE_DTYPE(base_node));
-    char* temp_data = malloc(nitems * bsize);
+    char* temp_data = NMem_Alloc(nitems * bsize);
     if (!temp_data) {
-        NError_RaiseMemoryError();
         return NULL;
     }
 
@@ -637,7 +639,7 @@ get_flat_bool_indexing(Node* base_node, NIndexRuleSet* rs)
         Node* nodes[] = {base_node, index_node};
         NMultiIter mit;
         if (NMultiIter_FromNodes(nodes, 2, &mit) < 0) {
-            free(temp_data);
+            NMem_Free(temp_data, nitems * bsize);
             return NULL;
         }
 
@@ -654,17 +656,16 @@ get_flat_bool_indexing(Node* base_node, NIndexRuleSet* rs)
         }
     }
 
-    char* out_data = malloc(correct_count * bsize);
+    char* out_data = NMem_Alloc(correct_count * bsize);
     if (!out_data) {
-        free(temp_data);
-        NError_RaiseMemoryError();
+        NMem_Free(temp_data, nitems * bsize);
         return NULL;
     }
 
     memcpy(out_data, temp_data, correct_count * bsize);
-    free(temp_data);
+    NMem_Free(temp_data, nitems * bsize);
 
-    return Node_New(out_data, 1, 1, (nr_intp[]){correct_count}, 
+    return Node_New(out_data, NR_OWNDATA_NMEM, 1, (nr_intp[]){correct_count}, 
                     NODE_DTYPE(base_node));
 }
 
@@ -695,10 +696,9 @@ get_fancy_indexing(IndexContext* ctx)
     /* No remaining dimensions - output is just broadcast shape */
     if (ctx->remaining_dims <= 0) {
         nr_size_t nitems = NR_NItems(mit->out_ndim, mit->out_shape);
-        char* out_data = malloc(nitems * bsize);
+        char* out_data = NMem_Alloc(nitems * bsize);
         if (!out_data) {
             free(mit);
-            NError_RaiseMemoryError();
             return NULL;
         }
 
@@ -718,7 +718,7 @@ get_fancy_indexing(IndexContext* ctx)
             NMultiIter_NEXT(mit);
         }
 
-        Node* result = Node_New(out_data, 1, mit->out_ndim, 
+        Node* result = Node_New(out_data, NR_OWNDATA_NMEM, mit->out_ndim, 
                                mit->out_shape, dtype);
         free(mit);
         return result;
@@ -732,10 +732,9 @@ get_fancy_indexing(IndexContext* ctx)
            sizeof(nr_intp) * ctx->remaining_dims);
 
     nr_size_t nitems = NR_NItems(tndim, tshape);
-    char* out_data = malloc(nitems * bsize);
+    char* out_data = NMem_Alloc(nitems * bsize);
     if (!out_data) {
         free(mit);
-        NError_RaiseMemoryError();
         return NULL;
     }
 
@@ -768,7 +767,7 @@ get_fancy_indexing(IndexContext* ctx)
         NMultiIter_NEXT(mit);
     }
 
-    Node* result = Node_New(out_data, 1, tndim, tshape, dtype);
+    Node* result = Node_New(out_data, NR_OWNDATA_NMEM, tndim, tshape, dtype);
     free(mit);
     return result;
 }
@@ -791,9 +790,8 @@ get_simple_indexing(IndexContext* ctx)
     NR_DTYPE dtype = NODE_DTYPE(ctx->base_node);
     
     nr_size_t nitems = NR_NItems(nnii->out_ndim, nnii->out_shape);
-    char* out_data = malloc(nitems * bsize);
+    char* out_data = NMem_Alloc(nitems * bsize);
     if (!out_data) {
-        NError_RaiseMemoryError();
         return NULL;
     }
     
@@ -809,7 +807,7 @@ get_simple_indexing(IndexContext* ctx)
         NIter_NEXT_STRIDED(&iter);
     }
     
-    return Node_New(out_data, 1, nnii->out_ndim, nnii->out_shape, dtype);
+    return Node_New(out_data, NR_OWNDATA_NMEM, nnii->out_ndim, nnii->out_shape, dtype);
 }
 
 /* ============================================================================
@@ -1027,7 +1025,7 @@ set_no_rules_indexing(Node* base_node, Node* value)
     } else {
         Node* nodes[] = {base_node, value};
         NMultiIter mit;
-        if (NMultiIter_FromNodes(nodes, 2, &mit) < 0) {
+        if (NMultiIter_FromNodesOrder(nodes, 2, NITER_ORDER_K, &mit) < 0) {
             return -1;
         }
         
@@ -1134,9 +1132,169 @@ GetItem_function(NFuncArgs* args)
     return 0;
 }
 
+/*
+ * GetItem gradient. Basic indices (ints, slices, new axes, ellipsis) only
+ * keep a copy of the rules: the backward pass replays them as a set of
+ * the output gradient into the zeroed input gradient.
+ * Node indices select items that may repeat, so the flat input position
+ * of every output item is saved instead and the gradient adds at it.
+ */
+typedef struct {
+    NIndexRuleSet rs;
+    int risky;
+    Node* positions;
+} GetItemGradSaved;
+
+NR_STATIC_INLINE int
+node_setitem_internal(Node* base_node, NIndexRuleSet* rs,
+                      Node* value, int risky_indexing);
+
+/*
+ * Flat input positions of the items selected by a node index, sized to
+ * the output: the index is replayed on one small probe per dimension,
+ * broadcast over the input shape with zero strides, holding the
+ * coordinate along that dimension already scaled by its C stride.
+ */
+NR_STATIC_INLINE Node*
+getitem_positions(Node* base_node, IndexOpArgs* op_args)
+{
+    int ndim = base_node->ndim;
+    if (ndim == 0) {
+        nr_int64 zero = 0;
+        Node* probe = Node_New(&zero, 0, 0, NULL, NR_INT64);
+        if (!probe) return NULL;
+        Node* positions = node_index_internal(probe, op_args->rs, op_args->risky);
+        Node_Free(probe);
+        return positions;
+    }
+
+    Node* positions = NULL;
+    nr_int64 cstride = 1;
+    for (int d = ndim - 1; d >= 0; d--) {
+        Node* coord = Node_NewEmpty(1, &base_node->shape[d], NR_INT64);
+        if (!coord) goto fail;
+        nr_int64* c = (nr_int64*)NODE_DATA(coord);
+        for (nr_intp i = 0; i < base_node->shape[d]; i++) c[i] = i * cstride;
+        cstride *= base_node->shape[d];
+
+        nr_intp strides[NR_NODE_MAX_NDIM] = {0};
+        strides[d] = sizeof(nr_int64);
+        Node* probe = Node_NewChild(coord, ndim, base_node->shape, strides, 0);
+        Node* part = probe ? node_index_internal(probe, op_args->rs, op_args->risky) : NULL;
+        Node_Free(probe);
+        Node_Free(coord);
+        if (!part) goto fail;
+
+        if (!positions) {
+            positions = part;
+            continue;
+        }
+        nr_int64* dst = (nr_int64*)NODE_DATA(positions);
+        const nr_int64* src = (const nr_int64*)NODE_DATA(part);
+        nr_intp n = Node_NItems(positions);
+        for (nr_intp i = 0; i < n; i++) dst[i] += src[i];
+        Node_Free(part);
+    }
+    return positions;
+
+fail:
+    Node_Free(positions);
+    return NULL;
+}
+
+NR_PRIVATE int
+GetItem_grad_save(NFuncArgs* args, void** saved)
+{
+    IndexOpArgs* op_args = (IndexOpArgs*)args->extra;
+    NIndexRuleSet* rs = op_args->rs;
+
+    GetItemGradSaved* s = malloc(sizeof(GetItemGradSaved));
+    if (!s) {
+        NError_RaiseMemoryError();
+        return -1;
+    }
+    s->risky = op_args->risky;
+    s->positions = NULL;
+    NIndexRuleSet_Init(&s->rs);
+
+    int has_node = 0;
+    for (nr_intp i = 0; rs && i < NIndexRuleSet_NUM_RULES(rs); i++) {
+        if (NIndexRuleSet_RULES(rs)[i].type == NIndexRuleType_Node) {
+            has_node = 1;
+            break;
+        }
+    }
+
+    if (has_node) {
+        s->positions = getitem_positions(args->in_nodes[0], op_args);
+        if (!s->positions) {
+            free(s);
+            return -1;
+        }
+    } else if (rs) {
+        s->rs = *rs;
+    }
+    *saved = s;
+    return 0;
+}
+
+NR_PRIVATE void
+GetItem_grad_release(void* saved)
+{
+    GetItemGradSaved* s = (GetItemGradSaved*)saved;
+    Node_Free(s->positions);
+    free(s);
+}
+
+#define DEFINE_GETITEM_GRAD(T, SFX) \
+NR_PRIVATE int \
+GetItem_grad_##SFX(NFuncArgs* args) \
+{ \
+    Node* x = args->in_nodes[0]; \
+    if (!NGrad_Needed(x)) return 0; \
+    GetItemGradSaved* s = (GetItemGradSaved*)args->extra; \
+    Node* gout = args->in_nodes[args->nout + 1]; \
+    Node* gx = Node_NewEmpty(x->ndim, x->shape, NODE_DTYPE(gout)); \
+    if (!gx) return -1; \
+    memset(NODE_DATA(gx), 0, Node_NItems(gx) * sizeof(T)); \
+    Node* gc = NGrad_Contiguous(gout); \
+    int ok = gc != NULL; \
+    if (ok && !s->positions) { \
+        ok = node_setitem_internal(gx, &s->rs, gc, s->risky) == 0; \
+    } else if (ok) { \
+        Node* ic = NGrad_Contiguous(s->positions); \
+        ok = ic != NULL; \
+        if (ok) { \
+            T* dst = (T*)NODE_DATA(gx); \
+            const T* g = (const T*)NODE_DATA(gc); \
+            const nr_int64* pos = (const nr_int64*)NODE_DATA(ic); \
+            nr_intp n = Node_NItems(ic); \
+            for (nr_intp i = 0; i < n; i++) dst[pos[i]] += g[i]; \
+        } \
+        Node_Free(ic); \
+    } \
+    Node_Free(gc); \
+    if (!ok) { \
+        Node_Free(gx); \
+        return -1; \
+    } \
+    args->out_nodes[0] = gx; \
+    return 0; \
+}
+
+DEFINE_GETITEM_GRAD(nr_float32, float32)
+DEFINE_GETITEM_GRAD(nr_float64, float64)
+
+GradFunc getitem_grad = {
+    .grad_func_float32 = GetItem_grad_float32,
+    .grad_func_float64 = GetItem_grad_float64,
+    .save = GetItem_grad_save,
+    .release = GetItem_grad_release
+};
+
 const NFunc getitem_nfunc = {
     .name = "getitem",
-    .flags = 0,
+    .flags = NFUNC_FLAG_GRADIENT,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -1144,7 +1302,7 @@ const NFunc getitem_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = GetItem_function,
-    .grad_func = NULL
+    .grad_func = &getitem_grad
 };
 
 NR_PUBLIC Node*
@@ -0,0 +1,818 @@
+#include "nchunk.h"
+#include "nmem.h"
+#include "node_core.h"
+#include "free.h"
+#include "ntools.h"
+#include "shape.h"
+#include "nerror.h"
+#include "./nmath/reduce.h"
+#include "./nmath/nmath.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define NCHUNK_FSEEK _fseeki64
+    #define NCHUNK_FTELL _ftelli64
+#else
+    #define NCHUNK_FSEEK fseeko
+    #define NCHUNK_FTELL ftello
+#endif
+
+#define NCHUNK_MAGIC "NRCHUNK1"
+#define NCHUNK_MAGIC_LEN 8
+#define NCHUNK_FIXED_LEN 24     // magic and the four u32 fields
+
+/* RLE control byte: < 0x80 starts 1 + c literal bytes, >= 0x80 a run */
+#define NCHUNK_RLE_MIN_RUN 3
+#define NCHUNK_RLE_MAX_RUN (0x7F + NCHUNK_RLE_MIN_RUN)
+#define NCHUNK_RLE_MAX_LITERAL 0x80
+
+NR_STATIC_INLINE void
+nchunk_put32(unsigned char* p, nr_uint32 v){
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+NR_STATIC_INLINE void
+nchunk_put64(unsigned char* p, nr_uint64 v){
+    nchunk_put32(p, (nr_uint32)v);
+    nchunk_put32(p + 4, (nr_uint32)(v >> 32));
+}
+
+NR_STATIC_INLINE nr_uint32
+nchunk_get32(const unsigned char* p){
+    return (nr_uint32)p[0] | ((nr_uint32)p[1] << 8) | ((nr_uint32)p[2] << 16) | ((nr_uint32)p[3] << 24);
+}
+
+NR_STATIC_INLINE nr_uint64
+nchunk_get64(const unsigned char* p){
+    return (nr_uint64)nchunk_get32(p) | ((nr_uint64)nchunk_get32(p + 4) << 32);
+}
+
+NR_STATIC_INLINE long long
+nchunk_table_pos(const NChunkFile* cf){
+    return NCHUNK_FIXED_LEN + 16LL * cf->ndim;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Codec                                                                    */
+/* ------------------------------------------------------------------------ */
+
+NR_PRIVATE void
+nchunk_shuffle(const char* src, char* dst, nr_intp nitems, nr_intp itemsize){
+    for (nr_intp b = 0; b < itemsize; b++) {
+        char* plane = dst + b * nitems;
+        for (nr_intp i = 0; i < nitems; i++) {
+            plane[i] = src[i * itemsize + b];
+        }
+    }
+}
+
+NR_PRIVATE void
+nchunk_unshuffle(const char* src, char* dst, nr_intp nitems, nr_intp itemsize){
+    for (nr_intp b = 0; b < itemsize; b++) {
+        const char* plane = src + b * nitems;
+        for (nr_intp i = 0; i < nitems; i++) {
+            dst[i * itemsize + b] = plane[i];
+        }
+    }
+}
+
+NR_STATIC_INLINE nr_intp
+nchunk_run_length(const unsigned char* src, nr_intp i, nr_intp n){
+    nr_intp j = i + 1;
+    while (j < n && j - i < NCHUNK_RLE_MAX_RUN && src[j] == src[i]) {
+        j++;
+    }
+    return j - i;
+}
+
+/*
+ * Run-length codes `n` bytes into `dst`. Returns the coded size, or -1 as
+ * soon as it would reach `cap` (the data does not shrink).
+ */
+NR_PRIVATE nr_intp
+nchunk_rle_encode(const unsigned char* src, nr_intp n, unsigned char* dst, nr_intp cap){
+    nr_intp i = 0, o = 0;
+    while (i < n) {
+        nr_intp run = nchunk_run_length(src, i, n);
+        if (run >= NCHUNK_RLE_MIN_RUN) {
+            if (o + 2 >= cap) {
+                return -1;
+            }
+            dst[o++] = (unsigned char)(0x80 | (run - NCHUNK_RLE_MIN_RUN));
+            dst[o++] = src[i];
+            i += run;
+            continue;
+        }
+        // literal bytes up to the next run worth coding
+        nr_intp j = i + run;
+        while (j < n && j - i < NCHUNK_RLE_MAX_LITERAL
+               && nchunk_run_length(src, j, n) < NCHUNK_RLE_MIN_RUN) {
+            j++;
+        }
+        nr_intp len = j - i;
+        if (o + 1 + len >= cap) {
+            return -1;
+        }
+        dst[o++] = (unsigned char)(len - 1);
+        memcpy(dst + o, src + i, len);
+        o += len;
+        i = j;
+    }
+    return o;
+}
+
+/* Returns 0 when `src` decodes to exactly `n` bytes */
+NR_PRIVATE int
+nchunk_rle_decode(const unsigned char* src, nr_intp size, unsigned char* dst, nr_intp n){
+    nr_intp i = 0, o = 0;
+    while (i < size) {
+        unsigned char c = src[i++];
+        if (c & 0x80) {
+            nr_intp run = (c & 0x7F) + NCHUNK_RLE_MIN_RUN;
+            if (i >= size || o + run > n) {
+                return -1;
+            }
+            memset(dst + o, src[i++], run);
+            o += run;
+        }
+        else {
+            nr_intp len = c + 1;
+            if (i + len > size || o + len > n) {
+                return -1;
+            }
+            memcpy(dst + o, src + i, len);
+            i += len;
+            o += len;
+        }
+    }
+    return o == n ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Helpers                                                                  */
+/* ------------------------------------------------------------------------ */
+
+/* Copies a `shape` block between two strided buffers */
+NR_PRIVATE void
+nchunk_copy_block(char* dst, const nr_intp* dst_strides, const char* src,
+                  const nr_intp* src_strides, const nr_intp* shape, int ndim, nr_intp itemsize){
+    if (ndim == 0) {
+        memcpy(dst, src, itemsize);
+        return;
+    }
+    if (ndim == 1) {
+        if (dst_strides[0] == itemsize && src_strides[0] == itemsize) {
+            memcpy(dst, src, shape[0] * itemsize);
+            return;
+        }
+        for (nr_intp i = 0; i < shape[0]; i++) {
+            memcpy(dst + i * dst_strides[0], src + i * src_strides[0], itemsize);
+        }
+        return;
+    }
+    for (nr_intp i = 0; i < shape[0]; i++) {
+        nchunk_copy_block(dst + i * dst_strides[0], dst_strides + 1, src + i * src_strides[0],
+                          src_strides + 1, shape + 1, ndim - 1, itemsize);
+    }
+}
+
+NR_PRIVATE void
+nchunk_default_chunks(int ndim, const nr_intp* shape, nr_intp itemsize, nr_intp* chunks){
+    nr_intp bytes = itemsize;
+    for (int i = 0; i < ndim; i++) {
+        chunks[i] = shape[i] > 0 ? shape[i] : 1;
+        bytes *= chunks[i];
+    }
+    // shrink the leading axes first so chunks stay C-contiguous runs
+    for (int i = 0; i < ndim && bytes > NCHUNK_DEFAULT_BYTES; i++) {
+        nr_intp inner = bytes / chunks[i];
+        chunks[i] = NCHUNK_DEFAULT_BYTES / inner > 1 ? NCHUNK_DEFAULT_BYTES / inner : 1;
+        bytes = inner * chunks[i];
+    }
+}
+
+/* Fills the grid from shape and chunks and allocates the table */
+NR_PRIVATE int
+nchunk_setup(NChunkFile* cf){
+    cf->itemsize = NDtype_Size(cf->dtype);
+    cf->nchunks = 1;
+    for (int i = 0; i < cf->ndim; i++) {
+        cf->grid[i] = (cf->shape[i] + cf->chunks[i] - 1) / cf->chunks[i];
+        cf->nchunks *= cf->grid[i];
+    }
+    nr_size_t n = cf->nchunks > 0 ? (nr_size_t)cf->nchunks : 1;
+    cf->offsets = (nr_uint64*)calloc(n, sizeof(nr_uint64));
+    cf->sizes = (nr_uint64*)calloc(n, sizeof(nr_uint64));
+    if (!cf->offsets || !cf->sizes) {
+        NError_RaiseMemoryError();
+        return -1;
+    }
+    return 0;
+}
+
+NR_PRIVATE void
+nchunk_free(NChunkFile* cf){
+    if (cf->file) {
+        fclose((FILE*)cf->file);
+    }
+    free(cf->offsets);
+    free(cf->sizes);
+    free(cf);
+}
+
+NR_PUBLIC void
+NChunk_ChunkShape(const NChunkFile* cf, nr_intp index, nr_intp* shape, nr_intp* origin){
+    for (int i = cf->ndim - 1; i >= 0; i--) {
+        nr_intp pos = index % cf->grid[i];
+        index /= cf->grid[i];
+        nr_intp start = pos * cf->chunks[i];
+        nr_intp left = cf->shape[i] - start;
+        shape[i] = left < cf->chunks[i] ? left : cf->chunks[i];
+        if (origin) {
+            origin[i] = start;
+        }
+    }
+}
+
+NR_PRIVATE int
+nchunk_check_index(const NChunkFile* cf, nr_intp index){
+    if (index < 0 || index >= cf->nchunks) {
+        NError_RaiseError(NError_IndexError, "chunk index %lld out of range for %lld chunks",
+                          (long long)index, (long long)cf->nchunks);
+        return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Create / open / close                                                    */
+/* ------------------------------------------------------------------------ */
+
+NR_PUBLIC NChunkFile*
+NChunk_Create(const char* path, int ndim, const nr_intp* shape, NR_DTYPE dtype,
+              const nr_intp* chunk_shape, NChunk_Codec codec){
+    if (ndim < 0 || ndim > NR_NODE_MAX_NDIM || !NDtype_IsValid(dtype)
+        || (codec != NCHUNK_CODEC_NONE && codec != NCHUNK_CODEC_SHUFFLE_RLE)) {
+        return NError_RaiseError(NError_ValueError, "chunk: invalid ndim, dtype or codec");
+    }
+    NChunkFile* cf = (NChunkFile*)calloc(1, sizeof(NChunkFile));
+    if (!cf) {
+        return NError_RaiseMemoryError();
+    }
+    cf->writable = 1;
+    cf->dtype = dtype;
+    cf->codec = codec;
+    cf->ndim = ndim;
+    for (int i = 0; i < ndim; i++) {
+        cf->shape[i] = shape[i];
+        if (shape[i] < 0 || (chunk_shape && chunk_shape[i] < 1)) {
+            nchunk_free(cf);
+            return NError_RaiseError(NError_ValueError, "chunk: invalid shape or chunk shape");
+        }
+    }
+    if (chunk_shape) {
+        memcpy(cf->chunks, chunk_shape, sizeof(nr_intp) * ndim);
+    }
+    else {
+        nchunk_default_chunks(ndim, shape, NDtype_Size(dtype), cf->chunks);
+    }
+    if (nchunk_setup(cf) != 0) {
+        nchunk_free(cf);
+        return NULL;
+    }
+
+    FILE* f = fopen(path, "w+b");
+    if (!f) {
+        nchunk_free(cf);
+        return NError_RaiseError(NError_IOError, "chunk: cannot open '%s' for writing", path);
+    }
+    cf->file = f;
+
+    // header now, the table on close; an all-zero table means no chunk yet
+    unsigned char fixed[NCHUNK_FIXED_LEN];
+    memcpy(fixed, NCHUNK_MAGIC, NCHUNK_MAGIC_LEN);
+    nchunk_put32(fixed + 8, (nr_uint32)dtype);
+    nchunk_put32(fixed + 12, (nr_uint32)codec);
+    nchunk_put32(fixed + 16, (nr_uint32)ndim);
+    nchunk_put32(fixed + 20, 0);
+    int ok = fwrite(fixed, 1, NCHUNK_FIXED_LEN, f) == NCHUNK_FIXED_LEN;
+    unsigned char dims[16 * NR_NODE_MAX_NDIM];
+    for (int i = 0; i < ndim; i++) {
+        nchunk_put64(dims + 8 * i, (nr_uint64)cf->shape[i]);
+        nchunk_put64(dims + 8 * (ndim + i), (nr_uint64)cf->chunks[i]);
+    }
+    ok = ok && fwrite(dims, 1, 16 * ndim, f) == (nr_size_t)(16 * ndim);
+    unsigned char zero[16] = {0};
+    for (nr_intp i = 0; i < cf->nchunks && ok; i++) {
+        ok = fwrite(zero, 1, 16, f) == 16;
+    }
+    if (!ok) {
+        nchunk_free(cf);
+        return NError_RaiseError(NError_IOError, "chunk: failed writing '%s'", path);
+    }
+    return cf;
+}
+
+NR_PUBLIC NChunkFile*
+NChunk_Open(const char* path){
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NError_RaiseError(NError_IOError, "chunk: cannot open '%s'", path);
+    }
+    NChunkFile* cf = (NChunkFile*)calloc(1, sizeof(NChunkFile));
+    if (!cf) {
+        fclose(f);
+        return NError_RaiseMemoryError();
+    }
+    cf->file = f;
+
+    unsigned char fixed[NCHUNK_FIXED_LEN];
+    unsigned char dims[16 * NR_NODE_MAX_NDIM];
+    if (fread(fixed, 1, NCHUNK_FIXED_LEN, f) != NCHUNK_FIXED_LEN
+        || memcmp(fixed, NCHUNK_MAGIC, NCHUNK_MAGIC_LEN) != 0) {
+        nchunk_free(cf);
+        return NError_RaiseError(NError_ValueError, "chunk: '%s' is not a chunked array file", path);
+    }
+    cf->dtype = (NR_DTYPE)nchunk_get32(fixed + 8);
+    cf->codec = (NChunk_Codec)nchunk_get32(fixed + 12);
+    nr_uint32 ndim = nchunk_get32(fixed + 16);
+    int ok = ndim <= NR_NODE_MAX_NDIM && NDtype_IsValid(cf->dtype) && cf->codec <= NCHUNK_CODEC_SHUFFLE_RLE
+             && fread(dims, 1, 16 * ndim, f) == 16 * ndim;
+    cf->ndim = (int)ndim;
+    for (int i = 0; i < cf->ndim && ok; i++) {
+        cf->shape[i] = (nr_intp)nchunk_get64(dims + 8 * i);
+        cf->chunks[i] = (nr_intp)nchunk_get64(dims + 8 * (cf->ndim + i));
+        ok = cf->shape[i] >= 0 && cf->chunks[i] >= 1;
+    }
+    if (!ok) {
+        nchunk_free(cf);
+        return NError_RaiseError(NError_ValueError, "chunk: '%s' has a malformed header", path);
+    }
+    if (nchunk_setup(cf) != 0) {
+        nchunk_free(cf);
+        return NULL;
+    }
+    for (nr_intp i = 0; i < cf->nchunks && ok; i++) {
+        unsigned char entry[16];
+        ok = fread(entry, 1, 16, f) == 16;
+        cf->offsets[i] = nchunk_get64(entry);
+        cf->sizes[i] = nchunk_get64(entry + 8);
+    }
+    if (!ok) {
+        nchunk_free(cf);
+        return NError_RaiseError(NError_ValueError, "chunk: '%s' has a truncated chunk table", path);
+    }
+    return cf;
+}
+
+NR_PUBLIC int
+NChunk_Close(NChunkFile* cf){
+    if (!cf) {
+        return 0;
+    }
+    int ok = 1;
+    if (cf->writable) {
+        FILE* f = (FILE*)cf->file;
+        ok = NCHUNK_FSEEK(f, nchunk_table_pos(cf), SEEK_SET) == 0;
+        for (nr_intp i = 0; i < cf->nchunks && ok; i++) {
+            unsigned char entry[16];
+            nchunk_put64(entry, cf->offsets[i]);
+            nchunk_put64(entry + 8, cf->sizes[i]);
+            ok = fwrite(entry, 1, 16, f) == 16;
+        }
+        ok = fclose(f) == 0 && ok;
+        cf->file = NULL;
+    }
+    nchunk_free(cf);
+    if (!ok) {
+        NError_RaiseError(NError_IOError, "chunk: failed writing the chunk table");
+        return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Chunk I/O                                                                */
+/* ------------------------------------------------------------------------ */
+
+/* Stores the chunk at `data`/`strides`; the shape is the chunk's own */
+NR_PRIVATE int
+nchunk_write(NChunkFile* cf, nr_intp index, const char* data, const nr_intp* strides){
+    nr_intp shape[NR_NODE_MAX_NDIM];
+    nr_intp cstrides[NR_NODE_MAX_NDIM];
+    NChunk_ChunkShape(cf, index, shape, NULL);
+    nr_intp nitems = NR_NItems(cf->ndim, shape);
+    nr_intp raw = nitems * cf->itemsize;
+
+    // raw C-ordered chunk, then its coded form behind it
+    char* buf = (char*)NMem_Alloc(2 * raw);
+    if (!buf) {
+        return -1;
+    }
+    NTools_CalculateStrides(cf->ndim, shape, cf->itemsize, cstrides);
+    if (nitems > 0) {
+        nchunk_copy_block(buf, cstrides, data, strides, shape, cf->ndim, cf->itemsize);
+    }
+    const char* out = buf;
+    nr_intp size = raw;
+    if (cf->codec == NCHUNK_CODEC_SHUFFLE_RLE && raw > 0) {
+        char* planes = buf + raw;
+        nchunk_shuffle(buf, planes, nitems, cf->itemsize);
+        // coded over the raw copy, which is no longer needed
+        nr_intp coded = nchunk_rle_encode((unsigned char*)planes, raw, (unsigned char*)buf, raw);
+        if (coded >= 0) {
+            size = coded;
+        }
+        else {
+            nchunk_copy_block(buf, cstrides, data, strides, shape, cf->ndim, cf->itemsize);
+        }
+    }
+
+    FILE* f = (FILE*)cf->file;
+    int ok = NCHUNK_FSEEK(f, 0, SEEK_END) == 0;
+    long long offset = ok ? (long long)NCHUNK_FTELL(f) : -1;
+    ok = ok && offset >= 0 && (size == 0 || fwrite(out, 1, size, f) == (nr_size_t)size);
+    NMem_Free(buf, 2 * raw);
+    if (!ok) {
+        NError_RaiseError(NError_IOError, "chunk: failed writing chunk %lld", (long long)index);
+        return -1;
+    }
+    cf->offsets[index] = (nr_uint64)offset;
+    cf->sizes[index] = (nr_uint64)size;
+    return 0;
+}
+
+/* Decodes chunk `index` into the C-contiguous buffer `out` */
+NR_PRIVATE int
+nchunk_read(NChunkFile* cf, nr_intp index, char* out, nr_intp nitems){
+    nr_intp raw = nitems * cf->itemsize;
+    nr_intp size = (nr_intp)cf->sizes[index];
+    if (size == 0) {
+        memset(out, 0, raw);
+        return 0;
+    }
+    FILE* f = (FILE*)cf->file;
+    if (size > raw || NCHUNK_FSEEK(f, (long long)cf->offsets[index], SEEK_SET) != 0) {
+        NError_RaiseError(NError_ValueError, "chunk: chunk %lld is corrupt", (long long)index);
+        return -1;
+    }
+    if (size == raw) {
+        if ((nr_intp)fread(out, 1, raw, f) != raw) {
+            NError_RaiseError(NError_IOError, "chunk: failed reading chunk %lld", (long long)index);
+            return -1;
+        }
+        return 0;
+    }
+
+    char* buf = (char*)NMem_Alloc(size + raw);
+    if (!buf) {
+        return -1;
+    }
+    char* planes = buf + size;
+    int rc = 0;
+    if ((nr_intp)fread(buf, 1, size, f) != size) {
+        NError_RaiseError(NError_IOError, "chunk: failed reading chunk %lld", (long long)index);
+        rc = -1;
+    }
+    else if (nchunk_rle_decode((unsigned char*)buf, size, (unsigned char*)planes, raw) != 0) {
+        NError_RaiseError(NError_ValueError, "chunk: chunk %lld is corrupt", (long long)index);
+        rc = -1;
+    }
+    else {
+        nchunk_unshuffle(planes, out, nitems, cf->itemsize);
+    }
+    NMem_Free(buf, size + raw);
+    return rc;
+}
+
+NR_PUBLIC int
+NChunk_WriteChunk(NChunkFile* cf, nr_intp index, const Node* node){
+    if (!cf->writable) {
+        NError_RaiseError(NError_ValueError, "chunk: file is opened read-only");
+        return -1;
+    }
+    if (nchunk_check_index(cf, index) != 0) {
+        return -1;
+    }
+    nr_intp shape[NR_NODE_MAX_NDIM];
+    NChunk_ChunkShape(cf, index, shape, NULL);
+    int same = node->ndim == cf->ndim && NODE_DTYPE(node) == cf->dtype;
+    for (int i = 0; i < cf->ndim && same; i++) {
+        same = node->shape[i] == shape[i];
+    }
+    if (!same) {
+        NError_RaiseError(NError_ValueError, "chunk: node does not match the shape or dtype of chunk %lld",
+                          (long long)index);
+        return -1;
+    }
+    return nchunk_write(cf, index, (const char*)NODE_DATA(node), node->strides);
+}
+
+NR_PUBLIC Node*
+NChunk_ReadChunk(NChunkFile* cf, nr_intp index){
+    if (nchunk_check_index(cf, index) != 0) {
+        return NULL;
+    }
+    nr_intp shape[NR_NODE_MAX_NDIM];
+    NChunk_ChunkShape(cf, index, shape, NULL);
+    Node* out = Node_NewEmpty(cf->ndim, shape, cf->dtype);
+    if (!out) {
+        return NULL;
+    }
+    if (nchunk_read(cf, index, (char*)NODE_DATA(out), Node_NItems(out)) != 0) {
+        Node_Free(out);
+        return NULL;
+    }
+    return out;
+}
+
+NR_PUBLIC int
+Node_SaveChunked(const Node* node, const char* path, const nr_intp* chunk_shape,
+                 NChunk_Codec codec){
+    NChunkFile* cf = NChunk_Create(path, node->ndim, node->shape, NODE_DTYPE(node), chunk_shape, codec);
+    if (!cf) {
+        return -1;
+    }
+    nr_intp shape[NR_NODE_MAX_NDIM];
+    nr_intp origin[NR_NODE_MAX_NDIM];
+    for (nr_intp k = 0; k < cf->nchunks; k++) {
+        NChunk_ChunkShape(cf, k, shape, origin);
+        const char* data = (const char*)NODE_DATA(node);
+        for (int i = 0; i < cf->ndim; i++) {
+            data += origin[i] * node->strides[i];
+        }
+        if (nchunk_write(cf, k, data, node->strides) != 0) {
+            NChunk_Close(cf);
+            return -1;
+        }
+    }
+    return NChunk_Close(cf);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Reading a box of chunks                                                  */
+/* ------------------------------------------------------------------------ */
+
+/*
+ * Decodes every chunk overlapping the box [lo, lo + box) into a new
+ * C-contiguous node of shape `box`.
+ */
+NR_PRIVATE Node*
+nchunk_read_box(NChunkFile* cf, const nr_intp* lo, const nr_intp* box){
+    Node* out = Node_NewEmpty(cf->ndim, (nr_intp*)box, cf->dtype);
+    if (!out || Node_NItems(out) == 0) {
+        return out;
+    }
+    int nd = cf->ndim;
+    nr_intp first[NR_NODE_MAX_NDIM], last[NR_NODE_MAX_NDIM], pos[NR_NODE_MAX_NDIM];
+    for (int i = 0; i < nd; i++) {
+        first[i] = lo[i] / cf->chunks[i];
+        last[i] = (lo[i] + box[i] - 1) / cf->chunks[i];
+        pos[i] = first[i];
+    }
+
+    nr_intp max_items = NR_NItems(nd, cf->chunks);
+    char* buf = (char*)NMem_Alloc(max_items * cf->itemsize);
+    if (!buf) {
+        Node_Free(out);
+        return NULL;
+    }
+    for (;;) {
+        nr_intp index = 0;
+        for (int i = 0; i < nd; i++) {
+            index = index * cf->grid[i] + pos[i];
+        }
+        nr_intp shape[NR_NODE_MAX_NDIM], origin[NR_NODE_MAX_NDIM], strides[NR_NODE_MAX_NDIM];
+        NChunk_ChunkShape(cf, index, shape, origin);
+        if (nchunk_read(cf, index, buf, NR_NItems(nd, shape)) != 0) {
+            NMem_Free(buf, max_items * cf->itemsize);
+            Node_Free(out);
+            return NULL;
+        }
+        NTools_CalculateStrides(nd, shape, cf->itemsize, strides);
+
+        // overlap of the chunk and the box
+        nr_intp overlap[NR_NODE_MAX_NDIM];
+        const char* src = buf;
+        char* dst = (char*)NODE_DATA(out);
+        for (int i = 0; i < nd; i++) {
+            nr_intp start = origin[i] > lo[i] ? origin[i] : lo[i];
+            nr_intp end = origin[i] + shape[i] < lo[i] + box[i] ? origin[i] + shape[i] : lo[i] + box[i];
+            overlap[i] = end - start;
+            src += (start - origin[i]) * strides[i];
+            dst += (start - lo[i]) * out->strides[i];
+        }
+        nchunk_copy_block(dst, out->strides, src, strides, overlap, nd, cf->itemsize);
+
+        int i = nd - 1;
+        while (i >= 0 && pos[i] == last[i]) {
+            pos[i] = first[i];
+            i--;
+        }
+        if (i < 0) {
+            break;
+        }
+        pos[i]++;
+    }
+    NMem_Free(buf, max_items * cf->itemsize);
+    return out;
+}
+
+/* Python slice semantics: first index, item count and step over `len` */
+NR_PRIVATE int
+nchunk_slice(const NIndexSlice* s, nr_intp len, nr_intp* first, nr_intp* count){
+    nr_intp step = s->step;
+    if (step == 0) {
+        NError_RaiseError(NError_ValueError, "slice step cannot be zero");
+        return -1;
+    }
+    nr_intp start, stop;
+    if (step > 0) {
+        start = s->has_start ? s->start : 0;
+        stop = s->has_stop ? s->stop : len;
+        if (start < 0) start = start + len < 0 ? 0 : start + len;
+        if (stop < 0) stop = stop + len < 0 ? 0 : stop + len;
+        if (start > len) start = len;
+        if (stop > len) stop = len;
+        *count = stop > start ? (stop - start + step - 1) / step : 0;
+    }
+    else {
+        start = s->has_start ? s->start : len - 1;
+        stop = s->has_stop ? s->stop : -len - 1;
+        if (start < 0) start = start + len < 0 ? -1 : start + len;
+        if (stop < 0) stop = stop + len < 0 ? -1 : stop + len;
+        if (start >= len) start = len - 1;
+        if (stop >= len) stop = len - 1;
+        *count = start > stop ? (start - stop - step - 1) / -step : 0;
+    }
+    *first = start;
+    return 0;
+}
+
+NR_PUBLIC Node*
+NChunk_Get(NChunkFile* cf, NIndexRuleSet* rs){
+    int nd = cf->ndim;
+    nr_intp lo[NR_NODE_MAX_NDIM], box[NR_NODE_MAX_NDIM];
+    for (int i = 0; i < nd; i++) {
+        lo[i] = 0;
+        box[i] = cf->shape[i];
+    }
+
+    // axes the rules consume, to size an ellipsis
+    int used = 0;
+    for (int r = 0; r < rs->num_rules; r++) {
+        NIndexRule* rule = &rs->rules[r];
+        if (rule->type == NIndexRuleType_Int || rule->type == NIndexRuleType_Slice) {
+            used++;
+        }
+        else if (rule->type == NIndexRuleType_Node) {
+            Node* idx = rule->data.node_data.node;
+            used += NODE_DTYPE(idx) == NR_BOOL ? idx->ndim : 1;
+        }
+    }
+
+    // same rules, relative to the box
+    NIndexRuleSet local = *rs;
+    int axis = 0;
+    for (int r = 0; r < rs->num_rules && axis <= nd; r++) {
+        NIndexRule* rule = &local.rules[r];
+        if (rule->type == NIndexRuleType_Ellipsis) {
+            axis += nd - used > 0 ? nd - used : 0;
+        }
+        else if (rule->type == NIndexRuleType_Node) {
+            Node* idx = rule->data.node_data.node;
+            axis += NODE_DTYPE(idx) == NR_BOOL ? idx->ndim : 1;
+        }
+        else if (rule->type == NIndexRuleType_Int && axis < nd) {
+            nr_intp i = rule->data.int_data.index;
+            if (i < 0) {
+                i += cf->shape[axis];
+            }
+            if (i < 0 || i >= cf->shape[axis]) {
+                return NError_RaiseError(NError_IndexError,
+                    "index %lld is out of bounds for axis %d with size %lld",
+                    (long long)rule->data.int_data.index, axis, (long long)cf->shape[axis]);
+            }
+            lo[axis] = i;
+            box[axis] = 1;
+            rule->data.int_data.index = 0;
+            axis++;
+        }
+        else if (rule->type == NIndexRuleType_Slice && axis < nd) {
+            NIndexSlice* s = &rule->data.slice_data;
+            nr_intp first, count;
+            if (nchunk_slice(s, cf->shape[axis], &first, &count) != 0) {
+                return NULL;
+            }
+            if (count == 0) {
+                lo[axis] = 0;
+                box[axis] = 0;
+                s->start = 0;
+                s->stop = 0;
+                s->step = 1;
+                s->has_start = s->has_stop = 1;
+            }
+            else {
+                nr_intp last = first + (count - 1) * s->step;
+                lo[axis] = first < last ? first : last;
+                box[axis] = (first < last ? last : first) - lo[axis] + 1;
+                // the box ends exactly on the last item, the stop is open
+                s->start = first - lo[axis];
+                s->has_start = 1;
+                s->has_stop = 0;
+            }
+            axis++;
+        }
+    }
+
+    Node* boxed = nchunk_read_box(cf, lo, box);
+    if (!boxed) {
+        return NULL;
+    }
+    Node* out = Node_Get(boxed, &local);
+    Node_Free(boxed);
+    return out;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Reductions                                                               */
+/* ------------------------------------------------------------------------ */
+
+NR_PUBLIC Node*
+NChunk_Sum(NChunkFile* cf, int* axis, int na){
+    int nd = cf->ndim;
+    int reduced[NR_NODE_MAX_NDIM];
+    for (int i = 0; i < nd; i++) {
+        reduced[i] = na == 0;
+    }
+    for (int k = 0; k < na; k++) {
+        int a = axis[k] < 0 ? axis[k] + nd : axis[k];
+        if (a < 0 || a >= nd) {
+            return NError_RaiseError(NError_ValueError,
+                "reduce axis %d out of bounds for array of dimension %d", axis[k], nd);
+        }
+        reduced[a] = 1;
+    }
+    nr_intp out_shape[NR_NODE_MAX_NDIM];
+    nr_intp keep_shape[NR_NODE_MAX_NDIM];
+    int out_nd = 0;
+    for (int i = 0; i < nd; i++) {
+        keep_shape[i] = reduced[i] ? 1 : cf->shape[i];
+        if (!reduced[i]) {
+            out_shape[out_nd++] = cf->shape[i];
+        }
+    }
+
+    if (cf->nchunks == 0) {
+        Node* empty = Node_NewEmpty(nd, cf->shape, cf->dtype);
+        Node* out = empty ? NMath_Sum(NULL, empty, axis, na) : NULL;
+        Node_Free(empty);
+        return out;
+    }
+
+    // partial sums with the reduced axes kept, added into their slot
+    Node* acc = NULL;
+    for (nr_intp k = 0; k < cf->nchunks; k++) {
+        nr_intp shape[NR_NODE_MAX_NDIM], origin[NR_NODE_MAX_NDIM];
+        NChunk_ChunkShape(cf, k, shape, origin);
+        Node* chunk = NChunk_ReadChunk(cf, k);
+        Node* part = chunk ? NMath_Sum(NULL, chunk, axis, na) : NULL;
+        Node_Free(chunk);
+        if (!part) {
+            Node_Free(acc);
+            return NULL;
+        }
+        if (!acc) {
+            acc = Node_NewEmpty(nd, keep_shape, NODE_DTYPE(part));
+            if (!acc) {
+                Node_Free(part);
+                return NULL;
+            }
+            memset(NODE_DATA(acc), 0, Node_NItems(acc) * NODE_ITEMSIZE(acc));
+        }
+        nr_intp slot = 0;
+        for (int i = 0; i < nd; i++) {
+            if (reduced[i]) {
+                shape[i] = 1;
+            }
+            else {
+                slot += origin[i] * acc->strides[i];
+            }
+        }
+        Node* dst = Node_NewChild(acc, nd, shape, acc->strides, slot);
+        Node* src = Node_NewChild(part, nd, shape, NULL, 0);
+        Node* sum = dst && src ? NMath_Add(dst, dst, src) : NULL;
+        Node_Free(dst);
+        Node_Free(src);
+        Node_Free(part);
+        if (!sum) {
+            Node_Free(acc);
+            return NULL;
+        }
+    }
+    return Node_Reshape(acc, out_shape, out_nd, 1);
+}
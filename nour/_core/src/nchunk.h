@@ -0,0 +1,115 @@
+#ifndef NR__CORE__SRC__NCHUNK_H
+#define NR__CORE__SRC__NCHUNK_H
+
+#include "nour/nour.h"
+#include "getset.h"
+
+/*
+ * Chunked array files, for arrays that do not fit in memory.
+ *
+ * The array is cut into a grid of chunks of a fixed shape (edge chunks
+ * are clipped to the array) and every chunk is stored on its own,
+ * compressed, so a read only decodes the chunks it touches. One file
+ * holds a small header, the chunk table and the chunk data:
+ *
+ *   "NRCHUNK1", u32 dtype, u32 codec, u32 ndim, u32 0,
+ *   u64 shape[ndim], u64 chunk_shape[ndim],
+ *   { u64 offset, u64 size } per chunk in C order of the grid,
+ *   chunk data
+ *
+ * all little-endian. A chunk holds its items in C order; its size equals
+ * the raw size when it is stored uncompressed and is 0 for chunks never
+ * written, which read as zeros.
+ *
+ * An NChunkFile is not safe to use from several threads at once.
+ */
+
+typedef enum{
+    NCHUNK_CODEC_NONE = 0,
+    /*
+     * Bytes of each item split into planes (all first bytes, then all
+     * second bytes, ...) and run-length coded. Cheap, and effective on
+     * smooth or sparse data where the high bytes repeat. Chunks that do
+     * not shrink are stored raw.
+     */
+    NCHUNK_CODEC_SHUFFLE_RLE,
+}NChunk_Codec;
+
+/* Target chunk size when no chunk shape is given */
+#define NCHUNK_DEFAULT_BYTES (1 << 20)
+
+typedef struct{
+    void* file;                 // FILE*
+    int writable;
+    NR_DTYPE dtype;
+    nr_intp itemsize;
+    NChunk_Codec codec;
+    int ndim;
+    nr_intp shape[NR_NODE_MAX_NDIM];
+    nr_intp chunks[NR_NODE_MAX_NDIM];   // chunk shape
+    nr_intp grid[NR_NODE_MAX_NDIM];     // chunks along each axis
+    nr_intp nchunks;
+    nr_uint64* offsets;
+    nr_uint64* sizes;
+}NChunkFile;
+
+/*
+ * Creates (or truncates) `path` for an array of `shape` and `dtype`.
+ * `chunk_shape` may be NULL to pick chunks of about NCHUNK_DEFAULT_BYTES,
+ * split along the leading axes. Chunks are then written one by one with
+ * NChunk_WriteChunk. Returns NULL with an error raised on failure.
+ */
+NR_PUBLIC NChunkFile*
+NChunk_Create(const char* path, int ndim, const nr_intp* shape, NR_DTYPE dtype,
+              const nr_intp* chunk_shape, NChunk_Codec codec);
+
+/* Opens an existing file for reading. */
+NR_PUBLIC NChunkFile*
+NChunk_Open(const char* path);
+
+/*
+ * Writes the chunk table of a created file and closes it. Returns 0, or
+ * -1 with an error raised (the file is closed either way).
+ */
+NR_PUBLIC int
+NChunk_Close(NChunkFile* cf);
+
+/* Shape of chunk `index` (C order of the grid), clipped at the edges. */
+NR_PUBLIC void
+NChunk_ChunkShape(const NChunkFile* cf, nr_intp index, nr_intp* shape, nr_intp* origin);
+
+/*
+ * Compresses `node` and stores it as chunk `index`. `node` must have the
+ * chunk's shape and the file's dtype, any layout. Writing a chunk twice
+ * keeps the last version; the space of the first one is not reused.
+ */
+NR_PUBLIC int
+NChunk_WriteChunk(NChunkFile* cf, nr_intp index, const Node* node);
+
+/* Decodes chunk `index` into a new C-contiguous node. */
+NR_PUBLIC Node*
+NChunk_ReadChunk(NChunkFile* cf, nr_intp index);
+
+/*
+ * Node_Get on the stored array. Only the chunks that overlap the box
+ * spanned by the index are read and decoded. Integer and slice rules
+ * narrow the box, a node index (fancy or mask) reads its whole axis.
+ */
+NR_PUBLIC Node*
+NChunk_Get(NChunkFile* cf, NIndexRuleSet* rs);
+
+/*
+ * NMath_Sum over the stored array, one chunk in memory at a time: every
+ * chunk is summed over `axis` and added into the result. Float results
+ * can differ from NMath_Sum on the whole array in the last bits, since
+ * the items are added in another order.
+ */
+NR_PUBLIC Node*
+NChunk_Sum(NChunkFile* cf, int* axis, int na);
+
+/* Writes `node` to `path` in chunks, see NChunk_Create. */
+NR_PUBLIC int
+Node_SaveChunked(const Node* node, const char* path, const nr_intp* chunk_shape,
+                 NChunk_Codec codec);
+
+#endif // NR__CORE__SRC__NCHUNK_H
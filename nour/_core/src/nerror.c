@@ -3,7 +3,7 @@
 #include <stdarg.h>
 #include <string.h>
 
-NError __NR_NERROR_GLOBAL_ERROR_VAR__ = {
+NR_TLS NError __NR_NERROR_GLOBAL_ERROR_VAR__ = {
     .type = NError_NoError,
     .context = ""
 };
@@ -96,3 +96,25 @@ NError_RaiseErrorNoContext(NError_Type type) {
     NERROR_CONTEXT[0] = '\0';
     return NULL;
 }
+
+NR_PUBLIC int
+NError_Fetch(NError* err) {
+    int is_error = NERROR_TYPE != NError_NoError;
+    if (err) {
+        err->type = NERROR_TYPE;
+        memcpy(err->context, NERROR_CONTEXT, NERROR_MAX_STRING_LEN);
+    }
+    NError_Clear();
+    return is_error;
+}
+
+NR_PUBLIC void
+NError_Restore(const NError* err) {
+    if (!err || err->type == NError_NoError) {
+        NError_Clear();
+        return;
+    }
+    NERROR_TYPE = err->type;
+    memcpy(NERROR_CONTEXT, err->context, NERROR_MAX_STRING_LEN);
+    NERROR_CONTEXT[NERROR_MAX_STRING_LEN - 1] = '\0';
+}
@@ -18,6 +18,22 @@ NError_Clear();
 NR_PUBLIC void* 
 NError_RaiseErrorNoContext(NError_Type type);
 
+/*
+    Moves the calling thread's error into `err` (may be NULL) and clears
+    it. Returns 1 if there was an error, 0 otherwise.
+    Together with NError_Restore this carries an error raised on a worker
+    thread back to the thread that is waiting for it.
+*/
+NR_PUBLIC int
+NError_Fetch(NError* err);
+
+/*
+    Sets the calling thread's error to `err`, as captured by NError_Fetch.
+    A NULL `err` or one with no error clears the error state.
+*/
+NR_PUBLIC void
+NError_Restore(const NError* err);
+
 // Convenience functions remain in header
 NR_HEADER void* NError_RaiseMemoryError() {
     return NError_RaiseErrorNoContext(NError_MemoryError);
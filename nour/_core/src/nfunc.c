@@ -5,6 +5,8 @@
 #include "node_core.h"
 #include "free.h"
 #include "tc_methods.h"
+#include "nlazy.h"
+#include "ngrad.h"
 
 #define DT_VALID(dtype) NDtype_IsValid(dtype)
 #define SELF_CREATED_OUT_NODES_STACK_SIZE 16
@@ -53,16 +55,38 @@ check_in_nums(const NFunc* nfunc, NFuncArgs* args){
     return 0;
 }
 
-NR_PRIVATE int
-understand_dtypes(const NFunc* nfunc, NFuncArgs* args, NR_DTYPE* in_dtype ,NR_DTYPE* out_dtype){
-    int flags = nfunc->flags;
-    int type_broadcastable = flags & NFUNC_FLAG_TYPE_BROADCASTABLE;
-
+/*
+ * In/out dtypes of the call from the input dtypes, once they passed the
+ * nfunc->in_dtype check.
+ */
+NR_PRIVATE void
+resolve_signature(const NFunc* nfunc, const NR_DTYPE* dtypes, int nin,
+                  NR_DTYPE* in_dtype, NR_DTYPE* out_dtype){
+    int type_broadcastable = nfunc->flags & NFUNC_FLAG_TYPE_BROADCASTABLE;
     int in_type = nfunc->in_type;
-    int out_type = nfunc->out_type;
 
+    if (DT_VALID(nfunc->in_dtype)){
+        *in_dtype = nfunc->in_dtype;
+    }
+    else if (type_broadcastable || in_type == NDTYPE_NONE){
+        // input dtypes is the broadcasted dtype of all inputs
+        NR_DTYPE broadcasted_dtype = dtypes[0];
+        for (int i = 1; i < nin; i++){
+            broadcasted_dtype = NTools_BroadcastDtypes(broadcasted_dtype, dtypes[i]);
+        }
+        *in_dtype = resolve_dtype(broadcasted_dtype, in_type);
+    }
+    else{
+        // input dtypes is resolved from the type constraint
+        *in_dtype = resolve_dtype(-1, in_type);
+    }
+
+    *out_dtype = DT_VALID(nfunc->out_dtype) ? nfunc->out_dtype : resolve_dtype(*in_dtype, nfunc->out_type);
+}
+
+NR_PRIVATE int
+understand_dtypes(const NFunc* nfunc, NFuncArgs* args, NR_DTYPE* in_dtype ,NR_DTYPE* out_dtype){
     NR_DTYPE in_dtype_local = nfunc->in_dtype;
-    NR_DTYPE out_dtype_local = nfunc->out_dtype;
 
     // Start with checking input dtypes
     if (DT_VALID(in_dtype_local)){
@@ -81,27 +105,94 @@ understand_dtypes(const NFunc* nfunc, NFuncArgs* args, NR_DTYPE* in_dtype ,NR_DT
                 return -1;
             }
         }
+    }
 
-        *in_dtype = in_dtype_local;
+    NR_DTYPE dtypes[2];
+    NR_DTYPE* pdtypes = dtypes;
+    if (args->nin > 2){
+        pdtypes = (NR_DTYPE*)malloc(sizeof(NR_DTYPE) * args->nin);
+        if (!pdtypes){
+            NError_RaiseMemoryError();
+            return -1;
+        }
     }
-    else{
-        if (type_broadcastable || in_type == NDTYPE_NONE){
-            // input dtypes is the broadcasted dtype of all inputs
-            NR_DTYPE broadcasted_dtype = NODE_DTYPE(args->in_nodes[0]);
-            for (int i = 1; i < args->nin; i++){
-                broadcasted_dtype = NTools_BroadcastDtypes(broadcasted_dtype, NODE_DTYPE(args->in_nodes[i]));
+    for (int i = 0; i < args->nin; i++){
+        pdtypes[i] = NODE_DTYPE(args->in_nodes[i]);
+    }
+    resolve_signature(nfunc, pdtypes, args->nin, in_dtype, out_dtype);
+    if (pdtypes != dtypes){
+        free(pdtypes);
+    }
+    return 0;
+}
+
+/*
+ * Dispatch tables (NFunc.dispatch)
+ * --------------------------------
+ * The dtypes resolved by understand_dtypes depend only on the input
+ * dtypes, so functions with one or two inputs can resolve every signature
+ * up front. The kernel of a signature is nfunc->kernels at the dtype the
+ * kernels see: the resolved input dtype when inputs are promoted or cast
+ * to it (NFUNC_FLAG_TYPE_BROADCASTABLE), the first input's dtype otherwise.
+ */
+NR_PRIVATE void
+fill_dispatch(const NFunc* nfunc, NFuncDispatch* d){
+    int n1 = nfunc->nin == 2 ? NR_NUM_NUMIRC_DT : 1;
+    for (int i = 0; i < NR_NUM_NUMIRC_DT; i++){
+        for (int j = 0; j < n1; j++){
+            NFuncDispatchEntry* e = &d->entries[i * NR_NUM_NUMIRC_DT + j];
+            NR_DTYPE dtypes[2] = {(NR_DTYPE)i, (NR_DTYPE)j};
+            e->in_dtype = NR_NONE;
+            e->out_dtype = NR_NONE;
+            e->func = nfunc->func;
+            if (DT_VALID(nfunc->in_dtype)
+                && (dtypes[0] != nfunc->in_dtype || (nfunc->nin == 2 && dtypes[1] != nfunc->in_dtype))){
+                continue;
+            }
+            resolve_signature(nfunc, dtypes, nfunc->nin, &e->in_dtype, &e->out_dtype);
+            NR_DTYPE kdt = (nfunc->flags & NFUNC_FLAG_TYPE_BROADCASTABLE) ? e->in_dtype : dtypes[0];
+            if (nfunc->kernels && DT_VALID(kdt) && nfunc->kernels[kdt]){
+                e->func = nfunc->kernels[kdt];
             }
-            *in_dtype = resolve_dtype(broadcasted_dtype, in_type);
+        }
+    }
+}
+
+NR_PRIVATE const NFuncDispatchEntry*
+lookup_dispatch(const NFunc* nfunc, const NFuncArgs* args){
+    NFuncDispatch* d = nfunc->dispatch;
+    if (!d || (nfunc->nin != 1 && nfunc->nin != 2) || (nfunc->flags & NFUNC_FLAG_NO_DATA)){
+        return NULL;
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    if (__atomic_load_n(&d->state, __ATOMIC_ACQUIRE) != 2){
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&d->state, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            fill_dispatch(nfunc, d);
+            __atomic_store_n(&d->state, 2, __ATOMIC_RELEASE);
         }
         else{
-            // input dtypes is resolved from the type constraint
-            NR_DTYPE resolved_dtype = resolve_dtype(-1, in_type);
-            *in_dtype = resolved_dtype;
+            // another thread is filling it, resolve this call the slow way
+            return NULL;
         }
     }
+#else
+    // no worker pool without GNU atomics (see nthread.c), as in nsimd_ensure_init
+    if (d->state != 2){
+        fill_dispatch(nfunc, d);
+        d->state = 2;
+    }
+#endif
 
-    *out_dtype = DT_VALID(out_dtype_local) ? out_dtype_local : resolve_dtype(*in_dtype, out_type);
-    return 0;
+    NR_DTYPE a = NODE_DTYPE(args->in_nodes[0]);
+    NR_DTYPE b = nfunc->nin == 2 ? NODE_DTYPE(args->in_nodes[1]) : 0;
+    if (!DT_VALID(a) || !DT_VALID(b)){
+        return NULL;
+    }
+    const NFuncDispatchEntry* e = &d->entries[a * NR_NUM_NUMIRC_DT + b];
+    return DT_VALID(e->in_dtype) ? e : NULL;
 }
 
 /*
@@ -234,14 +325,16 @@ clear_self_created_out_nodes_info(NFuncArgs* args, int so[], int* so2, int user_
  *  - If dtype promotion is required, create promoted copies (Node_ToType).
  *  - On any internal failure it frees any already created promoted nodes and the array.
  *  - Returns the `promoted_nodes` array on success (caller must free with clear_broadcasted_nodes).
- *  - Returns args->in_nodes itself if no promotion required.
+ *  - Returns args->in_nodes itself if no promotion required, or if the
+ *    kernels cast their inputs themselves (NFUNC_FLAG_CAST_IN_LOOP).
  */
 NR_PRIVATE Node**
 broadcast_nodes(const NFunc* nfunc, NFuncArgs* args, NR_DTYPE in_dtype){
     int nin = nfunc->nin;
     int flags = nfunc->flags;
     int broadcastable = flags & NFUNC_FLAG_TYPE_BROADCASTABLE;
-    if (!broadcastable || nin <= 0 || !DT_VALID(in_dtype)){
+    if (!broadcastable || nin <= 0 || !DT_VALID(in_dtype)
+        || (flags & NFUNC_FLAG_CAST_IN_LOOP)){
         return args->in_nodes;
     }
 
@@ -289,19 +382,56 @@ clear_broadcasted_nodes(const NFunc* nfunc, Node** original_nodes, Node** promot
     free(promoted_nodes);
 }
 
+/*
+ * check_record_aliasing:
+ *  - A recorded call keeps references to its inputs, so an output node that is also
+ *    an input would reference itself. Raises before anything is computed.
+ */
+NR_PRIVATE int
+check_record_aliasing(const NFunc* nfunc, NFuncArgs* args){
+    for (int i = 0; i < args->nout; i++){
+        for (int j = 0; j < args->nin; j++){
+            if (args->out_nodes[i] && args->out_nodes[i] == args->in_nodes[j]){
+                NError_RaiseError(
+                    NError_ValueError,
+                    "%s: an in-place operation on a node that needs a gradient can not be recorded",
+                    nfunc->name
+                );
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
 /*
  * track_out_node_if_needed:
  *  - If output nodes are tracked, registers the function info to the nodes.
+ *  - With `record` (see NGrad_Records) the outputs become tracked first.
+ *  - Outputs that are also inputs are not registered, they would reference themselves.
  *  - On failure it will unregister any nodes that were registered in this call.
  */
 NR_PRIVATE int
-track_out_node_if_needed(const NFunc* nfunc, NFuncArgs* args){
+track_out_node_if_needed(const NFunc* nfunc, NFuncArgs* args, int record){
     if (!args->out_nodes || args->nout <= 0){
         return 0;
     }
 
     for (int i = 0; i < args->nout; i++){
         Node* out_node = args->out_nodes[i];
+        if (!out_node){
+            continue;
+        }
+        int aliased = 0;
+        for (int j = 0; j < args->nin; j++){
+            aliased |= out_node == args->in_nodes[j];
+        }
+        if (aliased){
+            continue;
+        }
+        if (record){
+            out_node->flags |= NR_NODE_TRACK;
+        }
         if (NODE_IS_TRACK(out_node)){
             int res = _NFuncFuncInfo_RegisterToNode(out_node, nfunc, args, i);
             if (res < 0){
@@ -366,6 +496,15 @@ _NFuncFuncInfo_RegisterToNode(Node* node, const NFunc* nfunc, NFuncArgs* args, i
         return -1;
     }
 
+    /* args->extra only lives during the call, keep what the gradient needs of it */
+    if (nfunc->grad_func && nfunc->grad_func->save
+        && nfunc->grad_func->save(args, &new_nfunc_info->saved) < 0){
+        _NFuncFuncInfo_Free(new_nfunc_info);
+        return -1;
+    }
+    new_nfunc_info->replayable = !args->extra
+        || (nfunc->grad_func && nfunc->grad_func->saved_is_extra && new_nfunc_info->saved);
+
     /* Assign the created info to the node. Ownership transferred to the node. */
     node->nfunc_info = (struct NFuncFuncInfo*)new_nfunc_info;
     return 0;
@@ -376,10 +515,36 @@ _NFuncFuncInfo_Free(NFuncFuncInfo* nfunc_info){
     if (!nfunc_info){
         return;
     }
-    NFuncArgs_DECREF(nfunc_info->args);
+    if (nfunc_info->saved){
+        nfunc_info->nfunc->grad_func->release(nfunc_info->saved);
+    }
+    NFuncArgs* args = nfunc_info->args;
+    for (int i = 0; i < args->nin; i++){
+        if (args->in_nodes[i]){
+            Node_Free(args->in_nodes[i]);
+        }
+    }
+    NFuncArgs_DECREF(args);
     free(nfunc_info);
 }
 
+/* Calls that are not deferred need the data of lazy and checkpointed inputs (and outputs) */
+NR_PRIVATE int
+evaluate_lazy_nodes(NFuncArgs* args){
+    for (int i = 0; i < args->nin; i++){
+        if (Node_Materialize(args->in_nodes[i]) < 0){
+            return -1;
+        }
+    }
+    for (int i = 0; i < args->nout; i++){
+        Node* out = args->out_nodes[i];
+        if (out && Node_Materialize(out) < 0){
+            return -1;
+        }
+    }
+    return 0;
+}
+
 NR_PUBLIC int
 NFunc_Call(const NFunc* nfunc, NFuncArgs* args){
     if (!nfunc || !args){
@@ -393,6 +558,9 @@ NFunc_Call(const NFunc* nfunc, NFuncArgs* args){
 
     /* Fast path for metadata-only functions that must not touch data buffers. */
     if (nfunc->flags & NFUNC_FLAG_NO_DATA){
+        if (evaluate_lazy_nodes(args) < 0){
+            return -1;
+        }
         /* Enforce in-place semantics if declared; out node must be NULL or same pointer. */
         if (args->nout == 1){
             Node* in = args->in_nodes[0];
@@ -415,13 +583,14 @@ NFunc_Call(const NFunc* nfunc, NFuncArgs* args){
         } else {
             args->outtype = NR_NONE;
         }
+        args->intype = args->outtype;
 
         int result = nfunc->func(args);
         if (result < 0){
             return -1;
         }
         /* Tracking still allowed. */
-        if (track_out_node_if_needed(nfunc, args) < 0){
+        if (track_out_node_if_needed(nfunc, args, 0) < 0){
             return -1;
         }
         return result;
@@ -429,10 +598,29 @@ NFunc_Call(const NFunc* nfunc, NFuncArgs* args){
 
     NR_DTYPE in_dtype = -1;
     NR_DTYPE out_dtype = -1;
-    if (understand_dtypes(nfunc, args, &in_dtype, &out_dtype) < 0){
+    NFuncFunc func = nfunc->func;
+    const NFuncDispatchEntry* entry = lookup_dispatch(nfunc, args);
+    if (entry){
+        in_dtype = entry->in_dtype;
+        out_dtype = entry->out_dtype;
+        func = entry->func;
+    }
+    else if (understand_dtypes(nfunc, args, &in_dtype, &out_dtype) < 0){
+        return -1;
+    }
+
+    int record = NGrad_Records(nfunc, args->in_nodes, args->nin);
+    if (record && check_record_aliasing(nfunc, args) < 0){
+        return -1;
+    }
+    if (!record && NLazy_IsEnabled() && NLazy_CanDefer(nfunc, args, in_dtype)){
+        return NLazy_Defer(nfunc, args, in_dtype, out_dtype);
+    }
+    if (evaluate_lazy_nodes(args) < 0){
         return -1;
     }
     args->outtype = out_dtype;
+    args->intype = in_dtype;
 
     int so[SELF_CREATED_OUT_NODES_STACK_SIZE];
     int* so2 = NULL;
@@ -452,7 +640,7 @@ NFunc_Call(const NFunc* nfunc, NFuncArgs* args){
     Node** original_nodes = args->in_nodes;
     args->in_nodes = broadcasted_nodes;
     
-    int result = nfunc->func(args);
+    int result = func(args);
 
     /* restore original inputs and free promoted nodes */
     args->in_nodes = original_nodes;
@@ -465,7 +653,7 @@ NFunc_Call(const NFunc* nfunc, NFuncArgs* args){
     }
 
     /* Register tracking info if needed. If that fails, rollback outputs created by this call */
-    if (track_out_node_if_needed(nfunc, args) < 0){
+    if (track_out_node_if_needed(nfunc, args, record) < 0){
         clear_self_created_out_nodes_info(args, so, so2, user_nout);
         return -1;
     }
@@ -522,6 +710,7 @@ NFuncArgs_New(int nin, int nout)
     }
 
     args->outtype = NR_NONE;
+    args->intype = NR_NONE;
     args->extra = NULL;
     args->__ref_count = 1;
     return args;
@@ -557,6 +746,13 @@ _NFuncFuncInfo_New(const NFunc* nfunc, NFuncArgs* args, int out_idx){
     nfunc_info->nfunc = nfunc;
     nfunc_info->args = args;
     nfunc_info->out_idx = out_idx;
+    nfunc_info->saved = NULL;
+    nfunc_info->replayable = 0;
     NFuncArgs_INCREF(args);
+    for (int i = 0; i < args->nin; i++){
+        if (args->in_nodes[i]){
+            NODE_INCREF(args->in_nodes[i]);
+        }
+    }
     return nfunc_info;
 }
@@ -0,0 +1,832 @@
+#include "ngrad.h"
+#include "nfunc.h"
+#include "node_core.h"
+#include "ntools.h"
+#include "nerror.h"
+#include "free.h"
+#include "nlazy.h"
+#include "nmem.h"
+#include "tc_methods.h"
+#include "./nmath/nmath.h"
+#include "./nmath/reduce.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NGRAD_STACK_NIN 8
+
+NR_PRIVATE NR_TLS int __ngrad_enabled = 1;
+
+NR_PUBLIC int
+NGrad_SetEnabled(int enabled){
+    int prev = __ngrad_enabled;
+    __ngrad_enabled = enabled != 0;
+    return prev;
+}
+
+NR_PUBLIC int
+NGrad_IsEnabled(void){
+    return __ngrad_enabled;
+}
+
+NR_PUBLIC int
+NGrad_Records(const NFunc* nfunc, Node* const* in_nodes, int nin){
+    if (!__ngrad_enabled || !(nfunc->flags & NFUNC_FLAG_GRADIENT) || !nfunc->grad_func){
+        return 0;
+    }
+    for (int i = 0; i < nin; i++){
+        if (NGrad_Needed(in_nodes[i])){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Graph of one backward pass
+ * --------------------------
+ * Every node that needs a gradient gets an entry, found through an
+ * open-addressing table keyed by the node's address. `pending` counts the
+ * input slots of recorded calls that still owe the node a part of its
+ * gradient; the node is visited once it drops to 0, after all of its
+ * consumers.
+ */
+typedef struct{
+    Node* node;             // referenced for the whole pass
+    Node* grad;             // sum of the parts so far, NULL before the first one
+    int pending;
+    int has_call;           // the node's recorded call is differentiated
+    int released;           // released by Node_Checkpoint when the pass started
+}grad_entry;
+
+typedef struct{
+    grad_entry* entries;
+    int n, cap;
+    int* table;             // entry index + 1, 0 for an empty slot
+    int mask;               // table size - 1, the table stays at most half full
+}grad_graph;
+
+NR_STATIC_INLINE int
+graph_slot(const grad_graph* g, const Node* node){
+    uint64_t h = (uint64_t)(uintptr_t)node * 0x9E3779B97F4A7C15ull;
+    int slot = (int)(h >> 40) & g->mask;
+    while (g->table[slot] && g->entries[g->table[slot] - 1].node != node){
+        slot = (slot + 1) & g->mask;
+    }
+    return slot;
+}
+
+NR_PRIVATE int
+graph_find(const grad_graph* g, const Node* node){
+    return g->table[graph_slot(g, node)] - 1;
+}
+
+NR_PRIVATE int
+node_has_call(const Node* node){
+    const NFuncFuncInfo* info = (const NFuncFuncInfo*)node->nfunc_info;
+    return info && !NODE_IS_LAZY(node) && info->nfunc->grad_func && info->args->nout == 1;
+}
+
+/* Adds `node` (not in the graph yet), returns its entry or -1 */
+NR_PRIVATE int
+graph_add(grad_graph* g, Node* node){
+    if (g->n == g->cap){
+        int cap = g->cap ? g->cap * 2 : 64;
+        grad_entry* entries = (grad_entry*)realloc(g->entries, sizeof(grad_entry) * cap);
+        if (!entries){
+            NError_RaiseMemoryError();
+            return -1;
+        }
+        g->entries = entries;
+        g->cap = cap;
+    }
+    if (2 * (g->n + 1) > g->mask + 1){
+        int size = g->table ? 2 * (g->mask + 1) : 128;
+        int* table = (int*)calloc(size, sizeof(int));
+        if (!table){
+            NError_RaiseMemoryError();
+            return -1;
+        }
+        free(g->table);
+        g->table = table;
+        g->mask = size - 1;
+        for (int i = 0; i < g->n; i++){
+            g->table[graph_slot(g, g->entries[i].node)] = i + 1;
+        }
+    }
+
+    int e = g->n++;
+    g->entries[e].node = node;
+    g->entries[e].grad = NULL;
+    g->entries[e].pending = 0;
+    g->entries[e].has_call = node_has_call(node);
+    g->entries[e].released = NODE_IS_RECOMPUTE(node);
+    g->table[graph_slot(g, node)] = e + 1;
+    NODE_INCREF(node);
+    return e;
+}
+
+NR_PRIVATE void
+graph_free(grad_graph* g){
+    for (int i = 0; i < g->n; i++){
+        Node_Free(g->entries[i].grad);
+        Node_Free(g->entries[i].node);
+    }
+    free(g->entries);
+    free(g->table);
+}
+
+/* Drops the pass's reference to a visited node, its entry stays as a key of the table */
+NR_PRIVATE void
+graph_forget(grad_graph* g, int e){
+    Node* node = g->entries[e].node;
+    g->entries[e].node = NULL;
+    Node_Free(node);
+}
+
+/* Collects every node below `root` that needs a gradient, depth first with an explicit stack */
+NR_PRIVATE int
+graph_collect(grad_graph* g, Node* root){
+    if (graph_add(g, root) < 0){
+        return -1;
+    }
+    int* stack = (int*)malloc(sizeof(int) * 64);
+    int nstack = 0, cap = 64;
+    if (!stack){
+        NError_RaiseMemoryError();
+        return -1;
+    }
+    stack[nstack++] = 0;
+
+    while (nstack > 0){
+        int e = stack[--nstack];
+        if (!g->entries[e].has_call){
+            continue;
+        }
+        NFuncArgs* args = ((NFuncFuncInfo*)g->entries[e].node->nfunc_info)->args;
+        for (int i = 0; i < args->nin; i++){
+            Node* in = args->in_nodes[i];
+            if (!NGrad_Needed(in)){
+                continue;
+            }
+            int k = graph_find(g, in);
+            if (k < 0){
+                k = graph_add(g, in);
+                if (k < 0){
+                    free(stack);
+                    return -1;
+                }
+                if (nstack == cap){
+                    int* grown = (int*)realloc(stack, sizeof(int) * cap * 2);
+                    if (!grown){
+                        free(stack);
+                        NError_RaiseMemoryError();
+                        return -1;
+                    }
+                    stack = grown;
+                    cap *= 2;
+                }
+                stack[nstack++] = k;
+            }
+            g->entries[k].pending++;
+        }
+    }
+
+    free(stack);
+    return 0;
+}
+
+/*
+ * Gradient tensors
+ * ----------------
+ * A gradient is summed in place when nothing else can see its buffer:
+ * the pass holds the only reference and the node owns its data. Parts
+ * that are views or still referenced elsewhere (the output gradient an
+ * add passes through, the caller's seed) are summed into a new buffer.
+ */
+NR_STATIC_INLINE int
+grad_owned(const Node* node){
+    return NODE_REFCOUNT(node) == 1 && NODE_IS_OWNDATA(node) && !node->base
+        && !node->deleter && NODE_IS_WRITABLE(node);
+}
+
+/* Reshapes a fresh C-contiguous node in place, as shape.c does */
+NR_PRIVATE int
+grad_reshape(Node* node, int ndim, const nr_intp* shape){
+    if (ndim != node->ndim && Node_AllocDims(node, ndim) != 0){
+        return -1;
+    }
+    memcpy(node->shape, shape, sizeof(nr_intp) * ndim);
+    NTools_CalculateStrides(ndim, node->shape, NODE_ITEMSIZE(node), node->strides);
+    node->ndim = ndim;
+    Node_UpdateContiguity(node);
+    return 0;
+}
+
+/* `part` (consumed) summed over the axes `node` was broadcast along and cast to its dtype */
+NR_PRIVATE Node*
+grad_fit(Node* part, const Node* node){
+    if (!Node_SameShape(part, node)){
+        int lead = part->ndim - node->ndim;
+        int axes[NR_NODE_MAX_NDIM];
+        int na = 0;
+        int ok = lead >= 0;
+        for (int i = 0; ok && i < part->ndim; i++){
+            if (i < lead){
+                axes[na++] = i;
+            }
+            else if (node->shape[i - lead] != part->shape[i]){
+                ok = node->shape[i - lead] == 1;
+                axes[na++] = i;
+            }
+        }
+        if (!ok){
+            NError_RaiseError(NError_ValueError,
+                "gradient of ndim %d does not broadcast to its input of ndim %d",
+                part->ndim, node->ndim);
+            Node_Free(part);
+            return NULL;
+        }
+        Node* summed = NMath_Sum(NULL, part, axes, na);
+        Node_Free(part);
+        if (!summed){
+            return NULL;
+        }
+        if (grad_reshape(summed, node->ndim, node->shape) < 0){
+            Node_Free(summed);
+            return NULL;
+        }
+        part = summed;
+    }
+
+    if (NODE_DTYPE(part) != NODE_DTYPE(node)){
+        Node* cast = Node_ToType(NULL, part, NODE_DTYPE(node));
+        Node_Free(part);
+        part = cast;
+    }
+    return part;
+}
+
+/* Adds `part` (consumed) to the gradient of `e` */
+NR_PRIVATE int
+grad_accumulate(grad_entry* e, Node* part){
+    if (!e->grad){
+        e->grad = part;
+        return 0;
+    }
+
+    Node* sum;
+    if (grad_owned(e->grad)){
+        sum = NMath_Add(e->grad, e->grad, part);
+    }
+    else if (grad_owned(part)){
+        sum = NMath_Add(part, e->grad, part);
+    }
+    else{
+        sum = NMath_Add(NULL, e->grad, part);
+    }
+    if (!sum){
+        Node_Free(part);
+        return -1;
+    }
+    if (sum != part){
+        Node_Free(part);
+    }
+    if (sum != e->grad){
+        Node_Free(e->grad);
+    }
+    e->grad = sum;
+    return 0;
+}
+
+/* Adds the gradient `grad` (consumed) of the leaf `node` into node->grad */
+NR_PRIVATE int
+grad_store(Node* node, Node* grad){
+    if (node->grad){
+        Node* sum = NMath_Add(node->grad, node->grad, grad);
+        Node_Free(grad);
+        return sum ? 0 : -1;
+    }
+    if (!grad_owned(grad) || !NODE_IS_CONTIGUOUS(grad)){
+        Node* copy = Node_Copy(NULL, grad);
+        Node_Free(grad);
+        if (!copy){
+            return -1;
+        }
+        grad = copy;
+    }
+    node->grad = grad;
+    return 0;
+}
+
+/* Gradient of the root: `grad` cast to its dtype, or ones */
+NR_PRIVATE Node*
+grad_seed(Node* node, Node* grad){
+    if (grad){
+        if (!Node_SameShape(grad, node)){
+            NError_RaiseError(NError_ValueError,
+                "Node_Backward: gradient shape does not match the node shape");
+            return NULL;
+        }
+        if (NODE_DTYPE(grad) != NODE_DTYPE(node)){
+            return Node_ToType(NULL, grad, NODE_DTYPE(node));
+        }
+        NODE_INCREF(grad);
+        return grad;
+    }
+
+    Node* ones = Node_NewEmpty(node->ndim, node->shape, NODE_DTYPE(node));
+    if (!ones){
+        return NULL;
+    }
+    nr_intp n = Node_NItems(ones);
+    if (NODE_DTYPE(ones) == NR_FLOAT32){
+        for (nr_intp i = 0; i < n; i++) ((nr_float32*)NODE_DATA(ones))[i] = 1.0f;
+    }
+    else{
+        for (nr_intp i = 0; i < n; i++) ((nr_float64*)NODE_DATA(ones))[i] = 1.0;
+    }
+    return ones;
+}
+
+/* Calls the GradFunc recorded on `node`, filling `parts` (one per input, NULL first) */
+NR_PRIVATE int
+grad_call(Node* node, Node* grad, Node** parts){
+    NFuncFuncInfo* info = (NFuncFuncInfo*)node->nfunc_info;
+    NFuncArgs* args = info->args;
+    const GradFunc* gf = info->nfunc->grad_func;
+    GradFuncFunc func = NODE_DTYPE(grad) == NR_FLOAT32 ? gf->grad_func_float32 : gf->grad_func_float64;
+    if (!func){
+        NError_RaiseError(NError_TypeError, "%s has no gradient for dtype %d",
+                          info->nfunc->name, NODE_DTYPE(grad));
+        return -1;
+    }
+
+    Node* in_stack[NGRAD_STACK_NIN + 2];
+    Node** in_nodes = in_stack;
+    if (args->nin > NGRAD_STACK_NIN){
+        in_nodes = (Node**)malloc(sizeof(Node*) * (args->nin + 2));
+        if (!in_nodes){
+            NError_RaiseMemoryError();
+            return -1;
+        }
+    }
+    memcpy(in_nodes, args->in_nodes, sizeof(Node*) * args->nin);
+    in_nodes[args->nin] = node;
+    in_nodes[args->nin + 1] = grad;
+
+    NFuncArgs gargs = {
+        .in_nodes = in_nodes,
+        .out_nodes = parts,
+        .nin = args->nin + 2,
+        .nout = args->nin,
+        .outtype = NODE_DTYPE(grad),
+        .intype = args->intype,
+        .extra = info->saved,
+        .__ref_count = 1,
+    };
+    int result = func(&gargs);
+    if (in_nodes != in_stack){
+        free(in_nodes);
+    }
+    if (result < 0){
+        for (int i = 0; i < args->nin; i++){
+            Node_Free(parts[i]);
+            parts[i] = NULL;
+        }
+    }
+    return result;
+}
+
+/* Sends the gradient of `node` into the entries of its inputs, queueing the ones that are complete */
+NR_PRIVATE int
+grad_propagate(grad_graph* g, int e, Node* grad, int* ready, int* nready){
+    Node* node = g->entries[e].node;
+    NFuncArgs* args = ((NFuncFuncInfo*)node->nfunc_info)->args;
+    int nin = args->nin;
+    Node* parts_stack[NGRAD_STACK_NIN];
+    Node** parts = parts_stack;
+    if (nin > NGRAD_STACK_NIN){
+        parts = (Node**)malloc(sizeof(Node*) * nin);
+        if (!parts){
+            NError_RaiseMemoryError();
+            return -1;
+        }
+    }
+    for (int i = 0; i < nin; i++){
+        parts[i] = NULL;
+    }
+
+    int result = grad_call(node, grad, parts);
+    for (int i = 0; i < nin; i++){
+        Node* in = args->in_nodes[i];
+        Node* part = parts[i];
+        parts[i] = NULL;
+        if (result < 0 || !NGrad_Needed(in)){
+            Node_Free(part);
+            continue;
+        }
+        if (!part){
+            NError_RaiseError(NError_RuntimeError, "%s: no gradient for input %d",
+                              ((NFuncFuncInfo*)node->nfunc_info)->nfunc->name, i);
+            result = -1;
+            continue;
+        }
+        part = grad_fit(part, in);
+        int k = graph_find(g, in);
+        if (!part || grad_accumulate(&g->entries[k], part) < 0){
+            result = -1;
+            continue;
+        }
+        if (--g->entries[k].pending == 0){
+            ready[(*nready)++] = k;
+        }
+    }
+
+    if (parts != parts_stack){
+        free(parts);
+    }
+    return result;
+}
+
+NR_PUBLIC int
+Node_Backward(Node* node, Node* grad, int retain_graph){
+    if (!node){
+        NError_RaiseError(NError_ValueError, "Node_Backward received a NULL node");
+        return -1;
+    }
+    if (!NGrad_Needed(node)){
+        NError_RaiseError(NError_ValueError,
+            "Node_Backward: the node does not need a gradient (untracked or not float)");
+        return -1;
+    }
+    Node* seed = grad_seed(node, grad);
+    if (!seed){
+        return -1;
+    }
+
+    int prev_enabled = NGrad_SetEnabled(0);
+    int prev_lazy = NLazy_SetEnabled(0);
+    int result = -1;
+    int* ready = NULL;
+    int nready = 0, nvisited = 0;
+    grad_graph g = {NULL, 0, 0, NULL, -1};
+
+    if (graph_collect(&g, node) < 0){
+        Node_Free(seed);
+        goto done;
+    }
+    g.entries[0].grad = seed;
+    ready = (int*)malloc(sizeof(int) * g.n);
+    if (!ready){
+        NError_RaiseMemoryError();
+        goto done;
+    }
+    if (g.entries[0].pending == 0){
+        ready[nready++] = 0;
+    }
+
+    while (nready > 0){
+        int e = ready[--nready];
+        Node* x = g.entries[e].node;
+        Node* gx = g.entries[e].grad;
+        g.entries[e].grad = NULL;
+        nvisited++;
+
+        if (!g.entries[e].has_call){
+            if (grad_store(x, gx) < 0){
+                goto done;
+            }
+            if (!retain_graph){
+                graph_forget(&g, e);
+            }
+            continue;
+        }
+
+        // checkpointed results are replayed from the nearest kept ones
+        int r = Node_Recompute(x);
+        NFuncArgs* args = ((NFuncFuncInfo*)x->nfunc_info)->args;
+        for (int i = 0; r == 0 && i < args->nin; i++){
+            r = Node_Recompute(args->in_nodes[i]);
+        }
+        if (r == 0){
+            r = grad_propagate(&g, e, gx, ready, &nready);
+        }
+        // the intermediate gradient is consumed
+        Node_Free(gx);
+        if (r < 0){
+            goto done;
+        }
+        if (!retain_graph){
+            _NFuncFuncInfo_Free((NFuncFuncInfo*)x->nfunc_info);
+            x->nfunc_info = NULL;
+            NR_RMVFLG(x->flags, NR_NODE_TRACK);
+            // its consumers are done, the result can go as soon as nobody else holds it
+            graph_forget(&g, e);
+        }
+        else if (g.entries[e].released){
+            // keep the graph within its checkpoint budget for the next pass
+            Node_ReleaseData(x);
+            x->flags |= NR_NODE_RECOMPUTE;
+        }
+    }
+
+    if (nvisited != g.n){
+        NError_RaiseError(NError_RuntimeError, "Node_Backward: the recorded graph has a cycle");
+        goto done;
+    }
+    result = 0;
+
+done:
+    graph_free(&g);
+    free(ready);
+    NLazy_SetEnabled(prev_lazy);
+    NGrad_SetEnabled(prev_enabled);
+    return result;
+}
+
+/*
+ * Checkpointing
+ * -------------
+ * A released node keeps its shape, strides and recorded call but has no
+ * data. Replaying it runs the recorded NFunc again into a fresh buffer,
+ * with the node detached from its record so that the call is not
+ * recorded a second time.
+ */
+NR_PRIVATE int
+replay_node(Node* node){
+    NFuncFuncInfo* info = (NFuncFuncInfo*)node->nfunc_info;
+    nr_intp nbytes = Node_NItems(node) * NODE_ITEMSIZE(node);
+    void* data = NMem_Alloc(nbytes);
+    if (!data){
+        return -1;
+    }
+    node->data = data;
+    node->flags |= NR_NODE_OWNDATA | NR_NODE_NMEMDATA;
+    NR_RMVFLG(node->flags, NR_NODE_RECOMPUTE);
+
+    Node* out = node;
+    NFuncArgs rargs = {
+        .in_nodes = info->args->in_nodes,
+        .out_nodes = &out,
+        .nin = info->args->nin,
+        .nout = 1,
+        .outtype = NR_NONE,
+        .intype = NR_NONE,
+        .extra = info->nfunc->grad_func->saved_is_extra ? info->saved : NULL,
+        .__ref_count = 1,
+    };
+    int track = node->flags & NR_NODE_TRACK;
+    NR_RMVFLG(node->flags, NR_NODE_TRACK);
+    node->nfunc_info = NULL;
+    int prev_enabled = NGrad_SetEnabled(0);
+    int prev_lazy = NLazy_SetEnabled(0);
+
+    int result = NFunc_Call(info->nfunc, &rargs);
+
+    NLazy_SetEnabled(prev_lazy);
+    NGrad_SetEnabled(prev_enabled);
+    node->nfunc_info = (struct NFuncFuncInfo*)info;
+    node->flags |= track;
+    if (result < 0 || out != node){
+        if (out != node){
+            Node_Free(out);
+            NError_RaiseError(NError_RuntimeError, "%s: replay did not write the released node",
+                              info->nfunc->name);
+        }
+        Node_ReleaseData(node);
+        node->flags |= NR_NODE_RECOMPUTE;
+        return -1;
+    }
+    return 0;
+}
+
+NR_PUBLIC int
+Node_Recompute(Node* node){
+    if (!node || !NODE_IS_RECOMPUTE(node)){
+        return 0;
+    }
+
+    // inputs before the nodes that read them, with an explicit stack
+    Node* stack_inline[NGRAD_STACK_NIN * 4];
+    Node** stack = stack_inline;
+    int nstack = 0, cap = NGRAD_STACK_NIN * 4;
+    int result = 0;
+    stack[nstack++] = node;
+
+    while (nstack > 0){
+        Node* top = stack[nstack - 1];
+        if (!NODE_IS_RECOMPUTE(top)){
+            nstack--;
+            continue;
+        }
+        NFuncArgs* args = ((NFuncFuncInfo*)top->nfunc_info)->args;
+        int pushed = 0;
+        for (int i = 0; i < args->nin; i++){
+            Node* in = args->in_nodes[i];
+            if (!in || !NODE_IS_RECOMPUTE(in)){
+                continue;
+            }
+            if (nstack == cap){
+                Node** grown = (Node**)malloc(sizeof(Node*) * cap * 2);
+                if (!grown){
+                    NError_RaiseMemoryError();
+                    result = -1;
+                    goto done;
+                }
+                memcpy(grown, stack, sizeof(Node*) * nstack);
+                if (stack != stack_inline){
+                    free(stack);
+                }
+                stack = grown;
+                cap *= 2;
+            }
+            stack[nstack++] = in;
+            pushed = 1;
+        }
+        if (pushed){
+            continue;
+        }
+        nstack--;
+        if (replay_node(top) < 0){
+            result = -1;
+            goto done;
+        }
+    }
+
+done:
+    if (stack != stack_inline){
+        free(stack);
+    }
+    return result;
+}
+
+/* Bytes of the data of `node` */
+NR_STATIC_INLINE nr_intp
+node_nbytes(const Node* node){
+    return Node_NItems(node) * NODE_ITEMSIZE(node);
+}
+
+/*
+ * Whether the planner may release entry `e`: an intermediate result
+ * referenced only by the calls recorded in the graph (`uses` of them)
+ * and by the planner itself, owning a buffer it can drop.
+ */
+NR_PRIVATE int
+checkpoint_candidate(const grad_graph* g, int e, int uses){
+    const grad_entry* entry = &g->entries[e];
+    const Node* node = entry->node;
+    const NFuncFuncInfo* info = (const NFuncFuncInfo*)node->nfunc_info;
+    if (e == 0 || !entry->has_call || !info->replayable || node_nbytes(node) == 0
+        || NODE_REFCOUNT(node) != uses + 1){
+        return 0;
+    }
+    return NODE_IS_RECOMPUTE(node)
+        || (NODE_IS_OWNDATA(node) && node->data && !node->base && !node->deleter);
+}
+
+/*
+ * Releases the candidates (in forward order) whose chain of released
+ * inputs stays within `run` nodes, the others are kept. Returns the
+ * bytes of the candidates that are kept.
+ */
+NR_PRIVATE nr_intp
+checkpoint_plan(const grad_graph* g, const int* order, const char* candidate,
+                int run, char* release, int* depth){
+    nr_intp kept = 0;
+    for (int k = g->n - 1; k >= 0; k--){
+        int e = order[k];
+        release[e] = 0;
+        depth[e] = 0;
+        if (!candidate[e]){
+            continue;
+        }
+        const Node* node = g->entries[e].node;
+        NFuncArgs* args = ((NFuncFuncInfo*)node->nfunc_info)->args;
+        int d = 1;
+        for (int i = 0; i < args->nin; i++){
+            int j = NGrad_Needed(args->in_nodes[i]) ? graph_find(g, args->in_nodes[i]) : -1;
+            if (j >= 0 && release[j] && depth[j] + 1 > d){
+                d = depth[j] + 1;
+            }
+        }
+        if (d <= run){
+            release[e] = 1;
+            depth[e] = d;
+        }
+        else{
+            kept += node_nbytes(node);
+        }
+    }
+    return kept;
+}
+
+NR_PUBLIC nr_intp
+Node_Checkpoint(Node* node, nr_intp budget){
+    if (!node){
+        NError_RaiseError(NError_ValueError, "Node_Checkpoint received a NULL node");
+        return -1;
+    }
+    if (!NGrad_Needed(node)){
+        NError_RaiseError(NError_ValueError,
+            "Node_Checkpoint: the node does not need a gradient (untracked or not float)");
+        return -1;
+    }
+
+    nr_intp result = -1;
+    grad_graph g = {NULL, 0, 0, NULL, -1};
+    int* order = NULL;
+    int* depth = NULL;
+    int* uses = NULL;
+    char* candidate = NULL;
+    char* release = NULL;
+    if (graph_collect(&g, node) < 0){
+        goto done;
+    }
+    order = (int*)calloc(g.n, sizeof(int));
+    depth = (int*)malloc(sizeof(int) * g.n);
+    uses = (int*)malloc(sizeof(int) * g.n);
+    candidate = (char*)calloc(g.n, 1);
+    release = (char*)malloc(g.n);
+    if (!order || !depth || !uses || !candidate || !release){
+        NError_RaiseMemoryError();
+        goto done;
+    }
+
+    // consumers before their inputs, as Node_Backward visits them
+    for (int e = 0; e < g.n; e++){
+        uses[e] = g.entries[e].pending;
+    }
+    int norder = 0;
+    if (g.entries[0].pending == 0){
+        order[norder++] = 0;
+    }
+    for (int head = 0; head < norder; head++){
+        int e = order[head];
+        if (!g.entries[e].has_call){
+            continue;
+        }
+        NFuncArgs* args = ((NFuncFuncInfo*)g.entries[e].node->nfunc_info)->args;
+        for (int i = 0; i < args->nin; i++){
+            if (NGrad_Needed(args->in_nodes[i])){
+                int k = graph_find(&g, args->in_nodes[i]);
+                if (--g.entries[k].pending == 0){
+                    order[norder++] = k;
+                }
+            }
+        }
+    }
+    if (norder != g.n){
+        NError_RaiseError(NError_RuntimeError, "Node_Checkpoint: the recorded graph has a cycle");
+        goto done;
+    }
+
+    nr_intp fixed = 0;
+    int ncandidates = 0;
+    for (int e = 0; e < g.n; e++){
+        const Node* x = g.entries[e].node;
+        candidate[e] = (char)checkpoint_candidate(&g, e, uses[e]);
+        ncandidates += candidate[e];
+        if (!candidate[e] && e != 0 && g.entries[e].has_call && !NODE_IS_RECOMPUTE(x)
+            && NODE_IS_OWNDATA(x)){
+            fixed += node_nbytes(x);
+        }
+    }
+
+    // shortest run of released nodes that fits, kept bytes shrink as runs grow
+    int lo = 0, hi = ncandidates;
+    while (lo < hi){
+        int run = lo + (hi - lo) / 2;
+        if (fixed + checkpoint_plan(&g, order, candidate, run, release, depth) <= budget){
+            hi = run;
+        }
+        else{
+            lo = run + 1;
+        }
+    }
+    nr_intp kept = fixed + checkpoint_plan(&g, order, candidate, lo, release, depth);
+
+    // kept nodes that were released replay first, which may restore released ones
+    for (int k = g.n - 1; k >= 0; k--){
+        int e = order[k];
+        if (candidate[e] && !release[e] && Node_Recompute(g.entries[e].node) < 0){
+            goto done;
+        }
+    }
+    for (int e = 0; e < g.n; e++){
+        Node* x = g.entries[e].node;
+        if (release[e] && !NODE_IS_RECOMPUTE(x)){
+            Node_ReleaseData(x);
+            x->flags |= NR_NODE_RECOMPUTE;
+        }
+    }
+    result = kept;
+
+done:
+    graph_free(&g);
+    free(order);
+    free(depth);
+    free(uses);
+    free(candidate);
+    free(release);
+    return result;
+}
@@ -0,0 +1,88 @@
+#ifndef NR__CORE__SRC__NGRAD_H
+#define NR__CORE__SRC__NGRAD_H
+
+#include "nour/nour.h"
+
+/*
+ * Reverse-mode automatic differentiation.
+ *
+ * A node needs a gradient when it is tracked (NR_NODE_TRACK) and has a
+ * float dtype. While recording is on in a thread (the default), a call
+ * of an NFunc with NFUNC_FLAG_GRADIENT on such a node tracks the output
+ * and records the call in the output's nfunc_info, which keeps the
+ * inputs alive. Tracked nodes without a recorded call are the leaves.
+ *
+ * Node_Backward orders the graph below a node with an explicit worklist
+ * (no recursion, so graph depth is only bounded by memory) and visits it
+ * in reverse topological order. The gradient of every intermediate node
+ * is summed in place into a single buffer, handed to the GradFunc of its
+ * call once every consumer has delivered its part, and freed right
+ * after. Leaves add theirs into node->grad, across calls as well.
+ *
+ * Recording is off inside Node_Backward, and lazy mode (nlazy.h) never
+ * defers a call that is recorded.
+ */
+
+/* Turns recording of the calling thread on or off, returns the previous state. */
+NR_PUBLIC int
+NGrad_SetEnabled(int enabled);
+
+NR_PUBLIC int
+NGrad_IsEnabled(void);
+
+/* Whether gradients flow into `node` */
+NR_STATIC_INLINE int
+NGrad_Needed(const Node* node){
+    return node && NODE_IS_TRACK(node) && NDtype_IsFloat(NODE_DTYPE(node));
+}
+
+/* Used by NFunc_Call: whether a call of `nfunc` on the inputs is recorded. */
+NR_PUBLIC int
+NGrad_Records(const NFunc* nfunc, Node* const* in_nodes, int nin);
+
+/*
+ * Adds the gradient of `node` with respect to every leaf below it into
+ * the leaves' node->grad. `grad` is the gradient of `node` itself (same
+ * shape), NULL for ones. Without `retain_graph` the recorded calls are
+ * dropped as the pass goes: the intermediate nodes become untracked
+ * constants and what they kept alive for the gradient is freed.
+ * Returns 0, or -1 with an error raised.
+ */
+NR_PUBLIC int
+Node_Backward(Node* node, Node* grad, int retain_graph);
+
+/*
+ * Activation checkpointing.
+ *
+ * The intermediate results of a recorded graph stay alive until
+ * Node_Backward has used them. Node_Checkpoint plans the graph below
+ * `node` so that they take at most `budget` bytes: it keeps some of them
+ * (the checkpoints) and releases the data of the others, which become
+ * NR_NODE_RECOMPUTE. Node_Backward replays the recorded calls of the
+ * released nodes from the nearest checkpoints when it reaches them. Each
+ * one is replayed once per pass, at the cost of at most one more forward
+ * pass, and the pass then holds the budget plus one run of replayed
+ * results. The released buffers go back to the buffer cache (nmem.h),
+ * where the replays and the gradients pick them up again.
+ *
+ * Checkpoints are spaced evenly: the planner picks the shortest run of
+ * consecutive released nodes that fits the budget. Only results that
+ * nothing but the graph refers to, that own their data and whose call can
+ * be replayed are released; `node` itself, the leaves and results the
+ * caller still holds are always kept.
+ *
+ * Returns the bytes of intermediate results still held, which is above
+ * `budget` when the graph can not fit it, or -1 with an error raised.
+ */
+NR_PUBLIC nr_intp
+Node_Checkpoint(Node* node, nr_intp budget);
+
+/*
+ * Gives a node released by Node_Checkpoint its data again, replaying the
+ * released nodes it depends on first. Does nothing on other nodes.
+ * Returns 0, or -1 with an error raised (`node` stays released then).
+ */
+NR_PUBLIC int
+Node_Recompute(Node* node);
+
+#endif // NR__CORE__SRC__NGRAD_H
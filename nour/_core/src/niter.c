@@ -2,19 +2,171 @@
 #include "nerror.h"
 #include "ntools.h"
 
-NR_PUBLIC void
-NIter_FromNode(NIter* niter, const Node* node, int iter_mode){
-    if (iter_mode == NITER_MODE_NONE){
-        iter_mode = NODE_IS_CONTIGUOUS(node) ? NITER_MODE_CONTIGUOUS : NITER_MODE_STRIDED;
+/* ======== Axis coalescing ======== */
+
+/*
+ * niter_axis_before:
+ *  - Returns 1 if axis `a` should be visited outside of axis `b` for
+ *    NITER_ORDER_K, i.e. its stride is larger in every operand where both
+ *    strides are non zero (broadcast axes don't vote). Ties keep the
+ *    current order.
+ */
+NR_PRIVATE int
+niter_axis_before(nr_intp (*strides)[NR_NODE_MAX_NDIM], int n, int a, int b){
+    int before = 0;
+    for (int k = 0; k < n; k++){
+        nr_intp sa = strides[k][a] < 0 ? -strides[k][a] : strides[k][a];
+        nr_intp sb = strides[k][b] < 0 ? -strides[k][b] : strides[k][b];
+        if (sa == 0 || sb == 0 || sa == sb){
+            continue;
+        }
+        if (sa < sb){
+            return 0;
+        }
+        before = 1;
     }
+    return before;
+}
 
-    NIter_New(niter, node->data, node->ndim,
-                     node->shape, node->strides, iter_mode);
+/*
+ * niter_coalesce:
+ *  - Simplifies the iteration space shared by `n` operands in place and
+ *    returns the new number of dimensions (at least 1).
+ *  - Size-1 axes are dropped, then adjacent axes are merged when every
+ *    operand can step over both with a single stride
+ *    (strides[i] == strides[i + 1] * shape[i + 1]).
+ *  - With NITER_ORDER_K the axes are first sorted by decreasing stride so
+ *    transposed operands also collapse. This changes the visiting order,
+ *    so it is only valid when every array touched by the loop is one of
+ *    the operands.
+ *  - The items visited and their C order (for NITER_ORDER_C) are
+ *    unchanged, so the result can be used with the NIter macros as is.
+ */
+NR_PRIVATE int
+niter_coalesce(int ndim, nr_intp* shape, nr_intp (*strides)[NR_NODE_MAX_NDIM], int n, int order){
+    int nd = 0;
+
+    for (int i = 0; i < ndim; i++){
+        if (shape[i] == 0){
+            /* nothing to visit, a single empty axis is enough */
+            shape[0] = 0;
+            for (int k = 0; k < n; k++){
+                strides[k][0] = 0;
+            }
+            return 1;
+        }
+        if (shape[i] == 1){
+            continue;
+        }
+        shape[nd] = shape[i];
+        for (int k = 0; k < n; k++){
+            strides[k][nd] = strides[k][i];
+        }
+        nd++;
+    }
+
+    if (nd == 0){
+        shape[0] = 1;
+        for (int k = 0; k < n; k++){
+            strides[k][0] = 0;
+        }
+        return 1;
+    }
+
+    if (order == NITER_ORDER_K){
+        /* insertion sort, stable so ties keep the C order */
+        for (int i = 1; i < nd; i++){
+            for (int j = i; j > 0 && niter_axis_before(strides, n, j, j - 1); j--){
+                nr_intp t = shape[j];
+                shape[j] = shape[j - 1];
+                shape[j - 1] = t;
+                for (int k = 0; k < n; k++){
+                    t = strides[k][j];
+                    strides[k][j] = strides[k][j - 1];
+                    strides[k][j - 1] = t;
+                }
+            }
+        }
+    }
+
+    int j = 0;
+    for (int i = 1; i < nd; i++){
+        int can_merge = 1;
+        for (int k = 0; k < n; k++){
+            if (strides[k][j] != strides[k][i] * shape[i]){
+                can_merge = 0;
+                break;
+            }
+        }
+
+        if (can_merge){
+            shape[j] *= shape[i];
+            for (int k = 0; k < n; k++){
+                strides[k][j] = strides[k][i];
+            }
+        }
+        else{
+            j++;
+            shape[j] = shape[i];
+            for (int k = 0; k < n; k++){
+                strides[k][j] = strides[k][i];
+            }
+        }
+    }
+
+    return j + 1;
 }
 
-NR_PUBLIC void
-NIter_New(NIter* niter ,void* data, int ndim, const nr_intp* shape,
-          const nr_intp* strides, int iter_mode)
+/*
+ * niter_layout:
+ *  - Classifies a coalesced iteration space of `n` operands, see
+ *    NITER_MODE_INNER_CONTIGUOUS in nr_iter.h. `itemsizes` may be NULL
+ *    when the item sizes are unknown, the layout is then STRIDED.
+ */
+NR_PRIVATE int
+niter_layout(int nd, nr_intp (*strides)[NR_NODE_MAX_NDIM], int n, const nr_intp* itemsizes){
+    if (!itemsizes){
+        return NITER_MODE_STRIDED;
+    }
+
+    int flat = nd == 1;
+    for (int k = 0; k < n; k++){
+        nr_intp s = strides[k][nd - 1];
+        if (s == itemsizes[k]){
+            continue;
+        }
+        if (s != 0){
+            return NITER_MODE_STRIDED;
+        }
+        flat = 0;
+    }
+    return flat ? NITER_MODE_CONTIGUOUS : NITER_MODE_INNER_CONTIGUOUS;
+}
+
+/*
+ * niter_inner_stride:
+ *  - Stride of the innermost axis longer than 1, which is the item size
+ *    of a contiguous array. Used when the item size is not given.
+ */
+NR_PRIVATE nr_intp
+niter_inner_stride(int ndim, const nr_intp* shape, const nr_intp* strides){
+    for (int i = ndim - 1; i > -1; i--){
+        if (shape[i] != 1){
+            return strides[i];
+        }
+    }
+    return 0;
+}
+
+/*
+ * niter_init:
+ *  - Fills `niter` for an already coalesced iteration space.
+ *  - NITER_MODE_NONE becomes NITER_MODE_CONTIGUOUS when a single axis is
+ *    left, since stepping by `step` then visits every item.
+ */
+NR_PRIVATE void
+niter_init(NIter* niter, void* data, int ndim, const nr_intp* shape,
+           const nr_intp* strides, nr_intp nitems, int iter_mode)
 {
     niter->data = data;
     niter->nd_m1 = ndim - 1;
@@ -24,31 +176,103 @@ NIter_New(NIter* niter ,void* data, int ndim, const nr_intp* shape,
         niter->backstrides[i] = strides[i] * niter->shape_m1[i];
     }
 
-    niter->end = NR_NItems(ndim, shape);
+    niter->end = (int)nitems;
     niter->idx = niter->end;
     niter->step = niter->strides[niter->nd_m1];
-    niter->iter_mode = iter_mode == NITER_MODE_NONE ? NITER_MODE_STRIDED : iter_mode;
+    if (iter_mode == NITER_MODE_NONE){
+        iter_mode = ndim == 1 ? NITER_MODE_CONTIGUOUS : NITER_MODE_STRIDED;
+    }
+    niter->iter_mode = iter_mode;
 }
 
+/* ======== NIter ======== */
+
+NR_PUBLIC void
+NIter_FromNode(NIter* niter, const Node* node, int iter_mode){
+    if (iter_mode == NITER_MODE_NONE && NODE_IS_CONTIGUOUS(node)){
+        iter_mode = NITER_MODE_CONTIGUOUS;
+    }
+
+    NIter_New(niter, node->data, node->ndim,
+                     node->shape, node->strides, iter_mode);
+}
+
+NR_PUBLIC void
+NIter_New(NIter* niter ,void* data, int ndim, const nr_intp* shape,
+          const nr_intp* strides, int iter_mode)
+{
+    nr_intp cshape[NR_NODE_MAX_NDIM];
+    nr_intp cstrides[1][NR_NODE_MAX_NDIM];
+
+    memcpy(cshape, shape, sizeof(nr_intp) * ndim);
+    memcpy(cstrides[0], strides, sizeof(nr_intp) * ndim);
+    int nd = niter_coalesce(ndim, cshape, cstrides, 1, NITER_ORDER_C);
+
+    niter_init(niter, data, nd, cshape, cstrides[0],
+               NR_NItems(ndim, shape), iter_mode);
+}
+
+/* ======== NMultiIter ======== */
+
 NR_PUBLIC int
 NMultiIter_FromNodes(Node** nodes, int n_nodes, NMultiIter* mit){
+    return NMultiIter_FromNodesOrder(nodes, n_nodes, NITER_ORDER_C, mit);
+}
+
+NR_PRIVATE int
+nmultiiter_init(void** data_ptr, int num, int* ndims, nr_intp** shapes,
+                nr_intp** strides, const nr_intp* itemsizes, int order, NMultiIter* mit);
+
+NR_PUBLIC int
+NMultiIter_FromNodesOrder(Node** nodes, int n_nodes, int order, NMultiIter* mit){
     nr_intp* shapes[NR_MULTIITER_MAX_NITER];
     nr_intp* strides[NR_MULTIITER_MAX_NITER];
+    nr_intp itemsizes[NR_MULTIITER_MAX_NITER];
     int ndims[NR_MULTIITER_MAX_NITER];
     void* data_ptrs[NR_MULTIITER_MAX_NITER];
 
+    if (n_nodes > NR_MULTIITER_MAX_NITER){
+        NError_RaiseError(
+            NError_ValueError,
+            "Number of iterators exceeds maximum allowed (%d > %d)",
+            n_nodes, NR_MULTIITER_MAX_NITER
+        );
+        return -1;
+    }
+
     for (int i = 0; i < n_nodes; i++){
         shapes[i] = nodes[i]->shape;
         strides[i] = nodes[i]->strides;
         ndims[i] = nodes[i]->ndim;
         data_ptrs[i] = nodes[i]->data;
+        itemsizes[i] = NODE_ITEMSIZE(nodes[i]);
     }
 
-    return NMultiIter_New(data_ptrs, n_nodes, ndims, shapes, strides, mit);
+    return nmultiiter_init(data_ptrs, n_nodes, ndims, shapes, strides, itemsizes, order, mit);
 }
 
 NR_PUBLIC int
 NMultiIter_New(void** data_ptr, int num, int* ndims, nr_intp** shapes, nr_intp** strides, NMultiIter* mit){
+    return NMultiIter_NewOrder(data_ptr, num, ndims, shapes, strides, NITER_ORDER_C, mit);
+}
+
+NR_PUBLIC int
+NMultiIter_NewOrder(void** data_ptr, int num, int* ndims, nr_intp** shapes,
+                    nr_intp** strides, int order, NMultiIter* mit)
+{
+    return nmultiiter_init(data_ptr, num, ndims, shapes, strides, NULL, order, mit);
+}
+
+/*
+ * nmultiiter_init:
+ *  - Shared setup of NMultiIter. `itemsizes` (NULL when unknown) is used
+ *    to classify the layout; without it an operand counts as contiguous
+ *    when it can be walked with its innermost stride.
+ */
+NR_PRIVATE int
+nmultiiter_init(void** data_ptr, int num, int* ndims, nr_intp** shapes,
+                nr_intp** strides, const nr_intp* itemsizes, int order, NMultiIter* mit)
+{
     if (num > NR_MULTIITER_MAX_NITER){
         NError_RaiseError(
             NError_ValueError,
@@ -67,27 +291,22 @@ NMultiIter_New(void** data_ptr, int num, int* ndims, nr_intp** shapes, nr_intp**
         return -1;
     }
 
-    if (num == 1){ // create one single iterator
-        NIter_New(mit->iters, data_ptr[0], ndims[0], shapes[0], strides[0], NITER_MODE_NONE);
-        
-        mit->out_ndim = ndims[0];
-        memcpy(mit->out_shape, shapes[0], sizeof(nr_intp) * ndims[0]);
-        mit->n_iter = 1;
-        mit->end = (int)NR_NItems(mit->out_ndim, mit->out_shape);
-        return 0;
-    }
-
-
     // Use the new broadcast shapes function for arrays
     if (NTools_BroadcastShapesFromArrays(shapes, ndims, num, mit->out_shape, &mit->out_ndim) != 0) {
         return -1;
     }
 
-    nr_intp tmp_str[NR_NODE_MAX_NDIM];
+    /*
+     * Broadcast every operand to the output shape, then coalesce all of
+     * them together so they keep moving in lockstep.
+     */
+    nr_intp cshape[NR_NODE_MAX_NDIM];
+    nr_intp cstrides[NR_MULTIITER_MAX_NITER][NR_NODE_MAX_NDIM];
+    int modes[NR_MULTIITER_MAX_NITER];
     int tmp;
     
     for (int i = 0; i < num; i++){
-        tmp = NTools_BroadcastStrides(shapes[i], ndims[i], strides[i], mit->out_shape, mit->out_ndim, tmp_str);
+        tmp = NTools_BroadcastStrides(shapes[i], ndims[i], strides[i], mit->out_shape, mit->out_ndim, cstrides[i]);
         if (tmp != 0){
             return -1;
         }
@@ -96,28 +315,112 @@ NMultiIter_New(void** data_ptr, int num, int* ndims, nr_intp** shapes, nr_intp**
         if (ndims[i] == mit->out_ndim 
             && memcmp(shapes[i], mit->out_shape, ndims[i] * sizeof(nr_intp)) == 0)
         {
-            // Check if strides are contiguous
-            nr_intp expected_stride = 1;  // Assuming itemsize of 1, this could be parameterized
-            int is_contiguous = 1;
-            for (int j = ndims[i] - 1; j >= 0; j--) {
-                if (strides[i][j] != expected_stride) {
-                    is_contiguous = 0;
-                    break;
-                }
-                expected_stride *= shapes[i][j];
-            }
-            tmp = is_contiguous ? NITER_MODE_CONTIGUOUS : NITER_MODE_NONE;
+            nr_intp itemsize = itemsizes ? itemsizes[i]
+                               : niter_inner_stride(ndims[i], shapes[i], strides[i]);
+            int is_contiguous = NTools_IsCContiguous(ndims[i], shapes[i], strides[i], itemsize);
+            modes[i] = is_contiguous ? NITER_MODE_CONTIGUOUS : NITER_MODE_NONE;
         }
         else
         {
-            tmp = NITER_MODE_NONE;
+            modes[i] = NITER_MODE_NONE;
         }
+    }
+
+    memcpy(cshape, mit->out_shape, sizeof(nr_intp) * mit->out_ndim);
+    int nd = niter_coalesce(mit->out_ndim, cshape, cstrides, num, order);
+    nr_intp nitems = NR_NItems(mit->out_ndim, mit->out_shape);
 
-        NIter_New(mit->iters + i, data_ptr[i], ndims[i], mit->out_shape, tmp_str, tmp);
+    for (int i = 0; i < num; i++){
+        niter_init(mit->iters + i, data_ptr[i], nd, cshape, cstrides[i], nitems, modes[i]);
     }
 
-    mit->end = (int)NR_NItems(mit->out_ndim, mit->out_shape);
+    mit->end = (int)nitems;
     mit->n_iter = num;
+    mit->inner_size = cshape[nd - 1];
+    mit->iter_mode = niter_layout(nd, cstrides, num, itemsizes);
+
+    return 0;
+}
+
+/* ======== NInnerIter ======== */
+
+NR_PUBLIC int
+NInnerIter_FromNodes(NInnerIter* iit, Node** nodes, int nop, int order){
+    nr_intp* shapes[NR_MULTIITER_MAX_NITER];
+    nr_intp* strides[NR_MULTIITER_MAX_NITER];
+    nr_intp itemsizes[NR_MULTIITER_MAX_NITER];
+    int ndims[NR_MULTIITER_MAX_NITER];
+    void* data_ptrs[NR_MULTIITER_MAX_NITER];
+
+    if (nop > NR_MULTIITER_MAX_NITER){
+        NError_RaiseError(
+            NError_ValueError,
+            "Number of iterators exceeds maximum allowed (%d > %d)",
+            nop, NR_MULTIITER_MAX_NITER
+        );
+        return -1;
+    }
+
+    for (int i = 0; i < nop; i++){
+        shapes[i] = nodes[i]->shape;
+        strides[i] = nodes[i]->strides;
+        ndims[i] = nodes[i]->ndim;
+        data_ptrs[i] = nodes[i]->data;
+        itemsizes[i] = NODE_ITEMSIZE(nodes[i]);
+    }
+
+    return NInnerIter_New(iit, data_ptrs, nop, ndims, shapes, strides, itemsizes, order);
+}
+
+NR_PUBLIC int
+NInnerIter_New(NInnerIter* iit, void** data_ptr, int nop, int* ndims,
+               nr_intp** shapes, nr_intp** strides, const nr_intp* itemsizes, int order)
+{
+    if (nop > NR_MULTIITER_MAX_NITER || nop <= 0){
+        NError_RaiseError(
+            NError_ValueError,
+            "Number of operands must be between 1 and %d. Got %d",
+            NR_MULTIITER_MAX_NITER, nop
+        );
+        return -1;
+    }
+
+    if (NTools_BroadcastShapesFromArrays(shapes, ndims, nop, iit->out_shape, &iit->out_ndim) != 0){
+        return -1;
+    }
+
+    nr_intp cshape[NR_NODE_MAX_NDIM];
+    nr_intp cstrides[NR_MULTIITER_MAX_NITER][NR_NODE_MAX_NDIM];
+
+    for (int k = 0; k < nop; k++){
+        if (NTools_BroadcastStrides(shapes[k], ndims[k], strides[k],
+                                    iit->out_shape, iit->out_ndim, cstrides[k]) != 0){
+            return -1;
+        }
+    }
+
+    memcpy(cshape, iit->out_shape, sizeof(nr_intp) * iit->out_ndim);
+    int nd = niter_coalesce(iit->out_ndim, cshape, cstrides, nop, order);
+
+    /* the last coalesced axis is the row, the others are walked by NEXT */
+    iit->nop = nop;
+    iit->nd_m1 = nd - 2;
+    iit->inner_size = cshape[nd - 1];
+    iit->end = iit->inner_size == 0 ? 0 : 1;
+    for (int i = 0; i < nd - 1; i++){
+        iit->shape_m1[i] = cshape[i] - 1;
+        iit->end *= cshape[i];
+    }
+    for (int k = 0; k < nop; k++){
+        iit->data[k] = (char*)data_ptr[k];
+        iit->inner_strides[k] = cstrides[k][nd - 1];
+        for (int i = 0; i < nd - 1; i++){
+            iit->strides[k][i] = cstrides[k][i];
+            iit->backstrides[k][i] = cstrides[k][i] * iit->shape_m1[i];
+        }
+    }
+    iit->idx = iit->end;
+    iit->iter_mode = niter_layout(nd, cstrides, nop, itemsizes);
 
     return 0;
 }
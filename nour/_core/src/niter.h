@@ -18,6 +18,29 @@ NMultiIter_FromNodes(Node** nodes, int n_nodes, NMultiIter* mit);
 NR_PUBLIC int
 NMultiIter_New(void** data_ptr, int num, int* ndims, nr_intp** shapes, nr_intp** strides, NMultiIter* mit);
 
+/*
+ * Same as NMultiIter_FromNodes / NMultiIter_New with an explicit visiting
+ * order (NITER_ORDER_C or NITER_ORDER_K, see nr_iter.h).
+ */
+NR_PUBLIC int
+NMultiIter_FromNodesOrder(Node** nodes, int n_nodes, int order, NMultiIter* mit);
+
+NR_PUBLIC int
+NMultiIter_NewOrder(void** data_ptr, int num, int* ndims, nr_intp** shapes,
+                    nr_intp** strides, int order, NMultiIter* mit);
+
+/*
+ * Sets up `iit` over `nop` operands broadcast together (see NInnerIter in
+ * nr_iter.h). `order` is NITER_ORDER_C or NITER_ORDER_K. `itemsizes` may
+ * be NULL, `iter_mode` is then NITER_MODE_STRIDED.
+ */
+NR_PUBLIC int
+NInnerIter_FromNodes(NInnerIter* iit, Node** nodes, int nop, int order);
+
+NR_PUBLIC int
+NInnerIter_New(NInnerIter* iit, void** data_ptr, int nop, int* ndims,
+               nr_intp** shapes, nr_intp** strides, const nr_intp* itemsizes, int order);
+
 NR_PUBLIC int
 NWindowIter_New(const Node* node, NWindowIter* wit, const nr_intp* window_dims,
                 const nr_intp* strides_factor, const nr_intp* dilation);
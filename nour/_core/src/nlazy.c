@@ -0,0 +1,613 @@
+#include "nlazy.h"
+#include "nfunc.h"
+#include "node_core.h"
+#include "ntools.h"
+#include "niter.h"
+#include "nerror.h"
+#include "nmem.h"
+#include "free.h"
+#include "nthread.h"
+#include "tc_methods.h"
+
+NR_PRIVATE NR_TLS int __nlazy_enabled = 0;
+
+/* Blocks of one plan may run on several pool threads */
+#if defined(__GNUC__) || defined(__clang__)
+    #define NLAZY_SET_FAILED(p) __atomic_store_n(&(p)->failed, 1, __ATOMIC_RELAXED)
+#else
+    #define NLAZY_SET_FAILED(p) ((p)->failed = 1)
+#endif
+
+NR_PUBLIC int
+NLazy_SetEnabled(int enabled){
+    int prev = __nlazy_enabled;
+    __nlazy_enabled = enabled != 0;
+    return prev;
+}
+
+NR_PUBLIC int
+NLazy_IsEnabled(void){
+    return __nlazy_enabled;
+}
+
+/* Kernel dtype of a call, as in NFunc_Call's dispatch tables */
+NR_STATIC_INLINE NR_DTYPE
+lazy_kernel_dtype(const NFunc* nfunc, Node* in0, NR_DTYPE in_dtype){
+    return (nfunc->flags & NFUNC_FLAG_TYPE_BROADCASTABLE) ? in_dtype : NODE_DTYPE(in0);
+}
+
+NR_PUBLIC int
+NLazy_CanDefer(const NFunc* nfunc, const NFuncArgs* args, NR_DTYPE in_dtype){
+    int flags = nfunc->flags;
+    if (!(flags & NFUNC_FLAG_ELEMENTWISE) || (flags & NFUNC_FLAG_NO_DATA)
+        || args->nout != 1 || args->out_nodes[0]
+        || args->nin < 1 || args->nin > 2 || !nfunc->kernels){
+        return 0;
+    }
+    /* unsupported dtypes run eagerly, which raises the error */
+    NR_DTYPE kdt = lazy_kernel_dtype(nfunc, args->in_nodes[0], in_dtype);
+    return NDtype_IsValid(kdt) && nfunc->kernels[kdt] != NULL;
+}
+
+NR_PUBLIC int
+NLazy_Defer(const NFunc* nfunc, NFuncArgs* args, NR_DTYPE in_dtype, NR_DTYPE out_dtype){
+    nr_intp bshape[NR_NODE_MAX_NDIM];
+    int bndim;
+    if (NTools_BroadcastShapes(args->in_nodes, args->nin, bshape, &bndim) != 0){
+        return -1;
+    }
+
+    Node* node = Node_NewAdvanced(NULL, 0, bndim, bshape, NULL, out_dtype, 0, NULL);
+    if (!node){
+        return -1;
+    }
+    node->flags |= NR_NODE_LAZY;
+
+    /* the lazy node keeps its own args, the caller's may live on its stack */
+    NFuncArgs* largs = NFuncArgs_New(args->nin, 1);
+    if (!largs){
+        Node_Free(node);
+        return -1;
+    }
+    largs->outtype = out_dtype;
+    largs->intype = in_dtype;
+    largs->out_nodes[0] = node;
+    for (int i = 0; i < args->nin; i++){
+        largs->in_nodes[i] = args->in_nodes[i];
+    }
+    NFuncFuncInfo* info = _NFuncFuncInfo_New(nfunc, largs, 0);
+    NFuncArgs_DECREF(largs);
+    if (!info){
+        Node_Free(node);
+        return -1;
+    }
+    node->nfunc_info = (struct NFuncFuncInfo*)info;
+
+    args->outtype = out_dtype;
+    args->out_nodes[0] = node;
+    return 0;
+}
+
+NR_PUBLIC void
+NLazy_Release(Node* node){
+    NFuncFuncInfo* info = (NFuncFuncInfo*)node->nfunc_info;
+    NR_RMVFLG(node->flags, NR_NODE_LAZY);
+    node->nfunc_info = NULL;
+    _NFuncFuncInfo_Free(info);
+}
+
+/*
+ * Evaluation plan
+ * ---------------
+ * Operands are numbered leaves first (regular nodes, read through their
+ * broadcast strides), then ops in dependency order; the last op is the
+ * evaluated node. Nodes reached twice are computed once.
+ */
+#define NLAZY_MAX_LEAVES (NR_MULTIITER_MAX_NITER - 1)
+
+typedef struct{
+    const NFunc* nfunc;
+    Node* node;                 // the lazy node
+    NR_DTYPE in_dtype, out_dtype;
+    int nin;
+    int in[2];                  // operand of each input
+    NDtype_CastFunc cast[2];    // promotion to in_dtype, NULL if none
+}lazy_op;
+
+typedef struct{
+    int nleaves, nops;
+    Node* leaves[NLAZY_MAX_LEAVES];
+    lazy_op ops[NLAZY_MAX_OPS];
+
+    /* current row of the NInnerIter, then the output */
+    char* ptrs[NR_MULTIITER_MAX_NITER];
+    nr_intp strides[NR_MULTIITER_MAX_NITER];
+    int failed;
+}lazy_plan;
+
+/* lazy_plan_add results other than operands */
+#define LAZY_FULL (-(1 << 30))
+#define LAZY_ERROR (LAZY_FULL - 1)
+
+NR_STATIC_INLINE NR_DTYPE
+lazy_operand_dtype(const lazy_plan* p, int k){
+    return k < p->nleaves ? NODE_DTYPE(p->leaves[k]) : p->ops[k - p->nleaves].out_dtype;
+}
+
+NR_PRIVATE int
+lazy_plan_leaf(lazy_plan* p, Node* node){
+    for (int i = 0; i < p->nleaves; i++){
+        if (p->leaves[i] == node){
+            return -1 - i;
+        }
+    }
+    if (p->nleaves == NLAZY_MAX_LEAVES){
+        return LAZY_FULL;
+    }
+    p->leaves[p->nleaves] = node;
+    return -1 - p->nleaves++;
+}
+
+/*
+ * Adds `node` and what it depends on, returns its operand: -1 - leaf for
+ * leaves (they are numbered once all are known), the op otherwise. A lazy
+ * node below the root whose DAG does not fit is evaluated on its own and
+ * read as a leaf; LAZY_FULL tells the root's caller that even that did not
+ * fit.
+ */
+NR_PRIVATE int
+lazy_plan_add(lazy_plan* p, Node* node, int depth){
+    if (!NODE_IS_LAZY(node)){
+        return lazy_plan_leaf(p, node);
+    }
+    for (int i = 0; i < p->nops; i++){
+        if (p->ops[i].node == node){
+            return i;
+        }
+    }
+
+    NFuncFuncInfo* info = (NFuncFuncInfo*)node->nfunc_info;
+    int nleaves = p->nleaves, nops = p->nops;
+    int in[2];
+    int res = depth < NLAZY_MAX_OPS ? 0 : LAZY_FULL;
+    for (int i = 0; i < info->args->nin && res == 0; i++){
+        in[i] = lazy_plan_add(p, info->args->in_nodes[i], depth + 1);
+        if (in[i] == LAZY_FULL || in[i] == LAZY_ERROR){
+            res = in[i];
+        }
+    }
+    if (res == 0 && p->nops == NLAZY_MAX_OPS){
+        res = LAZY_FULL;
+    }
+    if (res != 0){
+        p->nleaves = nleaves;
+        p->nops = nops;
+        if (res == LAZY_ERROR || depth == 0){
+            return res;
+        }
+        return Node_Evaluate(node) != 0 ? LAZY_ERROR : lazy_plan_leaf(p, node);
+    }
+
+    lazy_op* op = &p->ops[p->nops];
+    op->nfunc = info->nfunc;
+    op->node = node;
+    op->in_dtype = info->args->intype;
+    op->out_dtype = NODE_DTYPE(node);
+    op->nin = info->args->nin;
+    for (int i = 0; i < op->nin; i++){
+        op->in[i] = in[i];
+    }
+    return p->nops++;
+}
+
+/* Fills the plan of `node`, evaluating parts of it first when it is too big */
+NR_PRIVATE int
+lazy_plan_build(lazy_plan* p, Node* node){
+    p->nleaves = 0;
+    p->nops = 0;
+    int res = lazy_plan_add(p, node, 0);
+    if (res == LAZY_FULL){
+        /* evaluate the inputs on their own, `node` then only reads leaves */
+        NFuncFuncInfo* info = (NFuncFuncInfo*)node->nfunc_info;
+        for (int i = 0; i < info->args->nin; i++){
+            if (Node_Evaluate(info->args->in_nodes[i]) != 0){
+                return -1;
+            }
+        }
+        p->nleaves = 0;
+        p->nops = 0;
+        res = lazy_plan_add(p, node, 0);
+    }
+    if (res == LAZY_ERROR){
+        return -1;
+    }
+
+    for (int i = 0; i < p->nops; i++){
+        lazy_op* op = &p->ops[i];
+        int promote = op->nfunc->flags & NFUNC_FLAG_TYPE_BROADCASTABLE;
+        for (int k = 0; k < op->nin; k++){
+            op->in[k] = op->in[k] < 0 ? -1 - op->in[k] : p->nleaves + op->in[k];
+            NR_DTYPE dt = lazy_operand_dtype(p, op->in[k]);
+            op->cast[k] = promote && dt != op->in_dtype ? NDtype_GetCastFunc(dt, op->in_dtype) : NULL;
+        }
+    }
+    return 0;
+}
+
+/* Views of the block buffers, pointed at new data for every block */
+NR_STATIC_INLINE Node*
+lazy_view(void* data, NR_DTYPE dtype){
+    nr_intp shape[1] = {NLAZY_BLOCK};
+    return Node_NewAdvanced(data, 0, 1, shape, NULL, dtype, 0, NULL);
+}
+
+NR_PRIVATE void
+lazy_range(void* ctx, nr_intp start, nr_intp end){
+    lazy_plan* p = (lazy_plan*)ctx;
+    int nopnd = p->nleaves + p->nops;
+    Node* views[NLAZY_MAX_LEAVES + NLAZY_MAX_OPS] = {NULL};
+    Node* casts[NLAZY_MAX_OPS][2] = {{NULL}};
+    nr_intp isizes[NLAZY_MAX_LEAVES + NLAZY_MAX_OPS];
+
+    /* one buffer of NLAZY_BLOCK float64 per operand and per cast */
+    int nbuf = nopnd;
+    for (int i = 0; i < p->nops; i++){
+        nbuf += (p->ops[i].cast[0] != NULL) + (p->ops[i].cast[1] != NULL);
+    }
+    char* scratch = (char*)malloc((size_t)nbuf * NLAZY_BLOCK * sizeof(nr_float64));
+    if (!scratch){
+        NLAZY_SET_FAILED(p);
+        return;
+    }
+    char* buf = scratch;
+    int ok = 1;
+    for (int k = 0; k < nopnd && ok; k++, buf += NLAZY_BLOCK * sizeof(nr_float64)){
+        NR_DTYPE dt = lazy_operand_dtype(p, k);
+        isizes[k] = NDtype_Size(dt);
+        ok = (views[k] = lazy_view(buf, dt)) != NULL;
+    }
+    for (int i = 0; i < p->nops && ok; i++){
+        for (int k = 0; k < p->ops[i].nin && ok; k++){
+            if (p->ops[i].cast[k]){
+                ok = (casts[i][k] = lazy_view(buf, p->ops[i].in_dtype)) != NULL;
+                buf += NLAZY_BLOCK * sizeof(nr_float64);
+            }
+        }
+    }
+
+    char* leaf_buf[NLAZY_MAX_LEAVES];
+    for (int k = 0; k < p->nleaves && ok; k++){
+        leaf_buf[k] = (char*)NODE_DATA(views[k]);
+    }
+    int root = nopnd - 1;
+    char* root_buf = ok ? (char*)NODE_DATA(views[root]) : NULL;
+    nr_intp osize = isizes[root];
+    nr_intp ostride = p->strides[p->nleaves];
+
+    for (nr_intp pos = start; ok && pos < end; pos += NLAZY_BLOCK){
+        nr_intp n = end - pos < NLAZY_BLOCK ? end - pos : NLAZY_BLOCK;
+        for (int k = 0; k < nopnd; k++){
+            views[k]->shape[0] = n;
+        }
+
+        /* leaves: in place when contiguous, gathered otherwise */
+        for (int k = 0; k < p->nleaves; k++){
+            nr_intp s = p->strides[k];
+            const char* src = p->ptrs[k] + pos * s;
+            if (s == isizes[k]){
+                views[k]->data = (void*)src;
+                continue;
+            }
+            char* d = leaf_buf[k];
+            for (nr_intp i = 0; i < n; i++, src += s, d += isizes[k]){
+                memcpy(d, src, isizes[k]);
+            }
+            views[k]->data = leaf_buf[k];
+        }
+
+        char* out = p->ptrs[p->nleaves] + pos * ostride;
+        views[root]->data = ostride == osize ? out : root_buf;
+
+        for (int i = 0; i < p->nops; i++){
+            lazy_op* op = &p->ops[i];
+            Node* in_nodes[2];
+            for (int k = 0; k < op->nin; k++){
+                in_nodes[k] = views[op->in[k]];
+                if (op->cast[k]){
+                    casts[i][k]->shape[0] = n;
+                    op->cast[k](NODE_DATA(in_nodes[k]), isizes[op->in[k]], NODE_DATA(casts[i][k]), n);
+                    in_nodes[k] = casts[i][k];
+                }
+            }
+            Node* out_node = views[p->nleaves + i];
+            NFuncArgs args = {
+                .in_nodes = in_nodes,
+                .out_nodes = &out_node,
+                .nin = op->nin,
+                .nout = 1,
+                .outtype = op->out_dtype,
+                .intype = op->in_dtype,
+                .extra = NULL,
+                .__ref_count = 1,
+            };
+            if (op->nfunc->func(&args) != 0){
+                NLAZY_SET_FAILED(p);
+                ok = 0;
+                break;
+            }
+        }
+
+        if (ok && ostride != osize){
+            const char* o = root_buf;
+            for (nr_intp i = 0; i < n; i++, o += osize){
+                memcpy(out + i * ostride, o, osize);
+            }
+        }
+    }
+
+    for (int k = 0; k < nopnd; k++){
+        if (views[k]){
+            views[k]->data = NULL;
+            Node_Free(views[k]);
+        }
+    }
+    for (int i = 0; i < p->nops; i++){
+        for (int k = 0; k < 2; k++){
+            Node_Free(casts[i][k]);
+        }
+    }
+    free(scratch);
+}
+
+/*
+ * Deep DAGs
+ * ---------
+ * lazy_plan_add recurses once per lazy node on a path, and the nodes it
+ * can not fit are evaluated from inside it. Before planning, lazy_cut
+ * orders the lazy nodes below the root with an explicit stack and
+ * evaluates, inputs first, each node NLAZY_MAX_OPS lazy levels above the
+ * last evaluated ones. Plans and the evaluations nested in them then stay
+ * within NLAZY_MAX_OPS levels whatever the length of the chain.
+ */
+typedef struct{
+    Node* node;
+    int pending;                // lazy consumers not ordered yet
+    int height;                 // lazy levels down to evaluated nodes or leaves
+}lazy_entry;
+
+typedef struct{
+    lazy_entry* entries;
+    int n, cap;
+    int* table;                 // entry index + 1, 0 for an empty slot
+    int mask;                   // table size - 1, the table stays at most half full
+}lazy_dag;
+
+NR_STATIC_INLINE int
+lazy_dag_slot(const lazy_dag* g, const Node* node){
+    uint64_t h = (uint64_t)(uintptr_t)node * 0x9E3779B97F4A7C15ull;
+    int slot = (int)(h >> 40) & g->mask;
+    while (g->table[slot] && g->entries[g->table[slot] - 1].node != node){
+        slot = (slot + 1) & g->mask;
+    }
+    return slot;
+}
+
+/* Entry of `node`, added when it is new; -1 with an error raised on failure */
+NR_PRIVATE int
+lazy_dag_get(lazy_dag* g, Node* node){
+    if (g->table){
+        int e = g->table[lazy_dag_slot(g, node)] - 1;
+        if (e >= 0){
+            return e;
+        }
+    }
+    if (g->n == g->cap){
+        int cap = g->cap ? g->cap * 2 : 64;
+        lazy_entry* entries = (lazy_entry*)realloc(g->entries, sizeof(lazy_entry) * cap);
+        if (!entries){
+            NError_RaiseMemoryError();
+            return -1;
+        }
+        g->entries = entries;
+        g->cap = cap;
+    }
+    if (2 * (g->n + 1) > g->mask + 1){
+        int size = g->table ? 2 * (g->mask + 1) : 128;
+        int* table = (int*)calloc(size, sizeof(int));
+        if (!table){
+            NError_RaiseMemoryError();
+            return -1;
+        }
+        free(g->table);
+        g->table = table;
+        g->mask = size - 1;
+        for (int i = 0; i < g->n; i++){
+            g->table[lazy_dag_slot(g, g->entries[i].node)] = i + 1;
+        }
+    }
+    int e = g->n++;
+    g->entries[e].node = node;
+    g->entries[e].pending = 0;
+    g->entries[e].height = 0;
+    g->table[lazy_dag_slot(g, node)] = e + 1;
+    return e;
+}
+
+NR_PRIVATE int
+lazy_push(int** stack, int* nstack, int* cap, int e){
+    if (*nstack == *cap){
+        int* grown = (int*)realloc(*stack, sizeof(int) * (*cap) * 2);
+        if (!grown){
+            NError_RaiseMemoryError();
+            return -1;
+        }
+        *stack = grown;
+        *cap *= 2;
+    }
+    (*stack)[(*nstack)++] = e;
+    return 0;
+}
+
+NR_STATIC_INLINE NFuncArgs*
+lazy_args(const Node* node){
+    return ((NFuncFuncInfo*)node->nfunc_info)->args;
+}
+
+NR_PRIVATE int
+lazy_cut(Node* root){
+    NFuncArgs* rargs = lazy_args(root);
+    int deep = 0;
+    for (int i = 0; i < rargs->nin; i++){
+        deep |= NODE_IS_LAZY(rargs->in_nodes[i]);
+    }
+    if (!deep){
+        return 0;
+    }
+
+    int result = -1;
+    lazy_dag g = {NULL, 0, 0, NULL, -1};
+    int cap = 64, nstack = 0, norder = 0;
+    int* stack = (int*)malloc(sizeof(int) * cap);
+    int* order = NULL;
+    if (!stack){
+        NError_RaiseMemoryError();
+        goto done;
+    }
+
+    // every lazy node once, counting the lazy consumers of each
+    if (lazy_dag_get(&g, root) < 0 || lazy_push(&stack, &nstack, &cap, 0) < 0){
+        goto done;
+    }
+    while (nstack > 0){
+        NFuncArgs* args = lazy_args(g.entries[stack[--nstack]].node);
+        for (int i = 0; i < args->nin; i++){
+            Node* in = args->in_nodes[i];
+            if (!NODE_IS_LAZY(in)){
+                continue;
+            }
+            int n = g.n;
+            int k = lazy_dag_get(&g, in);
+            if (k < 0 || (k == n && lazy_push(&stack, &nstack, &cap, k) < 0)){
+                goto done;
+            }
+            g.entries[k].pending++;
+        }
+    }
+
+    // consumers before their inputs
+    order = (int*)malloc(sizeof(int) * g.n);
+    if (!order){
+        NError_RaiseMemoryError();
+        goto done;
+    }
+    order[norder++] = 0;
+    for (int head = 0; head < norder; head++){
+        NFuncArgs* args = lazy_args(g.entries[order[head]].node);
+        for (int i = 0; i < args->nin; i++){
+            if (NODE_IS_LAZY(args->in_nodes[i])){
+                int k = g.table[lazy_dag_slot(&g, args->in_nodes[i])] - 1;
+                if (--g.entries[k].pending == 0){
+                    order[norder++] = k;
+                }
+            }
+        }
+    }
+
+    // inputs first; a consumer keeps its inputs alive, evaluated or not
+    for (int j = norder - 1; j > 0; j--){
+        lazy_entry* x = &g.entries[order[j]];
+        NFuncArgs* args = lazy_args(x->node);
+        int height = 1;
+        for (int i = 0; i < args->nin; i++){
+            if (NODE_IS_LAZY(args->in_nodes[i])){
+                int k = g.table[lazy_dag_slot(&g, args->in_nodes[i])] - 1;
+                height = NR_MAX(height, g.entries[k].height + 1);
+            }
+        }
+        x->height = height;
+        if (height == NLAZY_MAX_OPS){
+            if (Node_Evaluate(x->node) != 0){
+                goto done;
+            }
+            x->height = 0;
+        }
+    }
+    result = 0;
+
+done:
+    free(stack);
+    free(order);
+    free(g.entries);
+    free(g.table);
+    return result;
+}
+
+NR_PUBLIC int
+Node_Evaluate(Node* node){
+    if (!node || !NODE_IS_LAZY(node)){
+        return 0;
+    }
+    if (lazy_cut(node) != 0){
+        return -1;
+    }
+
+    lazy_plan* p = (lazy_plan*)malloc(sizeof(lazy_plan));
+    if (!p){
+        NError_RaiseMemoryError();
+        return -1;
+    }
+    if (lazy_plan_build(p, node) != 0){
+        free(p);
+        return -1;
+    }
+
+    nr_intp nitems = Node_NItems(node);
+    nr_intp nbytes = nitems * NODE_ITEMSIZE(node);
+    void* data = NMem_Alloc(nbytes);
+    if (!data){
+        free(p);
+        return -1;
+    }
+    node->data = data;
+
+    Node* nodes[NR_MULTIITER_MAX_NITER];
+    for (int i = 0; i < p->nleaves; i++){
+        nodes[i] = p->leaves[i];
+    }
+    nodes[p->nleaves] = node;
+    p->failed = 0;
+    if (nitems > 0){
+        NInnerIter iit;
+        if (NInnerIter_FromNodes(&iit, nodes, p->nleaves + 1, NITER_ORDER_K) != 0){
+            p->failed = 1;
+        }
+        else{
+            NInnerIter_ITER(&iit);
+            while (!p->failed && NInnerIter_NOTDONE(&iit)){
+                char** ptrs = NInnerIter_PTRS(&iit);
+                nr_intp* strides = NInnerIter_STRIDES(&iit);
+                for (int i = 0; i <= p->nleaves; i++){
+                    p->ptrs[i] = ptrs[i];
+                    p->strides[i] = strides[i];
+                }
+                NThread_ParallelFor(NInnerIter_COUNT(&iit), NTHREAD_GRAIN_HEAVY, lazy_range, p);
+                NInnerIter_NEXT(&iit);
+            }
+        }
+    }
+
+    if (p->failed){
+        node->data = NULL;
+        NMem_Free(data, nbytes);
+        free(p);
+        if (!NError_IsError()){
+            NError_RaiseError(NError_RuntimeError, "lazy evaluation failed");
+        }
+        return -1;
+    }
+
+    free(p);
+    node->flags |= NR_NODE_OWNDATA | NR_NODE_NMEMDATA;
+    NLazy_Release(node);
+    return 0;
+}
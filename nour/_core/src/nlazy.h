@@ -0,0 +1,63 @@
+#ifndef NR__CORE__SRC__NLAZY_H
+#define NR__CORE__SRC__NLAZY_H
+
+#include "nour/nour.h"
+
+/*
+ * Lazy elementwise evaluation.
+ *
+ * While lazy mode is on in a thread, NFunc_Call does not run elementwise
+ * functions (NFUNC_FLAG_ELEMENTWISE, one output, no output node given).
+ * It returns a lazy node instead: the result's shape and dtype with no
+ * data (NR_NODE_LAZY), whose nfunc_info holds the function and a
+ * reference to each input. Chains of such calls build an expression DAG.
+ *
+ * Node_Evaluate computes a lazy node in one pass: the DAG is cut into
+ * blocks of NLAZY_BLOCK items, and every block goes through all the
+ * functions while it is in cache, with the leaves gathered and the
+ * intermediate results kept in small per-thread buffers. Only the
+ * evaluated node gets a data buffer. `exp(a*b + c) - d` thus reads a, b,
+ * c and d once and allocates one array, instead of four arrays and four
+ * passes. Results match eager evaluation.
+ *
+ * Any NFunc that is not deferred evaluates its lazy inputs first, and so
+ * do views (Node_NewChild), Node_Copy, printing and the npy writers
+ * through Node_Materialize. Other code reads NODE_DATA directly, so lazy
+ * nodes must be evaluated before they are handed to it.
+ */
+
+/* Items per block of a fused pass */
+#define NLAZY_BLOCK 256
+
+/* Largest DAG fused in one pass; bigger ones are evaluated in parts */
+#define NLAZY_MAX_OPS 32
+
+/* Turns lazy mode of the calling thread on or off, returns the previous state. */
+NR_PUBLIC int
+NLazy_SetEnabled(int enabled);
+
+NR_PUBLIC int
+NLazy_IsEnabled(void);
+
+/*
+ * Computes a lazy node in place: it gets its data buffer, drops its
+ * references to the inputs and becomes a regular node. Lazy nodes of the
+ * DAG other than `node` stay lazy. Does nothing on regular nodes.
+ * Returns 0, or -1 with an error raised (`node` stays lazy then).
+ */
+NR_PUBLIC int
+Node_Evaluate(Node* node);
+
+/* Used by NFunc_Call: whether the call can be deferred in lazy mode. */
+NR_PUBLIC int
+NLazy_CanDefer(const NFunc* nfunc, const NFuncArgs* args, NR_DTYPE in_dtype);
+
+/* Used by NFunc_Call: stores a lazy node for the call in args->out_nodes[0]. */
+NR_PUBLIC int
+NLazy_Defer(const NFunc* nfunc, NFuncArgs* args, NR_DTYPE in_dtype, NR_DTYPE out_dtype);
+
+/* Used by Node_Free: releases the inputs of a lazy node. */
+NR_PUBLIC void
+NLazy_Release(Node* node);
+
+#endif // NR__CORE__SRC__NLAZY_H
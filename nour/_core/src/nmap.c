@@ -0,0 +1,189 @@
+#include "nmap.h"
+#include "node_core.h"
+#include "nerror.h"
+#include <stdlib.h>
+
+#if NR_UNIX
+    #define NMAP_POSIX 1
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <string.h>
+#else
+    #define NMAP_POSIX 0
+#endif
+
+#if NMAP_POSIX
+
+/* Deleter context: the whole mapping, which starts below the node data */
+typedef struct{
+    void* base;
+    size_t length;
+}nmap_region;
+
+NR_PRIVATE void
+nmap_unmap(NR_UNUSED(void* data), void* ctx){
+    nmap_region* region = (nmap_region*)ctx;
+    munmap(region->base, region->length);
+    free(region);
+}
+
+NR_PRIVATE int
+nmap_advice_flag(NMap_Advice advice){
+    switch (advice) {
+        case NMAP_ADVICE_SEQUENTIAL:
+            return MADV_SEQUENTIAL;
+        case NMAP_ADVICE_RANDOM:
+            return MADV_RANDOM;
+        case NMAP_ADVICE_WILLNEED:
+            return MADV_WILLNEED;
+        default:
+            return MADV_NORMAL;
+    }
+}
+
+NR_PUBLIC Node*
+Node_FromMmap(int fd, nr_intp offset, int ndim, nr_intp* shape,
+              NR_DTYPE dtype, NMap_Mode mode, NMap_Advice advice){
+    nr_intp itemsize = NDtype_Size(dtype);
+    if (offset < 0 || itemsize <= 0) {
+        return NError_RaiseError(NError_ValueError,
+            "mmap: invalid offset %lld or dtype", (long long)offset);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return NError_RaiseError(NError_IOError, "mmap: %s", strerror(errno));
+    }
+    nr_intp file_size = (nr_intp)st.st_size;
+
+    nr_intp flat_shape[1];
+    if (!shape) {
+        if (offset > file_size) {
+            return NError_RaiseError(NError_ValueError,
+                "mmap: offset %lld past the end of a %lld byte file",
+                (long long)offset, (long long)file_size);
+        }
+        flat_shape[0] = (file_size - offset) / itemsize;
+        shape = flat_shape;
+        ndim = 1;
+    }
+    nr_intp nbytes = NR_NItems(ndim, shape) * itemsize;
+    if (nbytes > file_size - offset) {
+        return NError_RaiseError(NError_ValueError,
+            "mmap: %lld bytes at offset %lld do not fit in a %lld byte file",
+            (long long)nbytes, (long long)offset, (long long)file_size);
+    }
+    if (nbytes == 0) {
+        return NError_RaiseError(NError_ValueError, "mmap: cannot map an empty region");
+    }
+
+    int prot = mode == NMAP_READONLY ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = mode == NMAP_COPYONWRITE ? MAP_PRIVATE : MAP_SHARED;
+
+    // mmap offsets must be page aligned, the node starts inside the first page
+    nr_intp page = (nr_intp)sysconf(_SC_PAGESIZE);
+    nr_intp map_offset = offset - offset % page;
+    size_t length = (size_t)(nbytes + (offset - map_offset));
+
+    nmap_region* region = (nmap_region*)malloc(sizeof(nmap_region));
+    if (!region) {
+        return NError_RaiseMemoryError();
+    }
+    void* base = mmap(NULL, length, prot, flags, fd, (off_t)map_offset);
+    if (base == MAP_FAILED) {
+        free(region);
+        return NError_RaiseError(NError_IOError, "mmap: %s", strerror(errno));
+    }
+    region->base = base;
+    region->length = length;
+    if (advice != NMAP_ADVICE_NORMAL) {
+        // only a hint, a refusal is not an error
+        madvise(base, length, nmap_advice_flag(advice));
+    }
+
+    char* data = (char*)base + (offset - map_offset);
+    Node* node = Node_NewExternal(data, ndim, shape, NULL, dtype, nmap_unmap, region);
+    if (!node) {
+        nmap_unmap(data, region);
+        return NULL;
+    }
+    return node;
+}
+
+NR_PUBLIC Node*
+Node_MapFile(const char* path, nr_intp offset, int ndim, nr_intp* shape,
+             NR_DTYPE dtype, NMap_Mode mode, NMap_Advice advice){
+    int fd = open(path, mode == NMAP_READWRITE ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return NError_RaiseError(NError_IOError, "mmap: cannot open '%s': %s",
+                                 path, strerror(errno));
+    }
+    Node* node = Node_FromMmap(fd, offset, ndim, shape, dtype, mode, advice);
+    // the mapping holds its own reference to the file
+    close(fd);
+    return node;
+}
+
+NR_PUBLIC int
+NMap_Advise(Node* node, NMap_Advice advice){
+    Node* root = node;
+    while (root && root->deleter != nmap_unmap) {
+        root = root->base;
+    }
+    if (!root) {
+        NError_RaiseError(NError_ValueError, "mmap: node is not backed by a mapped file");
+        return -1;
+    }
+    if (Node_NItems(node) == 0) {
+        return 0;
+    }
+
+    // byte span of the node, strides may be negative
+    nr_intp lo = 0, hi = 0;
+    for (int i = 0; i < node->ndim; i++) {
+        nr_intp extent = (node->shape[i] - 1) * node->strides[i];
+        if (extent < 0) {
+            lo += extent;
+        }
+        else {
+            hi += extent;
+        }
+    }
+    nr_intp page = (nr_intp)sysconf(_SC_PAGESIZE);
+    nmap_region* region = (nmap_region*)root->deleter_ctx;
+    char* start = (char*)NODE_DATA(node) + lo;
+    char* end = (char*)NODE_DATA(node) + hi + NODE_ITEMSIZE(node);
+    char* aligned = (char*)region->base + ((start - (char*)region->base) / page) * page;
+    if (madvise(aligned, (size_t)(end - aligned), nmap_advice_flag(advice)) != 0) {
+        NError_RaiseError(NError_IOError, "madvise: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+NR_PUBLIC Node*
+Node_FromMmap(int NR_UNUSED(fd), nr_intp NR_UNUSED(offset), int NR_UNUSED(ndim),
+              NR_UNUSED(nr_intp* shape), NR_DTYPE NR_UNUSED(dtype),
+              NMap_Mode NR_UNUSED(mode), NMap_Advice NR_UNUSED(advice)){
+    return NError_RaiseError(NError_NotImplementedError, "mmap is not supported on this platform");
+}
+
+NR_PUBLIC Node*
+Node_MapFile(NR_UNUSED(const char* path), nr_intp NR_UNUSED(offset), int NR_UNUSED(ndim),
+             NR_UNUSED(nr_intp* shape), NR_DTYPE NR_UNUSED(dtype),
+             NMap_Mode NR_UNUSED(mode), NMap_Advice NR_UNUSED(advice)){
+    return NError_RaiseError(NError_NotImplementedError, "mmap is not supported on this platform");
+}
+
+NR_PUBLIC int
+NMap_Advise(NR_UNUSED(Node* node), NMap_Advice NR_UNUSED(advice)){
+    NError_RaiseError(NError_NotImplementedError, "mmap is not supported on this platform");
+    return -1;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef NR__CORE__SRC__NMAP_H
+#define NR__CORE__SRC__NMAP_H
+
+#include "nour/nour.h"
+
+/*
+ * Nodes over memory-mapped files.
+ *
+ * The node wraps the mapping the way Node_NewExternal wraps a buffer: the
+ * node and every view of it (Node_Get slices, Node_NewChild, ...) keep the
+ * mapping alive and the last one to go unmaps it. Pages are read from the
+ * file on first touch, so slicing a large file only costs the pages the
+ * slice actually reads.
+ *
+ * POSIX only; elsewhere the constructors raise NotImplementedError.
+ */
+
+typedef enum{
+    NMAP_READONLY = 0,          // writing to the node faults
+    NMAP_READWRITE,             // writes go to the file
+    NMAP_COPYONWRITE,           // writes stay private to the process
+}NMap_Mode;
+
+/* Expected access pattern, passed to madvise */
+typedef enum{
+    NMAP_ADVICE_NORMAL = 0,
+    NMAP_ADVICE_SEQUENTIAL,     // aggressive read-ahead, pages dropped early
+    NMAP_ADVICE_RANDOM,         // no read-ahead
+    NMAP_ADVICE_WILLNEED,       // start reading the pages now
+}NMap_Advice;
+
+/*
+ * Maps `path` and returns a C-contiguous node of `dtype` over the bytes
+ * starting at `offset`, which need not be page aligned. With `shape` NULL
+ * the node is 1-D and covers the file up to its end; otherwise the file
+ * must hold the whole shape. The file is closed again before returning.
+ */
+NR_PUBLIC Node*
+Node_MapFile(const char* path, nr_intp offset, int ndim, nr_intp* shape,
+             NR_DTYPE dtype, NMap_Mode mode, NMap_Advice advice);
+
+/*
+ * Node_MapFile over an open file descriptor. `fd` stays with the caller
+ * and may be closed as soon as this returns.
+ */
+NR_PUBLIC Node*
+Node_FromMmap(int fd, nr_intp offset, int ndim, nr_intp* shape,
+              NR_DTYPE dtype, NMap_Mode mode, NMap_Advice advice);
+
+/*
+ * Applies `advice` to the pages spanned by `node`, which must be a mapped
+ * node or a view of one. Use it to announce the access pattern of a slice
+ * or to prefetch it with NMAP_ADVICE_WILLNEED. Returns 0, or -1 with an
+ * error raised.
+ */
+NR_PUBLIC int
+NMap_Advise(Node* node, NMap_Advice advice);
+
+#endif // NR__CORE__SRC__NMAP_H
@@ -1,11 +1,13 @@
 #include "nour/nour.h"
 #include "cumulative.h"
+#include "reduce.h"
 #include "../niter.h"
 #include "../nerror.h"
 #include "../node_core.h"
 #include "../tc_methods.h"
 #include "../nfunc.h"
 #include "../free.h"
+#include "../nthread.h"
 #include "loops.h"
 #include <string.h>
 #include <stdlib.h>
@@ -55,55 +57,135 @@ normalize_axis(int axis, int ndim)
 }
 
 /* ============================================================================
- * Index Conversion Helpers
+ * Slice Layout
  * ============================================================================ */
 
-NR_STATIC_INLINE void
-linear_to_coords(nr_intp linear, const nr_intp* shape, int ndim, nr_intp* coords)
+/*
+ * The kernels walk the input and the output with byte strides, never with
+ * per-item coordinates. The axes other than the scanned one are split in:
+ *  - lanes: the last of them, merged with the ones before it while both
+ *    nodes can step over them with a single stride;
+ *  - rows: all the others, stepped over like an odometer.
+ * A row holds `lanes` independent slices. When the scanned axis has the
+ * smaller stride (the last axis of a C-ordered node) every lane is walked
+ * on its own. Otherwise the lanes are walked together, one step of the
+ * scanned axis at a time, with a running value per lane, so cumsum over
+ * axis 0 of a C-ordered matrix reads and writes memory in order.
+ */
+#define CUM_LANES 256
+
+/* Long contiguous 1-D scans, see DEFINE_CUM_BLOCKS */
+#define CUM_PAR_BLOCK 65536
+#define CUM_PAR_MAX_BLOCKS 1024
+
+typedef struct{
+    Node* in;
+    Node* out;
+    int compensate;
+    nr_intp axis_len;           // items along the scanned axis of the input
+    nr_intp in_astride;         // byte strides along the scanned axis
+    nr_intp out_astride;
+    nr_intp lanes;
+    nr_intp in_lstride;         // byte strides from a lane to the next one
+    nr_intp out_lstride;
+    int lane_major;             // walk the lanes together
+    int nrow_dims;
+    nr_intp row_shape[NR_NODE_MAX_NDIM];
+    nr_intp in_rstrides[NR_NODE_MAX_NDIM];
+    nr_intp out_rstrides[NR_NODE_MAX_NDIM];
+    nr_intp n_rows;
+
+    // blocked 1-D scan, one entry per block
+    nr_intp block;
+    void* total;                // reduction of the block
+    void* total_comp;
+    int* has_total;             // 0 when a later min/max block only holds NaNs
+    void* start;                // running value the block starts from
+    void* start_comp;
+}cum_ctx;
+
+/* `out` has the shape of `in` except along `axis` */
+NR_PRIVATE void
+cum_ctx_init(cum_ctx* c, Node* in, Node* out, int axis, int compensate)
 {
-    for (int d = ndim - 1; d >= 0; d--) {
-        coords[d] = linear % shape[d];
-        linear /= shape[d];
+    int nd = in->ndim;
+    memset(c, 0, sizeof(cum_ctx));
+    c->in = in;
+    c->out = out;
+    c->compensate = compensate;
+    c->axis_len = in->shape[axis];
+    c->in_astride = in->strides[axis];
+    c->out_astride = out->strides[axis];
+
+    int lane_lo = -1, lane_hi = -1;
+    c->lanes = 1;
+    if (nd > 1) {
+        lane_hi = lane_lo = axis == nd - 1 ? nd - 2 : nd - 1;
+        c->lanes = in->shape[lane_hi];
+        c->in_lstride = in->strides[lane_hi];
+        c->out_lstride = out->strides[lane_hi];
+        while (lane_lo - 1 >= 0 && lane_lo - 1 != axis &&
+               in->strides[lane_lo - 1] == c->lanes * c->in_lstride &&
+               out->strides[lane_lo - 1] == c->lanes * c->out_lstride) {
+            lane_lo--;
+            c->lanes *= in->shape[lane_lo];
+        }
+    }
+
+    c->n_rows = 1;
+    for (int d = 0; d < nd; d++) {
+        if (d == axis || (d >= lane_lo && d <= lane_hi)) {
+            continue;
+        }
+        c->row_shape[c->nrow_dims] = in->shape[d];
+        c->in_rstrides[c->nrow_dims] = in->strides[d];
+        c->out_rstrides[c->nrow_dims] = out->strides[d];
+        c->nrow_dims++;
+        c->n_rows *= in->shape[d];
     }
+
+    nr_intp as = c->in_astride < 0 ? -c->in_astride : c->in_astride;
+    nr_intp ls = c->in_lstride < 0 ? -c->in_lstride : c->in_lstride;
+    c->lane_major = c->lanes > 1 && as > ls;
 }
 
-NR_STATIC_INLINE nr_intp
-coords_to_linear(const nr_intp* coords, const nr_intp* shape, int ndim)
+/* Points *pin / *pout at the first item of row `row` */
+NR_STATIC_INLINE void
+cum_row_seek(const cum_ctx* c, nr_intp row, nr_intp* coords, char** pin, char** pout)
 {
-    nr_intp linear = 0, mult = 1;
-    for (int d = ndim - 1; d >= 0; d--) {
-        linear += coords[d] * mult;
-        mult *= shape[d];
+    *pin = (char*)NODE_DATA(c->in);
+    *pout = (char*)NODE_DATA(c->out);
+    for (int d = c->nrow_dims - 1; d >= 0; d--) {
+        coords[d] = row % c->row_shape[d];
+        row /= c->row_shape[d];
+        *pin += coords[d] * c->in_rstrides[d];
+        *pout += coords[d] * c->out_rstrides[d];
     }
-    return linear;
 }
 
-NR_STATIC_INLINE nr_intp
-coords_to_offset(const nr_intp* coords, const nr_intp* strides, int ndim)
+NR_STATIC_INLINE void
+cum_row_next(const cum_ctx* c, nr_intp* coords, char** pin, char** pout)
 {
-    nr_intp offset = 0;
-    for (int d = 0; d < ndim; d++) {
-        offset += coords[d] * strides[d];
+    for (int d = c->nrow_dims - 1; d >= 0; d--) {
+        if (++coords[d] < c->row_shape[d]) {
+            *pin += c->in_rstrides[d];
+            *pout += c->out_rstrides[d];
+            return;
+        }
+        coords[d] = 0;
+        *pin -= (c->row_shape[d] - 1) * c->in_rstrides[d];
+        *pout -= (c->row_shape[d] - 1) * c->out_rstrides[d];
     }
-    return offset;
 }
 
-/* ============================================================================
- * Input/Output Value Access Macros
- * ============================================================================ */
-
-#define READ_VAL(NT, data, coords, node, is_contig, linear) \
-    (is_contig ? ((NT*)data)[linear] : \
-     *(NT*)((char*)data + coords_to_offset(coords, node->strides, node->ndim)))
-
-#define WRITE_VAL(NT, data, coords, node, is_contig, linear, val) \
-    do { \
-        if (is_contig) { \
-            ((NT*)data)[linear] = val; \
-        } else { \
-            *(NT*)((char*)data + coords_to_offset(coords, node->strides, node->ndim)) = val; \
-        } \
-    } while(0)
+/* Runs a kernel's row function over the pool, split by rows */
+NR_PRIVATE void
+cum_run_rows(cum_ctx* c, NThread_RangeFunc func)
+{
+    nr_intp per_row = c->axis_len * c->lanes;
+    nr_intp grain = per_row > 0 ? NTHREAD_GRAIN_DEFAULT / per_row : 1;
+    NThread_ParallelFor(c->n_rows, grain > 0 ? grain : 1, func, c);
+}
 
 /* ============================================================================
  * Output Node Setup (common to all cumulative operations)
@@ -157,126 +239,239 @@ coords_to_offset(const nr_intp* coords, const nr_intp* strides, int ndim)
     } \
     return 0;
 
+/*
+ * acc = OP_FUNC(acc, val), or a compensated add into (acc, comp) when
+ * `compensate` is set. A scan has no pairwise form, so float cumsum uses
+ * the compensated add in both PAIRWISE and KAHAN modes and writes
+ * acc + comp; comp stays 0 otherwise.
+ */
+#define CUM_ACCUMULATE(OP_FUNC, O_NT, acc, comp, val, compensate) do { \
+    if (compensate) { \
+        NMATH_KAHAN_ADD(O_NT, acc, comp, val); \
+    } else { \
+        acc = OP_FUNC(acc, (O_NT)(val)); \
+    } \
+} while (0)
+
 /* ============================================================================
- * BASIC CUMULATIVE KERNEL (cumsum, cumprod, cummin, cummax)
+ * Parallel Scans
  * ============================================================================ */
 
-#define DEFINE_CUM_KERNEL(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST, PROM_O_DT) \
-NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
-    SETUP_CUM_OUTPUT(O_NT, PROM_O_DT) \
-    I_NT* in_data = (I_NT*)NODE_DATA(n1); \
-    \
-    /* Calculate strides for iteration */ \
-    nr_intp axis_len = n1->shape[axis]; \
-    nr_intp n_slices = n_items / axis_len; \
-    \
-    /* Pre-compute stride multipliers for axis traversal */ \
-    nr_intp inner_size = 1; \
-    for (int d = axis + 1; d < n1->ndim; d++) { \
-        inner_size *= n1->shape[d]; \
-    } \
-    \
-    /* Iterate over all slices perpendicular to axis */ \
-    for (nr_intp slice = 0; slice < n_slices; slice++) { \
-        /* Compute base coordinates for this slice */ \
-        nr_intp outer_idx = slice / inner_size; \
-        nr_intp inner_idx = slice % inner_size; \
-        \
-        nr_intp base_coords[NR_NODE_MAX_NDIM]; \
-        nr_intp temp = outer_idx; \
-        for (int d = axis - 1; d >= 0; d--) { \
-            base_coords[d] = temp % n1->shape[d]; \
-            temp /= n1->shape[d]; \
+/*
+ * A contiguous 1-D scan of at least two CUM_PAR_BLOCK items is cut into
+ * fixed blocks and run in two passes over the thread pool: every block is
+ * reduced on its own, the block totals are folded in order into the value
+ * each block starts from, then every block is scanned again from that
+ * value. The blocks only depend on the length, so the result is the same
+ * for any number of threads; float sums and products can differ from a
+ * left-to-right scan in the last bits.
+ *
+ * Other inputs are split over the pool by rows (see Slice Layout).
+ */
+
+NR_STATIC_INLINE nr_intp
+cum_par_block(nr_intp n)
+{
+    nr_intp block = (n + CUM_PAR_MAX_BLOCKS - 1) / CUM_PAR_MAX_BLOCKS;
+    return block < CUM_PAR_BLOCK ? CUM_PAR_BLOCK : block;
+}
+
+/*
+ * Both passes of the blocked scan. Like DEFINE_REDUCE_BLOCKS, a min/max
+ * block past the first one skips its leading NaNs: the scan ignores a NaN
+ * that follows a value, so those must not end up in the block total.
+ */
+#define DEFINE_CUM_BLOCKS(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST) \
+NR_PRIVATE void OP_NAME##_totals_##I_NT(void* ctx, nr_intp start, nr_intp end) { \
+    cum_ctx* c = (cum_ctx*)ctx; \
+    const I_NT* in = (const I_NT*)NODE_DATA(c->in); \
+    for (nr_intp s = start; s < end; s += c->block) { \
+        nr_intp b = s / c->block; \
+        nr_intp e = end - s < c->block ? end : s + c->block; \
+        nr_intp i = s; \
+        O_NT acc = (O_NT)(INIT_VAL), comp = 0; \
+        if (NEEDS_FIRST) { \
+            acc = (O_NT)in[i++]; \
+            while (s > 0 && i < e && isnan((double)acc)) acc = (O_NT)in[i++]; \
         } \
-        temp = inner_idx; \
-        for (int d = n1->ndim - 1; d > axis; d--) { \
-            base_coords[d] = temp % n1->shape[d]; \
-            temp /= n1->shape[d]; \
+        for (; i < e; i++) { \
+            CUM_ACCUMULATE(OP_FUNC, O_NT, acc, comp, in[i], c->compensate); \
         } \
-        \
-        /* Cumulative operation along axis */ \
-        O_NT acc = (O_NT)(INIT_VAL); \
-        int first = (NEEDS_FIRST); \
-        \
-        for (nr_intp i = 0; i < axis_len; i++) { \
-            base_coords[axis] = i; \
-            nr_intp lin = coords_to_linear(base_coords, n1->shape, n1->ndim); \
-            \
-            I_NT in_val = READ_VAL(I_NT, in_data, base_coords, n1, in_contig, lin); \
-            \
+        ((O_NT*)c->total)[b] = acc; \
+        ((O_NT*)c->total_comp)[b] = comp; \
+        c->has_total[b] = !(NEEDS_FIRST) || s == 0 || !isnan((double)acc); \
+    } \
+} \
+NR_PRIVATE void OP_NAME##_rescan_##I_NT(void* ctx, nr_intp start, nr_intp end) { \
+    cum_ctx* c = (cum_ctx*)ctx; \
+    const I_NT* in = (const I_NT*)NODE_DATA(c->in); \
+    O_NT* out = (O_NT*)NODE_DATA(c->out); \
+    for (nr_intp s = start; s < end; s += c->block) { \
+        nr_intp b = s / c->block; \
+        nr_intp e = end - s < c->block ? end : s + c->block; \
+        O_NT acc = ((O_NT*)c->start)[b], comp = ((O_NT*)c->start_comp)[b]; \
+        int first = (NEEDS_FIRST) && s == 0; \
+        for (nr_intp i = s; i < e; i++) { \
             if (first) { \
-                acc = (O_NT)in_val; \
+                acc = (O_NT)in[i]; \
                 first = 0; \
             } else { \
-                acc = OP_FUNC(acc, (O_NT)in_val); \
+                CUM_ACCUMULATE(OP_FUNC, O_NT, acc, comp, in[i], c->compensate); \
             } \
-            \
-            WRITE_VAL(O_NT, out_data, base_coords, out, out_contig, lin, acc); \
+            out[i] = acc + comp; \
         } \
     } \
+} \
+NR_PRIVATE void OP_NAME##_scan_blocks_##I_NT(cum_ctx* c) { \
+    O_NT total[CUM_PAR_MAX_BLOCKS], total_comp[CUM_PAR_MAX_BLOCKS]; \
+    O_NT start[CUM_PAR_MAX_BLOCKS], start_comp[CUM_PAR_MAX_BLOCKS]; \
+    int has_total[CUM_PAR_MAX_BLOCKS]; \
+    c->block = cum_par_block(c->axis_len); \
+    c->total = total; \
+    c->total_comp = total_comp; \
+    c->has_total = has_total; \
+    c->start = start; \
+    c->start_comp = start_comp; \
+    NThread_ParallelFor(c->axis_len, c->block, OP_NAME##_totals_##I_NT, c); \
     \
-    FINALIZE_CUM_OUTPUT() \
+    nr_intp nb = (c->axis_len + c->block - 1) / c->block; \
+    start[0] = (O_NT)(INIT_VAL); \
+    start_comp[0] = 0; \
+    for (nr_intp b = 1; b < nb; b++) { \
+        O_NT acc = start[b - 1], comp = start_comp[b - 1]; \
+        if ((NEEDS_FIRST) && b == 1) { \
+            acc = total[0]; \
+        } else if (has_total[b - 1]) { \
+            CUM_ACCUMULATE(OP_FUNC, O_NT, acc, comp, total[b - 1], c->compensate); \
+            comp += total_comp[b - 1]; \
+        } \
+        start[b] = acc; \
+        start_comp[b] = comp; \
+    } \
+    NThread_ParallelFor(c->axis_len, c->block, OP_NAME##_rescan_##I_NT, c); \
 }
 
 /* ============================================================================
- * NAN-IGNORING CUMULATIVE KERNEL (nancumsum, nancumprod)
+ * BASIC CUMULATIVE KERNEL (cumsum, cumprod, cummin, cummax)
  * ============================================================================ */
 
-#define DEFINE_NANCUM_KERNEL(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST, PROM_O_DT, ISNAN_MACRO) \
-NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
-    SETUP_CUM_OUTPUT(O_NT, PROM_O_DT) \
-    I_NT* in_data = (I_NT*)NODE_DATA(n1); \
-    \
-    nr_intp axis_len = n1->shape[axis]; \
-    nr_intp n_slices = n_items / axis_len; \
-    \
-    nr_intp inner_size = 1; \
-    for (int d = axis + 1; d < n1->ndim; d++) { \
-        inner_size *= n1->shape[d]; \
-    } \
-    \
-    for (nr_intp slice = 0; slice < n_slices; slice++) { \
-        nr_intp outer_idx = slice / inner_size; \
-        nr_intp inner_idx = slice % inner_size; \
-        \
-        nr_intp base_coords[NR_NODE_MAX_NDIM]; \
-        nr_intp temp = outer_idx; \
-        for (int d = axis - 1; d >= 0; d--) { \
-            base_coords[d] = temp % n1->shape[d]; \
-            temp /= n1->shape[d]; \
-        } \
-        temp = inner_idx; \
-        for (int d = n1->ndim - 1; d > axis; d--) { \
-            base_coords[d] = temp % n1->shape[d]; \
-            temp /= n1->shape[d]; \
+/*
+ * Scans rows [start, end) of a cum_ctx. SKIP_NAN leaves NaNs out like the
+ * nan* variants, ISNAN_MACRO tells them apart. Lanes walked together take
+ * a plain loop when nothing can differ between them (no NaN to skip, no
+ * first item, no compensation) and both nodes are contiguous along them.
+ */
+#define DEFINE_CUM_ROWS(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST, ISNAN_MACRO, SKIP_NAN) \
+NR_PRIVATE void OP_NAME##_rows_##I_NT(void* ctx, nr_intp start, nr_intp end) { \
+    cum_ctx* c = (cum_ctx*)ctx; \
+    const int compensate = c->compensate; \
+    const nr_intp ias = c->in_astride, oas = c->out_astride; \
+    const nr_intp ils = c->in_lstride, ols = c->out_lstride; \
+    const int contig_lanes = ils == (nr_intp)sizeof(I_NT) && ols == (nr_intp)sizeof(O_NT); \
+    nr_intp coords[NR_NODE_MAX_NDIM]; \
+    char *pin, *pout; \
+    cum_row_seek(c, start, coords, &pin, &pout); \
+    for (nr_intp r = start; r < end; r++, cum_row_next(c, coords, &pin, &pout)) { \
+        if (!c->lane_major) { \
+            for (nr_intp j = 0; j < c->lanes; j++) { \
+                const char* p = pin + j * ils; \
+                char* q = pout + j * ols; \
+                O_NT acc = (O_NT)(INIT_VAL), comp = 0; \
+                int first = (NEEDS_FIRST); \
+                for (nr_intp i = 0; i < c->axis_len; i++, p += ias, q += oas) { \
+                    I_NT v = *(const I_NT*)p; \
+                    if (!((SKIP_NAN) && ISNAN_MACRO(v))) { \
+                        if (first) { \
+                            acc = (O_NT)v; \
+                            first = 0; \
+                        } else { \
+                            CUM_ACCUMULATE(OP_FUNC, O_NT, acc, comp, v, compensate); \
+                        } \
+                    } \
+                    *(O_NT*)q = acc + comp; \
+                } \
+            } \
+            continue; \
         } \
-        \
-        O_NT acc = (O_NT)(INIT_VAL); \
-        int first = (NEEDS_FIRST); \
-        \
-        for (nr_intp i = 0; i < axis_len; i++) { \
-            base_coords[axis] = i; \
-            nr_intp lin = coords_to_linear(base_coords, n1->shape, n1->ndim); \
-            \
-            I_NT in_val = READ_VAL(I_NT, in_data, base_coords, n1, in_contig, lin); \
-            \
-            /* Skip NaN values - treat as identity */ \
-            if (ISNAN_MACRO(in_val)) { \
-                WRITE_VAL(O_NT, out_data, base_coords, out, out_contig, lin, acc); \
-                continue; \
+        for (nr_intp j0 = 0; j0 < c->lanes; j0 += CUM_LANES) { \
+            nr_intp nl = c->lanes - j0 < CUM_LANES ? c->lanes - j0 : CUM_LANES; \
+            O_NT acc[CUM_LANES]; \
+            O_NT comp[CUM_LANES]; \
+            char first[CUM_LANES]; \
+            for (nr_intp j = 0; j < nl; j++) { \
+                acc[j] = (O_NT)(INIT_VAL); \
+                comp[j] = 0; \
+                first[j] = (NEEDS_FIRST); \
             } \
-            \
-            if (first) { \
-                acc = (O_NT)in_val; \
-                first = 0; \
-            } else { \
-                acc = OP_FUNC(acc, (O_NT)in_val); \
+            const char* p = pin + j0 * ils; \
+            char* q = pout + j0 * ols; \
+            for (nr_intp i = 0; i < c->axis_len; i++, p += ias, q += oas) { \
+                if (!(SKIP_NAN) && !compensate && !((NEEDS_FIRST) && i == 0) && contig_lanes) { \
+                    const I_NT* pv = (const I_NT*)p; \
+                    O_NT* qv = (O_NT*)q; \
+                    for (nr_intp j = 0; j < nl; j++) { \
+                        acc[j] = OP_FUNC(acc[j], (O_NT)pv[j]); \
+                        qv[j] = acc[j] + comp[j]; \
+                    } \
+                    continue; \
+                } \
+                const char* pj = p; \
+                char* qj = q; \
+                for (nr_intp j = 0; j < nl; j++, pj += ils, qj += ols) { \
+                    I_NT v = *(const I_NT*)pj; \
+                    if (!((SKIP_NAN) && ISNAN_MACRO(v))) { \
+                        if ((NEEDS_FIRST) && first[j]) { \
+                            acc[j] = (O_NT)v; \
+                            first[j] = 0; \
+                        } else { \
+                            CUM_ACCUMULATE(OP_FUNC, O_NT, acc[j], comp[j], v, compensate); \
+                        } \
+                    } \
+                    *(O_NT*)qj = acc[j] + comp[j]; \
+                } \
             } \
-            \
-            WRITE_VAL(O_NT, out_data, base_coords, out, out_contig, lin, acc); \
         } \
     } \
-    \
+}
+
+/*
+ * COMPENSATE marks float sums, which follow NMath_SetSumMode (see CUM_ACCUMULATE).
+ * Long contiguous 1-D inputs go through DEFINE_CUM_BLOCKS, others through
+ * DEFINE_CUM_ROWS.
+ */
+#define DEFINE_CUM_KERNEL(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST, PROM_O_DT, COMPENSATE) \
+DEFINE_CUM_BLOCKS(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST) \
+DEFINE_CUM_ROWS(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST, ISNAN_INT, 0) \
+NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
+    SETUP_CUM_OUTPUT(O_NT, PROM_O_DT) \
+    (void)out_data; \
+    cum_ctx c; \
+    cum_ctx_init(&c, n1, out, axis, (COMPENSATE) && NMath_GetSumMode() != NMATH_SUM_NAIVE); \
+    if (n_items == 0) { \
+        /* nothing to scan */ \
+    } else if (c.n_rows == 1 && c.lanes == 1 && c.axis_len >= 2 * CUM_PAR_BLOCK && \
+               c.in_astride == (nr_intp)sizeof(I_NT) && c.out_astride == (nr_intp)sizeof(O_NT)) { \
+        OP_NAME##_scan_blocks_##I_NT(&c); \
+    } else { \
+        cum_run_rows(&c, OP_NAME##_rows_##I_NT); \
+    } \
+    FINALIZE_CUM_OUTPUT() \
+}
+
+/* ============================================================================
+ * NAN-IGNORING CUMULATIVE KERNEL (nancumsum, nancumprod)
+ * ============================================================================ */
+
+#define DEFINE_NANCUM_KERNEL(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST, PROM_O_DT, ISNAN_MACRO, COMPENSATE) \
+DEFINE_CUM_ROWS(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST, ISNAN_MACRO, 1) \
+NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
+    SETUP_CUM_OUTPUT(O_NT, PROM_O_DT) \
+    (void)out_data; \
+    cum_ctx c; \
+    cum_ctx_init(&c, n1, out, axis, (COMPENSATE) && NMath_GetSumMode() != NMATH_SUM_NAIVE); \
+    if (n_items > 0) { \
+        cum_run_rows(&c, OP_NAME##_rows_##I_NT); \
+    } \
     FINALIZE_CUM_OUTPUT() \
 }
 
@@ -285,6 +480,40 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
  * ============================================================================ */
 
 #define DEFINE_DIFF_KERNEL(OP_NAME, O_NT, I_NT, PROM_O_DT) \
+NR_PRIVATE void OP_NAME##_rows_##I_NT(void* ctx, nr_intp start, nr_intp end) { \
+    cum_ctx* c = (cum_ctx*)ctx; \
+    const nr_intp ias = c->in_astride, oas = c->out_astride; \
+    const nr_intp ils = c->in_lstride, ols = c->out_lstride; \
+    nr_intp n_out = c->axis_len - 1; \
+    nr_intp coords[NR_NODE_MAX_NDIM]; \
+    char *pin, *pout; \
+    cum_row_seek(c, start, coords, &pin, &pout); \
+    for (nr_intp r = start; r < end; r++, cum_row_next(c, coords, &pin, &pout)) { \
+        if (!c->lane_major) { \
+            for (nr_intp j = 0; j < c->lanes; j++) { \
+                const char* p = pin + j * ils; \
+                char* q = pout + j * ols; \
+                I_NT prev_val = *(const I_NT*)p; \
+                for (nr_intp i = 0; i < n_out; i++, q += oas) { \
+                    p += ias; \
+                    I_NT curr_val = *(const I_NT*)p; \
+                    *(O_NT*)q = (O_NT)curr_val - (O_NT)prev_val; \
+                    prev_val = curr_val; \
+                } \
+            } \
+            continue; \
+        } \
+        for (nr_intp i = 0; i < n_out; i++) { \
+            const char* p0 = pin + i * ias; \
+            const char* p1 = p0 + ias; \
+            char* q = pout + i * oas; \
+            for (nr_intp j = 0; j < c->lanes; j++) { \
+                *(O_NT*)(q + j * ols) = (O_NT)*(const I_NT*)(p1 + j * ils) - \
+                                        (O_NT)*(const I_NT*)(p0 + j * ils); \
+            } \
+        } \
+    } \
+} \
 NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
     Node* n1 = args->in_nodes[0]; \
     Node* caller_out = args->out_nodes[0]; \
@@ -325,56 +554,10 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
         } \
     } \
     \
-    O_NT* out_data = (O_NT*)NODE_DATA(out); \
-    I_NT* in_data = (I_NT*)NODE_DATA(n1); \
-    int in_contig = NODE_IS_CONTIGUOUS(n1); \
-    int out_contig = NODE_IS_CONTIGUOUS(out); \
-    \
-    nr_intp axis_len = n1->shape[axis]; \
-    nr_intp out_axis_len = out_shape[axis]; \
-    nr_intp n_items = Node_NItems(n1); \
-    nr_intp n_slices = n_items / axis_len; \
-    \
-    nr_intp inner_size = 1; \
-    for (int d = axis + 1; d < n1->ndim; d++) { \
-        inner_size *= n1->shape[d]; \
-    } \
-    \
-    for (nr_intp slice = 0; slice < n_slices; slice++) { \
-        nr_intp outer_idx = slice / inner_size; \
-        nr_intp inner_idx = slice % inner_size; \
-        \
-        nr_intp in_coords[NR_NODE_MAX_NDIM]; \
-        nr_intp out_coords[NR_NODE_MAX_NDIM]; \
-        nr_intp temp = outer_idx; \
-        for (int d = axis - 1; d >= 0; d--) { \
-            in_coords[d] = out_coords[d] = temp % n1->shape[d]; \
-            temp /= n1->shape[d]; \
-        } \
-        temp = inner_idx; \
-        for (int d = n1->ndim - 1; d > axis; d--) { \
-            in_coords[d] = out_coords[d] = temp % n1->shape[d]; \
-            temp /= n1->shape[d]; \
-        } \
-        \
-        /* Compute differences */ \
-        in_coords[axis] = 0; \
-        nr_intp lin_prev = coords_to_linear(in_coords, n1->shape, n1->ndim); \
-        I_NT prev_val = READ_VAL(I_NT, in_data, in_coords, n1, in_contig, lin_prev); \
-        \
-        for (nr_intp i = 0; i < out_axis_len; i++) { \
-            in_coords[axis] = i + 1; \
-            out_coords[axis] = i; \
-            \
-            nr_intp lin_in = coords_to_linear(in_coords, n1->shape, n1->ndim); \
-            nr_intp lin_out = coords_to_linear(out_coords, out_shape, n1->ndim); \
-            \
-            I_NT curr_val = READ_VAL(I_NT, in_data, in_coords, n1, in_contig, lin_in); \
-            O_NT diff = (O_NT)curr_val - (O_NT)prev_val; \
-            \
-            WRITE_VAL(O_NT, out_data, out_coords, out, out_contig, lin_out, diff); \
-            prev_val = curr_val; \
-        } \
+    if (Node_NItems(out) > 0) { \
+        cum_ctx c; \
+        cum_ctx_init(&c, n1, out, axis, 0); \
+        cum_run_rows(&c, OP_NAME##_rows_##I_NT); \
     } \
     \
     FINALIZE_CUM_OUTPUT() \
@@ -385,77 +568,63 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
  * Output same shape as input, uses forward/backward diff at edges
  * ============================================================================ */
 
-#define DEFINE_GRADIENT_KERNEL(OP_NAME, O_NT, I_NT, PROM_O_DT) \
-NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
-    SETUP_CUM_OUTPUT(O_NT, PROM_O_DT) \
-    I_NT* in_data = (I_NT*)NODE_DATA(n1); \
-    \
-    nr_intp axis_len = n1->shape[axis]; \
-    nr_intp n_slices = n_items / axis_len; \
-    \
-    nr_intp inner_size = 1; \
-    for (int d = axis + 1; d < n1->ndim; d++) { \
-        inner_size *= n1->shape[d]; \
+/* Gradient at step i of the axis, from the items at p + k * ias */
+#define GRADIENT_AT(O_NT, I_NT, p, ias, i, len, dst) do { \
+    if ((i) == 0) { \
+        /* Forward difference at start */ \
+        dst = (O_NT)*(const I_NT*)((p) + (ias)) - (O_NT)*(const I_NT*)(p); \
+    } else if ((i) == (len) - 1) { \
+        /* Backward difference at end */ \
+        dst = (O_NT)*(const I_NT*)((p) + (i) * (ias)) - \
+              (O_NT)*(const I_NT*)((p) + ((i) - 1) * (ias)); \
+    } else { \
+        /* Central difference */ \
+        dst = ((O_NT)*(const I_NT*)((p) + ((i) + 1) * (ias)) - \
+               (O_NT)*(const I_NT*)((p) + ((i) - 1) * (ias))) / (O_NT)2.0; \
     } \
-    \
-    for (nr_intp slice = 0; slice < n_slices; slice++) { \
-        nr_intp outer_idx = slice / inner_size; \
-        nr_intp inner_idx = slice % inner_size; \
-        \
-        nr_intp coords[NR_NODE_MAX_NDIM]; \
-        nr_intp temp = outer_idx; \
-        for (int d = axis - 1; d >= 0; d--) { \
-            coords[d] = temp % n1->shape[d]; \
-            temp /= n1->shape[d]; \
-        } \
-        temp = inner_idx; \
-        for (int d = n1->ndim - 1; d > axis; d--) { \
-            coords[d] = temp % n1->shape[d]; \
-            temp /= n1->shape[d]; \
+} while (0)
+
+#define DEFINE_GRADIENT_KERNEL(OP_NAME, O_NT, I_NT, PROM_O_DT) \
+NR_PRIVATE void OP_NAME##_rows_##I_NT(void* ctx, nr_intp start, nr_intp end) { \
+    cum_ctx* c = (cum_ctx*)ctx; \
+    const nr_intp ias = c->in_astride, oas = c->out_astride; \
+    const nr_intp ils = c->in_lstride, ols = c->out_lstride; \
+    nr_intp len = c->axis_len; \
+    nr_intp coords[NR_NODE_MAX_NDIM]; \
+    char *pin, *pout; \
+    cum_row_seek(c, start, coords, &pin, &pout); \
+    for (nr_intp r = start; r < end; r++, cum_row_next(c, coords, &pin, &pout)) { \
+        if (!c->lane_major) { \
+            for (nr_intp j = 0; j < c->lanes; j++) { \
+                const char* p = pin + j * ils; \
+                char* q = pout + j * ols; \
+                for (nr_intp i = 0; i < len; i++, q += oas) { \
+                    GRADIENT_AT(O_NT, I_NT, p, ias, i, len, *(O_NT*)q); \
+                } \
+            } \
+            continue; \
         } \
-        \
-        for (nr_intp i = 0; i < axis_len; i++) { \
-            coords[axis] = i; \
-            nr_intp lin = coords_to_linear(coords, n1->shape, n1->ndim); \
-            \
-            O_NT grad; \
-            if (i == 0) { \
-                /* Forward difference at start */ \
-                coords[axis] = 0; \
-                nr_intp lin0 = coords_to_linear(coords, n1->shape, n1->ndim); \
-                coords[axis] = 1; \
-                nr_intp lin1 = coords_to_linear(coords, n1->shape, n1->ndim); \
-                I_NT v0 = READ_VAL(I_NT, in_data, coords, n1, in_contig, lin0); \
-                coords[axis] = 1; \
-                I_NT v1 = READ_VAL(I_NT, in_data, coords, n1, in_contig, lin1); \
-                grad = (O_NT)v1 - (O_NT)v0; \
-            } else if (i == axis_len - 1) { \
-                /* Backward difference at end */ \
-                coords[axis] = axis_len - 2; \
-                nr_intp lin0 = coords_to_linear(coords, n1->shape, n1->ndim); \
-                coords[axis] = axis_len - 1; \
-                nr_intp lin1 = coords_to_linear(coords, n1->shape, n1->ndim); \
-                I_NT v0 = READ_VAL(I_NT, in_data, coords, n1, in_contig, lin0); \
-                coords[axis] = axis_len - 1; \
-                I_NT v1 = READ_VAL(I_NT, in_data, coords, n1, in_contig, lin1); \
-                grad = (O_NT)v1 - (O_NT)v0; \
-            } else { \
-                /* Central difference */ \
-                coords[axis] = i - 1; \
-                nr_intp lin0 = coords_to_linear(coords, n1->shape, n1->ndim); \
-                coords[axis] = i + 1; \
-                nr_intp lin1 = coords_to_linear(coords, n1->shape, n1->ndim); \
-                coords[axis] = i - 1; \
-                I_NT v0 = READ_VAL(I_NT, in_data, coords, n1, in_contig, lin0); \
-                coords[axis] = i + 1; \
-                I_NT v1 = READ_VAL(I_NT, in_data, coords, n1, in_contig, lin1); \
-                grad = ((O_NT)v1 - (O_NT)v0) / (O_NT)2.0; \
+        for (nr_intp i = 0; i < len; i++) { \
+            char* q = pout + i * oas; \
+            for (nr_intp j = 0; j < c->lanes; j++) { \
+                GRADIENT_AT(O_NT, I_NT, pin + j * ils, ias, i, len, *(O_NT*)(q + j * ols)); \
             } \
-            \
-            coords[axis] = i; \
-            WRITE_VAL(O_NT, out_data, coords, out, out_contig, lin, grad); \
         } \
     } \
+} \
+NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
+    SETUP_CUM_OUTPUT(O_NT, PROM_O_DT) \
+    (void)out_data; \
+    if (n_items > 0 && n1->shape[axis] < 2) { \
+        NError_RaiseError(NError_ValueError, "gradient requires axis length > 1"); \
+        if (out != caller_out) NODE_DECREF(out); \
+        return -1; \
+    } \
+    if (n_items > 0) { \
+        cum_ctx c; \
+        cum_ctx_init(&c, n1, out, axis, 0); \
+        cum_run_rows(&c, OP_NAME##_rows_##I_NT); \
+    } \
     \
     FINALIZE_CUM_OUTPUT() \
 }
@@ -465,37 +634,37 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
  * ============================================================================ */
 
 /* Cumsum/Cumprod: integers -> int64/uint64, floats -> float64 */
-#define DEFINE_CUM_PROMOTED(OP, FUNC, INIT, NEED_FIRST) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_bool,    INIT, NEED_FIRST, NR_INT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int8,    INIT, NEED_FIRST, NR_INT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int16,   INIT, NEED_FIRST, NR_INT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int32,   INIT, NEED_FIRST, NR_INT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int64,   INIT, NEED_FIRST, NR_INT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint8,   INIT, NEED_FIRST, NR_UINT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint16,  INIT, NEED_FIRST, NR_UINT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint32,  INIT, NEED_FIRST, NR_UINT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint64,  INIT, NEED_FIRST, NR_UINT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_float64, nr_float32, INIT, NEED_FIRST, NR_FLOAT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64)
+#define DEFINE_CUM_PROMOTED(OP, FUNC, INIT, NEED_FIRST, COMP_FLOAT) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_bool,    INIT, NEED_FIRST, NR_INT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int8,    INIT, NEED_FIRST, NR_INT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int16,   INIT, NEED_FIRST, NR_INT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int32,   INIT, NEED_FIRST, NR_INT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int64,   INIT, NEED_FIRST, NR_INT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint8,   INIT, NEED_FIRST, NR_UINT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint16,  INIT, NEED_FIRST, NR_UINT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint32,  INIT, NEED_FIRST, NR_UINT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint64,  INIT, NEED_FIRST, NR_UINT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_float64, nr_float32, INIT, NEED_FIRST, NR_FLOAT64, COMP_FLOAT) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64, COMP_FLOAT)
 
 /* Cummin/Cummax: same type in/out */
 #define DEFINE_CUM_SAME_TYPE(OP, FUNC, INIT, NEED_FIRST) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_bool,    nr_bool,    INIT, NEED_FIRST, NR_BOOL) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int8,    nr_int8,    INIT, NEED_FIRST, NR_INT8) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int16,   nr_int16,   INIT, NEED_FIRST, NR_INT16) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int32,   nr_int32,   INIT, NEED_FIRST, NR_INT32) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int64,   INIT, NEED_FIRST, NR_INT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint8,   nr_uint8,   INIT, NEED_FIRST, NR_UINT8) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint16,  nr_uint16,  INIT, NEED_FIRST, NR_UINT16) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint32,  nr_uint32,  INIT, NEED_FIRST, NR_UINT32) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint64,  INIT, NEED_FIRST, NR_UINT64) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_float32, nr_float32, INIT, NEED_FIRST, NR_FLOAT32) \
-    DEFINE_CUM_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64)
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_bool,    nr_bool,    INIT, NEED_FIRST, NR_BOOL, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int8,    nr_int8,    INIT, NEED_FIRST, NR_INT8, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int16,   nr_int16,   INIT, NEED_FIRST, NR_INT16, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int32,   nr_int32,   INIT, NEED_FIRST, NR_INT32, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_int64,   nr_int64,   INIT, NEED_FIRST, NR_INT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint8,   nr_uint8,   INIT, NEED_FIRST, NR_UINT8, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint16,  nr_uint16,  INIT, NEED_FIRST, NR_UINT16, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint32,  nr_uint32,  INIT, NEED_FIRST, NR_UINT32, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_uint64,  nr_uint64,  INIT, NEED_FIRST, NR_UINT64, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_float32, nr_float32, INIT, NEED_FIRST, NR_FLOAT32, 0) \
+    DEFINE_CUM_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64, 0)
 
 /* NaN variants: float only */
-#define DEFINE_NANCUM_FLOATS(OP, FUNC, INIT, NEED_FIRST) \
-    DEFINE_NANCUM_KERNEL(OP, FUNC, nr_float64, nr_float32, INIT, NEED_FIRST, NR_FLOAT64, ISNAN_F32) \
-    DEFINE_NANCUM_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64, ISNAN_F64)
+#define DEFINE_NANCUM_FLOATS(OP, FUNC, INIT, NEED_FIRST, COMP_FLOAT) \
+    DEFINE_NANCUM_KERNEL(OP, FUNC, nr_float64, nr_float32, INIT, NEED_FIRST, NR_FLOAT64, ISNAN_F32, COMP_FLOAT) \
+    DEFINE_NANCUM_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64, ISNAN_F64, COMP_FLOAT)
 
 /* Diff: signed output for proper differences */
 #define DEFINE_DIFF_ALL(OP) \
@@ -593,13 +762,13 @@ NR_PUBLIC Node* NMath_##ApiName(Node* c, Node* a, int axis) { \
  * ============================================================================ */
 
 /* === Cumsum === */
-DEFINE_CUM_PROMOTED(Cumsum, OP_SUM, 0, 0)
+DEFINE_CUM_PROMOTED(Cumsum, OP_SUM, 0, 0, 1)
 DEFINE_DISPATCHER(Cumsum)
 DEFINE_NFUNC(Cumsum, cumsum)
 DEFINE_API(Cumsum, cumsum)
 
 /* === Cumprod === */
-DEFINE_CUM_PROMOTED(Cumprod, OP_PROD, 1, 0)
+DEFINE_CUM_PROMOTED(Cumprod, OP_PROD, 1, 0, 0)
 DEFINE_DISPATCHER(Cumprod)
 DEFINE_NFUNC(Cumprod, cumprod)
 DEFINE_API(Cumprod, cumprod)
@@ -633,25 +802,25 @@ DEFINE_API(Gradient, gradient)
  * ============================================================================ */
 
 /* === NanCumsum === */
-DEFINE_NANCUM_FLOATS(NanCumsum, OP_SUM, 0, 0)
+DEFINE_NANCUM_FLOATS(NanCumsum, OP_SUM, 0, 0, 1)
 DEFINE_DISPATCHER_FLOAT_ONLY(NanCumsum)
 DEFINE_NFUNC(NanCumsum, nancumsum)
 DEFINE_API(NanCumsum, nancumsum)
 
 /* === NanCumprod === */
-DEFINE_NANCUM_FLOATS(NanCumprod, OP_PROD, 1, 0)
+DEFINE_NANCUM_FLOATS(NanCumprod, OP_PROD, 1, 0, 0)
 DEFINE_DISPATCHER_FLOAT_ONLY(NanCumprod)
 DEFINE_NFUNC(NanCumprod, nancumprod)
 DEFINE_API(NanCumprod, nancumprod)
 
 /* === NanCummin === */
-DEFINE_NANCUM_FLOATS(NanCummin, OP_MIN, 0, 1)
+DEFINE_NANCUM_FLOATS(NanCummin, OP_MIN, 0, 1, 0)
 DEFINE_DISPATCHER_FLOAT_ONLY(NanCummin)
 DEFINE_NFUNC(NanCummin, nancummin)
 DEFINE_API(NanCummin, nancummin)
 
 /* === NanCummax === */
-DEFINE_NANCUM_FLOATS(NanCummax, OP_MAX, 0, 1)
+DEFINE_NANCUM_FLOATS(NanCummax, OP_MAX, 0, 1, 0)
 DEFINE_DISPATCHER_FLOAT_ONLY(NanCummax)
 DEFINE_NFUNC(NanCummax, nancummax)
 DEFINE_API(NanCummax, nancummax)
\ No newline at end of file
@@ -0,0 +1,467 @@
+#include "grad.h"
+#include "nmath.h"
+#include "reduce.h"
+#include "../ngrad.h"
+#include "../node_core.h"
+#include "../nerror.h"
+#include "../free.h"
+#include "../nthread.h"
+#include "../tc_methods.h"
+#include "nour/nr_math.h"
+#include <stdlib.h>
+
+#define GRAD_LN2  0.693147180559945309417
+#define GRAD_LN10 2.302585092994045684018
+
+/* Inputs of a GradFunc call, see GradFuncFunc */
+#define GRAD_IN(args, i)   ((args)->in_nodes[i])
+#define GRAD_OUT(args)     ((args)->in_nodes[(args)->nout])
+#define GRAD_DOUT(args)    ((args)->in_nodes[(args)->nout + 1])
+
+NR_PUBLIC Node*
+NGrad_Contiguous(Node* node){
+    if (NODE_IS_CONTIGUOUS(node)){
+        NODE_INCREF(node);
+        return node;
+    }
+    return Node_Copy(NULL, node);
+}
+
+typedef union{
+    nr_float32 f32;
+    nr_float64 f64;
+}grad_scalar_buf;
+
+/* 0-d node of `value` in `buf`, float32 when `dtype` is, float64 otherwise */
+NR_PRIVATE Node*
+grad_scalar(grad_scalar_buf* buf, NR_DTYPE dtype, nr_float64 value){
+    if (dtype == NR_FLOAT32){
+        buf->f32 = (nr_float32)value;
+        return Node_NewScalar(&buf->f32, NR_FLOAT32);
+    }
+    buf->f64 = value;
+    return Node_NewScalar(&buf->f64, NR_FLOAT64);
+}
+
+/*
+ * op(a, b) into a new node, for chains of temporaries: `a` is freed, and
+ * a NULL `a` or `b` (an earlier step failed) gives NULL.
+ */
+NR_STATIC_INLINE Node*
+grad_then(Node* (*op)(Node*, Node*, Node*), Node* a, Node* b){
+    Node* r = a && b ? op(NULL, a, b) : NULL;
+    Node_Free(a);
+    return r;
+}
+
+/* ============================================================================
+ * Binary elementwise
+ * ============================================================================ */
+
+NR_PRIVATE int
+add_grad_function(NFuncArgs* args){
+    Node* g = GRAD_DOUT(args);
+    for (int i = 0; i < 2; i++){
+        if (NGrad_Needed(GRAD_IN(args, i))){
+            NODE_INCREF(g);
+            args->out_nodes[i] = g;
+        }
+    }
+    return 0;
+}
+
+NR_PRIVATE int
+sub_grad_function(NFuncArgs* args){
+    Node* g = GRAD_DOUT(args);
+    if (NGrad_Needed(GRAD_IN(args, 0))){
+        NODE_INCREF(g);
+        args->out_nodes[0] = g;
+    }
+    if (NGrad_Needed(GRAD_IN(args, 1))){
+        args->out_nodes[1] = NMath_Neg(NULL, g);
+        if (!args->out_nodes[1]){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+NR_PRIVATE int
+mul_grad_function(NFuncArgs* args){
+    Node* g = GRAD_DOUT(args);
+    for (int i = 0; i < 2; i++){
+        if (NGrad_Needed(GRAD_IN(args, i))){
+            args->out_nodes[i] = NMath_Mul(NULL, g, GRAD_IN(args, 1 - i));
+            if (!args->out_nodes[i]){
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* d(a/b) = g/b, -g/b * a/b */
+NR_PRIVATE int
+div_grad_function(NFuncArgs* args){
+    Node* b = GRAD_IN(args, 1);
+    Node* g_b = NMath_Div(NULL, GRAD_DOUT(args), b);
+    if (!g_b){
+        return -1;
+    }
+    if (NGrad_Needed(b)){
+        Node* gb = NMath_Mul(NULL, g_b, GRAD_OUT(args));
+        if (!gb || !NMath_Neg(gb, gb)){
+            Node_Free(gb);
+            Node_Free(g_b);
+            return -1;
+        }
+        args->out_nodes[1] = gb;
+    }
+    if (NGrad_Needed(GRAD_IN(args, 0))){
+        args->out_nodes[0] = g_b;
+    }
+    else{
+        Node_Free(g_b);
+    }
+    return 0;
+}
+
+/* d(a^b) = g * b * a^(b-1), g * a^b * log(a) */
+NR_PRIVATE int
+pow_grad_function(NFuncArgs* args){
+    Node* a = GRAD_IN(args, 0);
+    Node* b = GRAD_IN(args, 1);
+    Node* g = GRAD_DOUT(args);
+    if (NGrad_Needed(a)){
+        grad_scalar_buf buf;
+        Node* one = grad_scalar(&buf, NODE_DTYPE(g), 1.0);
+        Node* bm1 = one ? NMath_Sub(NULL, b, one) : NULL;
+        Node* p = bm1 ? NMath_Pow(NULL, a, bm1) : NULL;
+        Node_Free(bm1);
+        Node_Free(one);
+        args->out_nodes[0] = grad_then(NMath_Mul, grad_then(NMath_Mul, p, b), g);
+        if (!args->out_nodes[0]){
+            return -1;
+        }
+    }
+    if (NGrad_Needed(b)){
+        Node* la = NMath_Log(NULL, a);
+        args->out_nodes[1] = grad_then(NMath_Mul, grad_then(NMath_Mul, la, GRAD_OUT(args)), g);
+        if (!args->out_nodes[1]){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+GradFunc add_grad = {.grad_func_float32 = add_grad_function, .grad_func_float64 = add_grad_function};
+GradFunc sub_grad = {.grad_func_float32 = sub_grad_function, .grad_func_float64 = sub_grad_function};
+GradFunc mul_grad = {.grad_func_float32 = mul_grad_function, .grad_func_float64 = mul_grad_function};
+GradFunc div_grad = {.grad_func_float32 = div_grad_function, .grad_func_float64 = div_grad_function};
+GradFunc pow_grad = {.grad_func_float32 = pow_grad_function, .grad_func_float64 = pow_grad_function};
+
+/* ============================================================================
+ * Unary elementwise
+ * ============================================================================
+ * gx = f'(x) * g in one pass over contiguous x, y = f(x) and g, split over
+ * the thread pool. EXPR sees the items as `x`, `y` and `g`.
+ */
+
+typedef struct{
+    const char* x;
+    const char* y;
+    const char* g;
+    char* gx;
+}unary_grad_ctx;
+
+NR_PRIVATE int
+unary_grad(NFuncArgs* args, NThread_RangeFunc range){
+    Node* x = GRAD_IN(args, 0);
+    Node* y = GRAD_OUT(args);
+    Node* g = GRAD_DOUT(args);
+    if (!NGrad_Needed(x)){
+        return 0;
+    }
+    if (NODE_DTYPE(x) != NODE_DTYPE(y) || NODE_DTYPE(g) != NODE_DTYPE(y)){
+        NError_RaiseError(NError_TypeError,
+            "elementwise gradient expects one dtype, got %d, %d and %d",
+            NODE_DTYPE(x), NODE_DTYPE(y), NODE_DTYPE(g));
+        return -1;
+    }
+
+    Node* xc = NGrad_Contiguous(x);
+    Node* yc = xc ? NGrad_Contiguous(y) : NULL;
+    Node* gc = yc ? NGrad_Contiguous(g) : NULL;
+    Node* gx = gc ? Node_NewEmpty(x->ndim, x->shape, NODE_DTYPE(x)) : NULL;
+    if (gx){
+        unary_grad_ctx ctx = {
+            (const char*)NODE_DATA(xc), (const char*)NODE_DATA(yc),
+            (const char*)NODE_DATA(gc), (char*)NODE_DATA(gx)
+        };
+        NThread_ParallelFor(Node_NItems(gx), NTHREAD_GRAIN_HEAVY, range, &ctx);
+        args->out_nodes[0] = gx;
+    }
+    Node_Free(xc);
+    Node_Free(yc);
+    Node_Free(gc);
+    return gx ? 0 : -1;
+}
+
+#define DEFINE_UNARY_GRAD_LOOP(NAME, T, SFX, EXPR)                              \
+NR_PRIVATE void NAME##_grad_range_##SFX(void* ctx_, nr_intp start, nr_intp end){ \
+    unary_grad_ctx* ctx = (unary_grad_ctx*)ctx_;                                \
+    const T* xs = (const T*)ctx->x;                                             \
+    const T* ys = (const T*)ctx->y;                                             \
+    const T* gs = (const T*)ctx->g;                                             \
+    T* gxs = (T*)ctx->gx;                                                       \
+    for (nr_intp i = start; i < end; i++){                                      \
+        T x = xs[i], y = ys[i], g = gs[i];                                      \
+        (void)x; (void)y;                                                       \
+        gxs[i] = (T)(EXPR);                                                     \
+    }                                                                           \
+}                                                                               \
+NR_PRIVATE int NAME##_grad_##SFX(NFuncArgs* args){                              \
+    return unary_grad(args, NAME##_grad_range_##SFX);                           \
+}
+
+#define DEFINE_UNARY_GRAD(NAME, EXPR_FLOAT32, EXPR_FLOAT64)                     \
+DEFINE_UNARY_GRAD_LOOP(NAME, nr_float32, float32, EXPR_FLOAT32)                 \
+DEFINE_UNARY_GRAD_LOOP(NAME, nr_float64, float64, EXPR_FLOAT64)                 \
+GradFunc NAME##_grad = {.grad_func_float32 = NAME##_grad_float32, .grad_func_float64 = NAME##_grad_float64};
+
+DEFINE_UNARY_GRAD(neg, -g, -g)
+DEFINE_UNARY_GRAD(sin, g * nr_cosf(x), g * nr_cos(x))
+DEFINE_UNARY_GRAD(cos, -g * nr_sinf(x), -g * nr_sin(x))
+DEFINE_UNARY_GRAD(tan, g * (1.0f + y * y), g * (1.0 + y * y))
+DEFINE_UNARY_GRAD(cot, -g * (1.0f + y * y), -g * (1.0 + y * y))
+DEFINE_UNARY_GRAD(exp, g * y, g * y)
+DEFINE_UNARY_GRAD(log, g / x, g / x)
+DEFINE_UNARY_GRAD(sinh, g * nr_coshf(x), g * nr_cosh(x))
+DEFINE_UNARY_GRAD(cosh, g * nr_sinhf(x), g * nr_sinh(x))
+DEFINE_UNARY_GRAD(tanh, g * (1.0f - y * y), g * (1.0 - y * y))
+DEFINE_UNARY_GRAD(coth, g * (1.0f - y * y), g * (1.0 - y * y))
+DEFINE_UNARY_GRAD(asin, g / nr_sqrtf(1.0f - x * x), g / nr_sqrt(1.0 - x * x))
+DEFINE_UNARY_GRAD(acos, -g / nr_sqrtf(1.0f - x * x), -g / nr_sqrt(1.0 - x * x))
+DEFINE_UNARY_GRAD(atan, g / (1.0f + x * x), g / (1.0 + x * x))
+DEFINE_UNARY_GRAD(asinh, g / nr_sqrtf(x * x + 1.0f), g / nr_sqrt(x * x + 1.0))
+DEFINE_UNARY_GRAD(acosh, g / nr_sqrtf(x * x - 1.0f), g / nr_sqrt(x * x - 1.0))
+DEFINE_UNARY_GRAD(atanh, g / (1.0f - x * x), g / (1.0 - x * x))
+DEFINE_UNARY_GRAD(exp2, g * y * (nr_float32)GRAD_LN2, g * y * GRAD_LN2)
+DEFINE_UNARY_GRAD(expm1, g * (y + 1.0f), g * (y + 1.0))
+DEFINE_UNARY_GRAD(log10, g / (x * (nr_float32)GRAD_LN10), g / (x * GRAD_LN10))
+DEFINE_UNARY_GRAD(log1p, g / (1.0f + x), g / (1.0 + x))
+DEFINE_UNARY_GRAD(sqrt, g / (2.0f * y), g / (2.0 * y))
+DEFINE_UNARY_GRAD(cbrt, g / (3.0f * y * y), g / (3.0 * y * y))
+DEFINE_UNARY_GRAD(abs, x > 0 ? g : (x < 0 ? -g : 0.0f), x > 0 ? g : (x < 0 ? -g : 0.0))
+
+/* ============================================================================
+ * Reductions
+ * ============================================================================
+ * The output and its gradient are read back at the input's shape through
+ * views with 0 strides along the reduced axes.
+ */
+
+NR_PRIVATE int
+reduce_grad_save(NFuncArgs* args, void** saved){
+    NFunc_ReduceArgs* rargs = (NFunc_ReduceArgs*)malloc(sizeof(NFunc_ReduceArgs));
+    if (!rargs){
+        NError_RaiseMemoryError();
+        return -1;
+    }
+    *rargs = *(NFunc_ReduceArgs*)args->extra;
+    *saved = rargs;
+    return 0;
+}
+
+NR_PRIVATE void
+reduce_grad_release(void* saved){
+    free(saved);
+}
+
+/* `r`, reduced from `x` along `rargs`, viewed at the shape of `x` */
+NR_PRIVATE Node*
+reduce_grad_expand(Node* r, const Node* x, const NFunc_ReduceArgs* rargs){
+    int reduced[NR_NODE_MAX_NDIM] = {0};
+    for (int i = 0; i < x->ndim; i++){
+        reduced[i] = rargs->n_axis == 0;
+    }
+    for (int i = 0; i < rargs->n_axis; i++){
+        int axis = rargs->axis[i] < 0 ? rargs->axis[i] + x->ndim : rargs->axis[i];
+        reduced[axis] = 1;
+    }
+    nr_intp strides[NR_NODE_MAX_NDIM];
+    for (int i = 0, k = 0; i < x->ndim; i++){
+        strides[i] = reduced[i] ? 0 : r->strides[k++];
+    }
+    return Node_NewChild(r, x->ndim, x->shape, strides, 0);
+}
+
+/* The reduced axes of `rargs`, as the reductions take them */
+NR_STATIC_INLINE void
+reduce_grad_axes(const NFunc_ReduceArgs* rargs, int* axes){
+    for (int i = 0; i < rargs->n_axis; i++){
+        axes[i] = rargs->axis[i];
+    }
+}
+
+/* Items of `x` reduced into each output item */
+NR_STATIC_INLINE nr_intp
+reduce_grad_count(const Node* x, const Node* y){
+    nr_intp ny = Node_NItems(y);
+    return ny ? Node_NItems(x) / ny : 0;
+}
+
+NR_PRIVATE int
+sum_grad_function(NFuncArgs* args){
+    if (!NGrad_Needed(GRAD_IN(args, 0))){
+        return 0;
+    }
+    args->out_nodes[0] = reduce_grad_expand(GRAD_DOUT(args), GRAD_IN(args, 0),
+                                            (NFunc_ReduceArgs*)args->extra);
+    return args->out_nodes[0] ? 0 : -1;
+}
+
+NR_PRIVATE int
+mean_grad_function(NFuncArgs* args){
+    Node* x = GRAD_IN(args, 0);
+    Node* g = GRAD_DOUT(args);
+    if (!NGrad_Needed(x)){
+        return 0;
+    }
+    nr_intp count = reduce_grad_count(x, GRAD_OUT(args));
+    grad_scalar_buf buf;
+    Node* scale = grad_scalar(&buf, NODE_DTYPE(g), count ? 1.0 / (nr_float64)count : 0.0);
+    Node* ge = scale ? reduce_grad_expand(g, x, (NFunc_ReduceArgs*)args->extra) : NULL;
+    args->out_nodes[0] = grad_then(NMath_Mul, ge, scale);
+    Node_Free(scale);
+    return args->out_nodes[0] ? 0 : -1;
+}
+
+/*
+ * d prod = g * the product of the other items, not g * y / x, which is
+ * 0/0 at zeros. With z zeros among the reduced items and p the product of
+ * the non-zero ones, that is p / x at non-zero items when z == 0, p at the
+ * zero when z == 1 and 0 elsewhere: p / x1 where z == (x == 0), x1 being
+ * x with its zeros set to 1.
+ */
+NR_PRIVATE int
+prod_grad_function(NFuncArgs* args){
+    Node* x = GRAD_IN(args, 0);
+    NFunc_ReduceArgs* rargs = (NFunc_ReduceArgs*)args->extra;
+    if (!NGrad_Needed(x)){
+        return 0;
+    }
+    int axes[NR_NODE_MAX_NDIM];
+    reduce_grad_axes(rargs, axes);
+    grad_scalar_buf buf;
+    Node* zero = grad_scalar(&buf, NODE_DTYPE(x), 0.0);
+    Node* is_zero = zero ? NMath_Eq(NULL, x, zero) : NULL;
+    Node_Free(zero);
+    Node* zf = is_zero ? Node_ToType(NULL, is_zero, NODE_DTYPE(x)) : NULL;
+    Node_Free(is_zero);
+    Node* x1 = zf ? NMath_Add(NULL, x, zf) : NULL;
+    Node* p = x1 ? NMath_Prod(NULL, x1, axes, rargs->n_axis) : NULL;
+    Node* z = p ? NMath_Sum(NULL, zf, axes, rargs->n_axis) : NULL;
+    Node* ze = z ? reduce_grad_expand(z, x, rargs) : NULL;
+    Node_Free(z);
+    Node* keep = ze ? NMath_Eq(NULL, ze, zf) : NULL;
+    Node_Free(ze);
+    Node_Free(zf);
+    Node* pe = keep ? reduce_grad_expand(p, x, rargs) : NULL;
+    Node_Free(p);
+    Node* gx = grad_then(NMath_Mul, grad_then(NMath_Div, pe, x1), keep);
+    Node_Free(x1);
+    Node_Free(keep);
+    Node* ge = gx ? reduce_grad_expand(GRAD_DOUT(args), x, rargs) : NULL;
+    args->out_nodes[0] = grad_then(NMath_Mul, gx, ge);
+    Node_Free(ge);
+    return args->out_nodes[0] ? 0 : -1;
+}
+
+/* The gradient is split evenly between the items equal to the min/max */
+NR_PRIVATE int
+extremum_grad_function(NFuncArgs* args){
+    Node* x = GRAD_IN(args, 0);
+    Node* g = GRAD_DOUT(args);
+    NFunc_ReduceArgs* rargs = (NFunc_ReduceArgs*)args->extra;
+    if (!NGrad_Needed(x)){
+        return 0;
+    }
+    int axes[NR_NODE_MAX_NDIM];
+    reduce_grad_axes(rargs, axes);
+    Node* ye = reduce_grad_expand(GRAD_OUT(args), x, rargs);
+    Node* eq = ye ? NMath_Eq(NULL, x, ye) : NULL;
+    Node_Free(ye);
+    Node* mask = eq ? Node_ToType(NULL, eq, NODE_DTYPE(g)) : NULL;
+    Node_Free(eq);
+    Node* ties = mask ? NMath_Sum(NULL, mask, axes, rargs->n_axis) : NULL;
+    Node* te = ties ? reduce_grad_expand(ties, x, rargs) : NULL;
+    Node_Free(ties);
+    Node* ge = te ? reduce_grad_expand(g, x, rargs) : NULL;
+    args->out_nodes[0] = grad_then(NMath_Div, grad_then(NMath_Mul, ge, mask), te);
+    Node_Free(mask);
+    Node_Free(te);
+    return args->out_nodes[0] ? 0 : -1;
+}
+
+/*
+ * d var = g * 2 (x - mean) / (n - ddof)
+ * d std = g * (x - mean) / ((n - ddof) * y)
+ */
+NR_PRIVATE int
+var_grad_common(NFuncArgs* args, int is_std){
+    Node* x = GRAD_IN(args, 0);
+    Node* y = GRAD_OUT(args);
+    Node* g = GRAD_DOUT(args);
+    NFunc_ReduceArgs* rargs = (NFunc_ReduceArgs*)args->extra;
+    if (!NGrad_Needed(x)){
+        return 0;
+    }
+    nr_float64 dof = (nr_float64)(reduce_grad_count(x, y) - rargs->ddof);
+    grad_scalar_buf buf;
+    Node* scale = grad_scalar(&buf, NODE_DTYPE(g), (is_std ? 1.0 : 2.0) / dof);
+
+    int axes[NR_NODE_MAX_NDIM];
+    reduce_grad_axes(rargs, axes);
+    Node* mean = scale ? NMath_Mean(NULL, x, axes, rargs->n_axis) : NULL;
+    Node* me = mean ? reduce_grad_expand(mean, x, rargs) : NULL;
+    Node_Free(mean);
+    Node* d = me ? NMath_Sub(NULL, x, me) : NULL;
+    Node_Free(me);
+    Node* ge = d ? reduce_grad_expand(g, x, rargs) : NULL;
+    Node* gx = grad_then(NMath_Mul, d, ge);
+    Node_Free(ge);
+    if (is_std){
+        Node* ye = gx ? reduce_grad_expand(y, x, rargs) : NULL;
+        gx = grad_then(NMath_Div, gx, ye);
+        Node_Free(ye);
+    }
+    args->out_nodes[0] = grad_then(NMath_Mul, gx, scale);
+    Node_Free(scale);
+    return args->out_nodes[0] ? 0 : -1;
+}
+
+NR_PRIVATE int
+var_grad_function(NFuncArgs* args){
+    return var_grad_common(args, 0);
+}
+
+NR_PRIVATE int
+std_grad_function(NFuncArgs* args){
+    return var_grad_common(args, 1);
+}
+
+GradFunc sum_grad = {.grad_func_float32 = sum_grad_function, .grad_func_float64 = sum_grad_function,
+                      .save = reduce_grad_save, .release = reduce_grad_release, .saved_is_extra = 1};
+GradFunc prod_grad = {.grad_func_float32 = prod_grad_function, .grad_func_float64 = prod_grad_function,
+                      .save = reduce_grad_save, .release = reduce_grad_release, .saved_is_extra = 1};
+GradFunc min_grad = {.grad_func_float32 = extremum_grad_function, .grad_func_float64 = extremum_grad_function,
+                      .save = reduce_grad_save, .release = reduce_grad_release, .saved_is_extra = 1};
+GradFunc max_grad = {.grad_func_float32 = extremum_grad_function, .grad_func_float64 = extremum_grad_function,
+                      .save = reduce_grad_save, .release = reduce_grad_release, .saved_is_extra = 1};
+GradFunc mean_grad = {.grad_func_float32 = mean_grad_function, .grad_func_float64 = mean_grad_function,
+                      .save = reduce_grad_save, .release = reduce_grad_release, .saved_is_extra = 1};
+GradFunc var_grad = {.grad_func_float32 = var_grad_function, .grad_func_float64 = var_grad_function,
+                      .save = reduce_grad_save, .release = reduce_grad_release, .saved_is_extra = 1};
+GradFunc std_grad = {.grad_func_float32 = std_grad_function, .grad_func_float64 = std_grad_function,
+                      .save = reduce_grad_save, .release = reduce_grad_release, .saved_is_extra = 1};
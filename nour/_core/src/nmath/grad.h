@@ -0,0 +1,57 @@
+#ifndef NOUR__CORE_SRC_NMATH_GRAD_H
+#define NOUR__CORE_SRC_NMATH_GRAD_H
+
+#include "nour/nour.h"
+
+/*
+ * Gradients of the differentiable math NFuncs (see GradFuncFunc and
+ * src/ngrad.h). The elementwise unary ones run one fused loop per dtype;
+ * the binary ones and the reductions are written with NMath calls, which
+ * already handle broadcasting and strides.
+ */
+
+extern GradFunc add_grad;
+extern GradFunc sub_grad;
+extern GradFunc mul_grad;
+extern GradFunc div_grad;
+extern GradFunc pow_grad;
+
+extern GradFunc neg_grad;
+extern GradFunc sin_grad;
+extern GradFunc cos_grad;
+extern GradFunc tan_grad;
+extern GradFunc cot_grad;
+extern GradFunc exp_grad;
+extern GradFunc log_grad;
+extern GradFunc sinh_grad;
+extern GradFunc cosh_grad;
+extern GradFunc tanh_grad;
+extern GradFunc coth_grad;
+extern GradFunc asin_grad;
+extern GradFunc acos_grad;
+extern GradFunc atan_grad;
+extern GradFunc asinh_grad;
+extern GradFunc acosh_grad;
+extern GradFunc atanh_grad;
+extern GradFunc exp2_grad;
+extern GradFunc expm1_grad;
+extern GradFunc log10_grad;
+extern GradFunc log1p_grad;
+extern GradFunc sqrt_grad;
+extern GradFunc cbrt_grad;
+extern GradFunc abs_grad;
+
+/* Reductions, they keep their NFunc_ReduceArgs */
+extern GradFunc sum_grad;
+extern GradFunc prod_grad;
+extern GradFunc min_grad;
+extern GradFunc max_grad;
+extern GradFunc mean_grad;
+extern GradFunc var_grad;
+extern GradFunc std_grad;
+
+/* `node` itself (new reference) when C-contiguous, a contiguous copy otherwise */
+NR_PUBLIC Node*
+NGrad_Contiguous(Node* node);
+
+#endif // NOUR__CORE_SRC_NMATH_GRAD_H
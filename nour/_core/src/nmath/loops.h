@@ -3,207 +3,200 @@
 
 #include "nour/nour.h"
 
-#define NMATH_LOOP_CCC(op, out_type, in_type) do {\
-    in_type* n1_dataptr = (in_type*)n1->data;\
-    in_type* n2_dataptr = (in_type*)n2->data;\
-    out_type* out_dataptr = (out_type*)out->data;\
-    nr_long nitems = Node_NItems(out);\
-    for (nr_long i = 0; i < nitems; i++) {\
-        *(out_type*)(out_dataptr + i) = op(*(in_type*)(n1_dataptr + i), \
-                                            *(in_type*)(n2_dataptr + i));\
-    }\
+/*
+ * Applies `op` between an item of the non-scalar operand and `sclr`,
+ * keeping the operand order of the call (`sfirst` is set when the scalar
+ * is the first input).
+ */
+#define NMATH_SCLR_OP(op, x) (sfirst ? op(sclr, x) : op(x, sclr))
+
+/*
+ * Neumaier's compensated add of `x` into `sum`: the rounding error of each
+ * add is collected in `comp` and the result is `sum + comp`. `sum` and
+ * `comp` are lvalues of the float type `type`.
+ */
+#define NMATH_KAHAN_ADD(type, sum, comp, x) do {\
+    type kx__ = (type)(x);\
+    type kt__ = (sum) + kx__;\
+    (comp) += fabs((double)(sum)) >= fabs((double)kx__) ? ((sum) - kt__) + kx__\
+                                                        : (kx__ - kt__) + (sum);\
+    (sum) = kt__;\
 } while (0)
 
-#define NMATH_LOOP_CSC(op, out_type, in_type) do {\
-    Node* con_n = n1c ? n1 : n2;\
-    Node* str_n = n1c ? n2 : n1;\
-    NIter it;\
-    NIter_FromNode(&it, str_n, NITER_MODE_STRIDED);\
-    in_type* n_dataptr = (in_type*)con_n->data;\
-    out_type* out_dataptr = (out_type*)out->data;\
-    NIter_ITER((&it));\
-    nr_long i = 0;\
-    while (NIter_NOTDONE((&it)))\
-    {\
-        *(out_type*)(out_dataptr + i) = op(*(in_type*)NIter_ITEM((&it)),\
-                                            *(in_type*)(n_dataptr + i));\
-        i++;\
-        NIter_NEXT_STRIDED(&it);\
+/*
+ * Defines NAME_vv, NAME_vs and NAME_sv, plain loops over contiguous
+ * buffers with the NSimd_BinFunc signature and operand layouts of simd.h.
+ * The kernels use them when there is no vector loop, so either one can be
+ * handed to the thread pool.
+ */
+#define NMATH_DEFINE_BIN_CLOOPS(NAME, op, out_type, in_type) \
+NR_STATIC void NAME##_vv(const void* a_, const void* b_, void* o_, nr_intp n){\
+    const in_type* a = (const in_type*)a_;\
+    const in_type* b = (const in_type*)b_;\
+    out_type* o = (out_type*)o_;\
+    for (nr_intp i = 0; i < n; i++) {\
+        o[i] = op(a[i], b[i]);\
     }\
-} while(0)
-
-#define NMATH_LOOP_CSS(op, out_type, in_type) do {\
-    NIter it1;\
-    NIter it2;\
-    NIter_FromNode(&it1, n1, NITER_MODE_STRIDED);\
-    NIter_FromNode(&it2, n2, NITER_MODE_STRIDED);\
-    out_type* out_dataptr = (out_type*)out->data;\
-    NIter_ITER(&it1);\
-    NIter_ITER(&it2);\
-    nr_long i = 0;\
-    while (NIter_NOTDONE(&it1))\
-    {\
-        *(out_type*)(out_dataptr + i) = op(*(in_type*)NIter_ITEM(&it1),\
-                                        *(in_type*)NIter_ITEM(&it2));\
-        i++;\
-        NIter_NEXT_STRIDED(&it1);\
-        NIter_NEXT_STRIDED(&it2);\
+}\
+NR_STATIC void NAME##_vs(const void* a_, const void* b_, void* o_, nr_intp n){\
+    const in_type* a = (const in_type*)a_;\
+    in_type b = *(const in_type*)b_;\
+    out_type* o = (out_type*)o_;\
+    for (nr_intp i = 0; i < n; i++) {\
+        o[i] = op(a[i], b);\
     }\
-} while(0)
-
-#define NMATH_LOOP_SSS(op, out_type, in_type) do {\
-    NIter nit1, nit2, oit;\
-    NIter_FromNode(&oit, out, NITER_MODE_STRIDED);\
-    NIter_FromNode(&nit1, n1, NITER_MODE_STRIDED);\
-    NIter_FromNode(&nit2, n2, NITER_MODE_STRIDED);\
-\
-    NIter_ITER(&oit);\
-    NIter_ITER(&nit1);\
-    NIter_ITER(&nit2);\
-    while (NIter_NOTDONE(&oit))\
-    {\
-        *(out_type*)NIter_ITEM(&oit) = op(*(in_type*)NIter_ITEM(&nit1),\
-                                        *(in_type*)NIter_ITEM(&nit2));\
-        NIter_NEXT_STRIDED(&oit);\
-        NIter_NEXT_STRIDED(&nit1);\
-        NIter_NEXT_STRIDED(&nit2);\
+}\
+NR_STATIC void NAME##_sv(const void* a_, const void* b_, void* o_, nr_intp n){\
+    in_type a = *(const in_type*)a_;\
+    const in_type* b = (const in_type*)b_;\
+    out_type* o = (out_type*)o_;\
+    for (nr_intp i = 0; i < n; i++) {\
+        o[i] = op(a, b[i]);\
     }\
-} while(0)
-
-#define NMATH_LOOP_SCC(op, out_type, in_type) do {\
-    NIter oit;\
-    NIter_FromNode(&oit, out, NITER_MODE_STRIDED);\
-    nr_long i = 0;\
-    while (NIter_NOTDONE(&oit))\
-    {\
-        /* cast the void* data to in_type* BEFORE doing pointer arithmetic */\
-        *(out_type*)NIter_ITEM(&oit) = op( *(((in_type*)n1->data) + i), \
-                                          *(((in_type*)n2->data) + i) );\
-        i++;\
-        NIter_NEXT_STRIDED(&oit);\
+}
+
+/*
+ * Strided binary loop over `n1`, `n2` and `out` (all the same shape or
+ * broadcastable to `out`). The operands are walked row by row with
+ * NInnerIter; a row where every operand is contiguous gets an indexed loop
+ * the compiler can vectorize. Every array the loop touches is an operand,
+ * so NITER_ORDER_K is used and transposed layouts also get long rows.
+ */
+#define NMATH_LOOP_BIN_INNER(op, out_type, in_type) do {\
+    Node* __inodes[3] = {n1, n2, out};\
+    NInnerIter __iit;\
+    if (NInnerIter_FromNodes(&__iit, __inodes, 3, NITER_ORDER_K) != 0) {\
+        return -1;\
     }\
-} while(0)
-
-#define NMATH_LOOP_SSC(op, out_type, in_type) do {\
-    Node* con_n = n1c ? n1 : n2;\
-    Node* str_n = n1c ? n2 : n1;\
-    NIter oit, nit;\
-    NIter_FromNode(&nit, str_n, NITER_MODE_STRIDED);\
-    NIter_FromNode(&oit, out, NITER_MODE_STRIDED);\
-    in_type* n_dataptr = (in_type*)con_n->data;\
-    nr_long i = 0;\
-    while (NIter_NOTDONE(&oit))\
+    NInnerIter_ITER(&__iit);\
+    while (NInnerIter_NOTDONE(&__iit))\
     {\
-        *(out_type*)NIter_ITEM(&oit) = op(*(in_type*)(n_dataptr + i),\
-                                            *(in_type*)NIter_ITEM(&nit));\
-        i++;\
-        NIter_NEXT_STRIDED(&oit);\
-        NIter_NEXT_STRIDED(&nit);\
+        char* __p1 = NInnerIter_PTRS(&__iit)[0];\
+        char* __p2 = NInnerIter_PTRS(&__iit)[1];\
+        char* __po = NInnerIter_PTRS(&__iit)[2];\
+        nr_intp __s1 = NInnerIter_STRIDES(&__iit)[0];\
+        nr_intp __s2 = NInnerIter_STRIDES(&__iit)[1];\
+        nr_intp __so = NInnerIter_STRIDES(&__iit)[2];\
+        nr_intp __cnt = NInnerIter_COUNT(&__iit);\
+        if (__s1 == sizeof(in_type) && __s2 == sizeof(in_type) && __so == sizeof(out_type)) {\
+            in_type* __a = (in_type*)__p1;\
+            in_type* __b = (in_type*)__p2;\
+            out_type* __o = (out_type*)__po;\
+            for (nr_intp i = 0; i < __cnt; i++) {\
+                __o[i] = op(__a[i], __b[i]);\
+            }\
+        } else {\
+            for (nr_intp i = 0; i < __cnt; i++) {\
+                *(out_type*)__po = op(*(in_type*)__p1, *(in_type*)__p2);\
+                __p1 += __s1;\
+                __p2 += __s2;\
+                __po += __so;\
+            }\
+        }\
+        NInnerIter_NEXT(&__iit);\
     }\
 } while(0)
 
-#define NMATH_LOOP_CC_S(op, out_type, in_type) do {\
-    in_type* n_dataptr = (in_type*)n->data;\
-    out_type* out_dataptr = (out_type*)out->data;\
-    nr_long nitems = Node_NItems(out);\
-    for (nr_long i = 0; i < nitems; i++) {\
-        *(out_type*)(out_dataptr + i) = op(*(in_type*)(n_dataptr + i), sclr);\
+/*
+ * The layout specific names are kept for the kernels; every mix of
+ * contiguous (C) and strided (S) operands goes through the same row loop.
+ */
+#define NMATH_LOOP_CSC(op, out_type, in_type) NMATH_LOOP_BIN_INNER(op, out_type, in_type)
+#define NMATH_LOOP_CSS(op, out_type, in_type) NMATH_LOOP_BIN_INNER(op, out_type, in_type)
+#define NMATH_LOOP_SSS(op, out_type, in_type) NMATH_LOOP_BIN_INNER(op, out_type, in_type)
+#define NMATH_LOOP_SCC(op, out_type, in_type) NMATH_LOOP_BIN_INNER(op, out_type, in_type)
+#define NMATH_LOOP_SSC(op, out_type, in_type) NMATH_LOOP_BIN_INNER(op, out_type, in_type)
+
+/*
+ * Strided loop between the non-scalar operand `n` and `sclr`, written to
+ * `out`. Same row walk as NMATH_LOOP_BIN_INNER.
+ */
+#define NMATH_LOOP_SCLR_INNER(op, out_type, in_type) do {\
+    Node* __inodes[2] = {n, out};\
+    NInnerIter __iit;\
+    if (NInnerIter_FromNodes(&__iit, __inodes, 2, NITER_ORDER_K) != 0) {\
+        return -1;\
     }\
-} while (0)
-
-#define NMATH_LOOP_CS_S(op, out_type, in_type) do {\
-    NIter nit;\
-    NIter_FromNode(&nit, n, NITER_MODE_STRIDED);\
-    out_type* out_dataptr = (out_type*)out->data;\
-    NIter_ITER(&nit);\
-    nr_long i = 0;\
-    while (NIter_NOTDONE(&nit))\
+    NInnerIter_ITER(&__iit);\
+    while (NInnerIter_NOTDONE(&__iit))\
     {\
-        *(out_type*)(out_dataptr + i) = op(*(in_type*)NIter_ITEM(&nit), sclr);\
-        i++;\
-        NIter_NEXT_STRIDED(&nit);\
+        char* __pn = NInnerIter_PTRS(&__iit)[0];\
+        char* __po = NInnerIter_PTRS(&__iit)[1];\
+        nr_intp __sn = NInnerIter_STRIDES(&__iit)[0];\
+        nr_intp __so = NInnerIter_STRIDES(&__iit)[1];\
+        nr_intp __cnt = NInnerIter_COUNT(&__iit);\
+        if (__sn == sizeof(in_type) && __so == sizeof(out_type)) {\
+            in_type* __a = (in_type*)__pn;\
+            out_type* __o = (out_type*)__po;\
+            for (nr_intp i = 0; i < __cnt; i++) {\
+                __o[i] = NMATH_SCLR_OP(op, __a[i]);\
+            }\
+        } else {\
+            for (nr_intp i = 0; i < __cnt; i++) {\
+                *(out_type*)__po = NMATH_SCLR_OP(op, *(in_type*)__pn);\
+                __pn += __sn;\
+                __po += __so;\
+            }\
+        }\
+        NInnerIter_NEXT(&__iit);\
     }\
 } while(0)
 
-#define NMATH_LOOP_SC_S(op, out_type, in_type) do {\
-    NIter oit;\
-    NIter_FromNode(&oit, out, NITER_MODE_STRIDED);\
-    in_type* n_dataptr = (in_type*)n->data;\
-    NIter_ITER(&oit);\
-    nr_long i = 0;\
-    while (NIter_NOTDONE(&oit))\
-    {\
-        *(out_type*)NIter_ITEM(&oit) = op(*(in_type*)(n_dataptr + i), sclr);\
-        i++;\
-        NIter_NEXT_STRIDED(&oit);\
+#define NMATH_LOOP_CS_S(op, out_type, in_type) NMATH_LOOP_SCLR_INNER(op, out_type, in_type)
+#define NMATH_LOOP_SC_S(op, out_type, in_type) NMATH_LOOP_SCLR_INNER(op, out_type, in_type)
+#define NMATH_LOOP_SS_S(op, out_type, in_type) NMATH_LOOP_SCLR_INNER(op, out_type, in_type)
+
+
+/*
+ * Defines NAME_v, the unary counterpart of NMATH_DEFINE_BIN_CLOOPS with the
+ * NSimd_UnFunc signature.
+ */
+#define NMATH_DEFINE_UN_CLOOP(NAME, op, out_type, in_type) \
+NR_STATIC void NAME##_v(const void* a_, void* o_, nr_intp n){\
+    const in_type* a = (const in_type*)a_;\
+    out_type* o = (out_type*)o_;\
+    for (nr_intp i = 0; i < n; i++) {\
+        o[i] = op(a[i]);\
     }\
-} while(0)
-
-#define NMATH_LOOP_SS_S(op, out_type, in_type) do {\
-    NIter oit, nit;\
-    NIter_FromNode(&oit, out, NITER_MODE_STRIDED);\
-    NIter_FromNode(&nit, n, NITER_MODE_STRIDED);\
-    NIter_ITER(&oit);\
-    NIter_ITER(&nit);\
-    while (NIter_NOTDONE(&oit))\
-    {\
-        *(out_type*)NIter_ITEM(&oit) = op(*(in_type*)(NIter_ITEM(&nit)), sclr);\
-        NIter_NEXT_STRIDED(&oit);\
-        NIter_NEXT_STRIDED(&nit);\
-    }\
-} while(0)
-
-
-#define NMATH_LOOP_CC_1I(op, out_type, in_type) do {\
-    in_type* n1_dataptr = (in_type*)n1->data;\
-    out_type* out_dataptr = (out_type*)out->data;\
-    nr_long nitems = Node_NItems(out);\
-    for (nr_long i = 0; i < nitems; i++) {\
-        *(out_type*)(out_dataptr + i) = op(*(in_type*)(n1_dataptr + i));\
-    }\
-} while (0)
-
-
-#define NMATH_LOOP_CS_1I(op, out_type, in_type) do {\
-    NIter nit;\
-    NIter_FromNode(&nit, n1, NITER_MODE_STRIDED);\
-    out_type* out_dataptr = (out_type*)out->data;\
-    NIter_ITER(&nit);\
-    nr_long i = 0;\
-    while (NIter_NOTDONE(&nit))\
-    {\
-        *(out_type*)(out_dataptr + i) = op(*(in_type*)NIter_ITEM(&nit));\
-        i++;\
-        NIter_NEXT_STRIDED(&nit);\
+}
+
+/*
+ * Strided unary loop from `n1` to `out`. Same row walk as
+ * NMATH_LOOP_BIN_INNER.
+ */
+#define NMATH_LOOP_UN_INNER(op, out_type, in_type) do {\
+    Node* __inodes[2] = {n1, out};\
+    NInnerIter __iit;\
+    if (NInnerIter_FromNodes(&__iit, __inodes, 2, NITER_ORDER_K) != 0) {\
+        return -1;\
     }\
-} while(0)
-
-#define NMATH_LOOP_SC_1I(op, out_type, in_type) do {\
-    NIter oit;\
-    NIter_FromNode(&oit, out, NITER_MODE_STRIDED);\
-    in_type* n1_dataptr = (in_type*)n1->data;\
-    NIter_ITER(&oit);\
-    nr_long i = 0;\
-    while (NIter_NOTDONE(&oit))\
+    NInnerIter_ITER(&__iit);\
+    while (NInnerIter_NOTDONE(&__iit))\
     {\
-        *(out_type*)NIter_ITEM(&oit) = op(*(in_type*)(n1_dataptr + i));\
-        i++;\
-        NIter_NEXT_STRIDED(&oit);\
+        char* __pn = NInnerIter_PTRS(&__iit)[0];\
+        char* __po = NInnerIter_PTRS(&__iit)[1];\
+        nr_intp __sn = NInnerIter_STRIDES(&__iit)[0];\
+        nr_intp __so = NInnerIter_STRIDES(&__iit)[1];\
+        nr_intp __cnt = NInnerIter_COUNT(&__iit);\
+        if (__sn == sizeof(in_type) && __so == sizeof(out_type)) {\
+            in_type* __a = (in_type*)__pn;\
+            out_type* __o = (out_type*)__po;\
+            for (nr_intp i = 0; i < __cnt; i++) {\
+                __o[i] = op(__a[i]);\
+            }\
+        } else {\
+            for (nr_intp i = 0; i < __cnt; i++) {\
+                *(out_type*)__po = op(*(in_type*)__pn);\
+                __pn += __sn;\
+                __po += __so;\
+            }\
+        }\
+        NInnerIter_NEXT(&__iit);\
     }\
 } while(0)
 
-#define NMATH_LOOP_SS_1I(op, out_type, in_type) do {\
-    NIter oit, nit;\
-    NIter_FromNode(&oit, out, NITER_MODE_STRIDED);\
-    NIter_FromNode(&nit, n1, NITER_MODE_STRIDED);\
-    NIter_ITER(&oit);\
-    NIter_ITER(&nit);\
-    while (NIter_NOTDONE(&oit))\
-    {\
-        *(out_type*)NIter_ITEM(&oit) = op(*(in_type*)(NIter_ITEM(&nit)));\
-        NIter_NEXT_STRIDED(&oit);\
-        NIter_NEXT_STRIDED(&nit);\
-    }\
-} while(0)
+#define NMATH_LOOP_CS_1I(op, out_type, in_type) NMATH_LOOP_UN_INNER(op, out_type, in_type)
+#define NMATH_LOOP_SC_1I(op, out_type, in_type) NMATH_LOOP_UN_INNER(op, out_type, in_type)
+#define NMATH_LOOP_SS_1I(op, out_type, in_type) NMATH_LOOP_UN_INNER(op, out_type, in_type)
 
 #endif
\ No newline at end of file
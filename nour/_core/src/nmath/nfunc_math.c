@@ -6,21 +6,209 @@
 #include "../node2str.h"
 #include "../free.h"
 #include "../tc_methods.h"
+#include "../nthread.h"
 #include "loops.h"
+#include "simd.h"
+#include "grad.h"
 #include "nour/nr_math.h"
 
 
 #define FUNC_NAME(OP_NAME, I_NT) OP_NAME##_kernel_##I_NT
 
+/*
+ * Contiguous loops go through the thread pool. The range callbacks move
+ * every operand `start` items forward; a step of 0 keeps a scalar operand
+ * in place.
+ */
+typedef struct{
+    NSimd_BinFunc func;
+    const char* a;
+    const char* b;
+    char* out;
+    nr_intp sa, sb, so;
+}ewise_bin_ctx;
+
+NR_PRIVATE void
+ewise_bin_range(void* ctx, nr_intp start, nr_intp end){
+    ewise_bin_ctx* c = (ewise_bin_ctx*)ctx;
+    c->func(c->a + start * c->sa, c->b + start * c->sb, c->out + start * c->so, end - start);
+}
+
+NR_PRIVATE void
+ewise_bin_parallel(NSimd_BinFunc func, const void* a, nr_intp sa, const void* b, nr_intp sb,
+                   void* out, nr_intp so, nr_intp n){
+    ewise_bin_ctx c = {func, (const char*)a, (const char*)b, (char*)out, sa, sb, so};
+    NThread_ParallelFor(n, NTHREAD_GRAIN_DEFAULT, ewise_bin_range, &c);
+}
+
+typedef struct{
+    NSimd_UnFunc func;
+    const char* a;
+    char* out;
+    nr_intp sa, so;
+}ewise_un_ctx;
+
+NR_PRIVATE void
+ewise_un_range(void* ctx, nr_intp start, nr_intp end){
+    ewise_un_ctx* c = (ewise_un_ctx*)ctx;
+    c->func(c->a + start * c->sa, c->out + start * c->so, end - start);
+}
+
+NR_PRIVATE void
+ewise_un_parallel(NSimd_UnFunc func, const void* a, nr_intp sa, void* out, nr_intp so,
+                  nr_intp n, nr_intp grain){
+    ewise_un_ctx c = {func, (const char*)a, (char*)out, sa, so};
+    NThread_ParallelFor(n, grain, ewise_un_range, &c);
+}
+
+/*
+ * Mixed dtype inputs (NFUNC_FLAG_CAST_IN_LOOP). Instead of promoted copies
+ * of whole inputs, every inner row is processed EWISE_CAST_BLOCK items at a
+ * time: inputs of another dtype (or strided ones) are cast/gathered into
+ * stack buffers, the kernel's vector loop runs on the buffers and strided
+ * outputs are scattered back. Broadcast (stride 0) inputs are cast once per
+ * row and use the scalar loops. Each range of a split row has its own
+ * buffers, so peak memory stays at a few blocks per thread.
+ */
+#define EWISE_CAST_BLOCK 512
+
+typedef struct{
+    NSimd_BinFunc vv, vs, sv;
+    NDtype_CastFunc cast[2];    // NULL when the input already has the kernel dtype
+    nr_intp isize, osize;
+    const char* in[2];
+    nr_intp istride[2];
+    char* out;
+    nr_intp ostride;
+}ewise_cast_ctx;
+
+/* Loads `n` items of input `k` as kernel dtype, into `buf` unless usable in place */
+NR_STATIC_INLINE const void*
+ewise_cast_load(const ewise_cast_ctx* c, int k, const char* src, nr_intp n, void* buf){
+    if (c->cast[k]){
+        c->cast[k](src, c->istride[k], buf, n);
+        return buf;
+    }
+    if (c->istride[k] == c->isize){
+        return src;
+    }
+    char* d = (char*)buf;
+    for (nr_intp i = 0; i < n; i++, src += c->istride[k], d += c->isize){
+        memcpy(d, src, c->isize);
+    }
+    return buf;
+}
+
+NR_PRIVATE void
+ewise_cast_range(void* ctx, nr_intp start, nr_intp end){
+    const ewise_cast_ctx* c = (const ewise_cast_ctx*)ctx;
+    nr_float64 abuf[EWISE_CAST_BLOCK], bbuf[EWISE_CAST_BLOCK], obuf[EWISE_CAST_BLOCK];
+    nr_float64 sclr[2];
+    /* both inputs broadcast: keep `a` as a (stride 0) vector */
+    int scalar[2] = {c->istride[0] == 0 && c->istride[1] != 0, c->istride[1] == 0};
+    NSimd_BinFunc func = scalar[0] ? c->sv : (scalar[1] ? c->vs : c->vv);
+    const void* sptr[2];
+    for (int k = 0; k < 2; k++){
+        if (scalar[k]){
+            sptr[k] = ewise_cast_load(c, k, c->in[k], 1, &sclr[k]);
+        }
+    }
+
+    const char* a = c->in[0] + start * c->istride[0];
+    const char* b = c->in[1] + start * c->istride[1];
+    char* out = c->out + start * c->ostride;
+    int ocontig = c->ostride == c->osize;
+    while (start < end){
+        nr_intp n = end - start < EWISE_CAST_BLOCK ? end - start : EWISE_CAST_BLOCK;
+        const void* pa = scalar[0] ? sptr[0] : ewise_cast_load(c, 0, a, n, abuf);
+        const void* pb = scalar[1] ? sptr[1] : ewise_cast_load(c, 1, b, n, bbuf);
+        if (ocontig){
+            func(pa, pb, out, n);
+        } else {
+            func(pa, pb, obuf, n);
+            const char* o = (const char*)obuf;
+            for (nr_intp i = 0; i < n; i++, o += c->osize){
+                memcpy(out + i * c->ostride, o, c->osize);
+            }
+        }
+        a += n * c->istride[0];
+        b += n * c->istride[1];
+        out += n * c->ostride;
+        start += n;
+    }
+}
+
+NR_PRIVATE int
+ewise_bin_cast(NFuncArgs* args, NSimd_BinOp op, nr_intp isize, nr_intp osize,
+               NSimd_BinFunc vv, NSimd_BinFunc vs, NSimd_BinFunc sv){
+    Node* out = args->out_nodes[0];
+    NR_DTYPE dt = args->intype;
+    if (!out){
+        nr_intp bshape[NR_NODE_MAX_NDIM];
+        int bndim;
+        if (NTools_BroadcastShapes(args->in_nodes, 2, bshape, &bndim) != 0){
+            return -1;
+        }
+        out = Node_NewEmpty(bndim, bshape, args->outtype);
+        if (!out){
+            return -1;
+        }
+    }
+
+    ewise_cast_ctx c;
+    NSimd_BinFunc f;
+    c.vv = (f = NSimd_BinaryFunc(op, dt, NSIMD_BIN_VV)) ? f : vv;
+    c.vs = (f = NSimd_BinaryFunc(op, dt, NSIMD_BIN_VS)) ? f : vs;
+    c.sv = (f = NSimd_BinaryFunc(op, dt, NSIMD_BIN_SV)) ? f : sv;
+    c.isize = isize;
+    c.osize = osize;
+    for (int k = 0; k < 2; k++){
+        NR_DTYPE kdt = NODE_DTYPE(args->in_nodes[k]);
+        c.cast[k] = kdt == dt ? NULL : NDtype_GetCastFunc(kdt, dt);
+    }
+
+    Node* inodes[3] = {args->in_nodes[0], args->in_nodes[1], out};
+    NInnerIter iit;
+    if (NInnerIter_FromNodes(&iit, inodes, 3, NITER_ORDER_K) != 0){
+        if (out != args->out_nodes[0]){
+            Node_Free(out);
+        }
+        return -1;
+    }
+    NInnerIter_ITER(&iit);
+    while (NInnerIter_NOTDONE(&iit)){
+        char** ptrs = NInnerIter_PTRS(&iit);
+        nr_intp* strides = NInnerIter_STRIDES(&iit);
+        c.in[0] = ptrs[0];
+        c.in[1] = ptrs[1];
+        c.out = ptrs[2];
+        c.istride[0] = strides[0];
+        c.istride[1] = strides[1];
+        c.ostride = strides[2];
+        NThread_ParallelFor(NInnerIter_COUNT(&iit), NTHREAD_GRAIN_DEFAULT, ewise_cast_range, &c);
+        NInnerIter_NEXT(&iit);
+    }
+    args->out_nodes[0] = out;
+    return 0;
+}
+
 /*
  * 2-Input / 1-Output Elementwise NFunc Kernel Template
  * ----------------------------------------------------
  * Use DEFINE_BIN_EWISE_KERNEL to declare a per-dtype kernel implementing
  * an elementwise binary operation. Each kernel:
- *  - Accepts already validated/promotion-adjusted inputs (same dtype or broadcastable).
+ *  - Accepts inputs of any dtype: inputs that differ from `args->intype`
+ *    (NFUNC_FLAG_CAST_IN_LOOP) go through ewise_bin_cast.
  *  - Allocates output node if NULL (using broadcast shape when needed).
  *  - Handles fast path for same-shape contiguous memory.
- *  - Falls back to NMultiIter for broadcasting or strided iteration.
+ *  - Uses the runtime-dispatched SIMD loop from simd.h for the contiguous
+ *    and contiguous-with-scalar paths when one exists for OP_NAME/I_NT, and
+ *    per row when broadcasting keeps every inner row contiguous or
+ *    broadcast (NITER_MODE_INNER_CONTIGUOUS).
+ *  - Falls back to the row loops of loops.h (NInnerIter) for broadcasting or
+ *    strided iteration.
+ *  - Splits the contiguous paths over the thread pool (nthread.h), with
+ *    the loops of NMATH_DEFINE_BIN_CLOOPS when there is no vector loop.
  *
  * Parameters:
  *  - OP_NAME: Operation name (e.g., add, sub, mul)
@@ -31,11 +219,19 @@
  * Returns 0 on success, -1 on error.
  */
 #define DEFINE_BIN_EWISE_KERNEL(OP_NAME, OP_MACRO, I_NT, O_NT)                      \
+NMATH_DEFINE_BIN_CLOOPS(OP_NAME##_cloop_##I_NT, OP_MACRO, O_NT, I_NT)              \
 NR_STATIC int FUNC_NAME(OP_NAME, I_NT)(NFuncArgs* args){                            \
     Node* n1 = args->in_nodes[0];                                                   \
     Node* n2 = args->in_nodes[1];                                                   \
     Node* out = args->out_nodes[0];                                                 \
                                                                                     \
+    if (NODE_DTYPE(n1) != args->intype || NODE_DTYPE(n2) != args->intype) {         \
+        return ewise_bin_cast(args, NSIMD_OP_##OP_NAME, sizeof(I_NT), sizeof(O_NT), \
+                              OP_NAME##_cloop_##I_NT##_vv,                          \
+                              OP_NAME##_cloop_##I_NT##_vs,                          \
+                              OP_NAME##_cloop_##I_NT##_sv);                         \
+    }                                                                               \
+                                                                                    \
     int ss = Node_SameShape(n1, n2);                                                \
     if (!out && ss) {                                                               \
         out = Node_NewEmpty(n1->ndim, n1->shape, args->outtype);                    \
@@ -51,7 +247,11 @@ NR_STATIC int FUNC_NAME(OP_NAME, I_NT)(NFuncArgs* args){
     if (ss) {                                                                       \
         if (outc) {                                                                 \
             if (n1c & n2c) {                                                        \
-                NMATH_LOOP_CCC(OP_MACRO, O_NT, I_NT);                               \
+                NSimd_BinFunc vfunc = NSimd_BinaryFunc(                             \
+                    NSIMD_OP_##OP_NAME, NODE_DTYPE(n1), NSIMD_BIN_VV);              \
+                ewise_bin_parallel(vfunc ? vfunc : OP_NAME##_cloop_##I_NT##_vv,    \
+                                   n1->data, sizeof(I_NT), n2->data, sizeof(I_NT),  \
+                                   out->data, sizeof(O_NT), Node_NItems(out));      \
             } else if (n1c | n2c) {                                                 \
                 NMATH_LOOP_CSC(OP_MACRO, O_NT, I_NT);                               \
             } else {                                                                \
@@ -69,13 +269,31 @@ NR_STATIC int FUNC_NAME(OP_NAME, I_NT)(NFuncArgs* args){
     } else {                                                                        \
         int issclr = NODE_IS_SCALAR(n1) | NODE_IS_SCALAR(n2);                       \
         if (issclr) {                                                               \
-            I_NT sclr = *(I_NT*)(NODE_IS_SCALAR(n1) ? n1->data : n2->data);         \
-            Node* n = NODE_IS_SCALAR(n1) ? n2 : n1;                                 \
+            int sfirst = NODE_IS_SCALAR(n1);                                        \
+            I_NT sclr = *(I_NT*)(sfirst ? n1->data : n2->data);                     \
+            Node* n = sfirst ? n2 : n1;                                             \
             int nc = NODE_IS_CONTIGUOUS(n);                                         \
                                                                                     \
+            if (!out) {                                                             \
+                out = Node_NewEmpty(n->ndim, n->shape, args->outtype);              \
+                if (!out) {                                                         \
+                    return -1;                                                      \
+                }                                                                   \
+                outc = 1;                                                           \
+            }                                                                       \
+                                                                                    \
             if (outc) {                                                             \
                 if (nc) {                                                           \
-                    NMATH_LOOP_CC_S(OP_MACRO, O_NT, I_NT);                          \
+                    NSimd_BinFunc vfunc = NSimd_BinaryFunc(NSIMD_OP_##OP_NAME,      \
+                        NODE_DTYPE(n), sfirst ? NSIMD_BIN_SV : NSIMD_BIN_VS);       \
+                    if (!vfunc) {                                                   \
+                        vfunc = sfirst ? OP_NAME##_cloop_##I_NT##_sv                \
+                                       : OP_NAME##_cloop_##I_NT##_vs;               \
+                    }                                                               \
+                    ewise_bin_parallel(vfunc,                                       \
+                        sfirst ? n1->data : n->data, sfirst ? 0 : sizeof(I_NT),     \
+                        sfirst ? n->data : n2->data, sfirst ? sizeof(I_NT) : 0,     \
+                        out->data, sizeof(O_NT), Node_NItems(out));                 \
                 } else {                                                            \
                     NMATH_LOOP_CS_S(OP_MACRO, O_NT, I_NT);                          \
                 }                                                                   \
@@ -87,27 +305,41 @@ NR_STATIC int FUNC_NAME(OP_NAME, I_NT)(NFuncArgs* args){
                 }                                                                   \
             }                                                                       \
         } else {                                                                    \
-            NMultiIter mit;                                                         \
-            if (NMultiIter_FromNodes(args->in_nodes, 2, &mit) != 0) {               \
-                return -1;                                                          \
-            }                                                                       \
-                                                                                    \
             if (!out) {                                                             \
-                out = Node_NewEmpty(mit.out_ndim, mit.out_shape, args->outtype);    \
+                nr_intp bshape[NR_NODE_MAX_NDIM];                                   \
+                int bndim;                                                          \
+                if (NTools_BroadcastShapes(args->in_nodes, 2, bshape, &bndim) != 0) { \
+                    return -1;                                                      \
+                }                                                                   \
+                out = Node_NewEmpty(bndim, bshape, args->outtype);                  \
                 if (!out) {                                                         \
                     return -1;                                                      \
                 }                                                                   \
             }                                                                       \
                                                                                     \
-            nr_size_t i = 0;                                                        \
-            NMultiIter_ITER(&mit);                                                  \
-            while (NMultiIter_NOTDONE(&mit)) {                                      \
-                *((O_NT*)out->data + i) = OP_MACRO(                                 \
-                    *((I_NT*)NMultiIter_ITEM(&mit, 0)),                             \
-                    *((I_NT*)NMultiIter_ITEM(&mit, 1))                              \
-                );                                                                  \
-                i++;                                                                \
-                NMultiIter_NEXT2(&mit);                                             \
+            Node* inodes[3] = {n1, n2, out};                                        \
+            NInnerIter iit;                                                         \
+            if (NInnerIter_FromNodes(&iit, inodes, 3, NITER_ORDER_K) != 0) {        \
+                return -1;                                                          \
+            }                                                                       \
+            nr_intp s1 = NInnerIter_STRIDES(&iit)[0];                               \
+            nr_intp s2 = NInnerIter_STRIDES(&iit)[1];                               \
+            NSimd_BinFunc vfunc = NULL;                                             \
+            if (iit.iter_mode != NITER_MODE_STRIDED && (s1 | s2) != 0               \
+                && NInnerIter_STRIDES(&iit)[2] != 0) {                              \
+                /* row vector + matrix and the like: one vector loop per row */    \
+                vfunc = NSimd_BinaryFunc(NSIMD_OP_##OP_NAME, NODE_DTYPE(n1),        \
+                    s1 == 0 ? NSIMD_BIN_SV : (s2 == 0 ? NSIMD_BIN_VS : NSIMD_BIN_VV)); \
+            }                                                                       \
+            if (vfunc) {                                                            \
+                NInnerIter_ITER(&iit);                                              \
+                while (NInnerIter_NOTDONE(&iit)) {                                  \
+                    char** ptrs = NInnerIter_PTRS(&iit);                            \
+                    vfunc(ptrs[0], ptrs[1], ptrs[2], NInnerIter_COUNT(&iit));       \
+                    NInnerIter_NEXT(&iit);                                          \
+                }                                                                   \
+            } else {                                                                \
+                NMATH_LOOP_BIN_INNER(OP_MACRO, O_NT, I_NT);                         \
             }                                                                       \
         }                                                                           \
     }                                                                               \
@@ -184,16 +416,46 @@ do { \
 } while (0)
 
 
+/* ----------------------------------------------
+   Kernel tables: OP##_kernels maps a dtype to its kernel (NULL when not
+   enabled) and OP##_dispatch is the NFunc's dispatch cache. The NFunc
+   points to both (`.kernels` / `.dispatch`), so NFunc_Call calls the
+   kernels directly once the table is filled.
+   ---------------------------------------------- */
+#define BOOL_ENTRY(OP) \
+    [NR_BOOL] = FUNC_NAME(OP, nr_bool),
+
+#define INT_ENTRIES(OP) \
+    [NR_INT8] = FUNC_NAME(OP, nr_int8), [NR_UINT8] = FUNC_NAME(OP, nr_uint8), \
+    [NR_INT16] = FUNC_NAME(OP, nr_int16), [NR_UINT16] = FUNC_NAME(OP, nr_uint16), \
+    [NR_INT32] = FUNC_NAME(OP, nr_int32), [NR_UINT32] = FUNC_NAME(OP, nr_uint32), \
+    [NR_INT64] = FUNC_NAME(OP, nr_int64), [NR_UINT64] = FUNC_NAME(OP, nr_uint64),
+
+#define FLOAT_ENTRIES(OP) \
+    [NR_FLOAT32] = FUNC_NAME(OP, nr_float32), [NR_FLOAT64] = FUNC_NAME(OP, nr_float64),
+
+#define DEFINE_DTYPE_KERNELS(OP, ALLOW_BOOL, ALLOW_INT, ALLOW_FLOAT) \
+NR_PRIVATE const NFuncFunc OP##_kernels[NR_NUM_NUMIRC_DT] = { \
+    ENABLE_IF_##ALLOW_BOOL ( BOOL_ENTRY(OP) ) \
+    ENABLE_IF_##ALLOW_INT  ( INT_ENTRIES(OP) ) \
+    ENABLE_IF_##ALLOW_FLOAT( FLOAT_ENTRIES(OP) ) \
+}; \
+NR_PRIVATE NFuncDispatch OP##_dispatch;
+
+
 /* Main dispatch function generator.
-   This now uses the `func` pointer set by DEFINE_DTYPE_TO_FUNC
-   and invokes it, or raises an error if unsupported.
+   It looks the kernel up in OP_NAME##_kernels and invokes it, or raises
+   an error if unsupported.
 */
 #define DEFINE_BIN_EWISE_MAIN_FUNC(OP_NAME, OP_STR, ALLOW_BOOL, ALLOW_INT, ALLOW_FLOAT) \
+DEFINE_DTYPE_KERNELS(OP_NAME, ALLOW_BOOL, ALLOW_INT, ALLOW_FLOAT)   \
 NR_PRIVATE int OP_NAME##_function(NFuncArgs* args){            \
     Node* a = args->in_nodes[0];                                  \
-    NR_DTYPE adt = NODE_DTYPE(a);                              \
-    NFuncFunc func = NULL;                                     \
-    DEFINE_DTYPE_TO_FUNC(OP_NAME, adt, func, ALLOW_BOOL, ALLOW_INT, ALLOW_FLOAT); \
+    if (!NDtype_IsValid(args->intype)) {                       \
+        args->intype = NODE_DTYPE(a);                          \
+    }                                                          \
+    NR_DTYPE adt = args->intype;                               \
+    NFuncFunc func = NDtype_IsValid(adt) ? OP_NAME##_kernels[adt] : NULL; \
     if (!func) {                                                \
         NError_RaiseError(NError_TypeError, OP_STR " unsupported dtype %d", adt); \
         return -1;                                              \
@@ -208,7 +470,7 @@ DEFINE_BIN_EWISE_ALL_TYPES(Add, NMATH_ADD, 1, 1, 1)
 DEFINE_BIN_EWISE_MAIN_FUNC(Add, "add", 1, 1, 1)
 const NFunc add_nfunc = {
     .name = "add",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -216,7 +478,9 @@ const NFunc add_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Add_function,
-    .grad_func = NULL
+    .grad_func = &add_grad,
+    .kernels = Add_kernels,
+    .dispatch = &Add_dispatch
 };
 
 // Subtraction
@@ -224,7 +488,7 @@ DEFINE_BIN_EWISE_ALL_TYPES(Sub, NMATH_SUB, 1, 1, 1)
 DEFINE_BIN_EWISE_MAIN_FUNC(Sub, "sub", 1, 1, 1)
 const NFunc sub_nfunc = {
     .name = "sub",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -232,7 +496,9 @@ const NFunc sub_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Sub_function,
-    .grad_func = NULL
+    .grad_func = &sub_grad,
+    .kernels = Sub_kernels,
+    .dispatch = &Sub_dispatch
 };
 
 // Multiplication
@@ -240,7 +506,7 @@ DEFINE_BIN_EWISE_ALL_TYPES(Mul, NMATH_MUL, 1, 1, 1)
 DEFINE_BIN_EWISE_MAIN_FUNC(Mul, "mul", 1, 1, 1)
 const NFunc mul_nfunc = {
     .name = "mul",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -248,7 +514,9 @@ const NFunc mul_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Mul_function,
-    .grad_func = NULL
+    .grad_func = &mul_grad,
+    .kernels = Mul_kernels,
+    .dispatch = &Mul_dispatch
 };
 
 // Division (float only)
@@ -256,7 +524,7 @@ DEFINE_BIN_EWISE_ALL_TYPES(Div, NMATH_DIV, 0, 0, 1)
 DEFINE_BIN_EWISE_MAIN_FUNC(Div, "div", 0, 0, 1)
 const NFunc div_nfunc = {
     .name = "div",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -264,7 +532,9 @@ const NFunc div_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Div_function,
-    .grad_func = NULL
+    .grad_func = &div_grad,
+    .kernels = Div_kernels,
+    .dispatch = &Div_dispatch
 };
 
 
@@ -273,7 +543,7 @@ DEFINE_BIN_EWISE_ALL_TYPES(TrueDiv, NMATH_TRUEDIV, 1, 1, 0)
 DEFINE_BIN_EWISE_MAIN_FUNC(TrueDiv, "true div", 1, 1, 0)
 const NFunc truediv_nfunc = {
     .name = "truediv",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_INT,
@@ -281,7 +551,9 @@ const NFunc truediv_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = TrueDiv_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = TrueDiv_kernels,
+    .dispatch = &TrueDiv_dispatch
 };
 
 
@@ -290,7 +562,7 @@ DEFINE_BIN_EWISE_ALL_TYPES(Mod, NMATH_MOD, 1, 1, 0)
 DEFINE_BIN_EWISE_MAIN_FUNC(Mod, "mod", 1, 1, 0)
 const NFunc mod_nfunc = {
     .name = "mod",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_INT,
@@ -298,7 +570,9 @@ const NFunc mod_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Mod_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Mod_kernels,
+    .dispatch = &Mod_dispatch
 };
 
 
@@ -307,7 +581,7 @@ DEFINE_BIN_EWISE_ALL_TYPES(Pow, NMATH_POW, 1, 1, 1)
 DEFINE_BIN_EWISE_MAIN_FUNC(Pow, "pow", 1, 1, 1)
 const NFunc pow_nfunc = {
     .name = "pow",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -315,7 +589,9 @@ const NFunc pow_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Pow_function,
-    .grad_func = NULL
+    .grad_func = &pow_grad,
+    .kernels = Pow_kernels,
+    .dispatch = &Pow_dispatch
 };
 
 /*
@@ -341,7 +617,7 @@ BOOL_OPERATIONS_KERNEL(Bg, NMATH_BG)
 DEFINE_BIN_EWISE_MAIN_FUNC(Bg, "bigger than", 1, 1, 1)
 const NFunc bg_nfunc = {
     .name = "bg",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -349,7 +625,9 @@ const NFunc bg_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_BOOL,
     .func = Bg_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Bg_kernels,
+    .dispatch = &Bg_dispatch
 };
 
 // Bigger Equal Than
@@ -357,7 +635,7 @@ BOOL_OPERATIONS_KERNEL(Bge, NMATH_BGE)
 DEFINE_BIN_EWISE_MAIN_FUNC(Bge, "bigger equal than", 1, 1, 1)
 const NFunc bge_nfunc = {
     .name = "bge",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -365,7 +643,9 @@ const NFunc bge_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_BOOL,
     .func = Bge_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Bge_kernels,
+    .dispatch = &Bge_dispatch
 };
 
 // Less Than
@@ -373,7 +653,7 @@ BOOL_OPERATIONS_KERNEL(Ls, NMATH_LS)
 DEFINE_BIN_EWISE_MAIN_FUNC(Ls, "less than", 1, 1, 1)
 const NFunc ls_nfunc = {
     .name = "ls",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -381,7 +661,9 @@ const NFunc ls_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_BOOL,
     .func = Ls_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Ls_kernels,
+    .dispatch = &Ls_dispatch
 };
 
 // Less Equal Than
@@ -389,7 +671,7 @@ BOOL_OPERATIONS_KERNEL(Lse, NMATH_LSE)
 DEFINE_BIN_EWISE_MAIN_FUNC(Lse, "less equal than", 1, 1, 1)
 const NFunc lse_nfunc = {
     .name = "lse",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -397,7 +679,9 @@ const NFunc lse_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_BOOL,
     .func = Lse_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Lse_kernels,
+    .dispatch = &Lse_dispatch
 };
 
 // Equal To
@@ -405,7 +689,7 @@ BOOL_OPERATIONS_KERNEL(Eq, NMATH_EQ)
 DEFINE_BIN_EWISE_MAIN_FUNC(Eq, "equal to", 1, 1, 1)
 const NFunc eq_nfunc = {
     .name = "eq",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -413,7 +697,9 @@ const NFunc eq_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_BOOL,
     .func = Eq_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Eq_kernels,
+    .dispatch = &Eq_dispatch
 };
 
 // Not Equal To
@@ -421,7 +707,7 @@ BOOL_OPERATIONS_KERNEL(Neq, NMATH_NEQ)
 DEFINE_BIN_EWISE_MAIN_FUNC(Neq, "not equal to", 1, 1, 1)
 const NFunc neq_nfunc = {
     .name = "neq",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -429,7 +715,9 @@ const NFunc neq_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_BOOL,
     .func = Neq_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Neq_kernels,
+    .dispatch = &Neq_dispatch
 };
 
 
@@ -453,7 +741,7 @@ BITWISE_OPERATIONS_KERNEL(BitAnd, NMATH_BIT_AND)
 DEFINE_BIN_EWISE_MAIN_FUNC(BitAnd, "bitwise and", 1, 1, 0)
 const NFunc bit_and_nfunc = {
     .name = "and",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_INT,
@@ -461,7 +749,9 @@ const NFunc bit_and_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = BitAnd_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = BitAnd_kernels,
+    .dispatch = &BitAnd_dispatch
 };
 
 // Bitwise OR
@@ -469,7 +759,7 @@ BITWISE_OPERATIONS_KERNEL(BitOr, NMATH_BIT_OR)
 DEFINE_BIN_EWISE_MAIN_FUNC(BitOr, "bitwise or", 1, 1, 0)
 const NFunc bit_or_nfunc = {
     .name = "or",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_INT,
@@ -477,7 +767,9 @@ const NFunc bit_or_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = BitOr_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = BitOr_kernels,
+    .dispatch = &BitOr_dispatch
 };
 
 // Bitwise XOR
@@ -485,7 +777,7 @@ BITWISE_OPERATIONS_KERNEL(BitXor, NMATH_BIT_XOR)
 DEFINE_BIN_EWISE_MAIN_FUNC(BitXor, "bitwise xor", 1, 1, 0)
 const NFunc bit_xor_nfunc = {
     .name = "xor",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_INT,
@@ -493,7 +785,9 @@ const NFunc bit_xor_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = BitXor_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = BitXor_kernels,
+    .dispatch = &BitXor_dispatch
 };
 
 // Bitwise Left Shift
@@ -501,7 +795,7 @@ BITWISE_OPERATIONS_KERNEL(BitLSH, NMATH_BIT_LSH)
 DEFINE_BIN_EWISE_MAIN_FUNC(BitLSH, "bitwise left shift", 1, 1, 0)
 const NFunc bit_lsh_nfunc = {
     .name = "lshift",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_INT,
@@ -509,7 +803,9 @@ const NFunc bit_lsh_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = BitLSH_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = BitLSH_kernels,
+    .dispatch = &BitLSH_dispatch
 };
 
 // Bitwise Right Shift
@@ -517,7 +813,7 @@ BITWISE_OPERATIONS_KERNEL(BitRSH, NMATH_BIT_RSH)
 DEFINE_BIN_EWISE_MAIN_FUNC(BitRSH, "bitwise right shift", 1, 1, 0)
 const NFunc bit_rsh_nfunc = {
     .name = "rshift",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE | NFUNC_FLAG_CAST_IN_LOOP,
     .nin = 2,
     .nout = 1,
     .in_type = NDTYPE_INT,
@@ -525,7 +821,9 @@ const NFunc bit_rsh_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = BitRSH_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = BitRSH_kernels,
+    .dispatch = &BitRSH_dispatch
 };
 
 
@@ -540,8 +838,8 @@ const NFunc bit_rsh_nfunc = {
  * an elementwise unary operation. Each kernel:
  *  - Accepts already validated input.
  *  - Allocates output node if NULL (using same shape as input).
- *  - Handles fast path for contiguous memory.
- *  - Falls back to NIter for strided iteration.
+ *  - Handles fast path for contiguous memory, split over the thread pool.
+ *  - Falls back to the row loops of loops.h (NInnerIter) for strided iteration.
  *
  * Parameters:
  *  - OP_NAME: Operation name (e.g., neg, abs, sin)
@@ -552,6 +850,7 @@ const NFunc bit_rsh_nfunc = {
  * Returns 0 on success, -1 on error.
  */
 #define DEFINE_UN_EWISE_KERNEL(OP_NAME, OP_MACRO, I_NT, O_NT)                                          \
+NMATH_DEFINE_UN_CLOOP(OP_NAME##_cloop_##I_NT, OP_MACRO, O_NT, I_NT)                 \
 NR_STATIC int FUNC_NAME(OP_NAME, I_NT)(NFuncArgs* args){                            \
     Node* n1 = args->in_nodes[0];                                                   \
     Node* out = args->out_nodes[0];                                                 \
@@ -568,7 +867,9 @@ NR_STATIC int FUNC_NAME(OP_NAME, I_NT)(NFuncArgs* args){
                                                                                     \
     if (outc) {                                                                     \
         if (n1c) {                                                                  \
-            NMATH_LOOP_CC_1I(OP_MACRO, O_NT, I_NT);                                \
+            ewise_un_parallel(OP_NAME##_cloop_##I_NT##_v, n1->data, sizeof(I_NT),   \
+                              out->data, sizeof(O_NT), Node_NItems(out),            \
+                              NTHREAD_GRAIN_DEFAULT);                               \
         } else {                                                                    \
             NMATH_LOOP_CS_1I(OP_MACRO, O_NT, I_NT);                                \
         }                                                                           \
@@ -598,11 +899,11 @@ NR_STATIC int FUNC_NAME(OP_NAME, I_NT)(NFuncArgs* args){
                              DEFINE_UN_EWISE_KERNEL(OP_NAME, OP_MACRO, nr_float64, nr_float64) )
 
 #define DEFINE_UN_EWISE_MAIN_FUNC(OP_NAME, OP_STR, ALLOW_BOOL, ALLOW_INT, ALLOW_FLOAT) \
+DEFINE_DTYPE_KERNELS(OP_NAME, ALLOW_BOOL, ALLOW_INT, ALLOW_FLOAT)   \
 NR_PRIVATE int OP_NAME##_function(NFuncArgs* args){            \
     Node* a = args->in_nodes[0];                                  \
     NR_DTYPE adt = NODE_DTYPE(a);                              \
-    NFuncFunc func = NULL;                                     \
-    DEFINE_DTYPE_TO_FUNC(OP_NAME, adt, func, ALLOW_BOOL, ALLOW_INT, ALLOW_FLOAT); \
+    NFuncFunc func = NDtype_IsValid(adt) ? OP_NAME##_kernels[adt] : NULL; \
     if (!func) {                                                \
         NError_RaiseError(NError_TypeError, OP_STR " unsupported dtype %d", adt); \
         return -1;                                              \
@@ -615,7 +916,7 @@ UN_EWISE_ALL_TYPES(Neg, NMATH_NEG, 0, 1, 1)
 DEFINE_UN_EWISE_MAIN_FUNC(Neg, "negation", 0, 1, 1)
 const NFunc neg_nfunc = {
     .name = "neg",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -623,7 +924,9 @@ const NFunc neg_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Neg_function,
-    .grad_func = NULL
+    .grad_func = &neg_grad,
+    .kernels = Neg_kernels,
+    .dispatch = &Neg_dispatch
 };
 
 // Bitwise NOT (integers only)
@@ -639,19 +942,65 @@ const NFunc bit_not_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = BitNot_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = BitNot_kernels,
+    .dispatch = &BitNot_dispatch
 };
 
+/*
+ * Float version of DEFINE_UN_EWISE_KERNEL. When input and output are both
+ * contiguous it uses the vector loop from simd_math.c if there is one for
+ * OP_NAME (see NSimd_UnaryFunc), and the scalar loops otherwise. These
+ * loops cost more per item, so they are split over the thread pool with
+ * the smaller NTHREAD_GRAIN_HEAVY.
+ */
+#define DEFINE_UN_EWISE_FLOAT_KERNEL(OP_NAME, OP_MACRO, I_NT, O_NT)                   \
+NMATH_DEFINE_UN_CLOOP(OP_NAME##_cloop_##I_NT, OP_MACRO, O_NT, I_NT)                 \
+NR_STATIC int FUNC_NAME(OP_NAME, I_NT)(NFuncArgs* args){                            \
+    Node* n1 = args->in_nodes[0];                                                   \
+    Node* out = args->out_nodes[0];                                                 \
+                                                                                    \
+    if (!out) {                                                                     \
+        out = Node_NewEmpty(n1->ndim, n1->shape, args->outtype);                    \
+        if (!out) {                                                                 \
+            return -1;                                                              \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    int n1c = NODE_IS_CONTIGUOUS(n1);                                               \
+    int outc = NODE_IS_CONTIGUOUS(out);                                             \
+                                                                                    \
+    if (outc) {                                                                     \
+        if (n1c) {                                                                  \
+            NSimd_UnFunc vfunc = NSimd_UnaryFunc(NSIMD_UOP_##OP_NAME, NODE_DTYPE(n1)); \
+            ewise_un_parallel(vfunc ? vfunc : OP_NAME##_cloop_##I_NT##_v,           \
+                              n1->data, sizeof(I_NT), out->data, sizeof(O_NT),      \
+                              Node_NItems(out), NTHREAD_GRAIN_HEAVY);               \
+        } else {                                                                    \
+            NMATH_LOOP_CS_1I(OP_MACRO, O_NT, I_NT);                                \
+        }                                                                           \
+    } else {                                                                        \
+        if (n1c) {                                                                  \
+            NMATH_LOOP_SC_1I(OP_MACRO, O_NT, I_NT);                                \
+        } else {                                                                    \
+            NMATH_LOOP_SS_1I(OP_MACRO, O_NT, I_NT);                                \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    args->out_nodes[0] = out;                                                       \
+    return 0;                                                                       \
+}
+
 #define UN_EWISE_FLOAT_TYPES(OP_NAME, OP_MACRO_FLOAT32, OP_MACRO_FLOAT64) \
-    DEFINE_UN_EWISE_KERNEL(OP_NAME, OP_MACRO_FLOAT32, nr_float32, nr_float32) \
-    DEFINE_UN_EWISE_KERNEL(OP_NAME, OP_MACRO_FLOAT64, nr_float64, nr_float64)
+    DEFINE_UN_EWISE_FLOAT_KERNEL(OP_NAME, OP_MACRO_FLOAT32, nr_float32, nr_float32) \
+    DEFINE_UN_EWISE_FLOAT_KERNEL(OP_NAME, OP_MACRO_FLOAT64, nr_float64, nr_float64)
 
 // Sine (floats only)
 UN_EWISE_FLOAT_TYPES(Sin, nr_sinf, nr_sin)
 DEFINE_UN_EWISE_MAIN_FUNC(Sin, "sine", 0, 0, 1)
 const NFunc sin_nfunc = {
     .name = "sin",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -659,7 +1008,9 @@ const NFunc sin_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Sin_function,
-    .grad_func = NULL
+    .grad_func = &sin_grad,
+    .kernels = Sin_kernels,
+    .dispatch = &Sin_dispatch
 };
 
 // Cosine (floats only)
@@ -667,7 +1018,7 @@ UN_EWISE_FLOAT_TYPES(Cos, nr_cosf, nr_cos)
 DEFINE_UN_EWISE_MAIN_FUNC(Cos, "cosine", 0, 0, 1)
 const NFunc cos_nfunc = {
     .name = "cos",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -675,7 +1026,9 @@ const NFunc cos_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Cos_function,
-    .grad_func = NULL
+    .grad_func = &cos_grad,
+    .kernels = Cos_kernels,
+    .dispatch = &Cos_dispatch
 };
 
 // Tangent (floats only)
@@ -683,7 +1036,7 @@ UN_EWISE_FLOAT_TYPES(Tan, nr_tanf, nr_tan)
 DEFINE_UN_EWISE_MAIN_FUNC(Tan, "tangent", 0, 0, 1)
 const NFunc tan_nfunc = {
     .name = "tan",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -691,7 +1044,9 @@ const NFunc tan_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Tan_function,
-    .grad_func = NULL
+    .grad_func = &tan_grad,
+    .kernels = Tan_kernels,
+    .dispatch = &Tan_dispatch
 };
 
 // Cotangent (floats only)
@@ -699,7 +1054,7 @@ UN_EWISE_FLOAT_TYPES(Cot, nr_cotf, nr_cot)
 DEFINE_UN_EWISE_MAIN_FUNC(Cot, "cotangent", 0, 0, 1)
 const NFunc cot_nfunc = {
     .name = "cot",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -707,7 +1062,9 @@ const NFunc cot_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Cot_function,
-    .grad_func = NULL
+    .grad_func = &cot_grad,
+    .kernels = Cot_kernels,
+    .dispatch = &Cot_dispatch
 };
 
 // Exponential (floats only)
@@ -715,7 +1072,7 @@ UN_EWISE_FLOAT_TYPES(Exp, nr_expf, nr_exp)
 DEFINE_UN_EWISE_MAIN_FUNC(Exp, "exponential", 0, 0, 1)
 const NFunc exp_nfunc = {
     .name = "exp",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -723,7 +1080,9 @@ const NFunc exp_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Exp_function,
-    .grad_func = NULL
+    .grad_func = &exp_grad,
+    .kernels = Exp_kernels,
+    .dispatch = &Exp_dispatch
 };
 
 // Natural Logarithm (floats only)
@@ -731,7 +1090,7 @@ UN_EWISE_FLOAT_TYPES(Log, nr_logf, nr_log)
 DEFINE_UN_EWISE_MAIN_FUNC(Log, "natural logarithm", 0, 0, 1)
 const NFunc log_nfunc = {
     .name = "log",
-    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -739,7 +1098,9 @@ const NFunc log_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Log_function,
-    .grad_func = NULL
+    .grad_func = &log_grad,
+    .kernels = Log_kernels,
+    .dispatch = &Log_dispatch
 };
 
 // Hyperbolic Sine (floats only)
@@ -747,7 +1108,7 @@ UN_EWISE_FLOAT_TYPES(Sinh, nr_sinhf, nr_sinh)
 DEFINE_UN_EWISE_MAIN_FUNC(Sinh, "hyperbolic sine", 0, 0, 1)
 const NFunc sinh_nfunc = {
     .name = "sinh",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -755,7 +1116,9 @@ const NFunc sinh_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Sinh_function,
-    .grad_func = NULL
+    .grad_func = &sinh_grad,
+    .kernels = Sinh_kernels,
+    .dispatch = &Sinh_dispatch
 };
 
 // Hyperbolic Cosine (floats only)
@@ -763,7 +1126,7 @@ UN_EWISE_FLOAT_TYPES(Cosh, nr_coshf, nr_cosh)
 DEFINE_UN_EWISE_MAIN_FUNC(Cosh, "hyperbolic cosine", 0, 0, 1)
 const NFunc cosh_nfunc = {
     .name = "cosh",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -771,7 +1134,9 @@ const NFunc cosh_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Cosh_function,
-    .grad_func = NULL
+    .grad_func = &cosh_grad,
+    .kernels = Cosh_kernels,
+    .dispatch = &Cosh_dispatch
 };
 
 // Hyperbolic Tangent (floats only)
@@ -779,7 +1144,7 @@ UN_EWISE_FLOAT_TYPES(Tanh, nr_tanhf, nr_tanh)
 DEFINE_UN_EWISE_MAIN_FUNC(Tanh, "hyperbolic tangent", 0, 0, 1)
 const NFunc tanh_nfunc = {
     .name = "tanh",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -787,7 +1152,9 @@ const NFunc tanh_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Tanh_function,
-    .grad_func = NULL
+    .grad_func = &tanh_grad,
+    .kernels = Tanh_kernels,
+    .dispatch = &Tanh_dispatch
 };
 
 // Hyperbolic Cotangent (floats only)
@@ -795,7 +1162,7 @@ UN_EWISE_FLOAT_TYPES(Coth, nr_cothf, nr_coth)
 DEFINE_UN_EWISE_MAIN_FUNC(Coth, "hyperbolic cotangent", 0, 0, 1)
 const NFunc coth_nfunc = {
     .name = "coth",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -803,7 +1170,9 @@ const NFunc coth_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Coth_function,
-    .grad_func = NULL
+    .grad_func = &coth_grad,
+    .kernels = Coth_kernels,
+    .dispatch = &Coth_dispatch
 };
 
 // Arc Sine (floats only)
@@ -811,7 +1180,7 @@ UN_EWISE_FLOAT_TYPES(Asin, nr_asinf, nr_asin)
 DEFINE_UN_EWISE_MAIN_FUNC(Asin, "arc sine", 0, 0, 1)
 const NFunc asin_nfunc = {
     .name = "asin",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -819,7 +1188,9 @@ const NFunc asin_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Asin_function,
-    .grad_func = NULL
+    .grad_func = &asin_grad,
+    .kernels = Asin_kernels,
+    .dispatch = &Asin_dispatch
 };
 
 // Arc Cosine (floats only)
@@ -827,7 +1198,7 @@ UN_EWISE_FLOAT_TYPES(Acos, nr_acosf, nr_acos)
 DEFINE_UN_EWISE_MAIN_FUNC(Acos, "arc cosine", 0, 0, 1)
 const NFunc acos_nfunc = {
     .name = "acos",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -835,7 +1206,9 @@ const NFunc acos_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Acos_function,
-    .grad_func = NULL
+    .grad_func = &acos_grad,
+    .kernels = Acos_kernels,
+    .dispatch = &Acos_dispatch
 };
 
 // Arc Tangent (floats only)
@@ -843,7 +1216,7 @@ UN_EWISE_FLOAT_TYPES(Atan, nr_atanf, nr_atan)
 DEFINE_UN_EWISE_MAIN_FUNC(Atan, "arc tangent", 0, 0, 1)
 const NFunc atan_nfunc = {
     .name = "atan",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -851,7 +1224,9 @@ const NFunc atan_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Atan_function,
-    .grad_func = NULL
+    .grad_func = &atan_grad,
+    .kernels = Atan_kernels,
+    .dispatch = &Atan_dispatch
 };
 
 // Inverse Hyperbolic Sine (floats only)
@@ -859,7 +1234,7 @@ UN_EWISE_FLOAT_TYPES(Asinh, nr_asinhf, nr_asinh)
 DEFINE_UN_EWISE_MAIN_FUNC(Asinh, "inverse hyperbolic sine", 0, 0, 1)
 const NFunc asinh_nfunc = {
     .name = "asinh",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -867,7 +1242,9 @@ const NFunc asinh_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Asinh_function,
-    .grad_func = NULL
+    .grad_func = &asinh_grad,
+    .kernels = Asinh_kernels,
+    .dispatch = &Asinh_dispatch
 };
 
 // Inverse Hyperbolic Cosine (floats only)
@@ -875,7 +1252,7 @@ UN_EWISE_FLOAT_TYPES(Acosh, nr_acoshf, nr_acosh)
 DEFINE_UN_EWISE_MAIN_FUNC(Acosh, "inverse hyperbolic cosine", 0, 0, 1)
 const NFunc acosh_nfunc = {
     .name = "acosh",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -883,7 +1260,9 @@ const NFunc acosh_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Acosh_function,
-    .grad_func = NULL
+    .grad_func = &acosh_grad,
+    .kernels = Acosh_kernels,
+    .dispatch = &Acosh_dispatch
 };
 
 // Inverse Hyperbolic Tangent (floats only)
@@ -891,7 +1270,7 @@ UN_EWISE_FLOAT_TYPES(Atanh, nr_atanhf, nr_atanh)
 DEFINE_UN_EWISE_MAIN_FUNC(Atanh, "inverse hyperbolic tangent", 0, 0, 1)
 const NFunc atanh_nfunc = {
     .name = "atanh",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -899,7 +1278,9 @@ const NFunc atanh_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Atanh_function,
-    .grad_func = NULL
+    .grad_func = &atanh_grad,
+    .kernels = Atanh_kernels,
+    .dispatch = &Atanh_dispatch
 };
 
 // Base-2 Exponential (floats only)
@@ -907,7 +1288,7 @@ UN_EWISE_FLOAT_TYPES(Exp2, nr_exp2f, nr_exp2)
 DEFINE_UN_EWISE_MAIN_FUNC(Exp2, "base-2 exponential", 0, 0, 1)
 const NFunc exp2_nfunc = {
     .name = "exp2",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -915,7 +1296,9 @@ const NFunc exp2_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Exp2_function,
-    .grad_func = NULL
+    .grad_func = &exp2_grad,
+    .kernels = Exp2_kernels,
+    .dispatch = &Exp2_dispatch
 };
 
 // Exponential minus 1 (floats only)
@@ -923,7 +1306,7 @@ UN_EWISE_FLOAT_TYPES(Expm1, nr_expm1f, nr_expm1)
 DEFINE_UN_EWISE_MAIN_FUNC(Expm1, "exponential minus 1", 0, 0, 1)
 const NFunc expm1_nfunc = {
     .name = "expm1",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -931,7 +1314,9 @@ const NFunc expm1_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Expm1_function,
-    .grad_func = NULL
+    .grad_func = &expm1_grad,
+    .kernels = Expm1_kernels,
+    .dispatch = &Expm1_dispatch
 };
 
 // Base-10 Logarithm (floats only)
@@ -939,7 +1324,7 @@ UN_EWISE_FLOAT_TYPES(Log10, nr_log10f, nr_log10)
 DEFINE_UN_EWISE_MAIN_FUNC(Log10, "base-10 logarithm", 0, 0, 1)
 const NFunc log10_nfunc = {
     .name = "log10",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -947,7 +1332,9 @@ const NFunc log10_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Log10_function,
-    .grad_func = NULL
+    .grad_func = &log10_grad,
+    .kernels = Log10_kernels,
+    .dispatch = &Log10_dispatch
 };
 
 // Logarithm plus 1 (floats only)
@@ -955,7 +1342,7 @@ UN_EWISE_FLOAT_TYPES(Log1p, nr_log1pf, nr_log1p)
 DEFINE_UN_EWISE_MAIN_FUNC(Log1p, "logarithm plus 1", 0, 0, 1)
 const NFunc log1p_nfunc = {
     .name = "log1p",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -963,7 +1350,9 @@ const NFunc log1p_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Log1p_function,
-    .grad_func = NULL
+    .grad_func = &log1p_grad,
+    .kernels = Log1p_kernels,
+    .dispatch = &Log1p_dispatch
 };
 
 // Square Root (floats only)
@@ -971,7 +1360,7 @@ UN_EWISE_FLOAT_TYPES(Sqrt, nr_sqrtf, nr_sqrt)
 DEFINE_UN_EWISE_MAIN_FUNC(Sqrt, "square root", 0, 0, 1)
 const NFunc sqrt_nfunc = {
     .name = "sqrt",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -979,7 +1368,9 @@ const NFunc sqrt_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Sqrt_function,
-    .grad_func = NULL
+    .grad_func = &sqrt_grad,
+    .kernels = Sqrt_kernels,
+    .dispatch = &Sqrt_dispatch
 };
 
 // Cube Root (floats only)
@@ -987,7 +1378,7 @@ UN_EWISE_FLOAT_TYPES(Cbrt, nr_cbrtf, nr_cbrt)
 DEFINE_UN_EWISE_MAIN_FUNC(Cbrt, "cube root", 0, 0, 1)
 const NFunc cbrt_nfunc = {
     .name = "cbrt",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -995,7 +1386,9 @@ const NFunc cbrt_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Cbrt_function,
-    .grad_func = NULL
+    .grad_func = &cbrt_grad,
+    .kernels = Cbrt_kernels,
+    .dispatch = &Cbrt_dispatch
 };
 
 // Absolute Value (all numeric types)
@@ -1020,7 +1413,7 @@ DEFINE_UN_EWISE_KERNEL(Abs, nr_fabs, nr_float64, nr_float64)
 DEFINE_UN_EWISE_MAIN_FUNC(Abs, "absolute value", 1, 1, 1)
 const NFunc abs_nfunc = {
     .name = "abs",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_GRADIENT | NFUNC_FLAG_ELEMENTWISE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_NONE,
@@ -1028,7 +1421,9 @@ const NFunc abs_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Abs_function,
-    .grad_func = NULL
+    .grad_func = &abs_grad,
+    .kernels = Abs_kernels,
+    .dispatch = &Abs_dispatch
 };
 
 // Ceiling (floats only)
@@ -1036,7 +1431,7 @@ UN_EWISE_FLOAT_TYPES(Ceil, nr_ceilf, nr_ceil)
 DEFINE_UN_EWISE_MAIN_FUNC(Ceil, "ceiling", 0, 0, 1)
 const NFunc ceil_nfunc = {
     .name = "ceil",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -1044,7 +1439,9 @@ const NFunc ceil_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Ceil_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Ceil_kernels,
+    .dispatch = &Ceil_dispatch
 };
 
 // Floor (floats only)
@@ -1052,7 +1449,7 @@ UN_EWISE_FLOAT_TYPES(Floor, nr_floorf, nr_floor)
 DEFINE_UN_EWISE_MAIN_FUNC(Floor, "floor", 0, 0, 1)
 const NFunc floor_nfunc = {
     .name = "floor",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -1060,7 +1457,9 @@ const NFunc floor_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Floor_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Floor_kernels,
+    .dispatch = &Floor_dispatch
 };
 
 // Truncate (floats only)
@@ -1068,7 +1467,7 @@ UN_EWISE_FLOAT_TYPES(Trunc, nr_truncf, nr_trunc)
 DEFINE_UN_EWISE_MAIN_FUNC(Trunc, "truncate", 0, 0, 1)
 const NFunc trunc_nfunc = {
     .name = "trunc",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -1076,7 +1475,9 @@ const NFunc trunc_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Trunc_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Trunc_kernels,
+    .dispatch = &Trunc_dispatch
 };
 
 // Round to nearest integer (floats only)
@@ -1084,7 +1485,7 @@ UN_EWISE_FLOAT_TYPES(Rint, nr_rintf, nr_rint)
 DEFINE_UN_EWISE_MAIN_FUNC(Rint, "round to nearest integer", 0, 0, 1)
 const NFunc rint_nfunc = {
     .name = "rint",
-    .flags = NFUNC_FLAG_ELEMENTWISE,
+    .flags = NFUNC_FLAG_ELEMENTWISE | NFUNC_FLAG_TYPE_BROADCASTABLE,
     .nin = 1,
     .nout = 1,
     .in_type = NDTYPE_FLOAT,
@@ -1092,7 +1493,9 @@ const NFunc rint_nfunc = {
     .in_dtype = NR_NONE,
     .out_dtype = NR_NONE,
     .func = Rint_function,
-    .grad_func = NULL
+    .grad_func = NULL,
+    .kernels = Rint_kernels,
+    .dispatch = &Rint_dispatch
 };
 
 
@@ -1383,7 +1786,7 @@ NR_STATIC int Ldexp_kernel_nr_float32(NFuncArgs* args){
         // Use broadcasting multiiter
         NMultiIter multiiter;
         Node* nodes[3] = {n1, exp_int32, out};
-        if (NMultiIter_FromNodes(nodes, 3, &multiiter) < 0) {
+        if (NMultiIter_FromNodesOrder(nodes, 3, NITER_ORDER_K, &multiiter) < 0) {
             if (exp_int32 != n2) Node_Free(exp_int32);
             return -1;
         }
@@ -1461,7 +1864,7 @@ NR_STATIC int Ldexp_kernel_nr_float64(NFuncArgs* args){
         // Use broadcasting multiiter
         NMultiIter multiiter;
         Node* nodes[3] = {n1, exp_int32, out};
-        if (NMultiIter_FromNodes(nodes, 3, &multiiter) < 0) {
+        if (NMultiIter_FromNodesOrder(nodes, 3, NITER_ORDER_K, &multiiter) < 0) {
             if (exp_int32 != n2) Node_Free(exp_int32);
             return -1;
         }
@@ -1551,7 +1954,7 @@ NR_STATIC int Modf_kernel_nr_float32(NFuncArgs* args){
         // Use multiiter for strided case
         NMultiIter multiiter;
         Node* nodes[3] = {n1, out_frac, out_int};
-        if (NMultiIter_FromNodes(nodes, 3, &multiiter) < 0) {
+        if (NMultiIter_FromNodesOrder(nodes, 3, NITER_ORDER_K, &multiiter) < 0) {
             NODE_DECREF(out_frac);
             NODE_DECREF(out_int);
             return -1;
@@ -1603,7 +2006,7 @@ NR_STATIC int Modf_kernel_nr_float64(NFuncArgs* args){
         // Use multiiter for strided case
         NMultiIter multiiter;
         Node* nodes[3] = {n1, out_frac, out_int};
-        if (NMultiIter_FromNodes(nodes, 3, &multiiter) < 0) {
+        if (NMultiIter_FromNodesOrder(nodes, 3, NITER_ORDER_K, &multiiter) < 0) {
             NODE_DECREF(out_frac);
             NODE_DECREF(out_int);
             return -1;
@@ -2,29 +2,57 @@
 #include "../nfunc.h"
 #include "../node2str.h"
 #include "nfunc_math.h"
+#include "../ngrad.h"
 
 
+/*
+ * The one-output wrappers keep their NFuncArgs on the stack. Args only
+ * outlive the call when it is recorded on the output node (the node
+ * keeps a reference to them, see NFunc_Call): when the output is tracked
+ * or gradients flow through the call. That case goes through
+ * NFuncArgs_New.
+ */
+NR_PRIVATE Node*
+nmath_call(const NFunc* nfunc, Node* c, Node** in_nodes, int nin){
+    int result;
+    if ((c && NODE_IS_TRACK(c)) || NGrad_Records(nfunc, in_nodes, nin)){
+        NFuncArgs* args = NFuncArgs_New(nin, 1);
+        if (!args){
+            return NULL;
+        }
+        for (int i = 0; i < nin; i++){
+            args->in_nodes[i] = in_nodes[i];
+        }
+        args->out_nodes[0] = c;
+        result = NFunc_Call(nfunc, args);
+        c = args->out_nodes[0];
+        NFuncArgs_DECREF(args);
+        return result != 0 ? NULL : c;
+    }
+
+    NFuncArgs args = {
+        .in_nodes = in_nodes,
+        .out_nodes = &c,
+        .nin = nin,
+        .nout = 1,
+        .outtype = NR_NONE,
+        .intype = NR_NONE,
+        .extra = NULL,
+        .__ref_count = 1,
+    };
+    result = NFunc_Call(nfunc, &args);
+    return result != 0 ? NULL : c;
+}
+
 #define TWO_IN_OPERATIONS(name, nfunc_name) \
 NR_PUBLIC Node* NMath_##name(Node* c, Node* a, Node* b){ \
-    NFuncArgs* args = NFuncArgs_New(2, 1);               \
-    args->in_nodes[0] = a;                               \
-    args->in_nodes[1] = b;                               \
-    args->out_nodes[0] = c;                              \
-    int result = NFunc_Call(&nfunc_name, args);          \
-    Node* out_node = args->out_nodes[0];                 \
-    NFuncArgs_DECREF(args);                              \
-    return result != 0 ? NULL : out_node;                \
+    Node* in_nodes[2] = {a, b};                          \
+    return nmath_call(&nfunc_name, c, in_nodes, 2);      \
 }
 
 #define ONE_IN_OPERATIONS(name, nfunc_name)              \
 NR_PUBLIC Node* NMath_##name(Node* c, Node* a){          \
-    NFuncArgs* args = NFuncArgs_New(1, 1);               \
-    args->in_nodes[0] = a;                               \
-    args->out_nodes[0] = c;                              \
-    int result = NFunc_Call(&nfunc_name, args);          \
-    Node* out_node = args->out_nodes[0];                 \
-    NFuncArgs_DECREF(args);                              \
-    return result != 0 ? NULL : out_node;                \
+    return nmath_call(&nfunc_name, c, &a, 1);            \
 }
 
 
@@ -5,7 +5,10 @@
 #include "../node_core.h"
 #include "../tc_methods.h"
 #include "../free.h"
+#include "../nmem.h"
+#include "../nthread.h"
 #include "loops.h"
+#include "grad.h"
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
@@ -80,49 +83,519 @@ compute_out_shape(NFunc_ReduceArgs* rargs, Node* input, nr_intp* out_shape)
 }
 
 /* ============================================================================
- * Index Conversion Helpers
+ * Full Reduction Loop
  * ============================================================================ */
 
-NR_STATIC_INLINE void
-linear_to_coords(nr_intp linear, const nr_intp* shape, int ndim, nr_intp* coords)
+/*
+ * Runs the statements after VAR for every item of n1, bound to VAR.
+ * Contiguous input is read with one flat loop, strided input one
+ * NInnerIter row at a time in memory order. `continue` moves to the next
+ * item; `break` only leaves the current row of a strided input.
+ */
+#define REDUCE_FULL_LOOP(I_NT, VAR, ...) do { \
+    if (in_contig) { \
+        for (nr_intp i__ = 0; i__ < n_in; i__++) { \
+            I_NT VAR = in_data[i__]; \
+            __VA_ARGS__ \
+        } \
+    } else { \
+        NInnerIter iit__; \
+        if (NInnerIter_FromNodes(&iit__, &n1, 1, NITER_ORDER_K) != 0) return -1; \
+        NInnerIter_ITER(&iit__); \
+        while (NInnerIter_NOTDONE(&iit__)) { \
+            char* p__ = NInnerIter_PTRS(&iit__)[0]; \
+            nr_intp s__ = NInnerIter_STRIDES(&iit__)[0]; \
+            nr_intp cnt__ = NInnerIter_COUNT(&iit__); \
+            for (nr_intp k__ = 0; k__ < cnt__; k__++, p__ += s__) { \
+                I_NT VAR = *(I_NT*)p__; \
+                __VA_ARGS__ \
+            } \
+            NInnerIter_NEXT(&iit__); \
+        } \
+    } \
+} while (0)
+
+/* ============================================================================
+ * Axis Reduction Engine
+ * ============================================================================ */
+
+/*
+ * Axis reductions walk the input together with the output broadcast back
+ * onto the input shape: the output keeps its strides on the kept axes and
+ * gets stride 0 on the reduced ones. NInnerIter coalesces and orders the
+ * axes, so every row it hands out is one of
+ *  - row-wise: the row runs along reduced axes (output stride 0). It is
+ *    folded into one accumulator and stored once.
+ *  - column-wise: the row runs along kept axes. Each input item updates its
+ *    own output item; when both sides are contiguous this is a plain
+ *    out[k] = op(out[k], in[k]) loop.
+ * Which one a reduction gets follows from its axes and the input strides:
+ * `NMath_Sum(x, axis=0)` on a C-contiguous matrix is column-wise, axis=1
+ * row-wise, and neither needs per-item index arithmetic.
+ */
+
+NR_PRIVATE void
+reduce_axes_mask(NFunc_ReduceArgs* rargs, int ndim, int* is_reduced)
 {
-    for (int d = ndim - 1; d >= 0; d--) {
-        coords[d] = linear % shape[d];
-        linear /= shape[d];
+    for (int i = 0; i < ndim; i++) is_reduced[i] = 0;
+    for (int i = 0; i < rargs->n_axis; i++) {
+        int ax = rargs->axis[i];
+        is_reduced[ax < 0 ? ax + ndim : ax] = 1;
     }
 }
 
-NR_STATIC_INLINE nr_intp
-coords_to_offset(const nr_intp* coords, const nr_intp* strides, int ndim)
+/*
+ * Sets up `iit` over n1 and the C-contiguous output buffer `out_data`.
+ * With `first_only` the reduced axes are clamped to their first item, so
+ * every output item is visited exactly once; n1 must not be empty then.
+ */
+NR_PRIVATE int
+reduce_iter_new(NInnerIter* iit, Node* n1, const int* is_reduced,
+                void* out_data, nr_intp out_itemsize, int first_only, int order)
 {
-    nr_intp offset = 0;
-    for (int d = 0; d < ndim; d++) {
-        offset += coords[d] * strides[d];
+    int nd = n1->ndim;
+    nr_intp shape[NR_NODE_MAX_NDIM];
+    nr_intp out_strides[NR_NODE_MAX_NDIM];
+    nr_intp step = out_itemsize;
+
+    for (int d = nd - 1; d >= 0; d--) {
+        shape[d] = (first_only && is_reduced[d]) ? 1 : n1->shape[d];
+        if (is_reduced[d]) {
+            out_strides[d] = 0;
+        } else {
+            out_strides[d] = step;
+            step *= n1->shape[d];
+        }
     }
-    return offset;
+
+    void* data[2] = {NODE_DATA(n1), out_data};
+    int ndims[2] = {nd, nd};
+    nr_intp* shapes[2] = {shape, shape};
+    nr_intp* strides[2] = {n1->strides, out_strides};
+    nr_intp itemsizes[2] = {NODE_ITEMSIZE(n1), out_itemsize};
+    return NInnerIter_New(iit, data, 2, ndims, shapes, strides, itemsizes, order);
 }
 
-NR_STATIC_INLINE nr_intp
-coords_to_out_idx(const nr_intp* coords, const nr_intp* out_shape, 
-                  const int* is_reduced, int in_ndim, int out_ndim)
+/*
+ * Runs the statements after VAR for every item visited by IIT (set up by
+ * reduce_iter_new), with VAR bound to the input item, `acc` to its output
+ * item (an O_NT lvalue) and `oi` to the output index, for kernels that keep
+ * per-output scratch arrays. The statements must not `continue` or
+ * `break`: the column-wise loops store `acc` back after them.
+ */
+#define REDUCE_AXIS_LOOP(IIT, I_NT, O_NT, VAR, ...) do { \
+    NInnerIter_ITER(IIT); \
+    while (NInnerIter_NOTDONE(IIT)) { \
+        char* pin__ = NInnerIter_PTRS(IIT)[0]; \
+        nr_intp sin__ = NInnerIter_STRIDES(IIT)[0]; \
+        nr_intp oi0__ = (nr_intp)(NInnerIter_PTRS(IIT)[1] - (char*)out_data) / (nr_intp)sizeof(O_NT); \
+        nr_intp ostep__ = NInnerIter_STRIDES(IIT)[1] / (nr_intp)sizeof(O_NT); \
+        nr_intp cnt__ = NInnerIter_COUNT(IIT); \
+        if (ostep__ == 0) { \
+            const nr_intp oi = oi0__; (void)oi; \
+            O_NT acc = out_data[oi0__]; \
+            for (nr_intp k__ = 0; k__ < cnt__; k__++, pin__ += sin__) { \
+                I_NT VAR = *(I_NT*)pin__; \
+                __VA_ARGS__ \
+            } \
+            out_data[oi0__] = acc; \
+        } else if (sin__ == (nr_intp)sizeof(I_NT) && ostep__ == 1) { \
+            const I_NT* in__ = (const I_NT*)pin__; \
+            O_NT* o__ = out_data + oi0__; \
+            for (nr_intp k__ = 0; k__ < cnt__; k__++) { \
+                const nr_intp oi = oi0__ + k__; (void)oi; \
+                I_NT VAR = in__[k__]; \
+                O_NT acc = o__[k__]; \
+                __VA_ARGS__ \
+                o__[k__] = acc; \
+            } \
+        } else { \
+            for (nr_intp k__ = 0; k__ < cnt__; k__++, pin__ += sin__) { \
+                const nr_intp oi = oi0__ + k__ * ostep__; (void)oi; \
+                I_NT VAR = *(I_NT*)pin__; \
+                O_NT acc = out_data[oi]; \
+                __VA_ARGS__ \
+                out_data[oi] = acc; \
+            } \
+        } \
+        NInnerIter_NEXT(IIT); \
+    } \
+} while (0)
+
+/* ============================================================================
+ * Float Summation
+ * ============================================================================ */
+
+NR_PRIVATE NMath_SumMode reduce_sum_mode = NMATH_SUM_PAIRWISE;
+
+NR_PUBLIC NMath_SumMode
+NMath_SetSumMode(NMath_SumMode mode)
 {
-    nr_intp out_idx = 0, mult = 1;
-    for (int d = in_ndim - 1, o = out_ndim - 1; d >= 0; d--) {
-        if (!is_reduced[d]) {
-            out_idx += coords[d] * mult;
-            mult *= out_shape[o--];
-        }
+    NMath_SumMode prev = reduce_sum_mode;
+    reduce_sum_mode = mode;
+    return prev;
+}
+
+NR_PUBLIC NMath_SumMode
+NMath_GetSumMode(void)
+{
+    return reduce_sum_mode;
+}
+
+#define SUM_PAIRWISE_BLOCK 128
+
+/*
+ * Defines sum_row_<I_NT><SUFFIX>, which adds a strided row of `n` items to
+ * (*sum, *comp) with the current summation mode and returns the number of
+ * items added. With SKIP_NAN, NaN items count as 0 and are not counted.
+ * `comp` is only touched in KAHAN mode.
+ */
+#define DEFINE_SUM_ROW(I_NT, SUFFIX, SKIP_NAN, ISNAN_CHECK) \
+NR_PRIVATE nr_float64 sum_pairwise_##I_NT##SUFFIX(const char* p, nr_intp n, nr_intp s) { \
+    nr_float64 res = 0.; \
+    if (n < 8) { \
+        for (nr_intp i = 0; i < n; i++) res += SUM_LOAD(I_NT, p + i*s, SKIP_NAN, ISNAN_CHECK); \
+        return res; \
+    } \
+    if (n <= SUM_PAIRWISE_BLOCK) { \
+        /* 8 accumulators break the add dependency chain and vectorize */ \
+        nr_float64 r[8]; \
+        for (int j = 0; j < 8; j++) r[j] = SUM_LOAD(I_NT, p + j*s, SKIP_NAN, ISNAN_CHECK); \
+        nr_intp i; \
+        for (i = 8; i < n - (n % 8); i += 8) { \
+            for (int j = 0; j < 8; j++) r[j] += SUM_LOAD(I_NT, p + (i + j)*s, SKIP_NAN, ISNAN_CHECK); \
+        } \
+        res = ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7])); \
+        for (; i < n; i++) res += SUM_LOAD(I_NT, p + i*s, SKIP_NAN, ISNAN_CHECK); \
+        return res; \
+    } \
+    nr_intp n2 = n / 2; \
+    n2 -= n2 % 8; \
+    return sum_pairwise_##I_NT##SUFFIX(p, n2, s) + sum_pairwise_##I_NT##SUFFIX(p + n2*s, n - n2, s); \
+} \
+NR_PRIVATE nr_intp sum_row_##I_NT##SUFFIX(const char* p, nr_intp n, nr_intp s, \
+                                          nr_float64* sum, nr_float64* comp) { \
+    if (reduce_sum_mode == NMATH_SUM_PAIRWISE) { \
+        *sum += sum_pairwise_##I_NT##SUFFIX(p, n, s); \
+    } else if (reduce_sum_mode == NMATH_SUM_KAHAN) { \
+        nr_float64 t = *sum, c = *comp; \
+        for (nr_intp i = 0; i < n; i++) NMATH_KAHAN_ADD(nr_float64, t, c, SUM_LOAD(I_NT, p + i*s, SKIP_NAN, ISNAN_CHECK)); \
+        *sum = t; *comp = c; \
+    } else { \
+        nr_float64 t = *sum; \
+        for (nr_intp i = 0; i < n; i++) t += SUM_LOAD(I_NT, p + i*s, SKIP_NAN, ISNAN_CHECK); \
+        *sum = t; \
+    } \
+    if (!(SKIP_NAN)) return n; \
+    nr_intp cnt = 0; \
+    for (nr_intp i = 0; i < n; i++) cnt += !ISNAN_CHECK(*(const I_NT*)(p + i*s)); \
+    return cnt; \
+}
+
+#define SUM_LOAD(I_NT, ptr, SKIP_NAN, ISNAN_CHECK) \
+    ((SKIP_NAN) && ISNAN_CHECK(*(const I_NT*)(ptr)) ? 0. : (nr_float64)*(const I_NT*)(ptr))
+
+DEFINE_SUM_ROW(nr_bool,    , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_int8,    , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_int16,   , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_int32,   , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_int64,   , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_uint8,   , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_uint16,  , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_uint32,  , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_uint64,  , 0, ISNAN_INT)
+DEFINE_SUM_ROW(nr_float32, , 0, ISNAN_F32)
+DEFINE_SUM_ROW(nr_float64, , 0, ISNAN_F64)
+DEFINE_SUM_ROW(nr_float32, _nan, 1, ISNAN_F32)
+DEFINE_SUM_ROW(nr_float64, _nan, 1, ISNAN_F64)
+
+/* ============================================================================
+ * Variance State (Welford / Chan)
+ * ============================================================================ */
+
+NR_STATIC_INLINE void
+var_state_merge(NMath_VarState* a, nr_intp nb, nr_float64 mean_b, nr_float64 m2_b)
+{
+    if (nb == 0) return;
+    if (a->count == 0) {
+        a->count = nb; a->mean = mean_b; a->m2 = m2_b;
+        return;
+    }
+    nr_intp n = a->count + nb;
+    nr_float64 delta = mean_b - a->mean;
+    a->mean += delta * ((nr_float64)nb / (nr_float64)n);
+    a->m2 += m2_b + delta * delta * ((nr_float64)a->count * (nr_float64)nb / (nr_float64)n);
+    a->count = n;
+}
+
+NR_PUBLIC void
+NMath_VarStateMerge(NMath_VarState* dst, const NMath_VarState* src)
+{
+    var_state_merge(dst, src->count, src->mean, src->m2);
+}
+
+NR_PUBLIC nr_float64
+NMath_VarStateGet(const NMath_VarState* st, int ddof)
+{
+    nr_intp dof = st->count - ddof;
+    return dof <= 0 ? NAN : st->m2 / (nr_float64)dof;
+}
+
+/* Items per block of var_row_*, small enough to stay in L1 for the second pass */
+#define VAR_BLOCK 1024
+
+#define VAR_DEV(I_NT, ptr, mean, SKIP_NAN, ISNAN_CHECK) \
+    ((SKIP_NAN) && ISNAN_CHECK(*(const I_NT*)(ptr)) ? 0. : (nr_float64)*(const I_NT*)(ptr) - (mean))
+
+/*
+ * Defines var_row_<I_NT><SUFFIX>, which merges a strided row of `n` items
+ * into `st`. The row is cut in blocks of VAR_BLOCK items; each block gets
+ * an exact two-pass mean and M2 while it is in cache and is merged with
+ * Chan's formula, so memory is read once.
+ */
+#define DEFINE_VAR_ROW(I_NT, SUFFIX, SKIP_NAN, ISNAN_CHECK) \
+NR_PRIVATE void var_row_##I_NT##SUFFIX(const char* p, nr_intp n, nr_intp s, NMath_VarState* st) { \
+    for (nr_intp b = 0; b < n; b += VAR_BLOCK) { \
+        nr_intp m = n - b < VAR_BLOCK ? n - b : VAR_BLOCK; \
+        const char* q = p + b * s; \
+        nr_intp cnt = m; \
+        if (SKIP_NAN) { \
+            cnt = 0; \
+            for (nr_intp i = 0; i < m; i++) cnt += !ISNAN_CHECK(*(const I_NT*)(q + i*s)); \
+            if (cnt == 0) continue; \
+        } \
+        nr_float64 mean = sum_pairwise_##I_NT##SUFFIX(q, m, s) / (nr_float64)cnt; \
+        nr_float64 r[8] = {0., 0., 0., 0., 0., 0., 0., 0.}; \
+        nr_intp i = 0; \
+        for (; i + 8 <= m; i += 8) { \
+            for (int j = 0; j < 8; j++) { \
+                nr_float64 d = VAR_DEV(I_NT, q + (i + j)*s, mean, SKIP_NAN, ISNAN_CHECK); \
+                r[j] += d * d; \
+            } \
+        } \
+        nr_float64 m2 = ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7])); \
+        for (; i < m; i++) { \
+            nr_float64 d = VAR_DEV(I_NT, q + i*s, mean, SKIP_NAN, ISNAN_CHECK); \
+            m2 += d * d; \
+        } \
+        var_state_merge(st, cnt, mean, m2); \
+    } \
+}
+
+DEFINE_VAR_ROW(nr_bool,    , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_int8,    , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_int16,   , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_int32,   , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_int64,   , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_uint8,   , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_uint16,  , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_uint32,  , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_uint64,  , 0, ISNAN_INT)
+DEFINE_VAR_ROW(nr_float32, , 0, ISNAN_F32)
+DEFINE_VAR_ROW(nr_float64, , 0, ISNAN_F64)
+DEFINE_VAR_ROW(nr_float32, _nan, 1, ISNAN_F32)
+DEFINE_VAR_ROW(nr_float64, _nan, 1, ISNAN_F64)
+
+/*
+ * Sets up `rit` over the reduced axes of n1 only (kept axes clamped to
+ * one item). Rebase it with NInnerIter_RESET_DATA to walk the items that
+ * reduce into one output.
+ */
+NR_PRIVATE int
+reduce_slab_iter_new(NInnerIter* rit, Node* n1, const int* is_reduced)
+{
+    nr_intp shape[NR_NODE_MAX_NDIM];
+    for (int d = 0; d < n1->ndim; d++) {
+        shape[d] = is_reduced[d] ? n1->shape[d] : 1;
     }
-    return out_idx;
+    void* data[1] = {NODE_DATA(n1)};
+    int ndims[1] = {n1->ndim};
+    nr_intp* shapes[1] = {shape};
+    nr_intp* strides[1] = {n1->strides};
+    nr_intp itemsizes[1] = {NODE_ITEMSIZE(n1)};
+    return NInnerIter_New(rit, data, 1, ndims, shapes, strides, itemsizes, NITER_ORDER_K);
 }
 
+/* Outputs updated together when the kept axis is the closer one in memory */
+#define VAR_LANES 1024
+
+/* Reduced items per lane block, so a block of all lanes stays in L1 */
+#define VAR_LANE_BLOCK 32
+
+#define VAR_LANES_BLOCK(I_NT, KS, SKIP_NAN, ISNAN_CHECK) do { \
+    for (nr_intp r = 0; r < nb; r++) { \
+        const char* row = q + r * rs; \
+        for (nr_intp j = 0; j < nl; j++) { \
+            bsum[j] += SUM_LOAD(I_NT, row + j * (KS), SKIP_NAN, ISNAN_CHECK); \
+            if (SKIP_NAN) bcnt[j] += !ISNAN_CHECK(*(const I_NT*)(row + j * (KS))); \
+        } \
+    } \
+    for (nr_intp j = 0; j < nl; j++) bsum[j] = bcnt[j] ? bsum[j] / (nr_float64)bcnt[j] : 0.; \
+    for (nr_intp r = 0; r < nb; r++) { \
+        const char* row = q + r * rs; \
+        for (nr_intp j = 0; j < nl; j++) { \
+            nr_float64 d = VAR_DEV(I_NT, row + j * (KS), bsum[j], SKIP_NAN, ISNAN_CHECK); \
+            bm2[j] += d * d; \
+        } \
+    } \
+} while (0)
+
+/*
+ * Defines var_lanes_<I_NT><SUFFIX>, which merges a strided row of `n`
+ * reduced positions into the states of `nl` neighbouring outputs, `ks`
+ * bytes apart. Blocks of VAR_LANE_BLOCK positions get a two-pass mean and
+ * M2 per output and are merged like in var_row_*.
+ */
+#define DEFINE_VAR_LANES(I_NT, SUFFIX, SKIP_NAN, ISNAN_CHECK) \
+NR_PRIVATE void var_lanes_##I_NT##SUFFIX(const char* p, nr_intp n, nr_intp rs, \
+                                         nr_intp nl, nr_intp ks, NMath_VarState* lst) { \
+    nr_float64 bsum[VAR_LANES], bm2[VAR_LANES]; \
+    nr_intp bcnt[VAR_LANES]; \
+    for (nr_intp r0 = 0; r0 < n; r0 += VAR_LANE_BLOCK) { \
+        nr_intp nb = n - r0 < VAR_LANE_BLOCK ? n - r0 : VAR_LANE_BLOCK; \
+        const char* q = p + r0 * rs; \
+        for (nr_intp j = 0; j < nl; j++) { bsum[j] = 0.; bm2[j] = 0.; bcnt[j] = (SKIP_NAN) ? 0 : nb; } \
+        if (ks == (nr_intp)sizeof(I_NT)) { \
+            VAR_LANES_BLOCK(I_NT, (nr_intp)sizeof(I_NT), SKIP_NAN, ISNAN_CHECK); \
+        } else { \
+            VAR_LANES_BLOCK(I_NT, ks, SKIP_NAN, ISNAN_CHECK); \
+        } \
+        for (nr_intp j = 0; j < nl; j++) var_state_merge(&lst[j], bcnt[j], bsum[j], bm2[j]); \
+    } \
+}
+
+DEFINE_VAR_LANES(nr_bool,    , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_int8,    , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_int16,   , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_int32,   , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_int64,   , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_uint8,   , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_uint16,  , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_uint32,  , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_uint64,  , 0, ISNAN_INT)
+DEFINE_VAR_LANES(nr_float32, , 0, ISNAN_F32)
+DEFINE_VAR_LANES(nr_float64, , 0, ISNAN_F64)
+DEFINE_VAR_LANES(nr_float32, _nan, 1, ISNAN_F32)
+DEFINE_VAR_LANES(nr_float64, _nan, 1, ISNAN_F64)
+
 /* ============================================================================
- * Input Value Reader (handles contiguous vs strided)
+ * Parallel Full Reductions
  * ============================================================================ */
 
-#define READ_INPUT(I_NT, in_data, lin, coords, n1, in_contig) \
-    (in_contig ? ((I_NT*)in_data)[lin] : \
-     *(I_NT*)((char*)in_data + coords_to_offset(coords, n1->strides, n1->ndim)))
+/*
+ * Contiguous full reductions of at least two REDUCE_PAR_BLOCK items are
+ * cut into fixed blocks. Each block is reduced on its own over the thread
+ * pool and the partial results are combined in block order. The blocks
+ * only depend on the input size, so the result is the same for any number
+ * of threads.
+ */
+#define REDUCE_PAR_BLOCK 65536
+#define REDUCE_PAR_MAX_BLOCKS 1024
+
+NR_STATIC_INLINE nr_intp
+reduce_par_block(nr_intp n)
+{
+    nr_intp block = (n + REDUCE_PAR_MAX_BLOCKS - 1) / REDUCE_PAR_MAX_BLOCKS;
+    return block < REDUCE_PAR_BLOCK ? REDUCE_PAR_BLOCK : block;
+}
+
+typedef nr_intp (*reduce_sum_row_func)(const char*, nr_intp, nr_intp, nr_float64*, nr_float64*);
+typedef void (*reduce_var_row_func)(const char*, nr_intp, nr_intp, NMath_VarState*);
+
+typedef struct{
+    const char* data;
+    nr_intp itemsize;
+    nr_intp n;
+    nr_intp block;
+    void* part;                 // one result per block
+    reduce_sum_row_func sum_row;
+    reduce_var_row_func var_row;
+    nr_float64* comp;           // sum_row only
+    nr_intp* count;             // sum_row only
+}reduce_par_ctx;
+
+NR_PRIVATE void
+reduce_par_sum_range(void* ctx, nr_intp start, nr_intp end)
+{
+    reduce_par_ctx* c = (reduce_par_ctx*)ctx;
+    for (nr_intp s = start; s < end; s += c->block) {
+        nr_intp b = s / c->block;
+        nr_intp cnt = end - s < c->block ? end - s : c->block;
+        nr_float64* sum = (nr_float64*)c->part + b;
+        *sum = 0.;
+        c->comp[b] = 0.;
+        c->count[b] = c->sum_row(c->data + s * c->itemsize, cnt, c->itemsize, sum, c->comp + b);
+    }
+}
+
+/* Sums n contiguous items with ROW, adding into (*sum, *comp); returns the count. */
+NR_PRIVATE nr_intp
+reduce_par_sum(reduce_sum_row_func row, const char* data, nr_intp n, nr_intp itemsize,
+               nr_float64* sum, nr_float64* comp)
+{
+    nr_float64 psum[REDUCE_PAR_MAX_BLOCKS], pcomp[REDUCE_PAR_MAX_BLOCKS];
+    nr_intp pcount[REDUCE_PAR_MAX_BLOCKS];
+    reduce_par_ctx c = {data, itemsize, n, reduce_par_block(n), psum, row, NULL, pcomp, pcount};
+    NThread_ParallelFor(n, c.block, reduce_par_sum_range, &c);
+
+    nr_intp nb = (n + c.block - 1) / c.block;
+    nr_intp count = 0;
+    sum_row_nr_float64((const char*)psum, nb, sizeof(nr_float64), sum, comp);
+    for (nr_intp b = 0; b < nb; b++) {
+        *comp += pcomp[b];
+        count += pcount[b];
+    }
+    return count;
+}
+
+NR_PRIVATE void
+reduce_par_var_range(void* ctx, nr_intp start, nr_intp end)
+{
+    reduce_par_ctx* c = (reduce_par_ctx*)ctx;
+    for (nr_intp s = start; s < end; s += c->block) {
+        NMath_VarState* st = (NMath_VarState*)c->part + s / c->block;
+        nr_intp cnt = end - s < c->block ? end - s : c->block;
+        st->count = 0; st->mean = 0.; st->m2 = 0.;
+        c->var_row(c->data + s * c->itemsize, cnt, c->itemsize, st);
+    }
+}
+
+/* Merges the (count, mean, M2) of n contiguous items into st with ROW. */
+NR_PRIVATE void
+reduce_par_var(reduce_var_row_func row, const char* data, nr_intp n, nr_intp itemsize,
+               NMath_VarState* st)
+{
+    NMath_VarState part[REDUCE_PAR_MAX_BLOCKS];
+    reduce_par_ctx c = {data, itemsize, n, reduce_par_block(n), part, NULL, row, NULL, NULL};
+    NThread_ParallelFor(n, c.block, reduce_par_var_range, &c);
+
+    nr_intp nb = (n + c.block - 1) / c.block;
+    for (nr_intp b = 0; b < nb; b++) {
+        var_state_merge(st, part[b].count, part[b].mean, part[b].m2);
+    }
+}
+
+/*
+ * Defines OP_NAME_blocks_<I_NT>, the block body of DEFINE_REDUCE_KERNEL.
+ * With NEEDS_FIRST the serial loop only lets a NaN through when it is the
+ * very first item, so later blocks seed with their first non-NaN item.
+ */
+#define DEFINE_REDUCE_BLOCKS(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST) \
+NR_PRIVATE void OP_NAME##_blocks_##I_NT(void* ctx, nr_intp start, nr_intp end) { \
+    reduce_par_ctx* c = (reduce_par_ctx*)ctx; \
+    const I_NT* in = (const I_NT*)c->data; \
+    for (nr_intp s = start; s < end; s += c->block) { \
+        nr_intp e = end - s < c->block ? end : s + c->block; \
+        nr_intp i = s; \
+        O_NT acc = (O_NT)(INIT_VAL); \
+        if (NEEDS_FIRST) { \
+            acc = (O_NT)in[i++]; \
+            while (s > 0 && i < e && isnan((double)acc)) acc = (O_NT)in[i++]; \
+        } \
+        for (; i < e; i++) acc = OP_FUNC(acc, (O_NT)in[i]); \
+        ((O_NT*)c->part)[s / c->block] = acc; \
+    } \
+}
 
 /* ============================================================================
  * Output Node Setup (common to all reduce operations)
@@ -137,33 +610,45 @@ coords_to_out_idx(const nr_intp* coords, const nr_intp* out_shape,
     int out_ndim = compute_out_shape(rargs, n1, out_shape); \
     if (out_ndim < 0) return -1; \
     \
-    Node* out = NULL; \
-    if (!caller_out || NODE_DTYPE(caller_out) != PROM_O_DT) { \
-        out = Node_NewEmpty(out_ndim, out_shape, PROM_O_DT); \
-        if (!out) return -1; \
-    } else { \
-        out = caller_out; \
-        if (out->ndim != out_ndim) { \
+    if (caller_out && NODE_DTYPE(caller_out) == PROM_O_DT) { \
+        if (caller_out->ndim != out_ndim) { \
             NError_RaiseError(NError_ValueError, "output array has wrong ndim"); \
             return -1; \
         } \
         for (int i = 0; i < out_ndim; ++i) { \
-            if (out->shape[i] != out_shape[i]) { \
+            if (caller_out->shape[i] != out_shape[i]) { \
                 NError_RaiseError(NError_ValueError, "output array has wrong shape"); \
                 return -1; \
             } \
         } \
     } \
     \
+    /* the kernels write `out` as a flat buffer, a strided caller output gets a copy */ \
+    Node* out = caller_out; \
+    if (!caller_out || NODE_DTYPE(caller_out) != PROM_O_DT || !NODE_IS_CONTIGUOUS(caller_out)) { \
+        out = Node_NewEmpty(out_ndim, out_shape, PROM_O_DT); \
+        if (!out) return -1; \
+    } \
+    \
     O_NT* out_data = (O_NT*)NODE_DATA(out); \
     nr_intp n_in = Node_NItems(n1); \
     nr_intp n_out = Node_NItems(out); \
     int in_contig = NODE_IS_CONTIGUOUS(n1); \
     (void)n_out;
 
+/* Drops an output allocated by SETUP_REDUCE_OUTPUT and fails the kernel. */
+#define REDUCE_FAIL() do { \
+    if (out != caller_out) NODE_DECREF(out); \
+    return -1; \
+} while (0)
+
 #define FINALIZE_REDUCE_OUTPUT() \
     if (!caller_out) { \
         args->out_nodes[0] = out; \
+    } else if (out != caller_out && NODE_DTYPE(caller_out) == NODE_DTYPE(out)) { \
+        Node_Copy(caller_out, out); \
+        args->out_nodes[0] = caller_out; \
+        NODE_DECREF(out); \
     } else if (out != caller_out) { \
         /* Manual element-wise cast to avoid incorrect Node_ToType behavior for reductions */ \
         nr_intp n_el__ = Node_NItems(out); \
@@ -193,151 +678,212 @@ coords_to_out_idx(const nr_intp* coords, const nr_intp* out_shape,
  * BASIC REDUCE KERNEL (sum, prod, min, max)
  * ============================================================================ */
 
-/* Generic reduce kernel for sum/prod/min/max. For min/max NEEDS_FIRST selects first-element initialization. */
+/*
+ * Generic reduce kernel for sum/prod/min/max. For min/max NEEDS_FIRST selects first-element initialization.
+ * Large contiguous full reductions go through DEFINE_REDUCE_BLOCKS.
+ */
 #define DEFINE_REDUCE_KERNEL(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST, PROM_O_DT) \
+DEFINE_REDUCE_BLOCKS(OP_NAME, OP_FUNC, O_NT, I_NT, INIT_VAL, NEEDS_FIRST) \
 NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
     SETUP_REDUCE_OUTPUT(O_NT, PROM_O_DT) \
     I_NT* in_data = (I_NT*)NODE_DATA(n1); \
     if (!rargs || rargs->n_axis == 0 ) { \
         O_NT acc = (O_NT)(INIT_VAL); \
-        int first = (NEEDS_FIRST); \
-        if (in_contig) { \
-            for (nr_intp i = 0; i < n_in; i++) { \
-                O_NT val = (O_NT)in_data[i]; \
-                if (first) { acc = val; first = 0; } else { acc = OP_FUNC(acc, val); } \
-            } \
+        if (in_contig && n_in >= 2 * REDUCE_PAR_BLOCK) { \
+            O_NT part[REDUCE_PAR_MAX_BLOCKS]; \
+            reduce_par_ctx c = {(const char*)in_data, sizeof(I_NT), n_in, reduce_par_block(n_in), part, \
+                                NULL, NULL, NULL, NULL}; \
+            NThread_ParallelFor(n_in, c.block, OP_NAME##_blocks_##I_NT, &c); \
+            acc = part[0]; \
+            for (nr_intp b = 1; b * c.block < n_in; b++) acc = OP_FUNC(acc, part[b]); \
         } else { \
-            NIter it; NIter_FromNode(&it, n1, NITER_MODE_STRIDED); \
-            NIter_ITER(&it); \
-            while (NIter_NOTDONE(&it)) { \
-                O_NT val = (O_NT)(*(I_NT*)NIter_ITEM(&it)); \
+            int first = (NEEDS_FIRST); \
+            REDUCE_FULL_LOOP(I_NT, v, \
+                O_NT val = (O_NT)v; \
                 if (first) { acc = val; first = 0; } else { acc = OP_FUNC(acc, val); } \
-                NIter_NEXT(&it); \
-            } \
+            ); \
         } \
         out_data[0] = acc; \
     } else { \
-        int is_reduced[NR_NODE_MAX_NDIM] = {0}; \
-        for (int i = 0; i < rargs->n_axis; i++) { \
-            int ax = rargs->axis[i]; \
-            if (ax < 0) ax += n1->ndim; \
-            is_reduced[ax] = 1; \
-        } \
-        nr_bool* first_flag = NULL; \
-        if (NEEDS_FIRST) { \
-            first_flag = (nr_bool*)calloc(n_out, sizeof(nr_bool)); \
-            if (!first_flag) { NError_RaiseMemoryError(); return -1; } \
+        int is_reduced[NR_NODE_MAX_NDIM]; \
+        reduce_axes_mask(rargs, n1->ndim, is_reduced); \
+        NInnerIter iit; \
+        if (NEEDS_FIRST && n_in > 0) { \
+            /* seed with the first slice, min/max ignore seeing it twice */ \
+            if (reduce_iter_new(&iit, n1, is_reduced, out_data, sizeof(O_NT), 1, NITER_ORDER_K) != 0) REDUCE_FAIL(); \
+            REDUCE_AXIS_LOOP(&iit, I_NT, O_NT, v, acc = (O_NT)v;); \
         } else { \
             for (nr_intp i = 0; i < n_out; i++) out_data[i] = (O_NT)(INIT_VAL); \
         } \
-        nr_intp coords[NR_NODE_MAX_NDIM]; \
-        for (nr_intp lin = 0; lin < n_in; lin++) { \
-            linear_to_coords(lin, n1->shape, n1->ndim, coords); \
-            nr_intp oi = coords_to_out_idx(coords, out_shape, is_reduced, n1->ndim, out_ndim); \
-            I_NT vtmp = READ_INPUT(I_NT, in_data, lin, coords, n1, in_contig); \
-            O_NT val = (O_NT)vtmp; \
-            if (NEEDS_FIRST) { \
-                if (!first_flag[oi]) { out_data[oi] = val; first_flag[oi] = 1; } \
-                else { out_data[oi] = OP_FUNC(out_data[oi], val); } \
-            } else { \
-                out_data[oi] = OP_FUNC(out_data[oi], val); \
-            } \
-        } \
-        if (first_flag) free(first_flag); \
+        if (reduce_iter_new(&iit, n1, is_reduced, out_data, sizeof(O_NT), 0, NITER_ORDER_K) != 0) REDUCE_FAIL(); \
+        REDUCE_AXIS_LOOP(&iit, I_NT, O_NT, v, acc = OP_FUNC(acc, (O_NT)v);); \
     } \
     FINALIZE_REDUCE_OUTPUT() \
 }
 
-/* Mean reduction kernel (optionally ignore NaNs). */
-#define DEFINE_MEAN_KERNEL(OP_NAME, O_NT, I_NT, PROM_O_DT, IGNORE_NAN, ISNAN_CHECK) \
+/*
+ * Float sum / mean kernel (DO_MEAN selects mean, IGNORE_NAN the nan
+ * variants). Accumulates in float64 with the summation mode set by
+ * NMath_SetSumMode; ROW is the sum_row_* helper for I_NT.
+ */
+#define DEFINE_FSUM_KERNEL(OP_NAME, I_NT, ROW, IGNORE_NAN, ISNAN_CHECK, DO_MEAN) \
 NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
-    SETUP_REDUCE_OUTPUT(O_NT, PROM_O_DT) \
+    SETUP_REDUCE_OUTPUT(nr_float64, NR_FLOAT64) \
     I_NT* in_data = (I_NT*)NODE_DATA(n1); \
     if (!rargs || rargs->n_axis == 0) { \
-        long long count = 0; \
-        O_NT sum = 0; \
-        if (in_contig) { \
-            for (nr_intp i = 0; i < n_in; i++) { \
-                I_NT v = in_data[i]; \
-                if (IGNORE_NAN && ISNAN_CHECK(v)) continue; \
-                sum += (O_NT)v; count++; \
-            } \
+        nr_float64 sum = 0., comp = 0.; \
+        nr_intp count = 0; \
+        if (in_contig && n_in >= 2 * REDUCE_PAR_BLOCK) { \
+            count = reduce_par_sum(ROW, (const char*)in_data, n_in, sizeof(I_NT), &sum, &comp); \
+        } else if (in_contig) { \
+            count = ROW((const char*)in_data, n_in, sizeof(I_NT), &sum, &comp); \
         } else { \
-            NIter it; NIter_FromNode(&it, n1, NITER_MODE_STRIDED); \
-            NIter_ITER(&it); \
-            while (NIter_NOTDONE(&it)) { \
-                I_NT v = *(I_NT*)NIter_ITEM(&it); \
-                if (IGNORE_NAN && ISNAN_CHECK(v)) { NIter_NEXT(&it); continue; } \
-                sum += (O_NT)v; count++; \
-                NIter_NEXT(&it); \
+            NInnerIter iit; \
+            if (NInnerIter_FromNodes(&iit, &n1, 1, NITER_ORDER_K) != 0) REDUCE_FAIL(); \
+            NInnerIter_ITER(&iit); \
+            while (NInnerIter_NOTDONE(&iit)) { \
+                count += ROW(NInnerIter_PTRS(&iit)[0], NInnerIter_COUNT(&iit), \
+                             NInnerIter_STRIDES(&iit)[0], &sum, &comp); \
+                NInnerIter_NEXT(&iit); \
             } \
         } \
-        out_data[0] = count == 0 ? NAN : (sum / (O_NT)count); \
+        sum += comp; \
+        out_data[0] = !(DO_MEAN) ? sum : (count == 0 ? NAN : sum / (nr_float64)count); \
     } else { \
-        int is_reduced[NR_NODE_MAX_NDIM] = {0}; \
-        for (int i = 0; i < rargs->n_axis; i++) { int ax = rargs->axis[i]; if (ax < 0) ax += n1->ndim; is_reduced[ax] = 1; } \
-        O_NT* sums = out_data; \
-        for (nr_intp i = 0; i < n_out; i++) sums[i] = 0; \
-        long long* counts = (long long*)calloc(n_out, sizeof(long long)); \
-        if (!counts) { NError_RaiseMemoryError(); return -1; } \
-        nr_intp coords[NR_NODE_MAX_NDIM]; \
-        for (nr_intp lin = 0; lin < n_in; lin++) { \
-            linear_to_coords(lin, n1->shape, n1->ndim, coords); \
-            I_NT vtmp = READ_INPUT(I_NT, in_data, lin, coords, n1, in_contig); \
-            if (IGNORE_NAN && ISNAN_CHECK(vtmp)) continue; \
-            O_NT v = (O_NT)vtmp; \
-            nr_intp oi = coords_to_out_idx(coords, out_shape, is_reduced, n1->ndim, out_ndim); \
-            sums[oi] += v; counts[oi]++; \
+        int is_reduced[NR_NODE_MAX_NDIM]; \
+        reduce_axes_mask(rargs, n1->ndim, is_reduced); \
+        for (nr_intp i = 0; i < n_out; i++) out_data[i] = 0; \
+        nr_float64* comp = NULL; \
+        nr_intp* counts = NULL; \
+        if (reduce_sum_mode == NMATH_SUM_KAHAN) { \
+            comp = (nr_float64*)NMem_Calloc(n_out * sizeof(nr_float64)); \
+            if (!comp) { REDUCE_FAIL(); } \
+        } \
+        /* without NaNs every output item sees the same number of inputs */ \
+        if ((DO_MEAN) && (IGNORE_NAN)) { \
+            counts = (nr_intp*)NMem_Calloc(n_out * sizeof(nr_intp)); \
+            if (!counts) { NMem_Free(comp, n_out * sizeof(nr_float64)); REDUCE_FAIL(); } \
         } \
-        for (nr_intp i = 0; i < n_out; i++) { out_data[i] = counts[i] == 0 ? NAN : (sums[i] / (O_NT)counts[i]); } \
-        free(counts); \
+        NInnerIter iit; \
+        if (reduce_iter_new(&iit, n1, is_reduced, out_data, sizeof(nr_float64), 0, NITER_ORDER_K) != 0) { \
+            NMem_Free(comp, n_out * sizeof(nr_float64)); NMem_Free(counts, n_out * sizeof(nr_intp)); REDUCE_FAIL(); \
+        } \
+        nr_float64 comp_unused = 0.; \
+        NInnerIter_ITER(&iit); \
+        while (NInnerIter_NOTDONE(&iit)) { \
+            char* pin = NInnerIter_PTRS(&iit)[0]; \
+            nr_intp sin = NInnerIter_STRIDES(&iit)[0]; \
+            nr_intp oi = (nr_intp)(NInnerIter_PTRS(&iit)[1] - (char*)out_data) / (nr_intp)sizeof(nr_float64); \
+            nr_intp ostep = NInnerIter_STRIDES(&iit)[1] / (nr_intp)sizeof(nr_float64); \
+            nr_intp cnt = NInnerIter_COUNT(&iit); \
+            if (ostep == 0) { \
+                /* reduced axis innermost: the row is one sum */ \
+                nr_intp c = ROW(pin, cnt, sin, out_data + oi, comp ? comp + oi : &comp_unused); \
+                if (counts) counts[oi] += c; \
+            } else if (!(IGNORE_NAN) && sin == (nr_intp)sizeof(I_NT) && ostep == 1) { \
+                /* kept axis innermost: the row is added item by item into the output row */ \
+                const I_NT* a = (const I_NT*)pin; \
+                nr_float64* o = out_data + oi; \
+                if (comp) { \
+                    nr_float64* c = comp + oi; \
+                    for (nr_intp k = 0; k < cnt; k++) NMATH_KAHAN_ADD(nr_float64, o[k], c[k], a[k]); \
+                } else { \
+                    for (nr_intp k = 0; k < cnt; k++) o[k] += (nr_float64)a[k]; \
+                } \
+            } else { \
+                for (nr_intp k = 0; k < cnt; k++, pin += sin, oi += ostep) { \
+                    I_NT x = *(I_NT*)pin; \
+                    if (IGNORE_NAN && ISNAN_CHECK(x)) continue; \
+                    if (comp) NMATH_KAHAN_ADD(nr_float64, out_data[oi], comp[oi], x); \
+                    else out_data[oi] += (nr_float64)x; \
+                    if (counts) counts[oi]++; \
+                } \
+            } \
+            NInnerIter_NEXT(&iit); \
+        } \
+        for (nr_intp i = 0; i < n_out; i++) { \
+            nr_float64 sum = out_data[i] + (comp ? comp[i] : 0.); \
+            nr_intp c = counts ? counts[i] : n_in / n_out; \
+            out_data[i] = !(DO_MEAN) ? sum : (c == 0 ? NAN : sum / (nr_float64)c); \
+        } \
+        NMem_Free(comp, n_out * sizeof(nr_float64)); NMem_Free(counts, n_out * sizeof(nr_intp)); \
     } \
     FINALIZE_REDUCE_OUTPUT() \
 }
 
-/* Variance / Std kernel (DO_SQRT selects std). */
-#define DEFINE_VAR_KERNEL(OP_NAME, O_NT, I_NT, PROM_O_DT, IGNORE_NAN, ISNAN_CHECK, DO_SQRT) \
+/*
+ * Variance / Std kernel (DO_SQRT selects std), dividing by N - ddof. ROW and
+ * LANES are the var_row_* / var_lanes_* helpers for I_NT.
+ *
+ * Axis reductions walk the outputs along the first-slice view of n1 and,
+ * for each, the items that reduce into it (reduce_slab_iter_new), so the
+ * (count, mean, M2) state lives in registers and no scratch arrays are
+ * needed. When the kept axis is closer in memory than the reduced one
+ * (e.g. axis=0 of a C-contiguous matrix), up to VAR_LANES neighbouring
+ * outputs are updated together by LANES, reading the input row by row
+ * instead of column by column.
+ */
+#define DEFINE_VAR_KERNEL(OP_NAME, I_NT, ROW, LANES, DO_SQRT) \
 NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
-    SETUP_REDUCE_OUTPUT(O_NT, PROM_O_DT) \
+    SETUP_REDUCE_OUTPUT(nr_float64, NR_FLOAT64) \
     I_NT* in_data = (I_NT*)NODE_DATA(n1); \
+    int ddof = rargs ? rargs->ddof : 0; \
     if (!rargs || rargs->n_axis == 0) { \
-        long long count = 0; \
-        O_NT sum = 0, sumsq = 0; \
-        for (nr_intp i = 0; i < n_in; i++) { \
-            I_NT v = in_data[i]; \
-            if (IGNORE_NAN && ISNAN_CHECK(v)) continue; \
-            O_NT fv = (O_NT)v; \
-            sum += fv; sumsq += fv*fv; count++; \
-        } \
-        if (count == 0) { out_data[0] = NAN; } else { \
-            O_NT mean = sum / (O_NT)count; \
-            O_NT var = (sumsq / (O_NT)count) - mean*mean; \
-            out_data[0] = DO_SQRT ? (O_NT)sqrt(var) : var; \
+        NMath_VarState st = {0, 0., 0.}; \
+        if (in_contig && n_in >= 2 * REDUCE_PAR_BLOCK) { \
+            reduce_par_var(ROW, (const char*)in_data, n_in, sizeof(I_NT), &st); \
+        } else if (in_contig) { \
+            ROW((const char*)in_data, n_in, sizeof(I_NT), &st); \
+        } else { \
+            NInnerIter iit; \
+            if (NInnerIter_FromNodes(&iit, &n1, 1, NITER_ORDER_K) != 0) REDUCE_FAIL(); \
+            NInnerIter_ITER(&iit); \
+            while (NInnerIter_NOTDONE(&iit)) { \
+                ROW(NInnerIter_PTRS(&iit)[0], NInnerIter_COUNT(&iit), NInnerIter_STRIDES(&iit)[0], &st); \
+                NInnerIter_NEXT(&iit); \
+            } \
         } \
+        nr_float64 var = NMath_VarStateGet(&st, ddof); \
+        out_data[0] = DO_SQRT ? sqrt(var) : var; \
+    } else if (n_in == 0) { \
+        for (nr_intp i = 0; i < n_out; i++) out_data[i] = NAN; \
     } else { \
-        int is_reduced[NR_NODE_MAX_NDIM] = {0}; \
-        for (int i = 0; i < rargs->n_axis; i++) { int ax = rargs->axis[i]; if (ax < 0) ax += n1->ndim; is_reduced[ax] = 1; } \
-        O_NT* sums = (O_NT*)calloc(n_out, sizeof(O_NT)); \
-        O_NT* sumsq = (O_NT*)calloc(n_out, sizeof(O_NT)); \
-        long long* counts = (long long*)calloc(n_out, sizeof(long long)); \
-        if (!sums || !sumsq || !counts) { NError_RaiseMemoryError(); free(sums); free(sumsq); free(counts); return -1; } \
-        nr_intp coords[NR_NODE_MAX_NDIM]; \
-        for (nr_intp lin = 0; lin < n_in; lin++) { \
-            linear_to_coords(lin, n1->shape, n1->ndim, coords); \
-            I_NT vtmp = READ_INPUT(I_NT, in_data, lin, coords, n1, in_contig); \
-            if (IGNORE_NAN && ISNAN_CHECK(vtmp)) continue; \
-            O_NT v = (O_NT)vtmp; \
-            nr_intp oi = coords_to_out_idx(coords, out_shape, is_reduced, n1->ndim, out_ndim); \
-            sums[oi] += v; sumsq[oi] += v*v; counts[oi]++; \
-        } \
-        for (nr_intp i = 0; i < n_out; i++) { \
-            if (counts[i] == 0) { out_data[i] = NAN; } else { \
-                O_NT mean = sums[i] / (O_NT)counts[i]; \
-                O_NT var = (sumsq[i] / (O_NT)counts[i]) - mean*mean; \
-                out_data[i] = DO_SQRT ? (O_NT)sqrt(var) : var; \
+        int is_reduced[NR_NODE_MAX_NDIM]; \
+        reduce_axes_mask(rargs, n1->ndim, is_reduced); \
+        NInnerIter oit, rit; \
+        if (reduce_iter_new(&oit, n1, is_reduced, out_data, sizeof(nr_float64), 1, NITER_ORDER_K) != 0 \
+            || reduce_slab_iter_new(&rit, n1, is_reduced) != 0) REDUCE_FAIL(); \
+        nr_intp rs_abs = NInnerIter_STRIDES(&rit)[0] < 0 ? -NInnerIter_STRIDES(&rit)[0] : NInnerIter_STRIDES(&rit)[0]; \
+        NInnerIter_ITER(&oit); \
+        while (NInnerIter_NOTDONE(&oit)) { \
+            char* pin = NInnerIter_PTRS(&oit)[0]; \
+            nr_intp ks = NInnerIter_STRIDES(&oit)[0]; \
+            nr_float64* po = (nr_float64*)NInnerIter_PTRS(&oit)[1]; \
+            nr_intp os = NInnerIter_STRIDES(&oit)[1] / (nr_intp)sizeof(nr_float64); \
+            nr_intp cnt = NInnerIter_COUNT(&oit); \
+            nr_intp lanes = (cnt > 1 && (ks < 0 ? -ks : ks) < rs_abs) ? VAR_LANES : 1; \
+            for (nr_intp j0 = 0; j0 < cnt; j0 += lanes) { \
+                nr_intp nl = cnt - j0 < lanes ? cnt - j0 : lanes; \
+                char* base = pin + j0 * ks; \
+                NMath_VarState st[VAR_LANES]; \
+                for (nr_intp j = 0; j < nl; j++) { st[j].count = 0; st[j].mean = 0.; st[j].m2 = 0.; } \
+                NInnerIter_RESET_DATA(&rit, 0, base); \
+                NInnerIter_ITER(&rit); \
+                while (NInnerIter_NOTDONE(&rit)) { \
+                    char* p = NInnerIter_PTRS(&rit)[0]; \
+                    nr_intp rs = NInnerIter_STRIDES(&rit)[0]; \
+                    nr_intp rc = NInnerIter_COUNT(&rit); \
+                    if (lanes == 1) ROW(p, rc, rs, &st[0]); \
+                    else LANES(p, rc, rs, nl, ks, st); \
+                    NInnerIter_NEXT(&rit); \
+                } \
+                for (nr_intp j = 0; j < nl; j++) { \
+                    nr_float64 var = NMath_VarStateGet(&st[j], ddof); \
+                    po[(j0 + j) * os] = DO_SQRT ? sqrt(var) : var; \
+                } \
             } \
+            NInnerIter_NEXT(&oit); \
         } \
-        free(sums); free(sumsq); free(counts); \
     } \
     FINALIZE_REDUCE_OUTPUT() \
 }
@@ -349,37 +895,48 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
     I_NT* in_data = (I_NT*)NODE_DATA(n1); \
     if (!rargs || rargs->n_axis == 0) { \
         if (n_in == 0) { NError_RaiseError(NError_ValueError, #OP_NAME ": empty input"); return -1; } \
-        I_NT best = in_data[0]; nr_int64 best_idx = 0; \
-        for (nr_intp i = 1; i < n_in; i++) { I_NT v = in_data[i]; if (v COMPARE_OP best) { best = v; best_idx = (nr_int64)i; } } \
+        I_NT best = 0; nr_int64 best_idx = -1; \
+        if (in_contig) { \
+            best = in_data[0]; best_idx = 0; \
+            for (nr_intp i = 1; i < n_in; i++) { I_NT v = in_data[i]; if (v COMPARE_OP best) { best = v; best_idx = (nr_int64)i; } } \
+        } else { \
+            /* C order so the row position gives the linear index */ \
+            NInnerIter iit; \
+            if (NInnerIter_FromNodes(&iit, &n1, 1, NITER_ORDER_C) != 0) return -1; \
+            nr_int64 lin = 0; \
+            NInnerIter_ITER(&iit); \
+            while (NInnerIter_NOTDONE(&iit)) { \
+                char* p = NInnerIter_PTRS(&iit)[0]; \
+                nr_intp s = NInnerIter_STRIDES(&iit)[0]; \
+                nr_intp cnt = NInnerIter_COUNT(&iit); \
+                for (nr_intp k = 0; k < cnt; k++, p += s, lin++) { \
+                    I_NT v = *(I_NT*)p; \
+                    if (best_idx < 0 || v COMPARE_OP best) { best = v; best_idx = lin; } \
+                } \
+                NInnerIter_NEXT(&iit); \
+            } \
+        } \
         out_data[0] = best_idx; \
     } else { \
-        int is_reduced[NR_NODE_MAX_NDIM] = {0}; \
-        int reduced_axes[NR_NODE_MAX_NDIM]; int nred = 0; \
-        for (int i = 0; i < rargs->n_axis; i++) { int ax = rargs->axis[i]; if (ax < 0) ax += n1->ndim; if (!is_reduced[ax]) { is_reduced[ax] = 1; reduced_axes[nred++] = ax; } } \
-        I_NT* best_vals = (I_NT*)calloc(n_out, sizeof(I_NT)); \
-        nr_int64* best_indices = (nr_int64*)calloc(n_out, sizeof(nr_int64)); \
-        nr_bool* first_flag = (nr_bool*)calloc(n_out, sizeof(nr_bool)); \
-        if (!best_vals || !best_indices || !first_flag) { NError_RaiseMemoryError(); free(best_vals); free(best_indices); free(first_flag); return -1; } \
-        nr_intp coords[NR_NODE_MAX_NDIM]; \
-        for (nr_intp lin = 0; lin < n_in; lin++) { \
-            linear_to_coords(lin, n1->shape, n1->ndim, coords); \
-            nr_intp oi = coords_to_out_idx(coords, out_shape, is_reduced, n1->ndim, out_ndim); \
-            I_NT v = READ_INPUT(I_NT, in_data, lin, coords, n1, in_contig); \
-            if (!first_flag[oi]) { \
-                best_vals[oi] = v; \
-                /* compute local index across reduced axes fused */ \
-                nr_int64 local_idx = 0; nr_int64 mult = 1; \
-                for (int k = nred - 1; k >= 0; --k) { local_idx += coords[reduced_axes[k]] * mult; mult *= n1->shape[reduced_axes[k]]; } \
-                best_indices[oi] = local_idx; first_flag[oi] = 1; \
-            } else if (v COMPARE_OP best_vals[oi]) { \
-                best_vals[oi] = v; \
-                nr_int64 local_idx = 0; nr_int64 mult = 1; \
-                for (int k = nred - 1; k >= 0; --k) { local_idx += coords[reduced_axes[k]] * mult; mult *= n1->shape[reduced_axes[k]]; } \
-                best_indices[oi] = local_idx; \
-            } \
+        if (n_in == 0 && n_out > 0) { NError_RaiseError(NError_ValueError, #OP_NAME ": empty reduction axis"); REDUCE_FAIL(); } \
+        int is_reduced[NR_NODE_MAX_NDIM]; \
+        reduce_axes_mask(rargs, n1->ndim, is_reduced); \
+        /* \
+         * C order visits the items of each output in increasing position \
+         * along the reduced axes, so the number already seen is the index. \
+         */ \
+        I_NT* best_vals = (I_NT*)NMem_Calloc(n_out * sizeof(I_NT)); \
+        nr_int64* seen = (nr_int64*)NMem_Calloc(n_out * sizeof(nr_int64)); \
+        if (!best_vals || !seen) { NMem_Free(best_vals, n_out * sizeof(I_NT)); NMem_Free(seen, n_out * sizeof(nr_int64)); REDUCE_FAIL(); } \
+        NInnerIter iit; \
+        if (reduce_iter_new(&iit, n1, is_reduced, out_data, sizeof(nr_int64), 0, NITER_ORDER_C) != 0) { \
+            NMem_Free(best_vals, n_out * sizeof(I_NT)); NMem_Free(seen, n_out * sizeof(nr_int64)); REDUCE_FAIL(); \
         } \
-        for (nr_intp i = 0; i < n_out; i++) out_data[i] = best_indices[i]; \
-        free(best_vals); free(best_indices); free(first_flag); \
+        REDUCE_AXIS_LOOP(&iit, I_NT, nr_int64, v, \
+            if (seen[oi] == 0 || v COMPARE_OP best_vals[oi]) { best_vals[oi] = v; acc = seen[oi]; } \
+            seen[oi]++; \
+        ); \
+        NMem_Free(best_vals, n_out * sizeof(I_NT)); NMem_Free(seen, n_out * sizeof(nr_int64)); \
     } \
     FINALIZE_REDUCE_OUTPUT() \
 }
@@ -394,38 +951,23 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
     nr_bool short_target = (nr_bool)(SHORT_TARGET); \
     if (!rargs || rargs->n_axis == 0) { \
         nr_bool acc = init; \
-        if (in_contig) { \
-            for (nr_intp i = 0; i < n_in; i++) { \
-                nr_bool val = (nr_bool)(in_data[i] != 0); \
-                acc = (short_target ? (acc || val) : (acc && val)); \
-                if (acc == short_target) break; \
-            } \
-        } else { \
-            NIter it; NIter_FromNode(&it, n1, NITER_MODE_STRIDED); NIter_ITER(&it); \
-            while (NIter_NOTDONE(&it)) { \
-                nr_bool val = (nr_bool)(*(I_NT*)NIter_ITEM(&it) != 0); \
-                acc = (short_target ? (acc || val) : (acc && val)); \
-                if (acc == short_target) break; \
-                NIter_NEXT(&it); \
-            } \
-        } \
+        /* once acc hits short_target it stays there, so leaving a row early is safe */ \
+        REDUCE_FULL_LOOP(I_NT, v, \
+            nr_bool val = (nr_bool)(v != 0); \
+            acc = (short_target ? (acc || val) : (acc && val)); \
+            if (acc == short_target) break; \
+        ); \
         out_data[0] = acc; \
     } else { \
-        int is_reduced[NR_NODE_MAX_NDIM] = {0}; \
-        for (int i = 0; i < rargs->n_axis; i++) { int ax = rargs->axis[i]; if (ax < 0) ax += n1->ndim; is_reduced[ax] = 1; } \
+        int is_reduced[NR_NODE_MAX_NDIM]; \
+        reduce_axes_mask(rargs, n1->ndim, is_reduced); \
         for (nr_intp i = 0; i < n_out; i++) out_data[i] = init; \
-        nr_bool* done = (nr_bool*)calloc(n_out, sizeof(nr_bool)); \
-        if (!done) { NError_RaiseMemoryError(); return -1; } \
-        nr_intp coords[NR_NODE_MAX_NDIM]; \
-        for (nr_intp lin = 0; lin < n_in; lin++) { \
-            linear_to_coords(lin, n1->shape, n1->ndim, coords); \
-            nr_intp oi = coords_to_out_idx(coords, out_shape, is_reduced, n1->ndim, out_ndim); \
-            if (done[oi]) continue; \
-            nr_bool val = (nr_bool)(READ_INPUT(I_NT, in_data, lin, coords, n1, in_contig) != 0); \
-            out_data[oi] = (short_target ? (out_data[oi] || val) : (out_data[oi] && val)); \
-            if (out_data[oi] == short_target) done[oi] = 1; \
-        } \
-        free(done); \
+        NInnerIter iit; \
+        if (reduce_iter_new(&iit, n1, is_reduced, out_data, sizeof(nr_bool), 0, NITER_ORDER_K) != 0) REDUCE_FAIL(); \
+        REDUCE_AXIS_LOOP(&iit, I_NT, nr_bool, v, \
+            nr_bool val = (nr_bool)(v != 0); \
+            acc = (short_target ? (acc || val) : (acc && val)); \
+        ); \
     } \
     FINALIZE_REDUCE_OUTPUT() \
 }
@@ -437,18 +979,24 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
     I_NT* in_data = (I_NT*)NODE_DATA(n1); \
     if (!rargs || rargs->n_axis == 0) { \
         O_NT acc = (O_NT)(INIT_VAL); int first = (NEEDS_FIRST); \
-        for (nr_intp i = 0; i < n_in; i++) { \
-            I_NT raw = in_data[i]; if (ISNAN_CHECK(raw)) continue; O_NT val = (O_NT)raw; \
+        REDUCE_FULL_LOOP(I_NT, raw, \
+            if (ISNAN_CHECK(raw)) continue; O_NT val = (O_NT)raw; \
             if (first) { acc = val; first = 0; } else { acc = OP_FUNC(acc, val); } \
-        } \
+        ); \
         out_data[0] = (NEEDS_FIRST && first) ? NAN : acc; \
     } else { \
-        int is_reduced[NR_NODE_MAX_NDIM]={0}; for(int i=0;i<rargs->n_axis;i++){int ax=rargs->axis[i]; if(ax<0) ax+=n1->ndim; is_reduced[ax]=1;} \
-        nr_bool* first_flag = NULL; if(NEEDS_FIRST){ first_flag = (nr_bool*)calloc(n_out,sizeof(nr_bool)); if(!first_flag){NError_RaiseMemoryError(); return -1;} } \
-        for(nr_intp i=0;i<n_out;i++) if(!NEEDS_FIRST) out_data[i]=(O_NT)(INIT_VAL); \
-        nr_intp coords[NR_NODE_MAX_NDIM]; \
-        for(nr_intp lin=0; lin<n_in; lin++){ linear_to_coords(lin,n1->shape,n1->ndim,coords); I_NT raw=READ_INPUT(I_NT,in_data,lin,coords,n1,in_contig); if(ISNAN_CHECK(raw)) continue; O_NT val=(O_NT)raw; nr_intp oi=coords_to_out_idx(coords,out_shape,is_reduced,n1->ndim,out_ndim); if(NEEDS_FIRST){ if(!first_flag[oi]){ out_data[oi]=val; first_flag[oi]=1;} else { out_data[oi]=OP_FUNC(out_data[oi],val);} } else { out_data[oi]=OP_FUNC(out_data[oi],val);} } \
-        if(first_flag){ for(nr_intp i=0;i<n_out;i++) if(!first_flag[i]) out_data[i]=NAN; free(first_flag);} \
+        int is_reduced[NR_NODE_MAX_NDIM]; \
+        reduce_axes_mask(rargs, n1->ndim, is_reduced); \
+        /* data NaNs are skipped, so a NaN accumulator means nothing seen yet */ \
+        for (nr_intp i = 0; i < n_out; i++) out_data[i] = NEEDS_FIRST ? (O_NT)NAN : (O_NT)(INIT_VAL); \
+        NInnerIter iit; \
+        if (reduce_iter_new(&iit, n1, is_reduced, out_data, sizeof(O_NT), 0, NITER_ORDER_K) != 0) REDUCE_FAIL(); \
+        REDUCE_AXIS_LOOP(&iit, I_NT, O_NT, raw, \
+            if (!ISNAN_CHECK(raw)) { \
+                O_NT val = (O_NT)raw; \
+                acc = (NEEDS_FIRST && ISNAN_CHECK(acc)) ? val : OP_FUNC(acc, val); \
+            } \
+        ); \
     } \
     FINALIZE_REDUCE_OUTPUT() \
 }
@@ -464,36 +1012,17 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
     \
     if (!rargs || rargs->n_axis == 0) { \
         nr_intp count = 0; \
-        if (in_contig) { \
-            for (nr_intp i = 0; i < n_in; i++) { \
-                if (in_data[i] != 0) count++; \
-            } \
-        } else { \
-            NIter it; NIter_FromNode(&it, n1, NITER_MODE_STRIDED); \
-            NIter_ITER(&it); \
-            while (NIter_NOTDONE(&it)) { \
-                if (*(I_NT*)NIter_ITEM(&it) != 0) count++; \
-                NIter_NEXT(&it); \
-            } \
-        } \
+        REDUCE_FULL_LOOP(I_NT, v, \
+            if (v != 0) count++; \
+        ); \
         out_data[0] = count; \
     } else { \
-        int is_reduced[NR_NODE_MAX_NDIM] = {0}; \
-        for (int i = 0; i < rargs->n_axis; i++) { \
-            int ax = rargs->axis[i]; \
-            is_reduced[ax < 0 ? ax + n1->ndim : ax] = 1; \
-        } \
+        int is_reduced[NR_NODE_MAX_NDIM]; \
+        reduce_axes_mask(rargs, n1->ndim, is_reduced); \
         for (nr_intp i = 0; i < n_out; i++) out_data[i] = 0; \
-        \
-        nr_intp coords[NR_NODE_MAX_NDIM]; \
-        for (nr_intp lin = 0; lin < n_in; lin++) { \
-            linear_to_coords(lin, n1->shape, n1->ndim, coords); \
-            I_NT val = READ_INPUT(I_NT, in_data, lin, coords, n1, in_contig); \
-            if (val != 0) { \
-                nr_intp oi = coords_to_out_idx(coords, out_shape, is_reduced, n1->ndim, out_ndim); \
-                out_data[oi]++; \
-            } \
-        } \
+        NInnerIter iit; \
+        if (reduce_iter_new(&iit, n1, is_reduced, out_data, sizeof(nr_intp), 0, NITER_ORDER_K) != 0) REDUCE_FAIL(); \
+        REDUCE_AXIS_LOOP(&iit, I_NT, nr_intp, v, acc += (v != 0);); \
     } \
     FINALIZE_REDUCE_OUTPUT() \
 }
@@ -504,6 +1033,11 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
 
 /* Sum/Prod: integers -> int64/uint64, floats -> float64 */
 #define DEFINE_REDUCE_PROMOTED(OP, FUNC, INIT, NEED_FIRST) \
+    DEFINE_REDUCE_PROMOTED_INTS(OP, FUNC, INIT, NEED_FIRST) \
+    DEFINE_REDUCE_KERNEL(OP, FUNC, nr_float64, nr_float32, INIT, NEED_FIRST, NR_FLOAT64) \
+    DEFINE_REDUCE_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64)
+
+#define DEFINE_REDUCE_PROMOTED_INTS(OP, FUNC, INIT, NEED_FIRST) \
     DEFINE_REDUCE_KERNEL(OP, FUNC, nr_int64,   nr_bool,    INIT, NEED_FIRST, NR_INT64) \
     DEFINE_REDUCE_KERNEL(OP, FUNC, nr_int64,   nr_int8,    INIT, NEED_FIRST, NR_INT64) \
     DEFINE_REDUCE_KERNEL(OP, FUNC, nr_int64,   nr_int16,   INIT, NEED_FIRST, NR_INT64) \
@@ -512,9 +1046,12 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
     DEFINE_REDUCE_KERNEL(OP, FUNC, nr_uint64,  nr_uint8,   INIT, NEED_FIRST, NR_UINT64) \
     DEFINE_REDUCE_KERNEL(OP, FUNC, nr_uint64,  nr_uint16,  INIT, NEED_FIRST, NR_UINT64) \
     DEFINE_REDUCE_KERNEL(OP, FUNC, nr_uint64,  nr_uint32,  INIT, NEED_FIRST, NR_UINT64) \
-    DEFINE_REDUCE_KERNEL(OP, FUNC, nr_uint64,  nr_uint64,  INIT, NEED_FIRST, NR_UINT64) \
-    DEFINE_REDUCE_KERNEL(OP, FUNC, nr_float64, nr_float32, INIT, NEED_FIRST, NR_FLOAT64) \
-    DEFINE_REDUCE_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64)
+    DEFINE_REDUCE_KERNEL(OP, FUNC, nr_uint64,  nr_uint64,  INIT, NEED_FIRST, NR_UINT64)
+
+/* Float sums: float32/float64 -> float64 with the summation mode */
+#define DEFINE_FSUM_FLOATS(OP, SUFFIX, IGNORE_NAN, DO_MEAN) \
+    DEFINE_FSUM_KERNEL(OP, nr_float32, sum_row_nr_float32##SUFFIX, IGNORE_NAN, ISNAN_F32, DO_MEAN) \
+    DEFINE_FSUM_KERNEL(OP, nr_float64, sum_row_nr_float64##SUFFIX, IGNORE_NAN, ISNAN_F64, DO_MEAN)
 
 /* Min/Max: same type in/out */
 #define DEFINE_REDUCE_SAME_TYPE(OP, FUNC, INIT, NEED_FIRST) \
@@ -536,32 +1073,35 @@ NR_PRIVATE int OP_NAME##_kernel_##I_NT(NFuncArgs* args) { \
     DEFINE_NANREDUCE_KERNEL(OP, FUNC, nr_float64, nr_float64, INIT, NEED_FIRST, NR_FLOAT64, ISNAN_F64)
 
 /* Mean: all types -> float64 */
-#define DEFINE_MEAN_ALL(OP, ISNAN_CHECK) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_bool,    NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_int8,    NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_int16,   NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_int32,   NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_int64,   NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_uint8,   NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_uint16,  NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_uint32,  NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_uint64,  NR_FLOAT64, ISNAN_CHECK, ISNAN_INT) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_float32, NR_FLOAT64, ISNAN_CHECK, ISNAN_F32) \
-    DEFINE_MEAN_KERNEL(OP, nr_float64, nr_float64, NR_FLOAT64, ISNAN_CHECK, ISNAN_F64)
+#define DEFINE_MEAN_ALL(OP) \
+    DEFINE_FSUM_KERNEL(OP, nr_bool,    sum_row_nr_bool,    0, ISNAN_INT, 1) \
+    DEFINE_FSUM_KERNEL(OP, nr_int8,    sum_row_nr_int8,    0, ISNAN_INT, 1) \
+    DEFINE_FSUM_KERNEL(OP, nr_int16,   sum_row_nr_int16,   0, ISNAN_INT, 1) \
+    DEFINE_FSUM_KERNEL(OP, nr_int32,   sum_row_nr_int32,   0, ISNAN_INT, 1) \
+    DEFINE_FSUM_KERNEL(OP, nr_int64,   sum_row_nr_int64,   0, ISNAN_INT, 1) \
+    DEFINE_FSUM_KERNEL(OP, nr_uint8,   sum_row_nr_uint8,   0, ISNAN_INT, 1) \
+    DEFINE_FSUM_KERNEL(OP, nr_uint16,  sum_row_nr_uint16,  0, ISNAN_INT, 1) \
+    DEFINE_FSUM_KERNEL(OP, nr_uint32,  sum_row_nr_uint32,  0, ISNAN_INT, 1) \
+    DEFINE_FSUM_KERNEL(OP, nr_uint64,  sum_row_nr_uint64,  0, ISNAN_INT, 1) \
+    DEFINE_FSUM_FLOATS(OP, , 0, 1)
 
 /* Var/Std: all types -> float64 */
-#define DEFINE_VAR_ALL(OP, ISNAN_CHECK, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_bool,    NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_int8,    NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_int16,   NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_int32,   NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_int64,   NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_uint8,   NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_uint16,  NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_uint32,  NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_uint64,  NR_FLOAT64, ISNAN_CHECK, ISNAN_INT, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_float32, NR_FLOAT64, ISNAN_CHECK, ISNAN_F32, DO_SQRT) \
-    DEFINE_VAR_KERNEL(OP, nr_float64, nr_float64, NR_FLOAT64, ISNAN_CHECK, ISNAN_F64, DO_SQRT)
+#define DEFINE_VAR_ALL(OP, DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_bool,    var_row_nr_bool,    var_lanes_nr_bool,    DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_int8,    var_row_nr_int8,    var_lanes_nr_int8,    DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_int16,   var_row_nr_int16,   var_lanes_nr_int16,   DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_int32,   var_row_nr_int32,   var_lanes_nr_int32,   DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_int64,   var_row_nr_int64,   var_lanes_nr_int64,   DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_uint8,   var_row_nr_uint8,   var_lanes_nr_uint8,   DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_uint16,  var_row_nr_uint16,  var_lanes_nr_uint16,  DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_uint32,  var_row_nr_uint32,  var_lanes_nr_uint32,  DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_uint64,  var_row_nr_uint64,  var_lanes_nr_uint64,  DO_SQRT) \
+    DEFINE_VAR_FLOATS(OP, , DO_SQRT)
+
+/* Var/Std on floats, NaN ignoring with SUFFIX _nan */
+#define DEFINE_VAR_FLOATS(OP, SUFFIX, DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_float32, var_row_nr_float32##SUFFIX, var_lanes_nr_float32##SUFFIX, DO_SQRT) \
+    DEFINE_VAR_KERNEL(OP, nr_float64, var_row_nr_float64##SUFFIX, var_lanes_nr_float64##SUFFIX, DO_SQRT)
 
 /* Argmin/Argmax: all types -> int64 */
 #define DEFINE_ARG_ALL(OP, COMPARE_OP) \
@@ -655,6 +1195,18 @@ const NFunc name_str##_nfunc = { \
     .grad_func = NULL \
 };
 
+/* DEFINE_NFUNC for a differentiable reduction, with its GradFunc from grad.c */
+#define DEFINE_NFUNC_GRAD(OP_NAME, name_str) \
+const NFunc name_str##_nfunc = { \
+    .name = #name_str, \
+    .flags = NFUNC_FLAG_OUT_DTYPES_NOT_SAME | NFUNC_FLAG_GRADIENT, \
+    .nin = 1, .nout = 1, \
+    .in_type = NDTYPE_NONE, .out_type = NDTYPE_NONE, \
+    .in_dtype = NR_NONE, .out_dtype = NR_NONE, \
+    .func = OP_NAME##_dispatch, \
+    .grad_func = &name_str##_grad \
+};
+
 #define DEFINE_API(ApiName, name_str) \
 NR_PUBLIC Node* NMath_##ApiName(Node* c, Node* a, int* axis, int na) { \
     NFuncArgs* args = NFuncArgs_New(1, 1); \
@@ -668,51 +1220,70 @@ NR_PUBLIC Node* NMath_##ApiName(Node* c, Node* a, int* axis, int na) { \
     return result != 0 ? NULL : out; \
 }
 
+/* Var/Std style API: NMath_<ApiName>Ddof plus NMath_<ApiName> with ddof = 0 */
+#define DEFINE_API_DDOF(ApiName, name_str) \
+NR_PUBLIC Node* NMath_##ApiName##Ddof(Node* c, Node* a, int* axis, int na, int ddof) { \
+    NFuncArgs* args = NFuncArgs_New(1, 1); \
+    args->in_nodes[0] = a; \
+    args->out_nodes[0] = c; \
+    NFunc_ReduceArgs rargs = NFunc_ReduceArgs_New(axis, na); \
+    rargs.ddof = ddof; \
+    args->extra = &rargs; \
+    int result = NFunc_Call(&name_str##_nfunc, args); \
+    Node* out = args->out_nodes[0]; \
+    NFuncArgs_DECREF(args); \
+    return result != 0 ? NULL : out; \
+} \
+NR_PUBLIC Node* NMath_##ApiName(Node* c, Node* a, int* axis, int na) { \
+    return NMath_##ApiName##Ddof(c, a, axis, na, 0); \
+}
+
 /* ============================================================================
  * INSTANTIATE ALL OPERATIONS
  * ============================================================================ */
 
 /* === Sum === */
-DEFINE_REDUCE_PROMOTED(Sum, OP_SUM, 0, 0)
+DEFINE_REDUCE_PROMOTED_INTS(Sum, OP_SUM, 0, 0)
+DEFINE_FSUM_FLOATS(Sum, , 0, 0)
 DEFINE_DISPATCHER(Sum)
-DEFINE_NFUNC(Sum, sum)
+DEFINE_NFUNC_GRAD(Sum, sum)
 DEFINE_API(Sum, sum)
 
 /* === Prod === */
 DEFINE_REDUCE_PROMOTED(Prod, OP_PROD, 1, 0)
 DEFINE_DISPATCHER(Prod)
-DEFINE_NFUNC(Prod, prod)
+DEFINE_NFUNC_GRAD(Prod, prod)
 DEFINE_API(Prod, prod)
 
 /* === Min === */
 DEFINE_REDUCE_SAME_TYPE(Min, OP_MIN, 0, 1)
 DEFINE_DISPATCHER(Min)
-DEFINE_NFUNC(Min, min)
+DEFINE_NFUNC_GRAD(Min, min)
 DEFINE_API(Min, min)
 
 /* === Max === */
 DEFINE_REDUCE_SAME_TYPE(Max, OP_MAX, 0, 1)
 DEFINE_DISPATCHER(Max)
-DEFINE_NFUNC(Max, max)
+DEFINE_NFUNC_GRAD(Max, max)
 DEFINE_API(Max, max)
 
 /* === Mean === */
-DEFINE_MEAN_ALL(Mean, 0)
+DEFINE_MEAN_ALL(Mean)
 DEFINE_DISPATCHER(Mean)
-DEFINE_NFUNC(Mean, mean)
+DEFINE_NFUNC_GRAD(Mean, mean)
 DEFINE_API(Mean, mean)
 
 /* === Var === */
-DEFINE_VAR_ALL(Var, 0, 0)
+DEFINE_VAR_ALL(Var, 0)
 DEFINE_DISPATCHER(Var)
-DEFINE_NFUNC(Var, var)
-DEFINE_API(Var, var)
+DEFINE_NFUNC_GRAD(Var, var)
+DEFINE_API_DDOF(Var, var)
 
 /* === Std === */
-DEFINE_VAR_ALL(Std, 0, 1)
+DEFINE_VAR_ALL(Std, 1)
 DEFINE_DISPATCHER(Std)
-DEFINE_NFUNC(Std, std)
-DEFINE_API(Std, std)
+DEFINE_NFUNC_GRAD(Std, std)
+DEFINE_API_DDOF(Std, std)
 
 /* === Argmin === */
 DEFINE_ARG_ALL(Argmin, <)
@@ -749,7 +1320,7 @@ DEFINE_API(CountNonzero, count_nonzero)
  * ============================================================================ */
 
 /* === NanSum === */
-DEFINE_NANREDUCE_FLOATS(NanSum, OP_SUM, 0, 0)
+DEFINE_FSUM_FLOATS(NanSum, _nan, 1, 0)
 DEFINE_DISPATCHER_FLOAT_ONLY(NanSum)
 DEFINE_NFUNC(NanSum, nansum)
 DEFINE_API(NanSum, nansum)
@@ -773,22 +1344,19 @@ DEFINE_NFUNC(NanMax, nanmax)
 DEFINE_API(NanMax, nanmax)
 
 /* === NanMean === */
-DEFINE_MEAN_KERNEL(NanMean, nr_float64, nr_float32, NR_FLOAT64, 1, ISNAN_F32)
-DEFINE_MEAN_KERNEL(NanMean, nr_float64, nr_float64, NR_FLOAT64, 1, ISNAN_F64)
+DEFINE_FSUM_FLOATS(NanMean, _nan, 1, 1)
 DEFINE_DISPATCHER_FLOAT_ONLY(NanMean)
 DEFINE_NFUNC(NanMean, nanmean)
 DEFINE_API(NanMean, nanmean)
 
 /* === NanVar === */
-DEFINE_VAR_KERNEL(NanVar, nr_float64, nr_float32, NR_FLOAT64, 1, ISNAN_F32, 0)
-DEFINE_VAR_KERNEL(NanVar, nr_float64, nr_float64, NR_FLOAT64, 1, ISNAN_F64, 0)
+DEFINE_VAR_FLOATS(NanVar, _nan, 0)
 DEFINE_DISPATCHER_FLOAT_ONLY(NanVar)
 DEFINE_NFUNC(NanVar, nanvar)
-DEFINE_API(NanVar, nanvar)
+DEFINE_API_DDOF(NanVar, nanvar)
 
 /* === NanStd === */
-DEFINE_VAR_KERNEL(NanStd, nr_float64, nr_float32, NR_FLOAT64, 1, ISNAN_F32, 1)
-DEFINE_VAR_KERNEL(NanStd, nr_float64, nr_float64, NR_FLOAT64, 1, ISNAN_F64, 1)
+DEFINE_VAR_FLOATS(NanStd, _nan, 1)
 DEFINE_DISPATCHER_FLOAT_ONLY(NanStd)
 DEFINE_NFUNC(NanStd, nanstd)
-DEFINE_API(NanStd, nanstd)
\ No newline at end of file
+DEFINE_API_DDOF(NanStd, nanstd)
\ No newline at end of file
@@ -10,11 +10,60 @@ typedef struct
 {
     int axis[NR_NODE_MAX_NDIM];
     int n_axis;
+    int ddof;       // delta degrees of freedom of var/std, 0 by default
 }NFunc_ReduceArgs;
 
 NR_PUBLIC NFunc_ReduceArgs
 NFunc_ReduceArgs_New(const int* axes, const int n_axes);
 
+/*
+ * Accumulation used by the float sums (sum, mean, nansum, nanmean, cumsum
+ * and nancumsum).
+ *  - PAIRWISE: blocked pairwise summation, error grows with log(n). Rows
+ *    are summed in blocks of 128 items with 8 independent accumulators,
+ *    so it is also faster than a single running sum. Scans have no
+ *    pairwise form and use KAHAN instead.
+ *  - KAHAN: compensated (Neumaier) summation, error independent of n,
+ *    about twice as slow as NAIVE.
+ *  - NAIVE: one running sum.
+ * Axis reductions whose innermost axis is kept add whole input rows into
+ * the output row; there PAIRWISE falls back to a running sum per output
+ * item (as NumPy does) and only KAHAN is compensated.
+ */
+typedef enum{
+    NMATH_SUM_PAIRWISE = 0,
+    NMATH_SUM_KAHAN,
+    NMATH_SUM_NAIVE,
+}NMath_SumMode;
+
+/* Sets the float summation mode for all threads, returns the previous one. */
+NR_PUBLIC NMath_SumMode
+NMath_SetSumMode(NMath_SumMode mode);
+
+NR_PUBLIC NMath_SumMode
+NMath_GetSumMode(void);
+
+/*
+ * Partial variance of a set of items: the count, their mean and the sum of
+ * squared deviations from it (M2). States of disjoint sets are combined
+ * with Chan's formula, so a variance can be computed in chunks (threads,
+ * batches) and merged at the end.
+ */
+typedef struct
+{
+    nr_intp count;
+    nr_float64 mean;
+    nr_float64 m2;
+}NMath_VarState;
+
+/* Merges `src` into `dst`. */
+NR_PUBLIC void
+NMath_VarStateMerge(NMath_VarState* dst, const NMath_VarState* src);
+
+/* Returns M2 / (count - ddof), NaN when count <= ddof. */
+NR_PUBLIC nr_float64
+NMath_VarStateGet(const NMath_VarState* st, int ddof);
+
 // Public API declarations
 NR_PUBLIC Node* NMath_Sum(Node* c, Node* a, int* axis, int na);
 NR_PUBLIC Node* NMath_Prod(Node* c, Node* a, int* axis, int na);
@@ -36,4 +85,10 @@ NR_PUBLIC Node* NMath_NanMean(Node* c, Node* a, int* axis, int na);
 NR_PUBLIC Node* NMath_NanVar(Node* c, Node* a, int* axis, int na);
 NR_PUBLIC Node* NMath_NanStd(Node* c, Node* a, int* axis, int na);
 
+// Var/Std with delta degrees of freedom: divide by N - ddof
+NR_PUBLIC Node* NMath_VarDdof(Node* c, Node* a, int* axis, int na, int ddof);
+NR_PUBLIC Node* NMath_StdDdof(Node* c, Node* a, int* axis, int na, int ddof);
+NR_PUBLIC Node* NMath_NanVarDdof(Node* c, Node* a, int* axis, int na, int ddof);
+NR_PUBLIC Node* NMath_NanStdDdof(Node* c, Node* a, int* axis, int na, int ddof);
+
 #endif // NOUR__CORE_SRC_NMATH_REDUCE_H
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "nour/nour.h"
+#include "reduce_state.h"
+#include "reduce.h"
+#include "../nerror.h"
+#include "../node_core.h"
+#include "../free.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct NReduceState{
+    NReduce_Op op;
+    int ddof;
+    int axis[NR_NODE_MAX_NDIM];
+    int na;
+
+    // set by the first batch
+    int ndim;                   // 0 until then
+    NR_DTYPE dtype;
+    nr_intp shape[NR_NODE_MAX_NDIM];    // shape[0] counts the rows seen
+    nr_intp inner;              // items per row along the reduced axes but 0
+    nr_intp n_out;
+
+    Node* acc;                  // sum/prod/min/max, argmin/argmax values
+    Node* idx;                  // argmin/argmax
+    NMath_VarState* var;        // mean/var/std, one per output
+};
+
+#define NREDUCE_DTYPE_SWITCH(dtype, MACRO) do { \
+    switch (dtype) { \
+        case NR_BOOL:    MACRO(nr_bool); break; \
+        case NR_INT8:    MACRO(nr_int8); break; \
+        case NR_UINT8:   MACRO(nr_uint8); break; \
+        case NR_INT16:   MACRO(nr_int16); break; \
+        case NR_UINT16:  MACRO(nr_uint16); break; \
+        case NR_INT32:   MACRO(nr_int32); break; \
+        case NR_UINT32:  MACRO(nr_uint32); break; \
+        case NR_INT64:   MACRO(nr_int64); break; \
+        case NR_UINT64:  MACRO(nr_uint64); break; \
+        case NR_FLOAT32: MACRO(nr_float32); break; \
+        case NR_FLOAT64: MACRO(nr_float64); break; \
+        default: break; \
+    } \
+} while (0)
+
+/* Partials are merged the way the kernels fold items (see OP_MIN / OP_MAX) */
+#define MERGE_SUM(T) { T* a = (T*)acc; const T* p = (const T*)pdata; \
+    for (nr_intp i = 0; i < n; i++) a[i] = a[i] + p[i]; }
+#define MERGE_PROD(T) { T* a = (T*)acc; const T* p = (const T*)pdata; \
+    for (nr_intp i = 0; i < n; i++) a[i] = a[i] * p[i]; }
+#define MERGE_MIN(T) { T* a = (T*)acc; const T* p = (const T*)pdata; \
+    for (nr_intp i = 0; i < n; i++) if (p[i] < a[i]) a[i] = p[i]; }
+#define MERGE_MAX(T) { T* a = (T*)acc; const T* p = (const T*)pdata; \
+    for (nr_intp i = 0; i < n; i++) if (p[i] > a[i]) a[i] = p[i]; }
+#define MERGE_ARGMIN(T) { T* a = (T*)acc; const T* p = (const T*)pdata; \
+    for (nr_intp i = 0; i < n; i++) if (p[i] < a[i]) { a[i] = p[i]; idx[i] = pidx[i] + base; } }
+#define MERGE_ARGMAX(T) { T* a = (T*)acc; const T* p = (const T*)pdata; \
+    for (nr_intp i = 0; i < n; i++) if (p[i] > a[i]) { a[i] = p[i]; idx[i] = pidx[i] + base; } }
+
+NR_PUBLIC NReduceState*
+NReduceState_NewDdof(NReduce_Op op, const int* axis, int na, int ddof){
+    if (op < NREDUCE_SUM || op > NREDUCE_ARGMAX || na < 0 || na > NR_NODE_MAX_NDIM) {
+        return NError_RaiseError(NError_ValueError, "reduce state: invalid op or axis count");
+    }
+    NReduceState* st = (NReduceState*)calloc(1, sizeof(NReduceState));
+    if (!st) {
+        return NError_RaiseMemoryError();
+    }
+    st->op = op;
+    st->ddof = ddof;
+    st->na = na;
+    for (int i = 0; i < na; i++) {
+        st->axis[i] = axis[i];
+    }
+    return st;
+}
+
+NR_PUBLIC NReduceState*
+NReduceState_New(NReduce_Op op, const int* axis, int na){
+    return NReduceState_NewDdof(op, axis, na, 0);
+}
+
+NR_PUBLIC void
+NReduceState_Free(NReduceState* st){
+    if (!st) {
+        return;
+    }
+    Node_Free(st->acc);
+    Node_Free(st->idx);
+    free(st->var);
+    free(st);
+}
+
+NR_PUBLIC nr_intp
+NReduceState_Rows(const NReduceState* st){
+    return st->ndim ? st->shape[0] : 0;
+}
+
+/* Checks the axes against the first batch and sizes the state */
+NR_PRIVATE int
+nreduce_state_init(NReduceState* st, Node* batch){
+    if (batch->ndim < 1) {
+        NError_RaiseError(NError_ValueError, "reduce state: batches need at least one axis");
+        return -1;
+    }
+    int reduced[NR_NODE_MAX_NDIM];
+    for (int i = 0; i < batch->ndim; i++) {
+        reduced[i] = st->na == 0;
+    }
+    for (int k = 0; k < st->na; k++) {
+        int a = st->axis[k] < 0 ? st->axis[k] + batch->ndim : st->axis[k];
+        if (a < 0 || a >= batch->ndim) {
+            NError_RaiseError(NError_ValueError,
+                "reduce axis %d out of bounds for array of dimension %d", st->axis[k], batch->ndim);
+            return -1;
+        }
+        reduced[a] = 1;
+    }
+    if (!reduced[0]) {
+        NError_RaiseError(NError_ValueError, "reduce state: batches are stacked on axis 0, which must be reduced");
+        return -1;
+    }
+    st->inner = 1;
+    st->n_out = 1;
+    for (int i = 1; i < batch->ndim; i++) {
+        if (reduced[i]) {
+            st->inner *= batch->shape[i];
+        }
+        else {
+            st->n_out *= batch->shape[i];
+        }
+    }
+    if (st->op == NREDUCE_MEAN || st->op == NREDUCE_VAR || st->op == NREDUCE_STD) {
+        st->var = (NMath_VarState*)calloc(st->n_out > 0 ? st->n_out : 1, sizeof(NMath_VarState));
+        if (!st->var) {
+            NError_RaiseMemoryError();
+            return -1;
+        }
+    }
+    st->ndim = batch->ndim;
+    st->dtype = NODE_DTYPE(batch);
+    memcpy(st->shape, batch->shape, sizeof(nr_intp) * batch->ndim);
+    st->shape[0] = 0;
+    return 0;
+}
+
+/* NMath_<Op> of `a` over the state's axes; `alt` gives the values behind argmin/argmax */
+NR_PRIVATE Node*
+nreduce_state_call(const NReduceState* st, Node* a, int alt){
+    int* axis = st->na ? (int*)st->axis : NULL;
+    switch (st->op) {
+        case NREDUCE_SUM:    return NMath_Sum(NULL, a, axis, st->na);
+        case NREDUCE_PROD:   return NMath_Prod(NULL, a, axis, st->na);
+        case NREDUCE_MIN:    return NMath_Min(NULL, a, axis, st->na);
+        case NREDUCE_MAX:    return NMath_Max(NULL, a, axis, st->na);
+        case NREDUCE_MEAN:   return NMath_Mean(NULL, a, axis, st->na);
+        case NREDUCE_VAR:    return NMath_VarDdof(NULL, a, axis, st->na, st->ddof);
+        case NREDUCE_STD:    return NMath_StdDdof(NULL, a, axis, st->na, st->ddof);
+        case NREDUCE_ARGMIN: return alt ? NMath_Min(NULL, a, axis, st->na)
+                                        : NMath_Argmin(NULL, a, axis, st->na);
+        case NREDUCE_ARGMAX: return alt ? NMath_Max(NULL, a, axis, st->na)
+                                        : NMath_Argmax(NULL, a, axis, st->na);
+    }
+    return NULL;
+}
+
+NR_PRIVATE int
+nreduce_state_fold_var(NReduceState* st, Node* batch){
+    int* axis = st->na ? st->axis : NULL;
+    nr_intp count = batch->shape[0] * st->inner;
+    if (count == 0) {
+        return 0;
+    }
+    Node* mean = NMath_Mean(NULL, batch, axis, st->na);
+    Node* var = st->op == NREDUCE_MEAN ? NULL : NMath_Var(NULL, batch, axis, st->na);
+    if (!mean || (st->op != NREDUCE_MEAN && !var)) {
+        Node_Free(mean);
+        Node_Free(var);
+        return -1;
+    }
+    const nr_float64* m = (const nr_float64*)NODE_DATA(mean);
+    const nr_float64* v = var ? (const nr_float64*)NODE_DATA(var) : NULL;
+    for (nr_intp i = 0; i < st->n_out; i++) {
+        NMath_VarState part = {count, m[i], v ? v[i] * (nr_float64)count : 0.};
+        NMath_VarStateMerge(&st->var[i], &part);
+    }
+    Node_Free(mean);
+    Node_Free(var);
+    return 0;
+}
+
+NR_PUBLIC int
+NReduceState_Update(NReduceState* st, Node* batch){
+    if (!st->ndim && nreduce_state_init(st, batch) != 0) {
+        return -1;
+    }
+    int same = batch->ndim == st->ndim && NODE_DTYPE(batch) == st->dtype;
+    for (int i = 1; i < st->ndim && same; i++) {
+        same = batch->shape[i] == st->shape[i];
+    }
+    if (!same) {
+        NError_RaiseError(NError_ValueError, "reduce state: batch does not match the dtype or shape of the first one");
+        return -1;
+    }
+    if (batch->shape[0] == 0) {
+        return 0;
+    }
+
+    if (st->var) {
+        if (nreduce_state_fold_var(st, batch) != 0) {
+            return -1;
+        }
+        st->shape[0] += batch->shape[0];
+        return 0;
+    }
+
+    int is_arg = st->op == NREDUCE_ARGMIN || st->op == NREDUCE_ARGMAX;
+    Node* part = nreduce_state_call(st, batch, is_arg);
+    Node* part_idx = is_arg && part ? nreduce_state_call(st, batch, 0) : NULL;
+    if (!part || (is_arg && !part_idx)) {
+        Node_Free(part);
+        return -1;
+    }
+    if (!st->acc) {
+        st->acc = part;
+        st->idx = part_idx;
+        st->shape[0] += batch->shape[0];
+        return 0;
+    }
+
+    void* acc = NODE_DATA(st->acc);
+    const void* pdata = NODE_DATA(part);
+    nr_intp n = st->n_out;
+    nr_int64* idx = st->idx ? (nr_int64*)NODE_DATA(st->idx) : NULL;
+    const nr_int64* pidx = part_idx ? (const nr_int64*)NODE_DATA(part_idx) : NULL;
+    // items of earlier batches come first along the flattened reduced axes
+    nr_int64 base = (nr_int64)(st->shape[0] * st->inner);
+    switch (st->op) {
+        case NREDUCE_SUM:    NREDUCE_DTYPE_SWITCH(NODE_DTYPE(st->acc), MERGE_SUM); break;
+        case NREDUCE_PROD:   NREDUCE_DTYPE_SWITCH(NODE_DTYPE(st->acc), MERGE_PROD); break;
+        case NREDUCE_MIN:    NREDUCE_DTYPE_SWITCH(NODE_DTYPE(st->acc), MERGE_MIN); break;
+        case NREDUCE_MAX:    NREDUCE_DTYPE_SWITCH(NODE_DTYPE(st->acc), MERGE_MAX); break;
+        case NREDUCE_ARGMIN: NREDUCE_DTYPE_SWITCH(NODE_DTYPE(st->acc), MERGE_ARGMIN); break;
+        case NREDUCE_ARGMAX: NREDUCE_DTYPE_SWITCH(NODE_DTYPE(st->acc), MERGE_ARGMAX); break;
+        default: break;
+    }
+    Node_Free(part);
+    Node_Free(part_idx);
+    st->shape[0] += batch->shape[0];
+    return 0;
+}
+
+NR_PUBLIC Node*
+NReduceState_Finalize(NReduceState* st){
+    if (!st->ndim) {
+        return NError_RaiseError(NError_ValueError, "reduce state: no batch was given");
+    }
+    if (st->shape[0] == 0) {
+        // only empty batches: whatever the kernel gives for an empty input
+        Node* empty = Node_NewEmpty(st->ndim, st->shape, st->dtype);
+        Node* out = empty ? nreduce_state_call(st, empty, 0) : NULL;
+        Node_Free(empty);
+        return out;
+    }
+    if (!st->var) {
+        Node* src = st->idx ? st->idx : st->acc;
+        return Node_Copy(NULL, src);
+    }
+
+    // output shape: the kept axes
+    nr_intp out_shape[NR_NODE_MAX_NDIM];
+    int out_ndim = 0;
+    int reduced[NR_NODE_MAX_NDIM] = {0};
+    for (int k = 0; k < st->na; k++) {
+        reduced[st->axis[k] < 0 ? st->axis[k] + st->ndim : st->axis[k]] = 1;
+    }
+    for (int i = 0; i < st->ndim && st->na; i++) {
+        if (!reduced[i]) {
+            out_shape[out_ndim++] = st->shape[i];
+        }
+    }
+    Node* out = Node_NewEmpty(out_ndim, out_shape, NR_FLOAT64);
+    if (!out) {
+        return NULL;
+    }
+    nr_float64* d = (nr_float64*)NODE_DATA(out);
+    for (nr_intp i = 0; i < st->n_out; i++) {
+        if (st->op == NREDUCE_MEAN) {
+            d[i] = st->var[i].count ? st->var[i].mean : NAN;
+        }
+        else {
+            nr_float64 v = NMath_VarStateGet(&st->var[i], st->ddof);
+            d[i] = st->op == NREDUCE_STD ? sqrt(v) : v;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,67 @@
+#ifndef NOUR__CORE_SRC_NMATH_REDUCE_STATE_H
+#define NOUR__CORE_SRC_NMATH_REDUCE_STATE_H
+
+#include "nour/nour.h"
+
+/*
+ * Streaming reductions.
+ *
+ * An NReduceState reduces an array that arrives in batches along axis 0,
+ * as if the batches were concatenated there, without keeping them: every
+ * batch goes through the NMath_<Op> kernel and only the per-output partial
+ * results are kept and merged. Axis 0 must be one of the reduced axes
+ * (`na` == 0 reduces all of them). Batches must agree on every axis but
+ * the first and may be empty.
+ *
+ * Results match NMath_<Op> on the concatenated array; float sums, means
+ * and variances may differ in the last bits since items are added in
+ * another order. Argmin/argmax give the index along the flattened reduced
+ * axes, as NMath_Argmin/NMath_Argmax do.
+ */
+
+typedef enum{
+    NREDUCE_SUM = 0,
+    NREDUCE_PROD,
+    NREDUCE_MIN,
+    NREDUCE_MAX,
+    NREDUCE_MEAN,
+    NREDUCE_VAR,
+    NREDUCE_STD,
+    NREDUCE_ARGMIN,
+    NREDUCE_ARGMAX,
+}NReduce_Op;
+
+typedef struct NReduceState NReduceState;
+
+/* New state reducing `axis` (`na` items, 0 for all axes) with `op`. */
+NR_PUBLIC NReduceState*
+NReduceState_New(NReduce_Op op, const int* axis, int na);
+
+/* Same, with the delta degrees of freedom used by NREDUCE_VAR/NREDUCE_STD. */
+NR_PUBLIC NReduceState*
+NReduceState_NewDdof(NReduce_Op op, const int* axis, int na, int ddof);
+
+/*
+ * Folds `batch` into the state. The first batch fixes the dtype and the
+ * shape of the other axes. Returns 0, or -1 with an error raised (the
+ * state is unchanged then).
+ */
+NR_PUBLIC int
+NReduceState_Update(NReduceState* st, Node* batch);
+
+/*
+ * Returns the reduction of every batch so far as a new node, with the
+ * dtype NMath_<Op> gives. The state is left as is, so it can be updated
+ * further and finalized again.
+ */
+NR_PUBLIC Node*
+NReduceState_Finalize(NReduceState* st);
+
+/* Number of rows (items along axis 0) folded in so far. */
+NR_PUBLIC nr_intp
+NReduceState_Rows(const NReduceState* st);
+
+NR_PUBLIC void
+NReduceState_Free(NReduceState* st);
+
+#endif // NOUR__CORE_SRC_NMATH_REDUCE_STATE_H
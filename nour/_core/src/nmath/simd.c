@@ -0,0 +1,648 @@
+#include "simd.h"
+#include "simd_math.h"
+#include "nour/nr_math.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Only x86 has vector loops for now. On other targets every lookup
+ * returns NULL and the kernels keep their scalar loops.
+ *
+ * The loops are compiled with per-function target attributes so the
+ * library itself does not need -mavx2 / -mavx512f and still runs on
+ * older CPUs.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define NSIMD_X86 1
+    #define NSIMD_TARGET(isa) __attribute__((target(isa)))
+    #include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define NSIMD_X86 1
+    #define NSIMD_TARGET(isa)
+    #include <intrin.h>
+    #include <immintrin.h>
+#else
+    #define NSIMD_X86 0
+#endif
+
+NR_PRIVATE NSimd_BinFunc __nsimd_bin_table[NSIMD_NUM_BINOPS][NR_NUM_NUMIRC_DT][NSIMD_BIN_NUM_LAYOUTS];
+NR_PRIVATE NSimd_UnFunc __nsimd_un_table[NSIMD_NUM_UNOPS][NR_NUM_NUMIRC_DT];
+NR_PRIVATE int __nsimd_fast_math = 0;
+NR_PRIVATE NSimd_Level __nsimd_level = NSIMD_LEVEL_NONE;
+NR_PRIVATE NSimd_Level __nsimd_hw_level = NSIMD_LEVEL_NONE;
+NR_PRIVATE int __nsimd_initialized = 0;
+
+#define NSIMD_REGISTER(OP, DT, NAME) do {                     \
+    __nsimd_bin_table[OP][DT][NSIMD_BIN_VV] = NAME##_vv;      \
+    __nsimd_bin_table[OP][DT][NSIMD_BIN_VS] = NAME##_vs;      \
+    __nsimd_bin_table[OP][DT][NSIMD_BIN_SV] = NAME##_sv;      \
+} while (0)
+
+#if NSIMD_X86
+
+/* ======== Loop templates ======== */
+
+/*
+ * Defines NAME_vv, NAME_vs and NAME_sv for an operation whose vector form
+ * produces a vector of the output type.
+ *
+ *  - W: number of items per vector.
+ *  - VT: vector type.
+ *  - LOAD / STORE / SET1: unaligned load, unaligned store and broadcast.
+ *  - VOP: vector operation, VOP(VT, VT) -> VT.
+ *  - SOP: scalar operation used for the tail (one of the NMATH_* macros).
+ *
+ * The main loop is unrolled twice so two independent loads are in flight
+ * per operand, which is what it takes to get close to memory bandwidth.
+ */
+#define NSIMD_BIN_LOOPS(NAME, TGT, T, W, VT, LOAD, STORE, SET1, VOP, SOP)         \
+NSIMD_TARGET(TGT) NR_PRIVATE void                                                 \
+NAME##_vv(const void* a_, const void* b_, void* o_, nr_intp n){                   \
+    const T* a = (const T*)a_;                                                    \
+    const T* b = (const T*)b_;                                                    \
+    T* o = (T*)o_;                                                                \
+    nr_intp i = 0;                                                                \
+    for (; i + 2 * (W) <= n; i += 2 * (W)) {                                      \
+        VT r0 = VOP(LOAD(a + i), LOAD(b + i));                                    \
+        VT r1 = VOP(LOAD(a + i + (W)), LOAD(b + i + (W)));                        \
+        STORE(o + i, r0);                                                         \
+        STORE(o + i + (W), r1);                                                   \
+    }                                                                             \
+    for (; i + (W) <= n; i += (W)) {                                              \
+        STORE(o + i, VOP(LOAD(a + i), LOAD(b + i)));                              \
+    }                                                                             \
+    for (; i < n; i++) {                                                          \
+        o[i] = SOP(a[i], b[i]);                                                   \
+    }                                                                             \
+}                                                                                 \
+NSIMD_TARGET(TGT) NR_PRIVATE void                                                 \
+NAME##_vs(const void* a_, const void* b_, void* o_, nr_intp n){                   \
+    const T* a = (const T*)a_;                                                    \
+    const T s = *(const T*)b_;                                                    \
+    T* o = (T*)o_;                                                                \
+    VT vs = SET1(s);                                                              \
+    nr_intp i = 0;                                                                \
+    for (; i + 2 * (W) <= n; i += 2 * (W)) {                                      \
+        VT r0 = VOP(LOAD(a + i), vs);                                             \
+        VT r1 = VOP(LOAD(a + i + (W)), vs);                                       \
+        STORE(o + i, r0);                                                         \
+        STORE(o + i + (W), r1);                                                   \
+    }                                                                             \
+    for (; i + (W) <= n; i += (W)) {                                              \
+        STORE(o + i, VOP(LOAD(a + i), vs));                                       \
+    }                                                                             \
+    for (; i < n; i++) {                                                          \
+        o[i] = SOP(a[i], s);                                                      \
+    }                                                                             \
+}                                                                                 \
+NSIMD_TARGET(TGT) NR_PRIVATE void                                                 \
+NAME##_sv(const void* a_, const void* b_, void* o_, nr_intp n){                   \
+    const T s = *(const T*)a_;                                                    \
+    const T* b = (const T*)b_;                                                    \
+    T* o = (T*)o_;                                                                \
+    VT vs = SET1(s);                                                              \
+    nr_intp i = 0;                                                                \
+    for (; i + 2 * (W) <= n; i += 2 * (W)) {                                      \
+        VT r0 = VOP(vs, LOAD(b + i));                                             \
+        VT r1 = VOP(vs, LOAD(b + i + (W)));                                       \
+        STORE(o + i, r0);                                                         \
+        STORE(o + i + (W), r1);                                                   \
+    }                                                                             \
+    for (; i + (W) <= n; i += (W)) {                                              \
+        STORE(o + i, VOP(vs, LOAD(b + i)));                                       \
+    }                                                                             \
+    for (; i < n; i++) {                                                          \
+        o[i] = SOP(s, b[i]);                                                      \
+    }                                                                             \
+}
+
+/*
+ * Comparison version of NSIMD_BIN_LOOPS. MASK(VT, VT) returns one bit per
+ * lane which is expanded to nr_bool bytes through __nsimd_mask_bytes.
+ */
+#define NSIMD_CMP_LOOPS(NAME, TGT, T, W, VT, LOAD, SET1, MASK, SOP)               \
+NSIMD_TARGET(TGT) NR_PRIVATE void                                                 \
+NAME##_vv(const void* a_, const void* b_, void* o_, nr_intp n){                   \
+    const T* a = (const T*)a_;                                                    \
+    const T* b = (const T*)b_;                                                    \
+    nr_bool* o = (nr_bool*)o_;                                                    \
+    nr_intp i = 0;                                                                \
+    for (; i + (W) <= n; i += (W)) {                                              \
+        nsimd_store_mask(o + i, (nr_uint32)MASK(LOAD(a + i), LOAD(b + i)), (W));  \
+    }                                                                             \
+    for (; i < n; i++) {                                                          \
+        o[i] = SOP(a[i], b[i]);                                                   \
+    }                                                                             \
+}                                                                                 \
+NSIMD_TARGET(TGT) NR_PRIVATE void                                                 \
+NAME##_vs(const void* a_, const void* b_, void* o_, nr_intp n){                   \
+    const T* a = (const T*)a_;                                                    \
+    const T s = *(const T*)b_;                                                    \
+    nr_bool* o = (nr_bool*)o_;                                                    \
+    VT vs = SET1(s);                                                              \
+    nr_intp i = 0;                                                                \
+    for (; i + (W) <= n; i += (W)) {                                              \
+        nsimd_store_mask(o + i, (nr_uint32)MASK(LOAD(a + i), vs), (W));           \
+    }                                                                             \
+    for (; i < n; i++) {                                                          \
+        o[i] = SOP(a[i], s);                                                      \
+    }                                                                             \
+}                                                                                 \
+NSIMD_TARGET(TGT) NR_PRIVATE void                                                 \
+NAME##_sv(const void* a_, const void* b_, void* o_, nr_intp n){                   \
+    const T s = *(const T*)a_;                                                    \
+    const T* b = (const T*)b_;                                                    \
+    nr_bool* o = (nr_bool*)o_;                                                    \
+    VT vs = SET1(s);                                                              \
+    nr_intp i = 0;                                                                \
+    for (; i + (W) <= n; i += (W)) {                                              \
+        nsimd_store_mask(o + i, (nr_uint32)MASK(vs, LOAD(b + i)), (W));           \
+    }                                                                             \
+    for (; i < n; i++) {                                                          \
+        o[i] = SOP(s, b[i]);                                                      \
+    }                                                                             \
+}
+
+/* byte j of entry m is bit j of m, so one memcpy writes 8 nr_bool values */
+NR_PRIVATE nr_uint64 __nsimd_mask_bytes[256];
+
+NR_STATIC_FINLINE void
+nsimd_store_mask(nr_bool* dst, nr_uint32 mask, int w){
+    while (w > 0) {
+        memcpy(dst, &__nsimd_mask_bytes[mask & 0xff], w < 8 ? w : 8);
+        mask >>= 8;
+        dst += 8;
+        w -= 8;
+    }
+}
+
+NR_PRIVATE void
+nsimd_init_mask_bytes(void){
+    for (int m = 0; m < 256; m++) {
+        nr_uint8 bytes[8];
+        for (int j = 0; j < 8; j++) {
+            bytes[j] = (nr_uint8)((m >> j) & 1);
+        }
+        memcpy(&__nsimd_mask_bytes[m], bytes, 8);
+    }
+}
+
+/* ======== SSE2 ======== */
+
+#define NSIMD_SSE2_LOADI(p) _mm_loadu_si128((const __m128i*)(p))
+#define NSIMD_SSE2_STOREI(p, v) _mm_storeu_si128((__m128i*)(p), v)
+
+#define NSIMD_SSE2_F32(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "sse2", T, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_set1_ps, VOP, SOP)
+#define NSIMD_SSE2_F64(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "sse2", T, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, VOP, SOP)
+#define NSIMD_SSE2_I8(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "sse2", T, 16, __m128i, NSIMD_SSE2_LOADI, NSIMD_SSE2_STOREI, _mm_set1_epi8, VOP, SOP)
+#define NSIMD_SSE2_I16(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "sse2", T, 8, __m128i, NSIMD_SSE2_LOADI, NSIMD_SSE2_STOREI, _mm_set1_epi16, VOP, SOP)
+#define NSIMD_SSE2_I32(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "sse2", T, 4, __m128i, NSIMD_SSE2_LOADI, NSIMD_SSE2_STOREI, _mm_set1_epi32, VOP, SOP)
+#define NSIMD_SSE2_I64(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "sse2", T, 2, __m128i, NSIMD_SSE2_LOADI, NSIMD_SSE2_STOREI, _mm_set1_epi64x, VOP, SOP)
+
+/*
+ * X(OP, DTYPE, C type, layout kind, vector op, scalar op)
+ */
+#define NSIMD_SSE2_LIST(X)                                              \
+    X(Add, NR_FLOAT32, nr_float32, F32, _mm_add_ps, NMATH_ADD)          \
+    X(Sub, NR_FLOAT32, nr_float32, F32, _mm_sub_ps, NMATH_SUB)          \
+    X(Mul, NR_FLOAT32, nr_float32, F32, _mm_mul_ps, NMATH_MUL)          \
+    X(Div, NR_FLOAT32, nr_float32, F32, _mm_div_ps, NMATH_DIV)          \
+    X(Add, NR_FLOAT64, nr_float64, F64, _mm_add_pd, NMATH_ADD)          \
+    X(Sub, NR_FLOAT64, nr_float64, F64, _mm_sub_pd, NMATH_SUB)          \
+    X(Mul, NR_FLOAT64, nr_float64, F64, _mm_mul_pd, NMATH_MUL)          \
+    X(Div, NR_FLOAT64, nr_float64, F64, _mm_div_pd, NMATH_DIV)          \
+    X(Add, NR_INT8,   nr_int8,   I8,  _mm_add_epi8,  NMATH_ADD)         \
+    X(Add, NR_UINT8,  nr_uint8,  I8,  _mm_add_epi8,  NMATH_ADD)         \
+    X(Add, NR_INT16,  nr_int16,  I16, _mm_add_epi16, NMATH_ADD)         \
+    X(Add, NR_UINT16, nr_uint16, I16, _mm_add_epi16, NMATH_ADD)         \
+    X(Add, NR_INT32,  nr_int32,  I32, _mm_add_epi32, NMATH_ADD)         \
+    X(Add, NR_UINT32, nr_uint32, I32, _mm_add_epi32, NMATH_ADD)         \
+    X(Add, NR_INT64,  nr_int64,  I64, _mm_add_epi64, NMATH_ADD)         \
+    X(Add, NR_UINT64, nr_uint64, I64, _mm_add_epi64, NMATH_ADD)         \
+    X(Sub, NR_INT8,   nr_int8,   I8,  _mm_sub_epi8,  NMATH_SUB)         \
+    X(Sub, NR_UINT8,  nr_uint8,  I8,  _mm_sub_epi8,  NMATH_SUB)         \
+    X(Sub, NR_INT16,  nr_int16,  I16, _mm_sub_epi16, NMATH_SUB)         \
+    X(Sub, NR_UINT16, nr_uint16, I16, _mm_sub_epi16, NMATH_SUB)         \
+    X(Sub, NR_INT32,  nr_int32,  I32, _mm_sub_epi32, NMATH_SUB)         \
+    X(Sub, NR_UINT32, nr_uint32, I32, _mm_sub_epi32, NMATH_SUB)         \
+    X(Sub, NR_INT64,  nr_int64,  I64, _mm_sub_epi64, NMATH_SUB)         \
+    X(Sub, NR_UINT64, nr_uint64, I64, _mm_sub_epi64, NMATH_SUB)         \
+    X(Mul, NR_INT16,  nr_int16,  I16, _mm_mullo_epi16, NMATH_MUL)       \
+    X(Mul, NR_UINT16, nr_uint16, I16, _mm_mullo_epi16, NMATH_MUL)       \
+    NSIMD_BITWISE_LIST(X, I8,  _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_BOOL,   nr_bool)   \
+    NSIMD_BITWISE_LIST(X, I8,  _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_INT8,   nr_int8)   \
+    NSIMD_BITWISE_LIST(X, I8,  _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_UINT8,  nr_uint8)  \
+    NSIMD_BITWISE_LIST(X, I16, _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_INT16,  nr_int16)  \
+    NSIMD_BITWISE_LIST(X, I16, _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_UINT16, nr_uint16) \
+    NSIMD_BITWISE_LIST(X, I32, _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_INT32,  nr_int32)  \
+    NSIMD_BITWISE_LIST(X, I32, _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_UINT32, nr_uint32) \
+    NSIMD_BITWISE_LIST(X, I64, _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_INT64,  nr_int64)  \
+    NSIMD_BITWISE_LIST(X, I64, _mm_and_si128, _mm_or_si128, _mm_xor_si128, NR_UINT64, nr_uint64)
+
+/* Bitwise ops do not care about the lane width, only the broadcast does. */
+#define NSIMD_BITWISE_LIST(X, KIND, AND, OR, XOR, DT, T) \
+    X(BitAnd, DT, T, KIND, AND, NMATH_BIT_AND)           \
+    X(BitOr,  DT, T, KIND, OR,  NMATH_BIT_OR)            \
+    X(BitXor, DT, T, KIND, XOR, NMATH_BIT_XOR)
+
+#define NSIMD_SSE2_DEFINE(OP, DT, T, KIND, VOP, SOP) \
+    NSIMD_SSE2_##KIND(nsimd_sse2_##OP##_##T, T, VOP, SOP)
+#define NSIMD_SSE2_REGISTER(OP, DT, T, KIND, VOP, SOP) \
+    NSIMD_REGISTER(NSIMD_OP_##OP, DT, nsimd_sse2_##OP##_##T);
+
+NSIMD_SSE2_LIST(NSIMD_SSE2_DEFINE)
+
+NR_PRIVATE void
+nsimd_register_sse2(void){
+    NSIMD_SSE2_LIST(NSIMD_SSE2_REGISTER)
+}
+
+/* ======== AVX2 ======== */
+
+#define NSIMD_AVX2_LOADI(p) _mm256_loadu_si256((const __m256i*)(p))
+#define NSIMD_AVX2_STOREI(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+
+#define NSIMD_AVX2_F32(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx2", T, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, VOP, SOP)
+#define NSIMD_AVX2_F64(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx2", T, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, VOP, SOP)
+#define NSIMD_AVX2_I8(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx2", T, 32, __m256i, NSIMD_AVX2_LOADI, NSIMD_AVX2_STOREI, _mm256_set1_epi8, VOP, SOP)
+#define NSIMD_AVX2_I16(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx2", T, 16, __m256i, NSIMD_AVX2_LOADI, NSIMD_AVX2_STOREI, _mm256_set1_epi16, VOP, SOP)
+#define NSIMD_AVX2_I32(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx2", T, 8, __m256i, NSIMD_AVX2_LOADI, NSIMD_AVX2_STOREI, _mm256_set1_epi32, VOP, SOP)
+#define NSIMD_AVX2_I64(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx2", T, 4, __m256i, NSIMD_AVX2_LOADI, NSIMD_AVX2_STOREI, _mm256_set1_epi64x, VOP, SOP)
+#define NSIMD_AVX2_CF32(NAME, T, VOP, SOP) \
+    NSIMD_CMP_LOOPS(NAME, "avx2", T, 8, __m256, _mm256_loadu_ps, _mm256_set1_ps, VOP, SOP)
+#define NSIMD_AVX2_CF64(NAME, T, VOP, SOP) \
+    NSIMD_CMP_LOOPS(NAME, "avx2", T, 4, __m256d, _mm256_loadu_pd, _mm256_set1_pd, VOP, SOP)
+
+/* Ordered predicates except for `!=`, which is true on NaN like in C. */
+#define NSIMD_AVX2_BG_PS(a, b)  _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ))
+#define NSIMD_AVX2_BGE_PS(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ))
+#define NSIMD_AVX2_LS_PS(a, b)  _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ))
+#define NSIMD_AVX2_LSE_PS(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ))
+#define NSIMD_AVX2_EQ_PS(a, b)  _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ))
+#define NSIMD_AVX2_NEQ_PS(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NEQ_UQ))
+#define NSIMD_AVX2_BG_PD(a, b)  _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ))
+#define NSIMD_AVX2_BGE_PD(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ))
+#define NSIMD_AVX2_LS_PD(a, b)  _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ))
+#define NSIMD_AVX2_LSE_PD(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ))
+#define NSIMD_AVX2_EQ_PD(a, b)  _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ))
+#define NSIMD_AVX2_NEQ_PD(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ))
+
+#define NSIMD_AVX2_LIST(X)                                                  \
+    X(Add, NR_FLOAT32, nr_float32, F32, _mm256_add_ps, NMATH_ADD)           \
+    X(Sub, NR_FLOAT32, nr_float32, F32, _mm256_sub_ps, NMATH_SUB)           \
+    X(Mul, NR_FLOAT32, nr_float32, F32, _mm256_mul_ps, NMATH_MUL)           \
+    X(Div, NR_FLOAT32, nr_float32, F32, _mm256_div_ps, NMATH_DIV)           \
+    X(Add, NR_FLOAT64, nr_float64, F64, _mm256_add_pd, NMATH_ADD)           \
+    X(Sub, NR_FLOAT64, nr_float64, F64, _mm256_sub_pd, NMATH_SUB)           \
+    X(Mul, NR_FLOAT64, nr_float64, F64, _mm256_mul_pd, NMATH_MUL)           \
+    X(Div, NR_FLOAT64, nr_float64, F64, _mm256_div_pd, NMATH_DIV)           \
+    X(Add, NR_INT8,   nr_int8,   I8,  _mm256_add_epi8,  NMATH_ADD)          \
+    X(Add, NR_UINT8,  nr_uint8,  I8,  _mm256_add_epi8,  NMATH_ADD)          \
+    X(Add, NR_INT16,  nr_int16,  I16, _mm256_add_epi16, NMATH_ADD)          \
+    X(Add, NR_UINT16, nr_uint16, I16, _mm256_add_epi16, NMATH_ADD)          \
+    X(Add, NR_INT32,  nr_int32,  I32, _mm256_add_epi32, NMATH_ADD)          \
+    X(Add, NR_UINT32, nr_uint32, I32, _mm256_add_epi32, NMATH_ADD)          \
+    X(Add, NR_INT64,  nr_int64,  I64, _mm256_add_epi64, NMATH_ADD)          \
+    X(Add, NR_UINT64, nr_uint64, I64, _mm256_add_epi64, NMATH_ADD)          \
+    X(Sub, NR_INT8,   nr_int8,   I8,  _mm256_sub_epi8,  NMATH_SUB)          \
+    X(Sub, NR_UINT8,  nr_uint8,  I8,  _mm256_sub_epi8,  NMATH_SUB)          \
+    X(Sub, NR_INT16,  nr_int16,  I16, _mm256_sub_epi16, NMATH_SUB)          \
+    X(Sub, NR_UINT16, nr_uint16, I16, _mm256_sub_epi16, NMATH_SUB)          \
+    X(Sub, NR_INT32,  nr_int32,  I32, _mm256_sub_epi32, NMATH_SUB)          \
+    X(Sub, NR_UINT32, nr_uint32, I32, _mm256_sub_epi32, NMATH_SUB)          \
+    X(Sub, NR_INT64,  nr_int64,  I64, _mm256_sub_epi64, NMATH_SUB)          \
+    X(Sub, NR_UINT64, nr_uint64, I64, _mm256_sub_epi64, NMATH_SUB)          \
+    X(Mul, NR_INT16,  nr_int16,  I16, _mm256_mullo_epi16, NMATH_MUL)        \
+    X(Mul, NR_UINT16, nr_uint16, I16, _mm256_mullo_epi16, NMATH_MUL)        \
+    X(Mul, NR_INT32,  nr_int32,  I32, _mm256_mullo_epi32, NMATH_MUL)        \
+    X(Mul, NR_UINT32, nr_uint32, I32, _mm256_mullo_epi32, NMATH_MUL)        \
+    X(Bg,  NR_FLOAT32, nr_float32, CF32, NSIMD_AVX2_BG_PS,  NMATH_BG)       \
+    X(Bge, NR_FLOAT32, nr_float32, CF32, NSIMD_AVX2_BGE_PS, NMATH_BGE)      \
+    X(Ls,  NR_FLOAT32, nr_float32, CF32, NSIMD_AVX2_LS_PS,  NMATH_LS)       \
+    X(Lse, NR_FLOAT32, nr_float32, CF32, NSIMD_AVX2_LSE_PS, NMATH_LSE)      \
+    X(Eq,  NR_FLOAT32, nr_float32, CF32, NSIMD_AVX2_EQ_PS,  NMATH_EQ)       \
+    X(Neq, NR_FLOAT32, nr_float32, CF32, NSIMD_AVX2_NEQ_PS, NMATH_NEQ)      \
+    X(Bg,  NR_FLOAT64, nr_float64, CF64, NSIMD_AVX2_BG_PD,  NMATH_BG)       \
+    X(Bge, NR_FLOAT64, nr_float64, CF64, NSIMD_AVX2_BGE_PD, NMATH_BGE)      \
+    X(Ls,  NR_FLOAT64, nr_float64, CF64, NSIMD_AVX2_LS_PD,  NMATH_LS)       \
+    X(Lse, NR_FLOAT64, nr_float64, CF64, NSIMD_AVX2_LSE_PD, NMATH_LSE)      \
+    X(Eq,  NR_FLOAT64, nr_float64, CF64, NSIMD_AVX2_EQ_PD,  NMATH_EQ)       \
+    X(Neq, NR_FLOAT64, nr_float64, CF64, NSIMD_AVX2_NEQ_PD, NMATH_NEQ)      \
+    NSIMD_BITWISE_LIST(X, I8,  _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_BOOL,   nr_bool)   \
+    NSIMD_BITWISE_LIST(X, I8,  _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_INT8,   nr_int8)   \
+    NSIMD_BITWISE_LIST(X, I8,  _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_UINT8,  nr_uint8)  \
+    NSIMD_BITWISE_LIST(X, I16, _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_INT16,  nr_int16)  \
+    NSIMD_BITWISE_LIST(X, I16, _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_UINT16, nr_uint16) \
+    NSIMD_BITWISE_LIST(X, I32, _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_INT32,  nr_int32)  \
+    NSIMD_BITWISE_LIST(X, I32, _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_UINT32, nr_uint32) \
+    NSIMD_BITWISE_LIST(X, I64, _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_INT64,  nr_int64)  \
+    NSIMD_BITWISE_LIST(X, I64, _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, NR_UINT64, nr_uint64)
+
+#define NSIMD_AVX2_DEFINE(OP, DT, T, KIND, VOP, SOP) \
+    NSIMD_AVX2_##KIND(nsimd_avx2_##OP##_##T, T, VOP, SOP)
+#define NSIMD_AVX2_REGISTER(OP, DT, T, KIND, VOP, SOP) \
+    NSIMD_REGISTER(NSIMD_OP_##OP, DT, nsimd_avx2_##OP##_##T);
+
+NSIMD_AVX2_LIST(NSIMD_AVX2_DEFINE)
+
+NR_PRIVATE void
+nsimd_register_avx2(void){
+    NSIMD_AVX2_LIST(NSIMD_AVX2_REGISTER)
+}
+
+/* ======== AVX-512 ======== */
+
+/*
+ * Only AVX-512F is assumed, so 8 and 16 bit lanes (which need AVX-512BW)
+ * keep their AVX2 loops.
+ */
+#define NSIMD_AVX512_LOADI(p) _mm512_loadu_si512((const void*)(p))
+#define NSIMD_AVX512_STOREI(p, v) _mm512_storeu_si512((void*)(p), v)
+
+#define NSIMD_AVX512_F32(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx512f", T, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps, VOP, SOP)
+#define NSIMD_AVX512_F64(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx512f", T, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd, VOP, SOP)
+#define NSIMD_AVX512_I32(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx512f", T, 16, __m512i, NSIMD_AVX512_LOADI, NSIMD_AVX512_STOREI, _mm512_set1_epi32, VOP, SOP)
+#define NSIMD_AVX512_I64(NAME, T, VOP, SOP) \
+    NSIMD_BIN_LOOPS(NAME, "avx512f", T, 8, __m512i, NSIMD_AVX512_LOADI, NSIMD_AVX512_STOREI, _mm512_set1_epi64, VOP, SOP)
+#define NSIMD_AVX512_CF32(NAME, T, VOP, SOP) \
+    NSIMD_CMP_LOOPS(NAME, "avx512f", T, 16, __m512, _mm512_loadu_ps, _mm512_set1_ps, VOP, SOP)
+#define NSIMD_AVX512_CF64(NAME, T, VOP, SOP) \
+    NSIMD_CMP_LOOPS(NAME, "avx512f", T, 8, __m512d, _mm512_loadu_pd, _mm512_set1_pd, VOP, SOP)
+
+#define NSIMD_AVX512_BG_PS(a, b)  _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ)
+#define NSIMD_AVX512_BGE_PS(a, b) _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ)
+#define NSIMD_AVX512_LS_PS(a, b)  _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ)
+#define NSIMD_AVX512_LSE_PS(a, b) _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ)
+#define NSIMD_AVX512_EQ_PS(a, b)  _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ)
+#define NSIMD_AVX512_NEQ_PS(a, b) _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ)
+#define NSIMD_AVX512_BG_PD(a, b)  _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ)
+#define NSIMD_AVX512_BGE_PD(a, b) _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ)
+#define NSIMD_AVX512_LS_PD(a, b)  _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ)
+#define NSIMD_AVX512_LSE_PD(a, b) _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ)
+#define NSIMD_AVX512_EQ_PD(a, b)  _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ)
+#define NSIMD_AVX512_NEQ_PD(a, b) _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ)
+
+#define NSIMD_AVX512_LIST(X)                                                \
+    X(Add, NR_FLOAT32, nr_float32, F32, _mm512_add_ps, NMATH_ADD)           \
+    X(Sub, NR_FLOAT32, nr_float32, F32, _mm512_sub_ps, NMATH_SUB)           \
+    X(Mul, NR_FLOAT32, nr_float32, F32, _mm512_mul_ps, NMATH_MUL)           \
+    X(Div, NR_FLOAT32, nr_float32, F32, _mm512_div_ps, NMATH_DIV)           \
+    X(Add, NR_FLOAT64, nr_float64, F64, _mm512_add_pd, NMATH_ADD)           \
+    X(Sub, NR_FLOAT64, nr_float64, F64, _mm512_sub_pd, NMATH_SUB)           \
+    X(Mul, NR_FLOAT64, nr_float64, F64, _mm512_mul_pd, NMATH_MUL)           \
+    X(Div, NR_FLOAT64, nr_float64, F64, _mm512_div_pd, NMATH_DIV)           \
+    X(Add, NR_INT32,  nr_int32,  I32, _mm512_add_epi32, NMATH_ADD)          \
+    X(Add, NR_UINT32, nr_uint32, I32, _mm512_add_epi32, NMATH_ADD)          \
+    X(Add, NR_INT64,  nr_int64,  I64, _mm512_add_epi64, NMATH_ADD)          \
+    X(Add, NR_UINT64, nr_uint64, I64, _mm512_add_epi64, NMATH_ADD)          \
+    X(Sub, NR_INT32,  nr_int32,  I32, _mm512_sub_epi32, NMATH_SUB)          \
+    X(Sub, NR_UINT32, nr_uint32, I32, _mm512_sub_epi32, NMATH_SUB)          \
+    X(Sub, NR_INT64,  nr_int64,  I64, _mm512_sub_epi64, NMATH_SUB)          \
+    X(Sub, NR_UINT64, nr_uint64, I64, _mm512_sub_epi64, NMATH_SUB)          \
+    X(Mul, NR_INT32,  nr_int32,  I32, _mm512_mullo_epi32, NMATH_MUL)        \
+    X(Mul, NR_UINT32, nr_uint32, I32, _mm512_mullo_epi32, NMATH_MUL)        \
+    X(Bg,  NR_FLOAT32, nr_float32, CF32, NSIMD_AVX512_BG_PS,  NMATH_BG)     \
+    X(Bge, NR_FLOAT32, nr_float32, CF32, NSIMD_AVX512_BGE_PS, NMATH_BGE)    \
+    X(Ls,  NR_FLOAT32, nr_float32, CF32, NSIMD_AVX512_LS_PS,  NMATH_LS)     \
+    X(Lse, NR_FLOAT32, nr_float32, CF32, NSIMD_AVX512_LSE_PS, NMATH_LSE)    \
+    X(Eq,  NR_FLOAT32, nr_float32, CF32, NSIMD_AVX512_EQ_PS,  NMATH_EQ)     \
+    X(Neq, NR_FLOAT32, nr_float32, CF32, NSIMD_AVX512_NEQ_PS, NMATH_NEQ)    \
+    X(Bg,  NR_FLOAT64, nr_float64, CF64, NSIMD_AVX512_BG_PD,  NMATH_BG)     \
+    X(Bge, NR_FLOAT64, nr_float64, CF64, NSIMD_AVX512_BGE_PD, NMATH_BGE)    \
+    X(Ls,  NR_FLOAT64, nr_float64, CF64, NSIMD_AVX512_LS_PD,  NMATH_LS)     \
+    X(Lse, NR_FLOAT64, nr_float64, CF64, NSIMD_AVX512_LSE_PD, NMATH_LSE)    \
+    X(Eq,  NR_FLOAT64, nr_float64, CF64, NSIMD_AVX512_EQ_PD,  NMATH_EQ)     \
+    X(Neq, NR_FLOAT64, nr_float64, CF64, NSIMD_AVX512_NEQ_PD, NMATH_NEQ)    \
+    NSIMD_BITWISE_LIST(X, I32, _mm512_and_si512, _mm512_or_si512, _mm512_xor_si512, NR_INT32,  nr_int32)  \
+    NSIMD_BITWISE_LIST(X, I32, _mm512_and_si512, _mm512_or_si512, _mm512_xor_si512, NR_UINT32, nr_uint32) \
+    NSIMD_BITWISE_LIST(X, I64, _mm512_and_si512, _mm512_or_si512, _mm512_xor_si512, NR_INT64,  nr_int64)  \
+    NSIMD_BITWISE_LIST(X, I64, _mm512_and_si512, _mm512_or_si512, _mm512_xor_si512, NR_UINT64, nr_uint64)
+
+#define NSIMD_AVX512_DEFINE(OP, DT, T, KIND, VOP, SOP) \
+    NSIMD_AVX512_##KIND(nsimd_avx512_##OP##_##T, T, VOP, SOP)
+#define NSIMD_AVX512_REGISTER(OP, DT, T, KIND, VOP, SOP) \
+    NSIMD_REGISTER(NSIMD_OP_##OP, DT, nsimd_avx512_##OP##_##T);
+
+NSIMD_AVX512_LIST(NSIMD_AVX512_DEFINE)
+
+NR_PRIVATE void
+nsimd_register_avx512(void){
+    NSIMD_AVX512_LIST(NSIMD_AVX512_REGISTER)
+}
+
+/* ======== CPU detection ======== */
+
+NR_PRIVATE NSimd_Level
+nsimd_detect_hardware(void){
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    int max_leaf = regs[0];
+
+    __cpuid(regs, 1);
+    int has_sse2 = (regs[3] >> 26) & 1;
+    int has_osxsave = (regs[2] >> 27) & 1;
+    int has_avx = (regs[2] >> 28) & 1;
+    int has_fma = (regs[2] >> 12) & 1;
+    unsigned long long xcr0 = has_osxsave ? _xgetbv(0) : 0;
+
+    int has_avx2 = 0, has_avx512f = 0;
+    if (max_leaf >= 7) {
+        __cpuidex(regs, 7, 0);
+        has_avx2 = (regs[1] >> 5) & 1;
+        has_avx512f = (regs[1] >> 16) & 1;
+    }
+
+    /* the OS must save the YMM (and ZMM/opmask) state across switches */
+    int os_ymm = (xcr0 & 0x6) == 0x6;
+    int os_zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (has_avx512f && has_fma && os_zmm) {
+        return NSIMD_LEVEL_AVX512;
+    }
+    if (has_avx && has_avx2 && has_fma && os_ymm) {
+        return NSIMD_LEVEL_AVX2;
+    }
+    return has_sse2 ? NSIMD_LEVEL_SSE2 : NSIMD_LEVEL_NONE;
+#else
+    /* libgcc also checks that the OS enabled the wider register state */
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("fma")) {
+        return NSIMD_LEVEL_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return NSIMD_LEVEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return NSIMD_LEVEL_SSE2;
+    }
+    return NSIMD_LEVEL_NONE;
+#endif
+}
+
+#endif // NSIMD_X86
+
+/* ======== Dispatch ======== */
+
+/*
+ * name: nsimd_env_level
+ * Reads the `NR_SIMD` cap. Unknown values are ignored.
+ */
+NR_PRIVATE NSimd_Level
+nsimd_env_level(NSimd_Level fallback){
+    const char* env = getenv("NR_SIMD");
+    if (!env) {
+        return fallback;
+    }
+    if (strcmp(env, "none") == 0) {
+        return NSIMD_LEVEL_NONE;
+    }
+    if (strcmp(env, "sse2") == 0) {
+        return NSIMD_LEVEL_SSE2;
+    }
+    if (strcmp(env, "avx2") == 0) {
+        return NSIMD_LEVEL_AVX2;
+    }
+    if (strcmp(env, "avx512") == 0) {
+        return NSIMD_LEVEL_AVX512;
+    }
+    return fallback;
+}
+
+/*
+ * name: nsimd_build_table
+ * Fills the dispatch table from the lowest level up so every entry ends up
+ * pointing at the widest loop available at `level`.
+ */
+NR_PRIVATE void
+nsimd_build_table(NSimd_Level level){
+    memset(__nsimd_bin_table, 0, sizeof(__nsimd_bin_table));
+    memset(__nsimd_un_table, 0, sizeof(__nsimd_un_table));
+#if NSIMD_X86
+    nsimd_init_mask_bytes();
+    if (level >= NSIMD_LEVEL_SSE2) {
+        nsimd_register_sse2();
+    }
+    if (level >= NSIMD_LEVEL_AVX2) {
+        nsimd_register_avx2();
+        NSimd_RegisterMathAVX2(__nsimd_un_table, __nsimd_fast_math);
+    }
+    if (level >= NSIMD_LEVEL_AVX512) {
+        nsimd_register_avx512();
+    }
+#endif
+    __nsimd_level = level;
+}
+
+NR_PRIVATE void
+nsimd_init(void){
+#if NSIMD_X86
+    __nsimd_hw_level = nsimd_detect_hardware();
+#else
+    __nsimd_hw_level = NSIMD_LEVEL_NONE;
+#endif
+    const char* fast = getenv("NR_FAST_MATH");
+    __nsimd_fast_math = fast && fast[0] != '\0' && strcmp(fast, "0") != 0;
+    NSimd_Level level = nsimd_env_level(__nsimd_hw_level);
+    nsimd_build_table(NR_MIN(level, __nsimd_hw_level));
+}
+
+/*
+ * name: nsimd_ensure_init
+ * Builds the table once. `__nsimd_initialized` goes 0 -> 1 (building) ->
+ * 2 (ready), so threads that race on the first lookup wait for the winner
+ * instead of reading a half-filled table.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+NR_PRIVATE void
+nsimd_ensure_init(void){
+    if (__atomic_load_n(&__nsimd_initialized, __ATOMIC_ACQUIRE) == 2) {
+        return;
+    }
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&__nsimd_initialized, &expected, 1, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        nsimd_init();
+        __atomic_store_n(&__nsimd_initialized, 2, __ATOMIC_RELEASE);
+        return;
+    }
+    while (__atomic_load_n(&__nsimd_initialized, __ATOMIC_ACQUIRE) != 2) {
+        // detection and table setup take microseconds
+    }
+}
+#else
+NR_PRIVATE void
+nsimd_ensure_init(void){
+    if (__nsimd_initialized != 2) {
+        nsimd_init();
+        __nsimd_initialized = 2;
+    }
+}
+#endif
+
+NR_PUBLIC NSimd_Level
+NSimd_GetLevel(void){
+    nsimd_ensure_init();
+    return __nsimd_level;
+}
+
+NR_PUBLIC NSimd_Level
+NSimd_GetHardwareLevel(void){
+    nsimd_ensure_init();
+    return __nsimd_hw_level;
+}
+
+NR_PUBLIC NSimd_Level
+NSimd_SetLevel(NSimd_Level level){
+    nsimd_ensure_init();
+    nsimd_build_table(NR_MIN(level, __nsimd_hw_level));
+    return __nsimd_level;
+}
+
+NR_PUBLIC NSimd_BinFunc
+NSimd_BinaryFunc(NSimd_BinOp op, NR_DTYPE dtype, NSimd_BinLayout layout){
+    nsimd_ensure_init();
+    if (dtype < 0 || dtype >= NR_NUM_NUMIRC_DT) {
+        return NULL;
+    }
+    return __nsimd_bin_table[op][dtype][layout];
+}
+
+NR_PUBLIC NSimd_UnFunc
+NSimd_UnaryFunc(NSimd_UnOp op, NR_DTYPE dtype){
+    nsimd_ensure_init();
+    if (dtype < 0 || dtype >= NR_NUM_NUMIRC_DT) {
+        return NULL;
+    }
+    return __nsimd_un_table[op][dtype];
+}
+
+NR_PUBLIC int
+NSimd_SetFastMath(int enable){
+    nsimd_ensure_init();
+    int prev = __nsimd_fast_math;
+    __nsimd_fast_math = enable ? 1 : 0;
+    nsimd_build_table(__nsimd_level);
+    return prev;
+}
+
+NR_PUBLIC int
+NSimd_GetFastMath(void){
+    nsimd_ensure_init();
+    return __nsimd_fast_math;
+}
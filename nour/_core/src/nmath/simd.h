@@ -0,0 +1,157 @@
+#ifndef NOUR__CORE_SRC_NMATH_SIMD_H
+#define NOUR__CORE_SRC_NMATH_SIMD_H
+
+#include "nour/nour.h"
+
+/*
+ * Runtime-dispatched SIMD loops for the binary elementwise kernels.
+ *
+ * The instruction set is detected once from CPUID the first time a loop is
+ * requested. The `NR_SIMD` environment variable ("none", "sse2", "avx2",
+ * "avx512") caps the level, which is useful for benchmarking and for
+ * testing the scalar fallback on a machine that has the wider units.
+ *
+ * Unary float loops (exp, log, tanh, ...) live in simd_math.c and need
+ * AVX2 with FMA.
+ *
+ * A loop is looked up by operation, input dtype and operand layout. A NULL
+ * result means there is no vector version and the caller must use its own
+ * scalar loop (NMATH_LOOP_* in loops.h).
+ */
+
+/* Instruction set levels. A higher level implies all the lower ones. */
+typedef enum{
+    NSIMD_LEVEL_NONE = 0,
+    NSIMD_LEVEL_SSE2,
+    NSIMD_LEVEL_AVX2,
+    NSIMD_LEVEL_AVX512,
+}NSimd_Level;
+
+/*
+ * Operand layouts of a binary loop.
+ *  - VV: both inputs are contiguous buffers of `n` items.
+ *  - VS: the first input is a buffer, the second one a single item.
+ *  - SV: the first input is a single item, the second one a buffer.
+ * The output is always a contiguous buffer of `n` items.
+ */
+typedef enum{
+    NSIMD_BIN_VV = 0,
+    NSIMD_BIN_VS,
+    NSIMD_BIN_SV,
+    NSIMD_BIN_NUM_LAYOUTS
+}NSimd_BinLayout;
+
+/*
+ * Binary operations, named after the OP_NAME used by
+ * DEFINE_BIN_EWISE_KERNEL in nfunc_math.c so the kernels can paste
+ * `NSIMD_OP_##OP_NAME`.
+ */
+typedef enum{
+    NSIMD_OP_Add = 0,
+    NSIMD_OP_Sub,
+    NSIMD_OP_Mul,
+    NSIMD_OP_Div,
+    NSIMD_OP_TrueDiv,
+    NSIMD_OP_Mod,
+    NSIMD_OP_Pow,
+    NSIMD_OP_Bg,
+    NSIMD_OP_Bge,
+    NSIMD_OP_Ls,
+    NSIMD_OP_Lse,
+    NSIMD_OP_Eq,
+    NSIMD_OP_Neq,
+    NSIMD_OP_BitAnd,
+    NSIMD_OP_BitOr,
+    NSIMD_OP_BitXor,
+    NSIMD_OP_BitLSH,
+    NSIMD_OP_BitRSH,
+    NSIMD_NUM_BINOPS
+}NSimd_BinOp;
+
+typedef void (*NSimd_BinFunc)(const void* a, const void* b, void* out, nr_intp n);
+
+/*
+ * Unary float operations, named after the OP_NAME used by
+ * UN_EWISE_FLOAT_TYPES in nfunc_math.c.
+ */
+typedef enum{
+    NSIMD_UOP_Sin = 0,
+    NSIMD_UOP_Cos,
+    NSIMD_UOP_Tan,
+    NSIMD_UOP_Cot,
+    NSIMD_UOP_Exp,
+    NSIMD_UOP_Log,
+    NSIMD_UOP_Sinh,
+    NSIMD_UOP_Cosh,
+    NSIMD_UOP_Tanh,
+    NSIMD_UOP_Coth,
+    NSIMD_UOP_Asin,
+    NSIMD_UOP_Acos,
+    NSIMD_UOP_Atan,
+    NSIMD_UOP_Asinh,
+    NSIMD_UOP_Acosh,
+    NSIMD_UOP_Atanh,
+    NSIMD_UOP_Exp2,
+    NSIMD_UOP_Expm1,
+    NSIMD_UOP_Log10,
+    NSIMD_UOP_Log1p,
+    NSIMD_UOP_Sqrt,
+    NSIMD_UOP_Cbrt,
+    NSIMD_UOP_Ceil,
+    NSIMD_UOP_Floor,
+    NSIMD_UOP_Trunc,
+    NSIMD_UOP_Rint,
+    NSIMD_NUM_UNOPS
+}NSimd_UnOp;
+
+typedef void (*NSimd_UnFunc)(const void* in, void* out, nr_intp n);
+
+/*
+ * Returns the level used by the dispatch table, detecting it on first use.
+ */
+NR_PUBLIC NSimd_Level
+NSimd_GetLevel(void);
+
+/*
+ * Returns the highest level supported by the running CPU and OS,
+ * ignoring `NR_SIMD` and NSimd_SetLevel.
+ */
+NR_PUBLIC NSimd_Level
+NSimd_GetHardwareLevel(void);
+
+/*
+ * Rebuilds the dispatch table for `level`, clamped to the hardware level.
+ * Returns the level actually in use. The table is shared by all threads:
+ * do not call this while other threads run kernels.
+ */
+NR_PUBLIC NSimd_Level
+NSimd_SetLevel(NSimd_Level level);
+
+/*
+ * Returns the vector loop for `op` on inputs of type `dtype` with the given
+ * operand layout, or NULL when there is none at the current level.
+ */
+NR_PUBLIC NSimd_BinFunc
+NSimd_BinaryFunc(NSimd_BinOp op, NR_DTYPE dtype, NSimd_BinLayout layout);
+
+/*
+ * Returns the vector loop for the unary float operation `op` on
+ * contiguous buffers of `dtype`, or NULL when there is none. Accuracy
+ * bounds of each loop are listed in simd_math.c.
+ */
+NR_PUBLIC NSimd_UnFunc
+NSimd_UnaryFunc(NSimd_UnOp op, NR_DTYPE dtype);
+
+/*
+ * Enables (1) or disables (0) the fast-math variants of the unary loops.
+ * They trade a few ULP and subnormal handling for speed. The
+ * `NR_FAST_MATH` environment variable sets the initial value. Returns the
+ * previous setting. Like NSimd_SetLevel it rebuilds the shared table.
+ */
+NR_PUBLIC int
+NSimd_SetFastMath(int enable);
+
+NR_PUBLIC int
+NSimd_GetFastMath(void);
+
+#endif // NOUR__CORE_SRC_NMATH_SIMD_H
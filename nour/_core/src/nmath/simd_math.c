@@ -0,0 +1,727 @@
+/*
+ * Vectorized transcendental functions for the float unary kernels.
+ *
+ * Every function is written for AVX2 + FMA and registered into the unary
+ * dispatch table of simd.c through NSimd_RegisterMathAVX2. Machines with
+ * AVX-512 use these loops as well.
+ *
+ * Method
+ * ------
+ *  - exp:   x = n*ln2 + r with |r| <= ln2/2 (Cody-Waite, two-part ln2),
+ *           polynomial in r, scaled by 2^n through the exponent bits.
+ *  - expm1: same reduction, expm1(r) polynomial, then
+ *           expm1(x) = 2^n * expm1(r) + (2^n - 1), which has no
+ *           cancellation for small x.
+ *  - log:   x = 2^e * m with m in [sqrt(1/2), sqrt(2)), log(m) from a
+ *           polynomial in f = m - 1 (float32, Cephes) or in
+ *           s = f / (2 + f) (float64, fdlibm), plus e*ln2 in two parts.
+ *  - tanh:  tanh(|x|) = e / (e + 2) with e = expm1(2|x|), sign restored.
+ *  - sin, cos: x = n*pi/2 + r with |r| <= pi/4 (Cody-Waite, three-part
+ *           pi/2), sin or cos polynomial in r (Cephes for float32, fdlibm
+ *           for float64) picked and signed by n mod 4. Inputs past 8192
+ *           (float32) or 1e6 (float64) and remainders close to a multiple
+ *           of pi/2, where the reduction loses bits, go to libm.
+ *  - sqrt, ceil, floor, trunc, rint: the exact hardware instructions.
+ *
+ * Accuracy
+ * --------
+ * Maximum error in ULP against libm evaluated in the next wider type.
+ * float32 was checked on every 16th bit pattern (2^28 inputs), float64
+ * on 4M inputs spread over the whole range and around 0 and 1.
+ *
+ *                  default        fast
+ *   exp   f32      1.1            2.9
+ *   expm1 f32      1.7            8.8
+ *   log   f32      0.9            0.9
+ *   tanh  f32      2.4            7.5
+ *   sin   f32      1.6            1.6
+ *   cos   f32      1.6            1.6
+ *   exp   f64      1.0            2.4
+ *   expm1 f64      1.8            7.6
+ *   log   f64      0.9            0.9
+ *   tanh  f64      2.5            5.9
+ *   sin   f64      2.4            2.4
+ *   cos   f64      2.4            2.4
+ *
+ * sqrt and the rounding functions are exact in both modes.
+ *
+ * Special values
+ * --------------
+ * In the default mode, lanes the polynomial path does not cover (exp
+ * and expm1 overflow, NaN, zero, negative, subnormal or infinite log
+ * inputs, and sin/cos inputs outside the reduction range) are recomputed
+ * with libm, so they follow C99 Annex F. The check costs one compare and
+ * one movemask per vector, and the scalar path only runs when such a lane
+ * is present.
+ *
+ * Fast mode (NSimd_SetFastMath / NR_FAST_MATH=1) drops one polynomial
+ * term in exp/expm1, uses an approximate reciprocal in float32 tanh and replaces
+ * the libm fallback by blends for inf, NaN and out of range inputs.
+ * sin and cos only blend inf and NaN; large arguments still use libm.
+ * Subnormal log inputs are treated as zero.
+ */
+#include "simd_math.h"
+#include "nour/nr_math.h"
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define NSIMD_MATH_X86 1
+    #define NSIMD_MATH_TARGET __attribute__((target("avx2,fma")))
+    #include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define NSIMD_MATH_X86 1
+    #define NSIMD_MATH_TARGET
+    #include <immintrin.h>
+#else
+    #define NSIMD_MATH_X86 0
+#endif
+
+#if NSIMD_MATH_X86
+
+#if defined(_MSC_VER)
+    #define NSIMD_MATH_INLINE static __forceinline
+#else
+    #define NSIMD_MATH_INLINE static inline __attribute__((always_inline)) NSIMD_MATH_TARGET
+#endif
+
+/*
+ * Recomputes the lanes of `res` selected by `bad` with the scalar libm
+ * function. Only taken when at least one lane is selected.
+ */
+#define NSIMD_FIXUP_PS(res, x, bad, SCALAR) do {                    \
+    int __m = _mm256_movemask_ps(bad);                              \
+    if (__m) {                                                      \
+        float __x[8], __r[8];                                       \
+        _mm256_storeu_ps(__x, x);                                   \
+        _mm256_storeu_ps(__r, res);                                 \
+        for (int __j = 0; __j < 8; __j++) {                         \
+            if (__m & (1 << __j)) __r[__j] = SCALAR(__x[__j]);      \
+        }                                                           \
+        res = _mm256_loadu_ps(__r);                                 \
+    }                                                               \
+} while (0)
+
+#define NSIMD_FIXUP_PD(res, x, bad, SCALAR) do {                    \
+    int __m = _mm256_movemask_pd(bad);                              \
+    if (__m) {                                                      \
+        double __x[4], __r[4];                                      \
+        _mm256_storeu_pd(__x, x);                                   \
+        _mm256_storeu_pd(__r, res);                                 \
+        for (int __j = 0; __j < 4; __j++) {                         \
+            if (__m & (1 << __j)) __r[__j] = SCALAR(__x[__j]);      \
+        }                                                           \
+        res = _mm256_loadu_pd(__r);                                 \
+    }                                                               \
+} while (0)
+
+/* ======== float32 ======== */
+
+#define NSIMD_LN2_HI_F 0.693359375f
+#define NSIMD_LN2_LO_F -2.12194440e-4f
+#define NSIMD_LOG2E_F 1.44269504088896341f
+
+/* 2^n for integral n in [-126, 127] */
+NSIMD_MATH_INLINE __m256
+nsimd_pow2i_ps(__m256 n){
+    __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+}
+
+/* n = round(x / ln2), r = x - n*ln2 */
+NSIMD_MATH_INLINE __m256
+nsimd_reduce_ln2_ps(__m256 x, __m256* r){
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(NSIMD_LOG2E_F)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 t = _mm256_fnmadd_ps(n, _mm256_set1_ps(NSIMD_LN2_HI_F), x);
+    *r = _mm256_fnmadd_ps(n, _mm256_set1_ps(NSIMD_LN2_LO_F), t);
+    return n;
+}
+
+/* e^r - 1 for |r| <= ln2/2 */
+NSIMD_MATH_INLINE __m256
+nsimd_expm1_poly_ps(__m256 r, int fast){
+    __m256 p;
+    if (fast) {
+        p = _mm256_set1_ps(1.0f / 720.0f);
+    } else {
+        p = _mm256_set1_ps(1.0f / 5040.0f);
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 720.0f));
+    }
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 120.0f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 24.0f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 6.0f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(0.5f));
+    return _mm256_fmadd_ps(_mm256_mul_ps(p, r), r, r);
+}
+
+NSIMD_MATH_INLINE __m256
+nsimd_exp_ps(__m256 x, int fast){
+    /* largest x with a finite result, and the point below which it rounds to 0 */
+    const __m256 hi = _mm256_set1_ps(88.72283172607421875f);
+    const __m256 lo = _mm256_set1_ps(-103.97f);
+    __m256 xc = _mm256_max_ps(_mm256_min_ps(x, hi), lo);
+
+    __m256 r;
+    __m256 n = nsimd_reduce_ln2_ps(xc, &r);
+    __m256 p = _mm256_add_ps(nsimd_expm1_poly_ps(r, fast), _mm256_set1_ps(1.0f));
+
+    /*
+     * Scale in two steps, 2^n1 * 2^(n-n1) with n1 = floor(n/2), so both
+     * factors stay normal at n = 128 and for subnormal results.
+     */
+    __m256 n1 = _mm256_floor_ps(_mm256_mul_ps(n, _mm256_set1_ps(0.5f)));
+    __m256 res = _mm256_mul_ps(_mm256_mul_ps(p, nsimd_pow2i_ps(n1)),
+                               nsimd_pow2i_ps(_mm256_sub_ps(n, n1)));
+
+    if (fast) {
+        res = _mm256_blendv_ps(res, _mm256_set1_ps(NR_INFF), _mm256_cmp_ps(x, hi, _CMP_GT_OQ));
+        res = _mm256_blendv_ps(res, _mm256_setzero_ps(), _mm256_cmp_ps(x, lo, _CMP_LT_OQ));
+        res = _mm256_blendv_ps(res, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+    } else {
+        __m256 bad = _mm256_or_ps(_mm256_cmp_ps(x, hi, _CMP_NLE_UQ),
+                                  _mm256_cmp_ps(x, lo, _CMP_NGE_UQ));
+        NSIMD_FIXUP_PS(res, x, bad, nr_expf);
+    }
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256
+nsimd_expm1_ps(__m256 x, int fast){
+    /* below -17 the result rounds to -1, which the clamp already gives */
+    const __m256 hi = _mm256_set1_ps(88.0f);
+    const __m256 lo = _mm256_set1_ps(-17.0f);
+    __m256 xc = _mm256_max_ps(_mm256_min_ps(x, hi), lo);
+
+    __m256 r;
+    __m256 n = nsimd_reduce_ln2_ps(xc, &r);
+    __m256 p = nsimd_expm1_poly_ps(r, fast);
+    __m256 s = nsimd_pow2i_ps(n);
+    __m256 res = _mm256_fmadd_ps(s, p, _mm256_sub_ps(s, _mm256_set1_ps(1.0f)));
+
+    if (fast) {
+        __m256 big = _mm256_cmp_ps(x, hi, _CMP_GT_OQ);
+        if (_mm256_movemask_ps(big)) {
+            __m256 e = _mm256_sub_ps(nsimd_exp_ps(x, 1), _mm256_set1_ps(1.0f));
+            res = _mm256_blendv_ps(res, e, big);
+        }
+        res = _mm256_blendv_ps(res, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+    } else {
+        __m256 bad = _mm256_cmp_ps(x, hi, _CMP_NLE_UQ);
+        NSIMD_FIXUP_PS(res, x, bad, nr_expm1f);
+    }
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256
+nsimd_log_ps(__m256 x, int fast){
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 min_norm = _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000));
+    __m256 xc = _mm256_max_ps(x, min_norm);
+
+    /* x = 2^e * m, m in [0.5, 1) */
+    __m256i xi = _mm256_castps_si256(xc);
+    __m256i ei = _mm256_sub_epi32(_mm256_srli_epi32(xi, 23), _mm256_set1_epi32(126));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(xi, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000)));
+    __m256 e = _mm256_cvtepi32_ps(ei);
+
+    /* move m into [sqrt(1/2), sqrt(2)) */
+    __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+    e = _mm256_sub_ps(e, _mm256_and_ps(one, small));
+    __m256 f = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(m, small)), one);
+
+    __m256 z = _mm256_mul_ps(f, f);
+    __m256 p = _mm256_set1_ps(7.0376836292e-2f);
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(-1.1514610310e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.1676998740e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(-1.2420140846e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.4249322787e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(-1.6668057665e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(2.0000714765e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(-2.4999993993e-1f));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(3.3333331174e-1f));
+
+    __m256 y = _mm256_mul_ps(_mm256_mul_ps(p, f), z);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(NSIMD_LN2_LO_F), y);
+    y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, y);
+    __m256 res = _mm256_add_ps(f, y);
+    res = _mm256_fmadd_ps(e, _mm256_set1_ps(NSIMD_LN2_HI_F), res);
+
+    if (fast) {
+        res = _mm256_blendv_ps(res, _mm256_set1_ps(-NR_INFF),
+                               _mm256_cmp_ps(x, min_norm, _CMP_LT_OQ));
+        res = _mm256_blendv_ps(res, _mm256_set1_ps(NAN),
+                               _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+        res = _mm256_blendv_ps(res, x, _mm256_cmp_ps(x, _mm256_set1_ps(NR_INFF), _CMP_EQ_OQ));
+        res = _mm256_blendv_ps(res, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+    } else {
+        __m256 bad = _mm256_or_ps(_mm256_cmp_ps(x, min_norm, _CMP_NGE_UQ),
+                                  _mm256_cmp_ps(x, _mm256_set1_ps(NR_INFF), _CMP_EQ_OQ));
+        NSIMD_FIXUP_PS(res, x, bad, nr_logf);
+    }
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256
+nsimd_tanh_ps(__m256 x, int fast){
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 a = _mm256_andnot_ps(sign, x);
+
+    /* past 2|x| = 40 the quotient below is exactly 1 */
+    __m256 a2 = _mm256_min_ps(_mm256_add_ps(a, a), _mm256_set1_ps(40.0f));
+    __m256 e = nsimd_expm1_ps(a2, fast);
+    __m256 d = _mm256_add_ps(e, _mm256_set1_ps(2.0f));
+    __m256 t;
+    if (fast) {
+        __m256 rcp = _mm256_rcp_ps(d);
+        rcp = _mm256_mul_ps(rcp, _mm256_fnmadd_ps(d, rcp, _mm256_set1_ps(2.0f)));
+        t = _mm256_mul_ps(e, rcp);
+    } else {
+        t = _mm256_div_ps(e, d);
+    }
+    t = _mm256_or_ps(t, _mm256_and_ps(sign, x));
+    return _mm256_blendv_ps(t, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+}
+
+/* pi/2 in three parts, the first two with short mantissas */
+#define NSIMD_PIO2_1_F 1.5703125f
+#define NSIMD_PIO2_2_F 4.837512969970703125e-4f
+#define NSIMD_PIO2_3_F 7.54978995489188216e-8f
+#define NSIMD_2OPI_F 0.636619772367581343f
+/* beyond this |x| the three-part reduction loses bits and libm takes over */
+#define NSIMD_TRIG_MAX_F 8192.0f
+/* remainders this small after a nonzero quotient are near a multiple of pi/2 */
+#define NSIMD_TRIG_TINY_F 2.0e-3f
+
+/*
+ * sin(x + q*pi/2) for q = 0 (sin) or 1 (cos). Lanes the reduction does
+ * not cover are flagged in `bad`.
+ */
+NSIMD_MATH_INLINE __m256
+nsimd_sincos_ps(__m256 x, int q, __m256* bad){
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 a = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(NSIMD_2OPI_F)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(NSIMD_PIO2_1_F), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(NSIMD_PIO2_2_F), r);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(NSIMD_PIO2_3_F), r);
+    __m256 z = _mm256_mul_ps(r, r);
+
+    /* Cephes sinf / cosf kernels on [-pi/4, pi/4] */
+    __m256 s = _mm256_fmadd_ps(_mm256_set1_ps(-1.9515295891e-4f), z, _mm256_set1_ps(8.3321608736e-3f));
+    s = _mm256_fmadd_ps(s, z, _mm256_set1_ps(-1.6666654611e-1f));
+    s = _mm256_fmadd_ps(_mm256_mul_ps(s, z), r, r);
+    __m256 c = _mm256_fmadd_ps(_mm256_set1_ps(2.443315711809948e-5f), z, _mm256_set1_ps(-1.388731625493765e-3f));
+    c = _mm256_fmadd_ps(c, z, _mm256_set1_ps(4.166664568298827e-2f));
+    c = _mm256_fmadd_ps(c, _mm256_mul_ps(z, z), _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, one));
+
+    /* odd quadrants take the cosine kernel, quadrants 2 and 3 flip the sign */
+    __m256i k = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(q));
+    __m256i k1 = _mm256_and_si256(k, _mm256_set1_epi32(1));
+    __m256 res = _mm256_blendv_ps(s, c, _mm256_castsi256_ps(_mm256_cmpeq_epi32(k1, _mm256_set1_epi32(1))));
+    __m256i flip = _mm256_slli_epi32(_mm256_and_si256(k, _mm256_set1_epi32(2)), 30);
+    res = _mm256_xor_ps(res, _mm256_castsi256_ps(flip));
+
+    *bad = _mm256_or_ps(_mm256_cmp_ps(a, _mm256_set1_ps(NSIMD_TRIG_MAX_F), _CMP_NLE_UQ),
+                        _mm256_and_ps(_mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), r),
+                                                    _mm256_set1_ps(NSIMD_TRIG_TINY_F), _CMP_LT_OQ),
+                                      _mm256_cmp_ps(a, _mm256_set1_ps(0.5f), _CMP_GT_OQ)));
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256
+nsimd_sin_ps(__m256 x, int fast){
+    __m256 bad;
+    __m256 res = nsimd_sincos_ps(x, 0, &bad);
+    /* keeps the sign of a zero input */
+    res = _mm256_blendv_ps(res, x, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_EQ_OQ));
+    if (fast) {
+        __m256 nf = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x),
+                                  _mm256_set1_ps(NR_INFF), _CMP_NLT_UQ);
+        res = _mm256_blendv_ps(res, _mm256_sub_ps(x, x), nf);
+        bad = _mm256_andnot_ps(nf, bad);
+    }
+    NSIMD_FIXUP_PS(res, x, bad, nr_sinf);
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256
+nsimd_cos_ps(__m256 x, int fast){
+    __m256 bad;
+    __m256 res = nsimd_sincos_ps(x, 1, &bad);
+    if (fast) {
+        __m256 nf = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x),
+                                  _mm256_set1_ps(NR_INFF), _CMP_NLT_UQ);
+        res = _mm256_blendv_ps(res, _mm256_sub_ps(x, x), nf);
+        bad = _mm256_andnot_ps(nf, bad);
+    }
+    NSIMD_FIXUP_PS(res, x, bad, nr_cosf);
+    return res;
+}
+
+/* ======== float64 ======== */
+
+#define NSIMD_LN2_HI 6.93147180369123816490e-01
+#define NSIMD_LN2_LO 1.90821492927058770002e-10
+#define NSIMD_LOG2E 1.44269504088896338700e+00
+
+#define NSIMD_LG1 6.666666666666735130e-01
+#define NSIMD_LG2 3.999999999940941908e-01
+#define NSIMD_LG3 2.857142874366239149e-01
+#define NSIMD_LG4 2.222219843214978396e-01
+#define NSIMD_LG5 1.818357216161805012e-01
+#define NSIMD_LG6 1.531383769920937332e-01
+#define NSIMD_LG7 1.479819860511658591e-01
+
+/* 2^n for integral n in [-1022, 1023] */
+NSIMD_MATH_INLINE __m256d
+nsimd_pow2i_pd(__m256d n){
+    /* adding 1.5*2^52 leaves n in the low mantissa bits */
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+    __m256i ni = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, magic)),
+                                  _mm256_castpd_si256(magic));
+    __m256i e = _mm256_add_epi64(ni, _mm256_set1_epi64x(1023));
+    return _mm256_castsi256_pd(_mm256_slli_epi64(e, 52));
+}
+
+NSIMD_MATH_INLINE __m256d
+nsimd_reduce_ln2_pd(__m256d x, __m256d* r){
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(NSIMD_LOG2E)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d t = _mm256_fnmadd_pd(n, _mm256_set1_pd(NSIMD_LN2_HI), x);
+    *r = _mm256_fnmadd_pd(n, _mm256_set1_pd(NSIMD_LN2_LO), t);
+    return n;
+}
+
+/* e^r - 1 for |r| <= ln2/2, Taylor coefficients 1/k! */
+NSIMD_MATH_INLINE __m256d
+nsimd_expm1_poly_pd(__m256d r, int fast){
+    __m256d p;
+    if (fast) {
+        p = _mm256_set1_pd(1.0 / 479001600.0);
+    } else {
+        p = _mm256_set1_pd(1.0 / 6227020800.0);
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 479001600.0));
+    }
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 39916800.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 3628800.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 362880.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 40320.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 5040.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 720.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 120.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 24.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 6.0));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(0.5));
+    return _mm256_fmadd_pd(_mm256_mul_pd(p, r), r, r);
+}
+
+NSIMD_MATH_INLINE __m256d
+nsimd_exp_pd(__m256d x, int fast){
+    /* largest x with a finite result, and the point below which it rounds to 0 */
+    const __m256d hi = _mm256_set1_pd(709.782712893383);
+    const __m256d lo = _mm256_set1_pd(-745.13);
+    __m256d xc = _mm256_max_pd(_mm256_min_pd(x, hi), lo);
+
+    __m256d r;
+    __m256d n = nsimd_reduce_ln2_pd(xc, &r);
+    __m256d p = _mm256_add_pd(nsimd_expm1_poly_pd(r, fast), _mm256_set1_pd(1.0));
+    /* two-step scaling as in nsimd_exp_ps */
+    __m256d n1 = _mm256_floor_pd(_mm256_mul_pd(n, _mm256_set1_pd(0.5)));
+    __m256d res = _mm256_mul_pd(_mm256_mul_pd(p, nsimd_pow2i_pd(n1)),
+                                nsimd_pow2i_pd(_mm256_sub_pd(n, n1)));
+
+    if (fast) {
+        res = _mm256_blendv_pd(res, _mm256_set1_pd(NR_INF), _mm256_cmp_pd(x, hi, _CMP_GT_OQ));
+        res = _mm256_blendv_pd(res, _mm256_setzero_pd(), _mm256_cmp_pd(x, lo, _CMP_LT_OQ));
+        res = _mm256_blendv_pd(res, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+    } else {
+        __m256d bad = _mm256_or_pd(_mm256_cmp_pd(x, hi, _CMP_NLE_UQ),
+                                   _mm256_cmp_pd(x, lo, _CMP_NGE_UQ));
+        NSIMD_FIXUP_PD(res, x, bad, nr_exp);
+    }
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256d
+nsimd_expm1_pd(__m256d x, int fast){
+    /* below -38 the result rounds to -1, which the clamp already gives */
+    const __m256d hi = _mm256_set1_pd(709.0);
+    const __m256d lo = _mm256_set1_pd(-38.0);
+    __m256d xc = _mm256_max_pd(_mm256_min_pd(x, hi), lo);
+
+    __m256d r;
+    __m256d n = nsimd_reduce_ln2_pd(xc, &r);
+    __m256d p = nsimd_expm1_poly_pd(r, fast);
+    __m256d s = nsimd_pow2i_pd(n);
+    __m256d res = _mm256_fmadd_pd(s, p, _mm256_sub_pd(s, _mm256_set1_pd(1.0)));
+
+    if (fast) {
+        __m256d big = _mm256_cmp_pd(x, hi, _CMP_GT_OQ);
+        if (_mm256_movemask_pd(big)) {
+            __m256d e = _mm256_sub_pd(nsimd_exp_pd(x, 1), _mm256_set1_pd(1.0));
+            res = _mm256_blendv_pd(res, e, big);
+        }
+        res = _mm256_blendv_pd(res, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+    } else {
+        __m256d bad = _mm256_cmp_pd(x, hi, _CMP_NLE_UQ);
+        NSIMD_FIXUP_PD(res, x, bad, nr_expm1);
+    }
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256d
+nsimd_log_pd(__m256d x, int fast){
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d min_norm = _mm256_castsi256_pd(_mm256_set1_epi64x(0x0010000000000000LL));
+    __m256d xc = _mm256_max_pd(x, min_norm);
+
+    /* x = 2^e * m, m in [1, 2) */
+    __m256i xi = _mm256_castpd_si256(xc);
+    __m256i ebits = _mm256_srli_epi64(xi, 52);
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+        _mm256_and_si256(xi, _mm256_set1_epi64x(0x000fffffffffffffLL)),
+        _mm256_set1_epi64x(0x3ff0000000000000LL)));
+    /* exponent bits are < 2^11, so they convert exactly through the magic constant */
+    const __m256d magic = _mm256_set1_pd(4503599627370496.0);
+    __m256d e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(ebits, _mm256_castpd_si256(magic))), magic);
+    e = _mm256_sub_pd(e, _mm256_set1_pd(1023.0));
+
+    /* move m into [sqrt(1/2), sqrt(2)) */
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(1.41421356237309504880), _CMP_GE_OQ);
+    e = _mm256_add_pd(e, _mm256_and_pd(one, big));
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+
+    __m256d f = _mm256_sub_pd(m, one);
+    __m256d s = _mm256_div_pd(f, _mm256_add_pd(f, _mm256_set1_pd(2.0)));
+    __m256d z = _mm256_mul_pd(s, s);
+    __m256d w = _mm256_mul_pd(z, z);
+
+    /* R = t1 + t2, fdlibm's Lg1..Lg7 series in z split into even and odd terms */
+    __m256d t1 = _mm256_fmadd_pd(w, _mm256_set1_pd(NSIMD_LG6), _mm256_set1_pd(NSIMD_LG4));
+    t1 = _mm256_mul_pd(w, _mm256_fmadd_pd(w, t1, _mm256_set1_pd(NSIMD_LG2)));
+    __m256d t2 = _mm256_fmadd_pd(w, _mm256_set1_pd(NSIMD_LG7), _mm256_set1_pd(NSIMD_LG5));
+    t2 = _mm256_fmadd_pd(w, t2, _mm256_set1_pd(NSIMD_LG3));
+    t2 = _mm256_mul_pd(z, _mm256_fmadd_pd(w, t2, _mm256_set1_pd(NSIMD_LG1)));
+    __m256d R = _mm256_add_pd(t1, t2);
+    __m256d hfsq = _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(f, f));
+
+    /* log(x) = e*ln2_hi - ((hfsq - (s*(hfsq + R) + e*ln2_lo)) - f) */
+    __m256d q = _mm256_fmadd_pd(s, _mm256_add_pd(hfsq, R), _mm256_mul_pd(e, _mm256_set1_pd(NSIMD_LN2_LO)));
+    __m256d res = _mm256_sub_pd(_mm256_sub_pd(hfsq, q), f);
+    res = _mm256_fmsub_pd(e, _mm256_set1_pd(NSIMD_LN2_HI), res);
+
+    if (fast) {
+        res = _mm256_blendv_pd(res, _mm256_set1_pd(-NR_INF),
+                               _mm256_cmp_pd(x, min_norm, _CMP_LT_OQ));
+        res = _mm256_blendv_pd(res, _mm256_set1_pd(NAN),
+                               _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ));
+        res = _mm256_blendv_pd(res, x, _mm256_cmp_pd(x, _mm256_set1_pd(NR_INF), _CMP_EQ_OQ));
+        res = _mm256_blendv_pd(res, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+    } else {
+        __m256d bad = _mm256_or_pd(_mm256_cmp_pd(x, min_norm, _CMP_NGE_UQ),
+                                   _mm256_cmp_pd(x, _mm256_set1_pd(NR_INF), _CMP_EQ_OQ));
+        NSIMD_FIXUP_PD(res, x, bad, nr_log);
+    }
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256d
+nsimd_tanh_pd(__m256d x, int fast){
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d a = _mm256_andnot_pd(sign, x);
+
+    /* past 2|x| = 40 the quotient below is exactly 1 */
+    __m256d a2 = _mm256_min_pd(_mm256_add_pd(a, a), _mm256_set1_pd(40.0));
+    __m256d e = nsimd_expm1_pd(a2, fast);
+    __m256d t = _mm256_div_pd(e, _mm256_add_pd(e, _mm256_set1_pd(2.0)));
+    t = _mm256_or_pd(t, _mm256_and_pd(sign, x));
+    return _mm256_blendv_pd(t, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+}
+
+/* pi/2 in three 33-bit parts (fdlibm pio2_1, pio2_2, pio2_3) */
+#define NSIMD_PIO2_1 1.57079632673412561417e+00
+#define NSIMD_PIO2_2 6.07710050630396597660e-11
+#define NSIMD_PIO2_3 2.02226624871116645580e-21
+#define NSIMD_2OPI 6.36619772367581382433e-01
+/* keeps the quotient below 2^20, so n * NSIMD_PIO2_1 is exact */
+#define NSIMD_TRIG_MAX 1.0e6
+/* remainders this small after a nonzero quotient are near a multiple of pi/2 */
+#define NSIMD_TRIG_TINY 1.0e-8
+
+/* fdlibm __kernel_sin / __kernel_cos coefficients */
+#define NSIMD_S1 -1.66666666666666324348e-01
+#define NSIMD_S2 8.33333333332248946124e-03
+#define NSIMD_S3 -1.98412698298579493134e-04
+#define NSIMD_S4 2.75573137070700676789e-06
+#define NSIMD_S5 -2.50507602534068634195e-08
+#define NSIMD_S6 1.58969099521155010221e-10
+#define NSIMD_C1 4.16666666666666019037e-02
+#define NSIMD_C2 -1.38888888888741095749e-03
+#define NSIMD_C3 2.48015872894767294178e-05
+#define NSIMD_C4 -2.75573143513906633035e-07
+#define NSIMD_C5 2.08757232129817482790e-09
+#define NSIMD_C6 -1.13596475577881948265e-11
+
+/* see nsimd_sincos_ps */
+NSIMD_MATH_INLINE __m256d
+nsimd_sincos_pd(__m256d x, int q, __m256d* bad){
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d a = _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(NSIMD_2OPI)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(NSIMD_PIO2_1), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(NSIMD_PIO2_2), r);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(NSIMD_PIO2_3), r);
+    __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d s = _mm256_fmadd_pd(_mm256_set1_pd(NSIMD_S6), z, _mm256_set1_pd(NSIMD_S5));
+    s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(NSIMD_S4));
+    s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(NSIMD_S3));
+    s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(NSIMD_S2));
+    s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(NSIMD_S1));
+    s = _mm256_fmadd_pd(_mm256_mul_pd(s, z), r, r);
+
+    /* cos(r) = w + ((1 - w) - z/2 + z^2 * C(z)) with w = 1 - z/2, as in fdlibm */
+    __m256d c = _mm256_fmadd_pd(_mm256_set1_pd(NSIMD_C6), z, _mm256_set1_pd(NSIMD_C5));
+    c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(NSIMD_C4));
+    c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(NSIMD_C3));
+    c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(NSIMD_C2));
+    c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(NSIMD_C1));
+    __m256d hz = _mm256_mul_pd(_mm256_set1_pd(0.5), z);
+    __m256d w = _mm256_sub_pd(one, hz);
+    c = _mm256_fmadd_pd(_mm256_mul_pd(z, z), c, _mm256_sub_pd(_mm256_sub_pd(one, w), hz));
+    c = _mm256_add_pd(w, c);
+
+    /* the magic constant leaves n in the low mantissa bits */
+    __m256i k = _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(6755399441055744.0)));
+    k = _mm256_add_epi64(k, _mm256_set1_epi64x(q));
+    __m256i k1 = _mm256_and_si256(k, _mm256_set1_epi64x(1));
+    __m256d res = _mm256_blendv_pd(s, c, _mm256_castsi256_pd(_mm256_cmpeq_epi64(k1, _mm256_set1_epi64x(1))));
+    __m256i flip = _mm256_slli_epi64(_mm256_and_si256(k, _mm256_set1_epi64x(2)), 62);
+    res = _mm256_xor_pd(res, _mm256_castsi256_pd(flip));
+
+    *bad = _mm256_or_pd(_mm256_cmp_pd(a, _mm256_set1_pd(NSIMD_TRIG_MAX), _CMP_NLE_UQ),
+                        _mm256_and_pd(_mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), r),
+                                                    _mm256_set1_pd(NSIMD_TRIG_TINY), _CMP_LT_OQ),
+                                      _mm256_cmp_pd(a, _mm256_set1_pd(0.5), _CMP_GT_OQ)));
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256d
+nsimd_sin_pd(__m256d x, int fast){
+    __m256d bad;
+    __m256d res = nsimd_sincos_pd(x, 0, &bad);
+    res = _mm256_blendv_pd(res, x, _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_EQ_OQ));
+    if (fast) {
+        __m256d nf = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), x),
+                                   _mm256_set1_pd(NR_INF), _CMP_NLT_UQ);
+        res = _mm256_blendv_pd(res, _mm256_sub_pd(x, x), nf);
+        bad = _mm256_andnot_pd(nf, bad);
+    }
+    NSIMD_FIXUP_PD(res, x, bad, nr_sin);
+    return res;
+}
+
+NSIMD_MATH_INLINE __m256d
+nsimd_cos_pd(__m256d x, int fast){
+    __m256d bad;
+    __m256d res = nsimd_sincos_pd(x, 1, &bad);
+    if (fast) {
+        __m256d nf = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), x),
+                                   _mm256_set1_pd(NR_INF), _CMP_NLT_UQ);
+        res = _mm256_blendv_pd(res, _mm256_sub_pd(x, x), nf);
+        bad = _mm256_andnot_pd(nf, bad);
+    }
+    NSIMD_FIXUP_PD(res, x, bad, nr_cos);
+    return res;
+}
+
+/* ======== Exact operations ======== */
+
+#define NSIMD_CEIL  (_MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC)
+#define NSIMD_FLOOR (_MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)
+#define NSIMD_TRUNC (_MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)
+#define NSIMD_RINT  (_MM_FROUND_CUR_DIRECTION)
+
+NSIMD_MATH_INLINE __m256 nsimd_ceil_ps(__m256 x, int fast){ (void)fast; return _mm256_round_ps(x, NSIMD_CEIL); }
+NSIMD_MATH_INLINE __m256 nsimd_floor_ps(__m256 x, int fast){ (void)fast; return _mm256_round_ps(x, NSIMD_FLOOR); }
+NSIMD_MATH_INLINE __m256 nsimd_trunc_ps(__m256 x, int fast){ (void)fast; return _mm256_round_ps(x, NSIMD_TRUNC); }
+NSIMD_MATH_INLINE __m256 nsimd_rint_ps(__m256 x, int fast){ (void)fast; return _mm256_round_ps(x, NSIMD_RINT); }
+NSIMD_MATH_INLINE __m256 nsimd_sqrt_ps(__m256 x, int fast){ (void)fast; return _mm256_sqrt_ps(x); }
+NSIMD_MATH_INLINE __m256d nsimd_ceil_pd(__m256d x, int fast){ (void)fast; return _mm256_round_pd(x, NSIMD_CEIL); }
+NSIMD_MATH_INLINE __m256d nsimd_floor_pd(__m256d x, int fast){ (void)fast; return _mm256_round_pd(x, NSIMD_FLOOR); }
+NSIMD_MATH_INLINE __m256d nsimd_trunc_pd(__m256d x, int fast){ (void)fast; return _mm256_round_pd(x, NSIMD_TRUNC); }
+NSIMD_MATH_INLINE __m256d nsimd_rint_pd(__m256d x, int fast){ (void)fast; return _mm256_round_pd(x, NSIMD_RINT); }
+NSIMD_MATH_INLINE __m256d nsimd_sqrt_pd(__m256d x, int fast){ (void)fast; return _mm256_sqrt_pd(x); }
+
+/* ======== Loops ======== */
+
+/*
+ * The tail is run through the same vector code on a padded copy so an
+ * item gets the same result whatever its position in the buffer.
+ */
+#define NSIMD_UN_LOOP(NAME, T, W, VT, LOAD, STORE, VFUNC, FAST)                   \
+NSIMD_MATH_TARGET NR_PRIVATE void                                                 \
+NAME(const void* in_, void* out_, nr_intp n){                                     \
+    const T* in = (const T*)in_;                                                  \
+    T* out = (T*)out_;                                                            \
+    nr_intp i = 0;                                                                \
+    for (; i + (W) <= n; i += (W)) {                                              \
+        STORE(out + i, VFUNC(LOAD(in + i), FAST));                                \
+    }                                                                             \
+    if (i < n) {                                                                  \
+        T tmp[W];                                                                 \
+        for (int j = 0; j < (W); j++) {                                           \
+            tmp[j] = (T)1;                                                        \
+        }                                                                         \
+        memcpy(tmp, in + i, (size_t)(n - i) * sizeof(T));                         \
+        STORE(tmp, VFUNC(LOAD(tmp), FAST));                                       \
+        memcpy(out + i, tmp, (size_t)(n - i) * sizeof(T));                        \
+    }                                                                             \
+}
+
+#define NSIMD_UN_LOOPS(OP, FUNC)                                                                          \
+    NSIMD_UN_LOOP(nsimd_avx2_##OP##_nr_float32, nr_float32, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, nsimd_##FUNC##_ps, 0) \
+    NSIMD_UN_LOOP(nsimd_avx2_##OP##_nr_float64, nr_float64, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, nsimd_##FUNC##_pd, 0) \
+    NSIMD_UN_LOOP(nsimd_avx2_fast_##OP##_nr_float32, nr_float32, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, nsimd_##FUNC##_ps, 1) \
+    NSIMD_UN_LOOP(nsimd_avx2_fast_##OP##_nr_float64, nr_float64, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, nsimd_##FUNC##_pd, 1)
+
+#define NSIMD_MATH_LIST(X) \
+    X(Exp, exp)            \
+    X(Expm1, expm1)        \
+    X(Log, log)            \
+    X(Tanh, tanh)          \
+    X(Sin, sin)            \
+    X(Cos, cos)            \
+    X(Sqrt, sqrt)          \
+    X(Ceil, ceil)          \
+    X(Floor, floor)        \
+    X(Trunc, trunc)        \
+    X(Rint, rint)
+
+NSIMD_MATH_LIST(NSIMD_UN_LOOPS)
+
+#define NSIMD_MATH_REGISTER(OP, FUNC)                                                     \
+    table[NSIMD_UOP_##OP][NR_FLOAT32] = fast ? nsimd_avx2_fast_##OP##_nr_float32          \
+                                             : nsimd_avx2_##OP##_nr_float32;              \
+    table[NSIMD_UOP_##OP][NR_FLOAT64] = fast ? nsimd_avx2_fast_##OP##_nr_float64          \
+                                             : nsimd_avx2_##OP##_nr_float64;
+
+NR_PUBLIC void
+NSimd_RegisterMathAVX2(NSimd_UnFunc table[NSIMD_NUM_UNOPS][NR_NUM_NUMIRC_DT], int fast){
+    NSIMD_MATH_LIST(NSIMD_MATH_REGISTER)
+}
+
+#else
+
+NR_PUBLIC void
+NSimd_RegisterMathAVX2(NSimd_UnFunc table[NSIMD_NUM_UNOPS][NR_NUM_NUMIRC_DT], int fast){
+    (void)table;
+    (void)fast;
+}
+
+#endif // NSIMD_MATH_X86
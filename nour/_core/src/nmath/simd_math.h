@@ -0,0 +1,14 @@
+#ifndef NOUR__CORE_SRC_NMATH_SIMD_MATH_H
+#define NOUR__CORE_SRC_NMATH_SIMD_MATH_H
+
+#include "simd.h"
+
+/*
+ * Fills the float32/float64 entries of the unary dispatch table with the
+ * AVX2 + FMA loops of simd_math.c, using the fast-math variants when
+ * `fast` is set. Called by simd.c; does nothing on non-x86 targets.
+ */
+NR_PUBLIC void
+NSimd_RegisterMathAVX2(NSimd_UnFunc table[NSIMD_NUM_UNOPS][NR_NUM_NUMIRC_DT], int fast);
+
+#endif // NOUR__CORE_SRC_NMATH_SIMD_MATH_H
@@ -0,0 +1,384 @@
+#include "nmem.h"
+#include "nerror.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if NR_UNIX
+    #define NMEM_POSIX_MEMALIGN 1
+#else
+    #define NMEM_POSIX_MEMALIGN 0
+#endif
+
+/* The counters and the cache are shared by all threads */
+#if defined(__GNUC__) || defined(__clang__)
+    #define NMEM_ADD(ptr, v) __atomic_add_fetch(ptr, v, __ATOMIC_RELAXED)
+    #define NMEM_SUB(ptr, v) __atomic_sub_fetch(ptr, v, __ATOMIC_RELAXED)
+    #define NMEM_LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+    #define NMEM_STORE(ptr, v) __atomic_store_n(ptr, v, __ATOMIC_RELAXED)
+    #define NMEM_LOCK(flag) while (__atomic_test_and_set(flag, __ATOMIC_ACQUIRE)) {}
+    #define NMEM_UNLOCK(flag) __atomic_clear(flag, __ATOMIC_RELEASE)
+#else
+    #define NMEM_ADD(ptr, v) (*(ptr) += (v))
+    #define NMEM_SUB(ptr, v) (*(ptr) -= (v))
+    #define NMEM_LOAD(ptr) (*(ptr))
+    #define NMEM_STORE(ptr, v) (*(ptr) = (v))
+    #define NMEM_LOCK(flag)
+    #define NMEM_UNLOCK(flag)
+#endif
+
+/* ------------------------------------------------------------------------ */
+/* Default allocator                                                        */
+/* ------------------------------------------------------------------------ */
+
+NR_PRIVATE void*
+nmem_default_alloc(NR_UNUSED(void* ctx), nr_size_t size, nr_size_t alignment){
+#if NMEM_POSIX_MEMALIGN
+    void* ptr = NULL;
+    if (alignment < sizeof(void*)) {
+        alignment = sizeof(void*);
+    }
+    return posix_memalign(&ptr, alignment, size) == 0 ? ptr : NULL;
+#else
+    // no free()-compatible aligned allocation here, malloc's alignment it is
+    (void)alignment;
+    return malloc(size);
+#endif
+}
+
+NR_PRIVATE void
+nmem_default_free(NR_UNUSED(void* ctx), void* ptr, NR_UNUSED(nr_size_t size)){
+    free(ptr);
+}
+
+NR_PRIVATE void*
+nmem_default_realloc(void* ctx, void* ptr, nr_size_t old_size,
+                     nr_size_t new_size, nr_size_t alignment){
+    void* out = nmem_default_alloc(ctx, new_size, alignment);
+    if (!out) {
+        return NULL;
+    }
+    memcpy(out, ptr, old_size < new_size ? old_size : new_size);
+    free(ptr);
+    return out;
+}
+
+NR_PRIVATE NMem_Allocator __nmem_allocator = {
+    .ctx = NULL,
+    .alloc = nmem_default_alloc,
+    .realloc = nmem_default_realloc,
+    .free = nmem_default_free,
+};
+
+NR_PRIVATE NMem_Stats __nmem_stats = {0};
+
+/* ------------------------------------------------------------------------ */
+/* Size classes and buffer cache                                            */
+/* ------------------------------------------------------------------------ */
+
+/*
+ * Blocks up to 1 KiB are rounded up to a multiple of 64 bytes, larger
+ * ones up to NMEM_CACHE_MAX_BLOCK to a quarter of their power of two
+ * (1280, 1536, 1792, 2048, 2560, ...), so any cached block of a class
+ * serves any request of that class and less than a fifth of a large block
+ * is slack. Rounding does not depend on whether the cache is on, so a block
+ * is always freed with the size it was allocated with.
+ */
+#define NMEM_SMALL_CLASSES 16
+#define NMEM_SMALL_STEP 64
+#define NMEM_NUM_CLASSES (NMEM_SMALL_CLASSES + 4 * 16)
+
+typedef struct nmem_free_block{
+    struct nmem_free_block* next;
+}nmem_free_block;
+
+typedef struct{
+    char lock;
+    nr_size_t limit;
+    nmem_free_block* heads[NMEM_NUM_CLASSES];
+}nmem_cache;
+
+NR_PRIVATE nmem_cache __nmem_cache = {
+    .lock = 0,
+    .limit = NMEM_CACHE_DEFAULT_LIMIT,
+};
+
+/* Returns the class of `size` (>= 1), or -1 for blocks that are not cached */
+NR_STATIC_INLINE int
+nmem_class(nr_size_t size){
+    if (size <= NMEM_SMALL_CLASSES * NMEM_SMALL_STEP) {
+        return (int)((size + NMEM_SMALL_STEP - 1) / NMEM_SMALL_STEP) - 1;
+    }
+    if (size > NMEM_CACHE_MAX_BLOCK) {
+        return -1;
+    }
+    int p = 10;
+    while (((nr_size_t)1 << (p + 1)) < size) {
+        p++;
+    }
+    nr_size_t step = (nr_size_t)1 << (p - 2);
+    int k = (int)((size + step - 1) / step);
+    return NMEM_SMALL_CLASSES + (p - 10) * 4 + (k - 5);
+}
+
+NR_STATIC_INLINE nr_size_t
+nmem_class_size(int cls){
+    if (cls < NMEM_SMALL_CLASSES) {
+        return (nr_size_t)(cls + 1) * NMEM_SMALL_STEP;
+    }
+    int p = 10 + (cls - NMEM_SMALL_CLASSES) / 4;
+    int k = 5 + (cls - NMEM_SMALL_CLASSES) % 4;
+    return (nr_size_t)k << (p - 2);
+}
+
+/* Size handed to the allocator for a request of `size` bytes */
+NR_STATIC_INLINE nr_size_t
+nmem_block_size(nr_size_t size){
+    int cls = nmem_class(size);
+    return cls < 0 ? size : nmem_class_size(cls);
+}
+
+/* Pops a cached block of class `cls`, or returns NULL */
+NR_PRIVATE void*
+nmem_cache_pop(int cls){
+    nmem_cache* c = &__nmem_cache;
+    NMEM_LOCK(&c->lock);
+    nmem_free_block* b = c->heads[cls];
+    if (b) {
+        c->heads[cls] = b->next;
+        NMEM_SUB(&__nmem_stats.cached_bytes, (nr_uint64)nmem_class_size(cls));
+    }
+    NMEM_UNLOCK(&c->lock);
+    return b;
+}
+
+/* Caches a block of class `cls`, returns 0 if the cache is full */
+NR_PRIVATE int
+nmem_cache_push(int cls, void* ptr){
+    nmem_cache* c = &__nmem_cache;
+    nr_size_t size = nmem_class_size(cls);
+    NMEM_LOCK(&c->lock);
+    if (NMEM_LOAD(&__nmem_stats.cached_bytes) + size > c->limit) {
+        NMEM_UNLOCK(&c->lock);
+        return 0;
+    }
+    nmem_free_block* b = (nmem_free_block*)ptr;
+    b->next = c->heads[cls];
+    c->heads[cls] = b;
+    NMEM_ADD(&__nmem_stats.cached_bytes, (nr_uint64)size);
+    NMEM_UNLOCK(&c->lock);
+    return 1;
+}
+
+/* Releases cached blocks, largest classes first, until at most `keep` bytes remain */
+NR_PRIVATE void
+nmem_cache_trim(nr_size_t keep){
+    for (int cls = NMEM_NUM_CLASSES - 1; cls >= 0; cls--) {
+        void* b;
+        while (NMEM_LOAD(&__nmem_stats.cached_bytes) > keep && (b = nmem_cache_pop(cls))) {
+            __nmem_allocator.free(__nmem_allocator.ctx, b, nmem_class_size(cls));
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* Statistics                                                               */
+/* ------------------------------------------------------------------------ */
+
+NR_PRIVATE void
+nmem_count_alloc(nr_size_t size){
+    nr_uint64 in_use = NMEM_ADD(&__nmem_stats.bytes_in_use, (nr_uint64)size);
+    NMEM_ADD(&__nmem_stats.total_bytes, (nr_uint64)size);
+#if defined(__GNUC__) || defined(__clang__)
+    nr_uint64 peak = NMEM_LOAD(&__nmem_stats.peak_bytes);
+    while (in_use > peak &&
+           !__atomic_compare_exchange_n(&__nmem_stats.peak_bytes, &peak, in_use, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+#else
+    if (in_use > __nmem_stats.peak_bytes) {
+        __nmem_stats.peak_bytes = in_use;
+    }
+#endif
+}
+
+/* Zero-byte requests still get a unique block */
+NR_STATIC_INLINE nr_size_t
+nmem_real_size(nr_size_t size){
+    return size ? size : 1;
+}
+
+/* Takes a block for `size` (>= 1) bytes from the cache or the allocator */
+NR_PRIVATE void*
+nmem_take(nr_size_t size){
+    int cls = nmem_class(size);
+    if (cls >= 0) {
+        void* ptr = nmem_cache_pop(cls);
+        if (ptr) {
+            NMEM_ADD(&__nmem_stats.cache_hits, 1);
+            return ptr;
+        }
+        NMEM_ADD(&__nmem_stats.cache_misses, 1);
+    }
+    void* ptr = __nmem_allocator.alloc(__nmem_allocator.ctx, nmem_block_size(size), NMEM_ALIGNMENT);
+    if (!ptr && NMEM_LOAD(&__nmem_stats.cached_bytes) > 0) {
+        // cached blocks of other classes may be what the allocator is missing
+        nmem_cache_trim(0);
+        ptr = __nmem_allocator.alloc(__nmem_allocator.ctx, nmem_block_size(size), NMEM_ALIGNMENT);
+    }
+    return ptr;
+}
+
+/*
+ * Gives back a block of `size` (>= 1) bytes to the cache or the allocator.
+ * `ptr` must come from nmem_take: a cached block serves any request of
+ * its class, so it has to be of the full class size and aligned.
+ */
+NR_PRIVATE void
+nmem_give(void* ptr, nr_size_t size){
+    int cls = nmem_class(size);
+    if (cls < 0 || !nmem_cache_push(cls, ptr)) {
+        __nmem_allocator.free(__nmem_allocator.ctx, ptr, nmem_block_size(size));
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* API                                                                      */
+/* ------------------------------------------------------------------------ */
+
+NR_PUBLIC void
+NMem_SetAllocator(const NMem_Allocator* allocator, NMem_Allocator* prev){
+    // cached blocks belong to the outgoing allocator
+    nmem_cache_trim(0);
+    if (prev) {
+        *prev = __nmem_allocator;
+    }
+    if (allocator) {
+        __nmem_allocator = *allocator;
+    }
+    else {
+        __nmem_allocator.ctx = NULL;
+        __nmem_allocator.alloc = nmem_default_alloc;
+        __nmem_allocator.realloc = nmem_default_realloc;
+        __nmem_allocator.free = nmem_default_free;
+    }
+}
+
+NR_PUBLIC void
+NMem_GetAllocator(NMem_Allocator* out){
+    *out = __nmem_allocator;
+}
+
+NR_PUBLIC void*
+NMem_Alloc(nr_size_t size){
+    size = nmem_real_size(size);
+    void* ptr = nmem_take(size);
+    if (!ptr) {
+        NMEM_ADD(&__nmem_stats.nfailed, 1);
+        return NError_RaiseMemoryError();
+    }
+    NMEM_ADD(&__nmem_stats.nallocs, 1);
+    nmem_count_alloc(size);
+    return ptr;
+}
+
+NR_PUBLIC void*
+NMem_Calloc(nr_size_t size){
+    void* ptr = NMem_Alloc(size);
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+NR_PUBLIC void*
+NMem_Realloc(void* ptr, nr_size_t old_size, nr_size_t new_size){
+    if (!ptr) {
+        return NMem_Alloc(new_size);
+    }
+    old_size = nmem_real_size(old_size);
+    new_size = nmem_real_size(new_size);
+    int old_cls = nmem_class(old_size);
+    int new_cls = nmem_class(new_size);
+    void* out;
+    if (old_cls >= 0 && old_cls == new_cls) {
+        // the block already has room
+        out = ptr;
+    }
+    else if (old_cls < 0 && new_cls < 0) {
+        out = __nmem_allocator.realloc(__nmem_allocator.ctx, ptr, old_size,
+                                       new_size, NMEM_ALIGNMENT);
+    }
+    else {
+        out = nmem_take(new_size);
+        if (out) {
+            memcpy(out, ptr, old_size < new_size ? old_size : new_size);
+            nmem_give(ptr, old_size);
+        }
+    }
+    if (!out) {
+        NMEM_ADD(&__nmem_stats.nfailed, 1);
+        return NError_RaiseMemoryError();
+    }
+    NMEM_ADD(&__nmem_stats.nreallocs, 1);
+    NMEM_SUB(&__nmem_stats.bytes_in_use, (nr_uint64)old_size);
+    nmem_count_alloc(new_size);
+    return out;
+}
+
+NR_PUBLIC void
+NMem_Free(void* ptr, nr_size_t size){
+    if (!ptr) {
+        return;
+    }
+    size = nmem_real_size(size);
+    nmem_give(ptr, size);
+    NMEM_ADD(&__nmem_stats.nfrees, 1);
+    NMEM_SUB(&__nmem_stats.bytes_in_use, (nr_uint64)size);
+}
+
+NR_PUBLIC void
+NMem_GetStats(NMem_Stats* stats){
+    stats->nallocs = NMEM_LOAD(&__nmem_stats.nallocs);
+    stats->nreallocs = NMEM_LOAD(&__nmem_stats.nreallocs);
+    stats->nfrees = NMEM_LOAD(&__nmem_stats.nfrees);
+    stats->nfailed = NMEM_LOAD(&__nmem_stats.nfailed);
+    stats->bytes_in_use = NMEM_LOAD(&__nmem_stats.bytes_in_use);
+    stats->peak_bytes = NMEM_LOAD(&__nmem_stats.peak_bytes);
+    stats->total_bytes = NMEM_LOAD(&__nmem_stats.total_bytes);
+    stats->cached_bytes = NMEM_LOAD(&__nmem_stats.cached_bytes);
+    stats->cache_hits = NMEM_LOAD(&__nmem_stats.cache_hits);
+    stats->cache_misses = NMEM_LOAD(&__nmem_stats.cache_misses);
+}
+
+NR_PUBLIC void
+NMem_ResetStats(void){
+    NMEM_STORE(&__nmem_stats.nallocs, 0);
+    NMEM_STORE(&__nmem_stats.nreallocs, 0);
+    NMEM_STORE(&__nmem_stats.nfrees, 0);
+    NMEM_STORE(&__nmem_stats.nfailed, 0);
+    NMEM_STORE(&__nmem_stats.total_bytes, 0);
+    NMEM_STORE(&__nmem_stats.cache_hits, 0);
+    NMEM_STORE(&__nmem_stats.cache_misses, 0);
+    NMEM_STORE(&__nmem_stats.peak_bytes, NMEM_LOAD(&__nmem_stats.bytes_in_use));
+}
+
+NR_PUBLIC nr_size_t
+NMem_SetCacheLimit(nr_size_t limit){
+    nmem_cache* c = &__nmem_cache;
+    NMEM_LOCK(&c->lock);
+    nr_size_t prev = c->limit;
+    c->limit = limit;
+    NMEM_UNLOCK(&c->lock);
+    nmem_cache_trim(limit);
+    return prev;
+}
+
+NR_PUBLIC nr_size_t
+NMem_GetCacheLimit(void){
+    return __nmem_cache.limit;
+}
+
+NR_PUBLIC void
+NMem_TrimCache(nr_size_t keep){
+    nmem_cache_trim(keep);
+}
@@ -0,0 +1,124 @@
+#ifndef NR__CORE__SRC__NMEM_H
+#define NR__CORE__SRC__NMEM_H
+
+#include "nour/nour.h"
+
+/*
+ * Allocator for Node data buffers and kernel scratch space.
+ *
+ * Every buffer the library allocates for array data goes through
+ * NMem_Alloc / NMem_Free, which forward to the registered allocator and
+ * keep usage statistics. The default allocator returns blocks aligned to
+ * NMEM_ALIGNMENT bytes from posix_memalign on POSIX.
+ *
+ * NMem_Free only takes blocks from NMem_Alloc. A node that owns a buffer
+ * the caller got from malloc (`own_data` 1, see node_core.h) releases it
+ * with free(): such buffers are not counted in NMem_Stats, never enter
+ * the cache below and carry no alignment guarantee.
+ *
+ * Sizes are passed back on free and realloc, so allocators do not need to
+ * track them. Switch allocators before any buffer is allocated, or make
+ * sure the new one can free the old one's blocks.
+ *
+ * Freed blocks up to NMEM_CACHE_MAX_BLOCK bytes are kept in a cache
+ * bucketed by size class and handed out again to requests of the same
+ * class, so a loop that allocates and drops the same shapes stops
+ * reaching the allocator once warm. The cache holds at most
+ * NMem_GetCacheLimit() bytes; NMem_SetCacheLimit(0) turns it off.
+ * Requests are rounded up to their class size before they reach the
+ * allocator, cache or not.
+ */
+
+/* Default alignment of data buffers, one cache line / AVX-512 vector */
+#define NMEM_ALIGNMENT 64
+
+/* Largest block kept by the buffer cache */
+#define NMEM_CACHE_MAX_BLOCK ((nr_size_t)1 << 26)
+
+/* Bytes the buffer cache may hold unless NMem_SetCacheLimit says otherwise */
+#define NMEM_CACHE_DEFAULT_LIMIT ((nr_size_t)1 << 27)
+
+typedef struct{
+    void* ctx;
+    // Returns a block of `size` bytes aligned to `alignment`, or NULL.
+    void* (*alloc)(void* ctx, nr_size_t size, nr_size_t alignment);
+    // Resizes `ptr`, keeping min(old_size, new_size) bytes; NULL on failure
+    // with `ptr` left untouched.
+    void* (*realloc)(void* ctx, void* ptr, nr_size_t old_size,
+                     nr_size_t new_size, nr_size_t alignment);
+    // Releases a block of `size` bytes.
+    void (*free)(void* ctx, void* ptr, nr_size_t size);
+}NMem_Allocator;
+
+typedef struct{
+    nr_uint64 nallocs;          // successful allocations
+    nr_uint64 nreallocs;        // successful reallocations
+    nr_uint64 nfrees;           // released blocks
+    nr_uint64 nfailed;          // requests the allocator refused
+    nr_uint64 bytes_in_use;     // bytes currently allocated
+    nr_uint64 peak_bytes;       // highest bytes_in_use since the last reset
+    nr_uint64 total_bytes;      // bytes allocated since the last reset
+    nr_uint64 cached_bytes;     // bytes held by the buffer cache
+    nr_uint64 cache_hits;       // requests served from the cache
+    nr_uint64 cache_misses;     // cacheable requests that went to the allocator
+}NMem_Stats;
+
+/*
+ * Registers `allocator`, or restores the default one when it is NULL.
+ * The previous allocator is copied to `prev` when it is not NULL.
+ */
+NR_PUBLIC void
+NMem_SetAllocator(const NMem_Allocator* allocator, NMem_Allocator* prev);
+
+/* Copies the registered allocator to `out`. */
+NR_PUBLIC void
+NMem_GetAllocator(NMem_Allocator* out);
+
+/*
+ * Allocates `size` bytes aligned to NMEM_ALIGNMENT. Returns NULL with a
+ * MemoryError raised on failure.
+ */
+NR_PUBLIC void*
+NMem_Alloc(nr_size_t size);
+
+/* NMem_Alloc, with the block zeroed. */
+NR_PUBLIC void*
+NMem_Calloc(nr_size_t size);
+
+/*
+ * Resizes a block from NMem_Alloc. Returns NULL with a MemoryError raised
+ * on failure, `ptr` then stays valid.
+ */
+NR_PUBLIC void*
+NMem_Realloc(void* ptr, nr_size_t old_size, nr_size_t new_size);
+
+/* Releases a block of `size` bytes from NMem_Alloc. NULL is ignored. */
+NR_PUBLIC void
+NMem_Free(void* ptr, nr_size_t size);
+
+/* Copies the allocation counters to `stats`. */
+NR_PUBLIC void
+NMem_GetStats(NMem_Stats* stats);
+
+/*
+ * Zeroes the counters. bytes_in_use and cached_bytes are kept and
+ * peak_bytes restarts from bytes_in_use.
+ */
+NR_PUBLIC void
+NMem_ResetStats(void);
+
+/*
+ * Sets the most bytes the buffer cache may hold and releases what is over
+ * it. 0 disables the cache. Returns the previous limit.
+ */
+NR_PUBLIC nr_size_t
+NMem_SetCacheLimit(nr_size_t limit);
+
+NR_PUBLIC nr_size_t
+NMem_GetCacheLimit(void);
+
+/* Releases cached blocks until at most `keep` bytes remain cached. */
+NR_PUBLIC void
+NMem_TrimCache(nr_size_t keep);
+
+#endif // NR__CORE__SRC__NMEM_H
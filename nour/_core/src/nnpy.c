@@ -0,0 +1,770 @@
+#include "nnpy.h"
+#include "nmap.h"
+#include "nmem.h"
+#include "node_core.h"
+#include "niter.h"
+#include "free.h"
+#include "nerror.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define NNPY_FSEEK _fseeki64
+    #define NNPY_FTELL _ftelli64
+#else
+    #define NNPY_FSEEK fseeko
+    #define NNPY_FTELL ftello
+#endif
+
+#define NNPY_MAGIC "\x93NUMPY"
+#define NNPY_MAGIC_LEN 6
+
+/* Header dict plus preamble; NR_NODE_MAX_NDIM 20-digit dims fit easily */
+#define NNPY_HEADER_MAX 1024
+
+/* Bytes gathered per write for layouts that are not contiguous */
+#define NNPY_GATHER_BYTES (1 << 16)
+
+/* ------------------------------------------------------------------------ */
+/* Descriptors                                                              */
+/* ------------------------------------------------------------------------ */
+
+NR_STATIC_INLINE int
+nnpy_little_endian(void){
+    const nr_uint16 one = 1;
+    return *(const nr_uint8*)&one == 1;
+}
+
+/* NumPy kind character of each NR_DTYPE, in enum order */
+static const char __nnpy_kinds[] = {
+    'b', 'i', 'u', 'i', 'u', 'i', 'u', 'i', 'u', 'f', 'f',
+};
+
+NR_PRIVATE void
+nnpy_descr(NR_DTYPE dtype, char* out){
+    nr_intp size = NDtype_Size(dtype);
+    char order = size == 1 ? '|' : (nnpy_little_endian() ? '<' : '>');
+    sprintf(out, "%c%c%d", order, __nnpy_kinds[dtype], (int)size);
+}
+
+/* Parses a descriptor, sets `swap` when the data is not in native order */
+NR_PRIVATE int
+nnpy_parse_descr(const char* descr, NR_DTYPE* dtype, int* swap){
+    char order = descr[0];
+    if (order != '<' && order != '>' && order != '|' && order != '=') {
+        return -1;
+    }
+    char kind = descr[1];
+    int size = atoi(descr + 2);
+    if (kind == '?') {
+        kind = 'b';
+    }
+    for (int dt = 0; dt < NR_NUM_NUMIRC_DT; dt++) {
+        if (__nnpy_kinds[dt] == kind && NDtype_Size((NR_DTYPE)dt) == size) {
+            *dtype = (NR_DTYPE)dt;
+            *swap = size > 1 && ((order == '<') != nnpy_little_endian()) && order != '=' && order != '|';
+            return 0;
+        }
+    }
+    return -1;
+}
+
+NR_PRIVATE void
+nnpy_byteswap(char* data, nr_intp nitems, nr_intp itemsize){
+    for (nr_intp i = 0; i < nitems; i++, data += itemsize) {
+        for (nr_intp a = 0, b = itemsize - 1; a < b; a++, b--) {
+            char t = data[a];
+            data[a] = data[b];
+            data[b] = t;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* Output with an optional running CRC-32 (for .npz entries)                */
+/* ------------------------------------------------------------------------ */
+
+typedef struct{
+    FILE* f;
+    const nr_uint32* crc_table;     // NULL when no CRC is needed
+    nr_uint32 crc;
+    nr_uint64 nbytes;
+}nnpy_writer;
+
+NR_PRIVATE void
+nnpy_crc_table(nr_uint32* table){
+    for (nr_uint32 i = 0; i < 256; i++) {
+        nr_uint32 c = i;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+}
+
+NR_PRIVATE int
+nnpy_write(nnpy_writer* w, const void* data, nr_size_t n){
+    if (w->crc_table) {
+        const nr_uint8* p = (const nr_uint8*)data;
+        nr_uint32 c = ~w->crc;
+        for (nr_size_t i = 0; i < n; i++) {
+            c = w->crc_table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+        }
+        w->crc = ~c;
+    }
+    w->nbytes += n;
+    return n == 0 || fwrite(data, 1, n, w->f) == n ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Writing                                                                  */
+/* ------------------------------------------------------------------------ */
+
+NR_PRIVATE int
+nnpy_is_f_contiguous(const Node* node){
+    nr_intp expected = NODE_ITEMSIZE(node);
+    for (int i = 0; i < node->ndim; i++) {
+        if (node->shape[i] != 1 && node->strides[i] != expected) {
+            return 0;
+        }
+        expected *= node->shape[i];
+    }
+    return 1;
+}
+
+/* Formats the preamble and header dict, padded to a multiple of 64 bytes */
+NR_PRIVATE nr_intp
+nnpy_format_header(const Node* node, int fortran, char* out){
+    char descr[8];
+    char dict[NNPY_HEADER_MAX];
+    nnpy_descr(NODE_DTYPE(node), descr);
+    int len = sprintf(dict, "{'descr': '%s', 'fortran_order': %s, 'shape': (",
+                      descr, fortran ? "True" : "False");
+    for (int i = 0; i < node->ndim; i++) {
+        len += sprintf(dict + len, "%lld,%s", (long long)node->shape[i],
+                       i + 1 < node->ndim ? " " : "");
+    }
+    if (node->ndim > 1) {
+        len--;  // (3, 4) but (3,)
+    }
+    len += sprintf(dict + len, "), }");
+
+    // version 1.0: magic, 2 version bytes, 2 length bytes, dict ending in '\n'
+    nr_intp total = NNPY_MAGIC_LEN + 4 + len + 1;
+    nr_intp padded = (total + 63) / 64 * 64;
+    nr_intp hlen = padded - NNPY_MAGIC_LEN - 4;
+    memcpy(out, NNPY_MAGIC, NNPY_MAGIC_LEN);
+    out[6] = 1;
+    out[7] = 0;
+    out[8] = (char)(hlen & 0xFF);
+    out[9] = (char)(hlen >> 8);
+    memcpy(out + 10, dict, len);
+    memset(out + 10 + len, ' ', hlen - len - 1);
+    out[padded - 1] = '\n';
+    return padded;
+}
+
+NR_PRIVATE int
+nnpy_write_node(nnpy_writer* w, const Node* node){
+    int c_contig = NODE_IS_CONTIGUOUS(node);
+    int fortran = !c_contig && nnpy_is_f_contiguous(node);
+    char header[NNPY_HEADER_MAX + 64];
+    nr_intp hlen = nnpy_format_header(node, fortran, header);
+    if (nnpy_write(w, header, hlen) != 0) {
+        return -1;
+    }
+
+    nr_intp itemsize = NODE_ITEMSIZE(node);
+    nr_intp nitems = Node_NItems(node);
+    if (c_contig || fortran) {
+        return nnpy_write(w, NODE_DATA(node), nitems * itemsize);
+    }
+
+    // gather other layouts in C order
+    char* buf = (char*)NMem_Alloc(NNPY_GATHER_BYTES);
+    if (!buf) {
+        return -2;
+    }
+    nr_intp per_buf = NNPY_GATHER_BYTES / itemsize;
+    nr_intp filled = 0;
+    int rc = 0;
+    NIter it;
+    NIter_New(&it, NODE_DATA(node), node->ndim, node->shape, node->strides, NITER_MODE_STRIDED);
+    NIter_ITER(&it);
+    while (NIter_NOTDONE(&it) && rc == 0) {
+        memcpy(buf + filled * itemsize, NIter_ITEM(&it), itemsize);
+        if (++filled == per_buf) {
+            rc = nnpy_write(w, buf, filled * itemsize);
+            filled = 0;
+        }
+        NIter_NEXT_STRIDED(&it);
+    }
+    if (rc == 0) {
+        rc = nnpy_write(w, buf, filled * itemsize);
+    }
+    NMem_Free(buf, NNPY_GATHER_BYTES);
+    return rc;
+}
+
+NR_PUBLIC int
+Node_SaveNpy(const Node* node, const char* path){
+    if (Node_Materialize((Node*)node) < 0) {
+        return -1;
+    }
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        NError_RaiseError(NError_IOError, "npy: cannot open '%s' for writing", path);
+        return -1;
+    }
+    nnpy_writer w = {f, NULL, 0, 0};
+    int rc = nnpy_write_node(&w, node);
+    if (fclose(f) != 0 && rc == 0) {
+        rc = -1;
+    }
+    if (rc == -1) {
+        NError_RaiseError(NError_IOError, "npy: failed writing '%s'", path);
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Reading                                                                  */
+/* ------------------------------------------------------------------------ */
+
+typedef struct{
+    NR_DTYPE dtype;
+    int swap;
+    int fortran;
+    int ndim;
+    nr_intp shape[NR_NODE_MAX_NDIM];
+}nnpy_header;
+
+/* Returns the text right after `'key':`, or NULL */
+NR_PRIVATE const char*
+nnpy_find_key(const char* dict, const char* key){
+    const char* p = strstr(dict, key);
+    if (!p) {
+        return NULL;
+    }
+    p = strchr(p + strlen(key), ':');
+    if (!p) {
+        return NULL;
+    }
+    p++;
+    while (*p == ' ') {
+        p++;
+    }
+    return p;
+}
+
+NR_PRIVATE int
+nnpy_parse_dict(const char* dict, nnpy_header* h){
+    const char* p = nnpy_find_key(dict, "'descr'");
+    if (!p || (*p != '\'' && *p != '"')) {
+        return -1;
+    }
+    char descr[16];
+    int n = 0;
+    for (p++; *p && *p != '\'' && *p != '"' && n < 15; p++) {
+        descr[n++] = *p;
+    }
+    descr[n] = '\0';
+    if (nnpy_parse_descr(descr, &h->dtype, &h->swap) != 0) {
+        NError_RaiseError(NError_TypeError, "npy: unsupported dtype '%s'", descr);
+        return -2;
+    }
+
+    p = nnpy_find_key(dict, "'fortran_order'");
+    if (!p) {
+        return -1;
+    }
+    h->fortran = strncmp(p, "True", 4) == 0;
+
+    p = nnpy_find_key(dict, "'shape'");
+    if (!p || *p != '(') {
+        return -1;
+    }
+    h->ndim = 0;
+    // the bytes of the non-zero dimensions must fit nr_intp, or the buffer would be too small
+    nr_intp max_items = INTPTR_MAX / NDtype_Size(h->dtype);
+    nr_intp nitems = 1;
+    for (p++; *p && *p != ')';) {
+        char* end;
+        long long v = strtoll(p, &end, 10);
+        if (end == p) {
+            if (*p == ',' || *p == ' ') {
+                p++;
+                continue;
+            }
+            return -1;
+        }
+        if (h->ndim == NR_NODE_MAX_NDIM || v < 0) {
+            return -1;
+        }
+        if ((unsigned long long)v > (unsigned long long)INTPTR_MAX
+            || (v > 0 && nitems > max_items / v)) {
+            NError_RaiseError(NError_ValueError, "npy: shape holds more bytes than an array can address");
+            return -2;
+        }
+        if (v > 0) {
+            nitems *= (nr_intp)v;
+        }
+        h->shape[h->ndim++] = (nr_intp)v;
+        p = end;
+    }
+    return *p == ')' ? 0 : -1;
+}
+
+/* Reads the preamble and header at the current position of `f` */
+NR_PRIVATE int
+nnpy_read_header(FILE* f, nnpy_header* h){
+    unsigned char pre[12];
+    if (fread(pre, 1, 10, f) != 10 || memcmp(pre, NNPY_MAGIC, NNPY_MAGIC_LEN) != 0) {
+        NError_RaiseError(NError_ValueError, "npy: not a .npy file");
+        return -1;
+    }
+    nr_intp hlen;
+    if (pre[6] == 1) {
+        hlen = pre[8] | (pre[9] << 8);
+    }
+    else if (pre[6] == 2 || pre[6] == 3) {
+        if (fread(pre + 10, 1, 2, f) != 2) {
+            NError_RaiseError(NError_ValueError, "npy: truncated header");
+            return -1;
+        }
+        hlen = (nr_intp)pre[8] | ((nr_intp)pre[9] << 8) | ((nr_intp)pre[10] << 16) | ((nr_intp)pre[11] << 24);
+    }
+    else {
+        NError_RaiseError(NError_ValueError, "npy: unsupported format version %d.%d", pre[6], pre[7]);
+        return -1;
+    }
+    if (hlen > (1 << 24)) {
+        NError_RaiseError(NError_ValueError, "npy: header too large");
+        return -1;
+    }
+    char* dict = (char*)malloc(hlen + 1);
+    if (!dict) {
+        NError_RaiseMemoryError();
+        return -1;
+    }
+    if ((nr_intp)fread(dict, 1, hlen, f) != hlen) {
+        free(dict);
+        NError_RaiseError(NError_ValueError, "npy: truncated header");
+        return -1;
+    }
+    dict[hlen] = '\0';
+    int rc = nnpy_parse_dict(dict, h);
+    free(dict);
+    if (rc == -1) {
+        NError_RaiseError(NError_ValueError, "npy: malformed header");
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+/* Strides of `h`'s shape in Fortran order */
+NR_PRIVATE void
+nnpy_f_strides(const nnpy_header* h, nr_intp* strides){
+    nr_intp s = NDtype_Size(h->dtype);
+    for (int i = 0; i < h->ndim; i++) {
+        strides[i] = s;
+        s *= h->shape[i];
+    }
+}
+
+/*
+ * Loads the array whose header starts at the current position of `f`.
+ * `path` is only needed for the mapped modes.
+ */
+NR_PRIVATE Node*
+nnpy_load(FILE* f, const char* path, NNpy_LoadMode mode){
+    nnpy_header h;
+    if (nnpy_read_header(f, &h) != 0) {
+        return NULL;
+    }
+    nr_intp itemsize = NDtype_Size(h.dtype);
+    nr_intp nitems = NR_NItems(h.ndim, h.shape);
+    nr_intp nbytes = nitems * itemsize;
+    nr_intp fstrides[NR_NODE_MAX_NDIM];
+    nr_intp* strides = NULL;
+    if (h.fortran && h.ndim > 1) {
+        nnpy_f_strides(&h, fstrides);
+        strides = fstrides;
+    }
+
+    if (mode != NNPY_LOAD_READ && nbytes > 0) {
+        if (h.swap) {
+            return NError_RaiseError(NError_ValueError,
+                "npy: data in non-native byte order cannot be mapped");
+        }
+        NMap_Mode mmode = mode == NNPY_LOAD_MMAP_READWRITE ? NMAP_READWRITE :
+                          mode == NNPY_LOAD_MMAP_COPYONWRITE ? NMAP_COPYONWRITE : NMAP_READONLY;
+        nr_intp offset = (nr_intp)NNPY_FTELL(f);
+        Node* flat = Node_MapFile(path, offset, 1, &nitems, h.dtype, mmode, NMAP_ADVICE_NORMAL);
+        if (!flat) {
+            return NULL;
+        }
+        Node* out = Node_NewChild(flat, h.ndim, h.shape, strides, 0);
+        Node_Free(flat);
+        return out;
+    }
+
+    // a corrupt shape must not make us allocate more than the file holds
+    if (nbytes > 0) {
+        long long pos = (long long)NNPY_FTELL(f);
+        if (pos < 0 || NNPY_FSEEK(f, 0, SEEK_END) != 0) {
+            return NError_RaiseError(NError_IOError, "npy: cannot seek in the file");
+        }
+        long long end = (long long)NNPY_FTELL(f);
+        if (NNPY_FSEEK(f, pos, SEEK_SET) != 0) {
+            return NError_RaiseError(NError_IOError, "npy: cannot seek in the file");
+        }
+        if (end - pos < (long long)nbytes) {
+            return NError_RaiseError(NError_ValueError, "npy: file holds less data than its shape");
+        }
+    }
+
+    char* data = (char*)NMem_Alloc(nbytes);
+    if (!data) {
+        return NULL;
+    }
+    if ((nr_intp)fread(data, 1, nbytes, f) != nbytes) {
+        NMem_Free(data, nbytes);
+        return NError_RaiseError(NError_ValueError, "npy: file holds less data than its shape");
+    }
+    if (h.swap) {
+        nnpy_byteswap(data, nitems, itemsize);
+    }
+    Node* out = Node_NewAdvanced(data, NR_OWNDATA_NMEM, h.ndim, h.shape, strides, h.dtype, 0, NULL);
+    if (!out) {
+        NMem_Free(data, nbytes);
+    }
+    return out;
+}
+
+NR_PUBLIC Node*
+Node_LoadNpy(const char* path, NNpy_LoadMode mode){
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NError_RaiseError(NError_IOError, "npy: cannot open '%s'", path);
+    }
+    Node* out = nnpy_load(f, path, mode);
+    fclose(f);
+    return out;
+}
+
+/* ------------------------------------------------------------------------ */
+/* .npz archives                                                            */
+/* ------------------------------------------------------------------------ */
+
+#define NNPZ_LOCAL_SIG 0x04034b50u
+#define NNPZ_CENTRAL_SIG 0x02014b50u
+#define NNPZ_END_SIG 0x06054b50u
+#define NNPZ_END64_SIG 0x06064b50u
+#define NNPZ_END64_LOC_SIG 0x07064b50u
+#define NNPZ_LOCAL_LEN 30
+#define NNPZ_CENTRAL_LEN 46
+#define NNPZ_END_LEN 22
+#define NNPZ_NAME_MAX 512
+#define NNPZ_DOS_DATE 0x21      // 1980-01-01
+
+NR_STATIC_INLINE void
+nnpz_put16(unsigned char* p, nr_uint32 v){
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+NR_STATIC_INLINE void
+nnpz_put32(unsigned char* p, nr_uint32 v){
+    nnpz_put16(p, v & 0xFFFF);
+    nnpz_put16(p + 2, v >> 16);
+}
+
+NR_STATIC_INLINE nr_uint32
+nnpz_get16(const unsigned char* p){
+    return (nr_uint32)p[0] | ((nr_uint32)p[1] << 8);
+}
+
+NR_STATIC_INLINE nr_uint32
+nnpz_get32(const unsigned char* p){
+    return nnpz_get16(p) | (nnpz_get16(p + 2) << 16);
+}
+
+NR_STATIC_INLINE nr_uint64
+nnpz_get64(const unsigned char* p){
+    return (nr_uint64)nnpz_get32(p) | ((nr_uint64)nnpz_get32(p + 4) << 32);
+}
+
+typedef struct{
+    char name[NNPZ_NAME_MAX];
+    nr_uint32 crc;
+    nr_uint64 size;
+    nr_uint64 offset;
+}nnpz_entry;
+
+/* Fills the local (`local` set) or central directory header of `e` */
+NR_PRIVATE nr_intp
+nnpz_format_header(const nnpz_entry* e, int local, unsigned char* out){
+    nr_size_t name_len = strlen(e->name);
+    unsigned char* p = out;
+    memset(out, 0, NNPZ_CENTRAL_LEN);
+    nnpz_put32(p, local ? NNPZ_LOCAL_SIG : NNPZ_CENTRAL_SIG);
+    p += 4;
+    if (!local) {
+        nnpz_put16(p, 20);      // version made by
+        p += 2;
+    }
+    nnpz_put16(p, 20);          // version needed
+    nnpz_put16(p + 2, 0);       // flags
+    nnpz_put16(p + 4, 0);       // stored
+    nnpz_put16(p + 6, 0);       // time
+    nnpz_put16(p + 8, NNPZ_DOS_DATE);
+    nnpz_put32(p + 10, e->crc);
+    nnpz_put32(p + 14, (nr_uint32)e->size);
+    nnpz_put32(p + 18, (nr_uint32)e->size);
+    nnpz_put16(p + 22, (nr_uint32)name_len);
+    nnpz_put16(p + 24, 0);      // extra length
+    p += 26;
+    if (!local) {
+        // comment length, disk, internal and external attributes zero
+        nnpz_put32(p + 10, (nr_uint32)e->offset);
+        p += 14;
+    }
+    memcpy(p, e->name, name_len);
+    return (p - out) + (nr_intp)name_len;
+}
+
+NR_PUBLIC int
+Node_SaveNpz(const char* path, const Node** nodes, const char** names, int n){
+    for (int i = 0; i < n; i++) {
+        if (Node_Materialize((Node*)nodes[i]) < 0) {
+            return -1;
+        }
+    }
+    nnpz_entry* entries = (nnpz_entry*)calloc(n > 0 ? n : 1, sizeof(nnpz_entry));
+    if (!entries) {
+        NError_RaiseMemoryError();
+        return -1;
+    }
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        free(entries);
+        NError_RaiseError(NError_IOError, "npz: cannot open '%s' for writing", path);
+        return -1;
+    }
+
+    nr_uint32 table[256];
+    nnpy_crc_table(table);
+    unsigned char hdr[NNPZ_CENTRAL_LEN + NNPZ_NAME_MAX];
+    int rc = 0;
+    for (int i = 0; i < n && rc == 0; i++) {
+        nnpz_entry* e = &entries[i];
+        if (strlen(names[i]) + 5 > NNPZ_NAME_MAX) {
+            NError_RaiseError(NError_ValueError, "npz: name '%s' too long", names[i]);
+            rc = -2;
+            break;
+        }
+        sprintf(e->name, "%s.npy", names[i]);
+        e->offset = (nr_uint64)NNPY_FTELL(f);
+
+        // placeholder local header, rewritten once size and CRC are known
+        nr_intp hlen = nnpz_format_header(e, 1, hdr);
+        if ((nr_intp)fwrite(hdr, 1, hlen, f) != hlen) {
+            rc = -1;
+            break;
+        }
+        nnpy_writer w = {f, table, 0, 0};
+        rc = nnpy_write_node(&w, nodes[i]);
+        if (rc != 0) {
+            break;
+        }
+        if (w.nbytes >= 0xFFFFFFFFu || e->offset >= 0xFFFFFFFFu) {
+            NError_RaiseError(NError_ValueError, "npz: archives over 4 GiB are not supported");
+            rc = -2;
+            break;
+        }
+        e->crc = w.crc;
+        e->size = w.nbytes;
+        nr_uint64 end = (nr_uint64)NNPY_FTELL(f);
+        nnpz_format_header(e, 1, hdr);
+        if (NNPY_FSEEK(f, (long long)e->offset, SEEK_SET) != 0
+            || fwrite(hdr, 1, hlen, f) != (size_t)hlen
+            || NNPY_FSEEK(f, (long long)end, SEEK_SET) != 0) {
+            rc = -1;
+        }
+    }
+
+    if (rc == 0) {
+        nr_uint64 cd_offset = (nr_uint64)NNPY_FTELL(f);
+        nr_uint64 cd_size = 0;
+        for (int i = 0; i < n && rc == 0; i++) {
+            nr_intp hlen = nnpz_format_header(&entries[i], 0, hdr);
+            rc = (nr_intp)fwrite(hdr, 1, hlen, f) == hlen ? 0 : -1;
+            cd_size += hlen;
+        }
+        unsigned char end[NNPZ_END_LEN] = {0};
+        nnpz_put32(end, NNPZ_END_SIG);
+        nnpz_put16(end + 8, (nr_uint32)n);
+        nnpz_put16(end + 10, (nr_uint32)n);
+        nnpz_put32(end + 12, (nr_uint32)cd_size);
+        nnpz_put32(end + 16, (nr_uint32)cd_offset);
+        if (rc == 0 && fwrite(end, 1, NNPZ_END_LEN, f) != NNPZ_END_LEN) {
+            rc = -1;
+        }
+    }
+    if (fclose(f) != 0 && rc == 0) {
+        rc = -1;
+    }
+    free(entries);
+    if (rc == -1) {
+        NError_RaiseError(NError_IOError, "npz: failed writing '%s'", path);
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+/* Finds the central directory: sets its offset and entry count */
+NR_PRIVATE int
+nnpz_find_directory(FILE* f, nr_uint64* cd_offset, nr_uint64* count){
+    if (NNPY_FSEEK(f, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    long long file_size = (long long)NNPY_FTELL(f);
+    // the end record sits at most a 64 KiB comment before the end of the file
+    long long scan = file_size < 65535 + NNPZ_END_LEN ? file_size : 65535 + NNPZ_END_LEN;
+    unsigned char* buf = (unsigned char*)malloc(scan > 0 ? scan : 1);
+    if (!buf) {
+        return -1;
+    }
+    if (NNPY_FSEEK(f, file_size - scan, SEEK_SET) != 0 || (long long)fread(buf, 1, scan, f) != scan) {
+        free(buf);
+        return -1;
+    }
+    long long pos = -1;
+    for (long long i = scan - NNPZ_END_LEN; i >= 0; i--) {
+        if (nnpz_get32(buf + i) == NNPZ_END_SIG) {
+            pos = i;
+            break;
+        }
+    }
+    if (pos < 0) {
+        free(buf);
+        return -1;
+    }
+    *count = nnpz_get16(buf + pos + 10);
+    *cd_offset = nnpz_get32(buf + pos + 16);
+    int zip64 = *count == 0xFFFF || *cd_offset == 0xFFFFFFFFu;
+    long long end_pos = file_size - scan + pos;
+    free(buf);
+    if (!zip64) {
+        return 0;
+    }
+
+    // zip64 end record, found through the locator right before the end record
+    unsigned char loc[20], rec[56];
+    if (end_pos < 20 || NNPY_FSEEK(f, end_pos - 20, SEEK_SET) != 0 || fread(loc, 1, 20, f) != 20
+        || nnpz_get32(loc) != NNPZ_END64_LOC_SIG) {
+        return -1;
+    }
+    if (NNPY_FSEEK(f, (long long)nnpz_get64(loc + 8), SEEK_SET) != 0 || fread(rec, 1, 56, f) != 56
+        || nnpz_get32(rec) != NNPZ_END64_SIG) {
+        return -1;
+    }
+    *count = nnpz_get64(rec + 32);
+    *cd_offset = nnpz_get64(rec + 48);
+    return 0;
+}
+
+/*
+ * Positions `f` at the data of entry `name` (or `name`.npy). Returns 0,
+ * -1 on a malformed archive, -2 when the entry is missing and -3 when it
+ * is compressed.
+ */
+NR_PRIVATE int
+nnpz_seek_entry(FILE* f, const char* name){
+    nr_uint64 cd_offset, count;
+    if (nnpz_find_directory(f, &cd_offset, &count) != 0
+        || NNPY_FSEEK(f, (long long)cd_offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    nr_size_t want = strlen(name);
+    int has_ext = want >= 4 && strcmp(name + want - 4, ".npy") == 0;
+
+    for (nr_uint64 i = 0; i < count; i++) {
+        unsigned char h[NNPZ_CENTRAL_LEN];
+        char entry_name[NNPZ_NAME_MAX];
+        if (fread(h, 1, NNPZ_CENTRAL_LEN, f) != NNPZ_CENTRAL_LEN || nnpz_get32(h) != NNPZ_CENTRAL_SIG) {
+            return -1;
+        }
+        nr_uint32 method = nnpz_get16(h + 10);
+        nr_uint32 name_len = nnpz_get16(h + 28);
+        nr_uint32 extra_len = nnpz_get16(h + 30);
+        nr_uint32 comment_len = nnpz_get16(h + 32);
+        nr_uint64 usize = nnpz_get32(h + 24);
+        nr_uint64 csize = nnpz_get32(h + 20);
+        nr_uint64 offset = nnpz_get32(h + 42);
+        if (name_len >= NNPZ_NAME_MAX || fread(entry_name, 1, name_len, f) != name_len) {
+            return -1;
+        }
+        entry_name[name_len] = '\0';
+
+        unsigned char extra[65536];
+        if (fread(extra, 1, extra_len, f) != extra_len) {
+            return -1;
+        }
+        NNPY_FSEEK(f, comment_len, SEEK_CUR);
+
+        int match = has_ext ? strcmp(entry_name, name) == 0
+                            : (name_len == want + 4 && strncmp(entry_name, name, want) == 0
+                               && strcmp(entry_name + want, ".npy") == 0);
+        if (!match) {
+            continue;
+        }
+        // zip64 extra field: the 64-bit values of the saturated fields, in order
+        for (nr_uint32 p = 0; p + 4 <= extra_len;) {
+            nr_uint32 tag = nnpz_get16(extra + p), len = nnpz_get16(extra + p + 2);
+            if (tag == 0x0001) {
+                nr_uint32 q = p + 4;
+                if (usize == 0xFFFFFFFFu && q + 8 <= p + 4 + len) { usize = nnpz_get64(extra + q); q += 8; }
+                if (csize == 0xFFFFFFFFu && q + 8 <= p + 4 + len) { csize = nnpz_get64(extra + q); q += 8; }
+                if (offset == 0xFFFFFFFFu && q + 8 <= p + 4 + len) { offset = nnpz_get64(extra + q); }
+            }
+            p += 4 + len;
+        }
+        if (method != 0 || csize != usize) {
+            return -3;
+        }
+
+        unsigned char local[NNPZ_LOCAL_LEN];
+        if (NNPY_FSEEK(f, (long long)offset, SEEK_SET) != 0
+            || fread(local, 1, NNPZ_LOCAL_LEN, f) != NNPZ_LOCAL_LEN || nnpz_get32(local) != NNPZ_LOCAL_SIG) {
+            return -1;
+        }
+        long long data = (long long)offset + NNPZ_LOCAL_LEN + nnpz_get16(local + 26) + nnpz_get16(local + 28);
+        return NNPY_FSEEK(f, data, SEEK_SET) == 0 ? 0 : -1;
+    }
+    return -2;
+}
+
+NR_PUBLIC Node*
+Node_LoadNpz(const char* path, const char* name, NNpy_LoadMode mode){
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NError_RaiseError(NError_IOError, "npz: cannot open '%s'", path);
+    }
+    int rc = nnpz_seek_entry(f, name);
+    Node* out = NULL;
+    if (rc == 0) {
+        out = nnpy_load(f, path, mode);
+    }
+    else if (rc == -2) {
+        NError_RaiseError(NError_KeyError, "npz: no array '%s' in '%s'", name, path);
+    }
+    else if (rc == -3) {
+        NError_RaiseError(NError_NotImplementedError, "npz: '%s' is compressed", name);
+    }
+    else {
+        NError_RaiseError(NError_ValueError, "npz: '%s' is not a valid archive", path);
+    }
+    fclose(f);
+    return out;
+}
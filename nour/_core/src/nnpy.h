@@ -0,0 +1,57 @@
+#ifndef NR__CORE__SRC__NNPY_H
+#define NR__CORE__SRC__NNPY_H
+
+#include "nour/nour.h"
+
+/*
+ * NumPy .npy / .npz files.
+ *
+ * Every NR_DTYPE maps to its NumPy descriptor ('|b1', '|i1', '<u2', ...,
+ * '<f8'). C-contiguous and Fortran-contiguous nodes are written with one
+ * write of their buffer, other layouts are gathered in C order. Loading
+ * accepts both orders (a Fortran file gives a node with Fortran strides)
+ * and either byte order, swapping non-native data when it is copied in.
+ *
+ * .npz archives are written uncompressed, one `<name>.npy` entry per
+ * node, and entries of up to 4 GiB. Reading accepts uncompressed
+ * archives (np.savez) including their zip64 records; compressed ones
+ * (np.savez_compressed) raise NotImplementedError.
+ */
+
+typedef enum{
+    NNPY_LOAD_READ = 0,             // read into a new buffer
+    NNPY_LOAD_MMAP_READONLY,        // map the file, see Node_MapFile
+    NNPY_LOAD_MMAP_READWRITE,
+    NNPY_LOAD_MMAP_COPYONWRITE,
+}NNpy_LoadMode;
+
+/*
+ * Writes `node` to `path` as a .npy file. Returns 0, or -1 with an error
+ * raised.
+ */
+NR_PUBLIC int
+Node_SaveNpy(const Node* node, const char* path);
+
+/*
+ * Loads a .npy file. The mapped modes keep the data in the file and need
+ * native byte order. Returns NULL with an error raised on failure.
+ */
+NR_PUBLIC Node*
+Node_LoadNpy(const char* path, NNpy_LoadMode mode);
+
+/*
+ * Writes `n` nodes to `path` as an uncompressed .npz archive, node i
+ * under `names[i]` (".npy" is appended). Returns 0, or -1 with an error
+ * raised.
+ */
+NR_PUBLIC int
+Node_SaveNpz(const char* path, const Node** nodes, const char** names, int n);
+
+/*
+ * Loads the array `name` (with or without ".npy") from a .npz archive.
+ * Raises KeyError when the archive has no such entry.
+ */
+NR_PUBLIC Node*
+Node_LoadNpz(const char* path, const char* name, NNpy_LoadMode mode);
+
+#endif // NR__CORE__SRC__NNPY_H
@@ -1,5 +1,6 @@
 #include "node2str.h"
 #include "ntools.h"
+#include "node_core.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
@@ -214,6 +215,9 @@ NR_PUBLIC void
 Node_ToStringWithOptions(Node* node, char* buffer, NodePrintOptions* opts){
     buffer[0] = '\0';
     int intend = 0;
+    if (Node_Materialize(node) < 0){
+        return;
+    }
 
     if (opts == NULL){
         opts = &_default_options;
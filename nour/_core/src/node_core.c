@@ -4,9 +4,38 @@
 #include "nerror.h"
 #include "niter.h"
 #include "free.h"
+#include "node_pool.h"
+#include "nmem.h"
+#include "nlazy.h"
+#include "ngrad.h"
 
 char* NR_NODE_NAME = "node";
 
+NR_PUBLIC int
+Node_AllocDims(Node* node, int ndim) {
+    Node_FreeDims(node);
+    if (ndim <= NR_NODE_INLINE_NDIM){
+        node->shape = node->inline_dims;
+    }
+    else{
+        node->shape = (nr_intp*)malloc(sizeof(nr_intp) * 2 * ndim);
+        if (!node->shape){
+            NError_RaiseMemoryError();
+            return -1;
+        }
+    }
+    node->strides = node->shape + ndim;
+    return 0;
+}
+
+NR_PUBLIC void
+Node_FreeDims(Node* node) {
+    if (node->shape && node->shape != node->inline_dims){
+        free(node->shape);
+    }
+    node->shape = NULL;
+    node->strides = NULL;
+}
 
 NR_PUBLIC Node*
 Node_NewAdvanced(void* data, int own_data, int ndim, nr_intp* shape, 
@@ -21,9 +50,8 @@ Node_NewAdvanced(void* data, int own_data, int ndim, nr_intp* shape,
 
     int is_contiguous = 1;
 
-    Node* node = (Node*)malloc(sizeof(Node));
+    Node* node = NodePool_Get();
     if (!node){
-        NError_RaiseMemoryError();
         return NULL;
     }
 
@@ -39,36 +67,24 @@ Node_NewAdvanced(void* data, int own_data, int ndim, nr_intp* shape,
     node->name = name ? name : NR_NODE_NAME;
     node->nfunc_info = NULL;
     node->grad = NULL;
+    node->deleter = NULL;
+    node->deleter_ctx = NULL;
 
     nr_int s = sizeof(nr_intp) * ndim;
 
-    // Allocate and set shape
-    node->shape = (nr_intp*)malloc(s);
-    if (!node->shape){
-        free(node);
-        NError_RaiseMemoryError();
+    // Shape and strides live inline for small ndim
+    node->shape = NULL;
+    if (Node_AllocDims(node, ndim) != 0){
+        NodePool_Put(node);
         return NULL;
     }
-    memcpy(node->shape, shape, s);
-
-    // Allocate and set strides
-    node->strides = (nr_intp*)malloc(s);
-    if (!node->strides){
-        free(node->shape);
-        free(node);
-        NError_RaiseMemoryError();
-        return NULL;
+    if (ndim > 0){
+        memcpy(node->shape, shape, s);
     }
 
-    if (strides){
+    if (strides && ndim > 0){
         memcpy(node->strides, strides, s);
-        for (int i = 0; i < ndim - 1; i++){
-            if (node->strides[i] < 0){
-                is_contiguous = 0;
-                break;
-            }
-        }
-    
+        is_contiguous = NTools_IsCContiguous(ndim, shape, strides, dt.size);
     } else {
         nr_intp itemsize = NDtype_Size(dtype);
         NTools_CalculateStrides(ndim, shape, itemsize, node->strides);
@@ -86,6 +102,9 @@ Node_NewAdvanced(void* data, int own_data, int ndim, nr_intp* shape,
     if (own_data == 1){
         node->flags |= NR_NODE_OWNDATA;
     }
+    else if (own_data == NR_OWNDATA_NMEM){
+        node->flags |= NR_NODE_OWNDATA | NR_NODE_NMEMDATA;
+    }
     if (ndim == 0){
         node->flags |= NR_NODE_SCALAR;
     }
@@ -93,6 +112,29 @@ Node_NewAdvanced(void* data, int own_data, int ndim, nr_intp* shape,
     return node;
 }
 
+NR_PUBLIC Node*
+Node_NewExternal(void* data, int ndim, nr_intp* shape, nr_intp* strides,
+                 NR_DTYPE dtype, Node_Deleter deleter, void* ctx) {
+    Node* node = Node_NewAdvanced(data, 0, ndim, shape, strides, dtype, 0, NR_NODE_NAME);
+    if (!node){
+        return NULL;
+    }
+    node->deleter = deleter;
+    node->deleter_ctx = ctx;
+    return node;
+}
+
+NR_PUBLIC void
+Node_UpdateContiguity(Node* node) {
+    NR_RMVFLG(node->flags, (NR_NODE_CONTIGUOUS | NR_NODE_STRIDED));
+    if (NTools_IsCContiguous(node->ndim, node->shape, node->strides, NODE_ITEMSIZE(node))){
+        node->flags |= NR_NODE_CONTIGUOUS;
+    }
+    else{
+        node->flags |= NR_NODE_STRIDED;
+    }
+}
+
 NR_PUBLIC Node*
 Node_New(void* data, int own_data, int ndim, nr_intp* shape, NR_DTYPE dtype) {
     return Node_NewAdvanced(data, own_data, ndim, shape, NULL, dtype, 0, NR_NODE_NAME);
@@ -102,12 +144,15 @@ NR_PUBLIC Node*
 Node_NewEmpty(int ndim, nr_intp* shape, NR_DTYPE dtype) {
     nr_intp dtype_size = NDtype_Size(dtype);
     nr_intp nitems = NR_NItems(ndim, shape);
-    void* data = malloc(nitems * dtype_size);
+    void* data = NMem_Alloc(nitems * dtype_size);
     if (!data){
-        NError_RaiseMemoryError();
         return NULL;
     }
-    return Node_New(data, 1, ndim, shape, dtype);
+    Node* node = Node_New(data, NR_OWNDATA_NMEM, ndim, shape, dtype);
+    if (!node){
+        NMem_Free(data, nitems * dtype_size);
+    }
+    return node;
 }
 
 NR_PUBLIC Node*
@@ -126,8 +171,19 @@ Node_SetName(Node* node, const char* name) {
     }
 }
 
+NR_PUBLIC int
+Node_Materialize(Node* node) {
+    if (Node_Evaluate(node) < 0 || Node_Recompute(node) < 0){
+        return -1;
+    }
+    return 0;
+}
+
 NR_PUBLIC Node*
 Node_Copy(Node* dst, const Node* src) {
+    if (Node_Materialize((Node*)src) < 0){
+        return NULL;
+    }
     if (!dst){
         dst = Node_NewEmpty(src->ndim, src->shape, src->dtype.dtype);
     }
@@ -139,6 +195,9 @@ Node_Copy(Node* dst, const Node* src) {
 
 NR_PUBLIC Node*
 Node_NewChild(Node* src, int ndim, nr_intp* shape, nr_intp* strides, nr_intp offset) {
+    if (Node_Materialize(src) < 0){
+        return NULL;
+    }
     char* data = (char*)NODE_DATA(src) + offset;
     NR_DTYPE dtype = NODE_DTYPE(src);
     Node* dst = Node_NewAdvanced(data, 0, ndim, shape, strides, dtype, 0, NULL);
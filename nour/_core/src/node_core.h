@@ -3,6 +3,13 @@
 
 #include "nour/nour.h"
 
+/*
+ * `own_data` of Node_New and Node_NewAdvanced: 0 borrows `data`, 1 takes
+ * a buffer from malloc (released with free()), NR_OWNDATA_NMEM takes one
+ * from NMem_Alloc (released with NMem_Free, so it is counted and cached).
+ */
+#define NR_OWNDATA_NMEM 2
+
 NR_PUBLIC Node*
 Node_New(void* data, int own_data, int ndim, nr_intp* shape, NR_DTYPE dtype);
 
@@ -19,9 +26,51 @@ NR_PUBLIC Node*
 Node_NewAdvanced(void* data_block, int copy_data, int ndim, nr_intp* shape, 
                  nr_intp* strides, NR_DTYPE dtype, int flags, const char* name);
 
+/*
+ * Wraps an external buffer without copying it. `strides` may be NULL for
+ * a C-contiguous buffer. The node and every view of it keep the buffer
+ * alive; once the last of them is freed, `deleter(data, ctx)` is called
+ * (a NULL deleter borrows the buffer). On failure NULL is returned, the
+ * deleter is not called and the buffer stays with the caller.
+ */
+NR_PUBLIC Node*
+Node_NewExternal(void* data, int ndim, nr_intp* shape, nr_intp* strides,
+                 NR_DTYPE dtype, Node_Deleter deleter, void* ctx);
+
 NR_PUBLIC void
 Node_SetName(Node* node, const char* name);
 
+/*
+ * Points node->shape and node->strides at room for `ndim` dimensions,
+ * releasing the previous ones: the node's inline buffer up to
+ * NR_NODE_INLINE_NDIM dimensions, one heap block above that. The contents
+ * are left undefined. Returns 0, or -1 with a MemoryError raised.
+ */
+NR_PUBLIC int
+Node_AllocDims(Node* node, int ndim);
+
+/*
+ * Releases node->shape and node->strides and sets them to NULL.
+ */
+NR_PUBLIC void
+Node_FreeDims(Node* node);
+
+/*
+ * Recomputes the NR_NODE_CONTIGUOUS / NR_NODE_STRIDED flags from the
+ * node's shape and strides. Call it after changing strides in place.
+ */
+NR_PUBLIC void
+Node_UpdateContiguity(Node* node);
+
+/*
+ * Gives a lazy (nlazy.h) or checkpointed (ngrad.h) node its data, for
+ * code that reads NODE_DATA. Does nothing on other nodes. Returns 0, or
+ * -1 with an error raised.
+ */
+NR_PUBLIC int
+Node_Materialize(Node* node);
+
+/* A view of `src`, which is materialized first; NULL with an error raised on failure. */
 NR_PUBLIC Node*
 Node_NewChild(Node* src, int ndim, nr_intp* shape, nr_intp* strides, nr_intp offset);
     
@@ -0,0 +1,96 @@
+#include "node_pool.h"
+#include "nerror.h"
+#include <stdlib.h>
+
+/*
+ * The cached headers are chained through their `base` field. On POSIX a
+ * thread-specific key with a destructor frees a thread's list when the
+ * thread exits; elsewhere it stays cached until NodePool_Clear.
+ */
+#if NR_UNIX && (defined(__GNUC__) || defined(__clang__))
+    #define NODE_POOL_POSIX 1
+    #include <pthread.h>
+#else
+    #define NODE_POOL_POSIX 0
+#endif
+
+NR_PRIVATE NR_TLS Node* __node_pool_head = NULL;
+NR_PRIVATE NR_TLS int __node_pool_count = 0;
+
+#if NODE_POOL_POSIX
+NR_PRIVATE NR_TLS int __node_pool_registered = 0;
+NR_PRIVATE pthread_key_t __node_pool_key;
+NR_PRIVATE pthread_once_t __node_pool_once = PTHREAD_ONCE_INIT;
+NR_PRIVATE int __node_pool_key_ok = 0;
+
+NR_PRIVATE void
+node_pool_thread_exit(NR_UNUSED(void* arg)){
+    NodePool_Clear();
+}
+
+NR_PRIVATE void
+node_pool_make_key(void){
+    __node_pool_key_ok = pthread_key_create(&__node_pool_key, node_pool_thread_exit) == 0;
+}
+
+/* Arms the exit destructor, returns 0 if headers must not be cached */
+NR_PRIVATE int
+node_pool_register(void){
+    if (!__node_pool_registered) {
+        pthread_once(&__node_pool_once, node_pool_make_key);
+        if (!__node_pool_key_ok || pthread_setspecific(__node_pool_key, (void*)1) != 0) {
+            return 0;
+        }
+        __node_pool_registered = 1;
+    }
+    return 1;
+}
+#else
+NR_PRIVATE int
+node_pool_register(void){
+    return 1;
+}
+#endif
+
+NR_PUBLIC Node*
+NodePool_Get(void){
+    Node* node = __node_pool_head;
+    if (node) {
+        __node_pool_head = node->base;
+        __node_pool_count--;
+        return node;
+    }
+    node = (Node*)malloc(sizeof(Node));
+    if (!node) {
+        NError_RaiseMemoryError();
+    }
+    return node;
+}
+
+NR_PUBLIC void
+NodePool_Put(Node* node){
+    if (__node_pool_count >= NODE_POOL_MAX_CACHED || !node_pool_register()) {
+        free(node);
+        return;
+    }
+    node->base = __node_pool_head;
+    __node_pool_head = node;
+    __node_pool_count++;
+}
+
+NR_PUBLIC void
+NodePool_Clear(void){
+    Node* node = __node_pool_head;
+    while (node) {
+        Node* next = node->base;
+        free(node);
+        node = next;
+    }
+    __node_pool_head = NULL;
+    __node_pool_count = 0;
+}
+
+NR_PUBLIC int
+NodePool_Cached(void){
+    return __node_pool_count;
+}
@@ -0,0 +1,44 @@
+#ifndef NR__CORE__SRC__NODE_POOL_H
+#define NR__CORE__SRC__NODE_POOL_H
+
+#include "nour/nour.h"
+
+/*
+ * Per-thread cache of freed Node headers.
+ *
+ * Node_Free hands headers back here instead of freeing them and the node
+ * constructors take them from here first, so creating and dropping views
+ * costs no malloc/free once the cache is warm. Each thread keeps its own
+ * list of at most NODE_POOL_MAX_CACHED headers, no locking involved; a
+ * header freed on another thread than the one that made it simply joins
+ * the freeing thread's list. A thread's list is released when it exits.
+ */
+
+#define NODE_POOL_MAX_CACHED 256
+
+/*
+ * Returns an uninitialized Node header, or NULL with a MemoryError raised.
+ */
+NR_PUBLIC Node*
+NodePool_Get(void);
+
+/*
+ * Gives back a header from NodePool_Get. Its shape, data and other
+ * references must already be released.
+ */
+NR_PUBLIC void
+NodePool_Put(Node* node);
+
+/*
+ * Frees every header cached by the calling thread.
+ */
+NR_PUBLIC void
+NodePool_Clear(void);
+
+/*
+ * Returns the number of headers cached by the calling thread.
+ */
+NR_PUBLIC int
+NodePool_Cached(void);
+
+#endif // NR__CORE__SRC__NODE_POOL_H
@@ -0,0 +1,314 @@
+#include "nthread.h"
+#include "nerror.h"
+#include <stdlib.h>
+
+/*
+ * Threads are POSIX only for now. On other targets every parallel loop
+ * runs on the calling thread.
+ */
+#if NR_UNIX && (defined(__GNUC__) || defined(__clang__))
+    #define NTHREAD_POSIX 1
+    #include <pthread.h>
+    #include <unistd.h>
+#else
+    #define NTHREAD_POSIX 0
+#endif
+
+/* Ranges per thread, so one slow thread does not hold up the whole loop */
+#define NTHREAD_CHUNKS_PER_THREAD 4
+
+#if NTHREAD_POSIX
+
+NR_PRIVATE int
+nthread_clamp(long n){
+    if (n < 1) {
+        return 1;
+    }
+    return n > NTHREAD_MAX_THREADS ? NTHREAD_MAX_THREADS : (int)n;
+}
+
+/*
+ * The pool runs one loop at a time. The submitting thread publishes the
+ * loop under `lock`, bumps `gen` and works on the loop itself; every
+ * worker wakes up on the new generation, takes chunk indices from `next`
+ * until they run out and checks out through `pending`. The first error a
+ * worker raises is moved into `err` and handed to the submitting thread.
+ */
+typedef struct{
+    pthread_mutex_t submit;     // held by the thread running a loop
+    pthread_mutex_t lock;       // guards everything below
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    pthread_t threads[NTHREAD_MAX_THREADS];
+    int nworkers;
+    int stop;
+    int pending;
+    unsigned long gen;
+
+    NThread_RangeFunc func;
+    void* ctx;
+    nr_intp n;
+    nr_intp chunk;
+    nr_intp nchunks;
+    nr_intp next;               // next chunk, taken with an atomic add
+    NError err;                 // first error raised on a worker
+}nthread_pool;
+
+NR_PRIVATE nthread_pool __nthread_pool = {
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+NR_PRIVATE int __nthread_num = 1;
+NR_PRIVATE pthread_once_t __nthread_once = PTHREAD_ONCE_INIT;
+
+/* Set while a thread runs loop bodies, nested loops then run inline */
+NR_PRIVATE NR_TLS int __nthread_busy = 0;
+
+NR_PRIVATE int
+nthread_hardware_count(void){
+#ifdef _SC_NPROCESSORS_ONLN
+    return nthread_clamp(sysconf(_SC_NPROCESSORS_ONLN));
+#else
+    return 1;
+#endif
+}
+
+NR_PRIVATE void
+nthread_atfork_prepare(void){
+    pthread_mutex_lock(&__nthread_pool.submit);
+}
+
+NR_PRIVATE void
+nthread_atfork_parent(void){
+    pthread_mutex_unlock(&__nthread_pool.submit);
+}
+
+/* Only the forking thread survives in the child: forget the workers */
+NR_PRIVATE void
+nthread_atfork_child(void){
+    nthread_pool* p = &__nthread_pool;
+    pthread_mutex_init(&p->submit, NULL);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+    p->nworkers = 0;
+    p->stop = 0;
+    p->pending = 0;
+}
+
+NR_PRIVATE void
+nthread_init(void){
+    int n = nthread_hardware_count();
+    const char* env = getenv("NR_NUM_THREADS");
+    if (env && env[0] != '\0') {
+        char* end;
+        long v = strtol(env, &end, 10);
+        if (*end == '\0' && v > 0) {
+            n = nthread_clamp(v);
+        }
+    }
+    __atomic_store_n(&__nthread_num, n, __ATOMIC_RELAXED);
+    pthread_atfork(nthread_atfork_prepare, nthread_atfork_parent, nthread_atfork_child);
+}
+
+/*
+ * Runs chunks until none are left. With `stop_on_error` set, a chunk that
+ * raises takes the remaining chunks off the queue so the loop ends early.
+ */
+NR_PRIVATE void
+nthread_run_chunks(nthread_pool* p, int stop_on_error){
+    for (;;) {
+        nr_intp k = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED);
+        if (k >= p->nchunks) {
+            break;
+        }
+        nr_intp start = k * p->chunk;
+        nr_intp end = p->n - start < p->chunk ? p->n : start + p->chunk;
+        p->func(p->ctx, start, end);
+        if (stop_on_error && NError_IsError()) {
+            __atomic_store_n(&p->next, p->nchunks, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+}
+
+NR_PRIVATE void*
+nthread_worker(void* arg){
+    nthread_pool* p = &__nthread_pool;
+    unsigned long seen = (unsigned long)(size_t)arg;
+    __nthread_busy = 1;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->gen == seen && !p->stop) {
+            pthread_cond_wait(&p->wake, &p->lock);
+        }
+        if (p->stop) {
+            break;
+        }
+        seen = p->gen;
+        pthread_mutex_unlock(&p->lock);
+
+        nthread_run_chunks(p, 1);
+
+        pthread_mutex_lock(&p->lock);
+        if (NError_IsError()) {
+            if (p->err.type == NError_NoError) {
+                NError_Fetch(&p->err);
+            }
+            else {
+                NError_Clear();
+            }
+        }
+        if (--p->pending == 0) {
+            pthread_cond_signal(&p->done);
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/* Both need `submit` held */
+NR_PRIVATE void
+nthread_start_workers(nthread_pool* p, int nworkers){
+    while (p->nworkers < nworkers) {
+        if (pthread_create(&p->threads[p->nworkers], NULL,
+                           nthread_worker, (void*)(size_t)p->gen) != 0) {
+            // run with the workers we have
+            break;
+        }
+        p->nworkers++;
+    }
+}
+
+NR_PRIVATE void
+nthread_stop_workers(nthread_pool* p){
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < p->nworkers; i++) {
+        pthread_join(p->threads[i], NULL);
+    }
+    p->nworkers = 0;
+    p->stop = 0;
+}
+
+NR_PUBLIC void
+NThread_ParallelFor(nr_intp n, nr_intp grain, NThread_RangeFunc func, void* ctx){
+    if (n <= 0) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+    pthread_once(&__nthread_once, nthread_init);
+    int nthreads = __atomic_load_n(&__nthread_num, __ATOMIC_RELAXED);
+
+    nr_intp ngrains = n / grain;
+    if (nthreads <= 1 || ngrains < 2 || __nthread_busy) {
+        func(ctx, 0, n);
+        return;
+    }
+
+    nthread_pool* p = &__nthread_pool;
+    if (pthread_mutex_trylock(&p->submit) != 0) {
+        // another thread owns the pool
+        func(ctx, 0, n);
+        return;
+    }
+
+    nthread_start_workers(p, nthreads - 1);
+    if (p->nworkers == 0) {
+        pthread_mutex_unlock(&p->submit);
+        func(ctx, 0, n);
+        return;
+    }
+
+    nr_intp ntasks = (nr_intp)(p->nworkers + 1) * NTHREAD_CHUNKS_PER_THREAD;
+    if (ntasks > ngrains) {
+        ntasks = ngrains;
+    }
+    nr_intp grains_per_chunk = (ngrains + ntasks - 1) / ntasks;
+
+    pthread_mutex_lock(&p->lock);
+    p->func = func;
+    p->ctx = ctx;
+    p->n = n;
+    p->chunk = grains_per_chunk * grain;
+    p->nchunks = (n + p->chunk - 1) / p->chunk;
+    p->next = 0;
+    p->pending = p->nworkers;
+    p->err.type = NError_NoError;
+    p->gen++;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+
+    // an error the caller already had must not stop the loop
+    int had_error = NError_IsError();
+    __nthread_busy = 1;
+    nthread_run_chunks(p, !had_error);
+    __nthread_busy = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (p->pending > 0) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    if (p->err.type != NError_NoError && !NError_IsError()) {
+        NError_Restore(&p->err);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    pthread_mutex_unlock(&p->submit);
+}
+
+NR_PUBLIC int
+NThread_GetNumThreads(void){
+    pthread_once(&__nthread_once, nthread_init);
+    return __atomic_load_n(&__nthread_num, __ATOMIC_RELAXED);
+}
+
+NR_PUBLIC int
+NThread_SetNumThreads(int nthreads){
+    pthread_once(&__nthread_once, nthread_init);
+    int prev = __atomic_load_n(&__nthread_num, __ATOMIC_RELAXED);
+    if (__nthread_busy) {
+        // the pool is ours and running a loop
+        return prev;
+    }
+    int n = nthreads <= 0 ? nthread_hardware_count() : nthread_clamp(nthreads);
+
+    nthread_pool* p = &__nthread_pool;
+    pthread_mutex_lock(&p->submit);
+    if (p->nworkers > n - 1) {
+        nthread_stop_workers(p);
+    }
+    __atomic_store_n(&__nthread_num, n, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&p->submit);
+    return prev;
+}
+
+#else
+
+NR_PUBLIC void
+NThread_ParallelFor(nr_intp n, nr_intp NR_UNUSED(grain), NThread_RangeFunc func, void* ctx){
+    if (n > 0) {
+        func(ctx, 0, n);
+    }
+}
+
+NR_PUBLIC int
+NThread_GetNumThreads(void){
+    return 1;
+}
+
+NR_PUBLIC int
+NThread_SetNumThreads(int NR_UNUSED(nthreads)){
+    return 1;
+}
+
+#endif
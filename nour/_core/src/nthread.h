@@ -0,0 +1,68 @@
+#ifndef NOUR__CORE_SRC_NOUR_NTHREAD_H
+#define NOUR__CORE_SRC_NOUR_NTHREAD_H
+
+#include "nour/nour.h"
+
+/*
+ * Library-wide worker pool.
+ *
+ * The pool is started on the first parallel loop that needs it and keeps
+ * its threads parked between loops. The number of threads (the calling
+ * thread included) comes from the `NR_NUM_THREADS` environment variable,
+ * or the number of online CPUs when it is not set, and can be changed at
+ * run time with NThread_SetNumThreads.
+ *
+ * NThread_ParallelFor runs on the calling thread alone when the range is
+ * too small for its grain, when there is a single thread, when it is
+ * called from inside another parallel loop, or when another thread is
+ * already using the pool.
+ */
+
+/* Upper bound for NThread_SetNumThreads and NR_NUM_THREADS */
+#define NTHREAD_MAX_THREADS 256
+
+/*
+ * Grain sizes, in items, for the kernels: a loop needs at least two grains
+ * before it is split. Cheap memory-bound loops (add, cast, sum) need large
+ * ranges to pay for waking the workers, loops that cost tens of cycles per
+ * item (exp, sin, tanh) much smaller ones.
+ */
+#define NTHREAD_GRAIN_DEFAULT 32768
+#define NTHREAD_GRAIN_HEAVY 4096
+
+/*
+ * Loop body of NThread_ParallelFor, called for the items [start, end).
+ * It may run on any thread of the pool and may raise an NError there.
+ */
+typedef void (*NThread_RangeFunc)(void* ctx, nr_intp start, nr_intp end);
+
+/*
+ * Calls `func` over [0, n) split into ranges of at least `grain` items,
+ * spread over the pool, and returns once every range is done. Every range
+ * starts at a multiple of `grain`, so a caller that keeps one partial
+ * result per grain block gets the same blocks for any number of threads.
+ *
+ * When a range raises an error, ranges not started yet are skipped and the
+ * error is set on the calling thread before returning (the first one, if
+ * several ranges fail). Ranges that already ran keep their side effects.
+ */
+NR_PUBLIC void
+NThread_ParallelFor(nr_intp n, nr_intp grain, NThread_RangeFunc func, void* ctx);
+
+/*
+ * Returns the number of threads parallel loops use, the calling thread
+ * included.
+ */
+NR_PUBLIC int
+NThread_GetNumThreads(void);
+
+/*
+ * Sets the number of threads parallel loops use. `nthreads` <= 0 selects
+ * the number of online CPUs, 1 turns threading off. Running workers are
+ * stopped and the pool restarts with the new size on the next loop.
+ * Returns the previous value.
+ */
+NR_PUBLIC int
+NThread_SetNumThreads(int nthreads);
+
+#endif // NOUR__CORE_SRC_NOUR_NTHREAD_H
@@ -14,12 +14,15 @@ NTools_BroadcastStrides(nr_intp* a_shape, int a_ndim,
     }
 
     int d = src_ndim - a_ndim;
+    for (int i = 0; i < d; i++){
+        out_strides[i] = 0;
+    }
     for (int i = 0; i < a_ndim; i++){
         if (src_shape[i + d] == a_shape[i]){
-            out_strides[i] = a_strides[i];
+            out_strides[i + d] = a_strides[i];
         }
         else if (a_shape[i] == 1){
-            out_strides[i] = 0;
+            out_strides[i + d] = 0;
         }
         else{
             NError_RaiseError(NError_ValueError,
@@ -65,6 +68,30 @@ NTools_CalculateStrides(int nd, const nr_intp* shape,
     return 0;
 }
 
+NR_PUBLIC int
+NTools_IsCContiguous(int nd, const nr_intp* shape,
+                     const nr_intp* strides, nr_intp itemsize)
+{
+    nr_intp expected = itemsize;
+    for (int i = nd - 1; i > -1; i--){
+        if (shape[i] == 0){
+            return 1;
+        }
+    }
+
+    for (int i = nd - 1; i > -1; i--){
+        if (shape[i] == 1){
+            continue;
+        }
+        if (strides[i] != expected){
+            return 0;
+        }
+        expected *= shape[i];
+    }
+
+    return 1;
+}
+
 NR_PUBLIC void
 NTools_ShapeAsString(nr_intp* shape, int ndim, char str[]) {
     str[0] = '(';
@@ -15,6 +15,15 @@ NR_PUBLIC int
 NTools_CalculateStrides(int nd, const nr_intp* shape,
                         nr_intp itemsize, nr_intp* _des_strides);
 
+/*
+ * Returns 1 if `strides` walk `shape` in C order with no gaps, i.e. each
+ * axis of length > 1 steps over exactly the items of the axes after it.
+ * Size-1 axes may have any stride. Empty shapes count as contiguous.
+ */
+NR_PUBLIC int
+NTools_IsCContiguous(int nd, const nr_intp* shape,
+                     const nr_intp* strides, nr_intp itemsize);
+
 NR_PUBLIC void
 NTools_ShapeAsString(nr_intp* shape, int ndim, char str[]);
 
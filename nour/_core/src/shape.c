@@ -13,30 +13,31 @@
 #include "ntools.h"
 #include "nerror.h"
 #include "niter.h"
+#include "free.h"
+#include "nmem.h"
 
 /* -------------------------------------------------------------------------- */
 /* Helper utilities                                                           */
 /* -------------------------------------------------------------------------- */
 
+/* Lazy and checkpointed nodes are not reshaped in place, their views materialize them */
 NR_STATIC_INLINE int _can_inplace(Node* node, int copy){
-    return copy && node && NODE_REFCOUNT(node) == 1;
+    return copy && node && NODE_REFCOUNT(node) == 1
+        && !NODE_IS_LAZY(node) && !NODE_IS_RECOMPUTE(node);
 }
 
 NR_STATIC_INLINE void _apply_inplace(Node* node, int new_ndim, nr_intp* new_shape){
     /* Reallocate shape/strides if ndim changed */
     if (new_ndim != node->ndim){
-        free(node->shape);
-        free(node->strides);
-        node->shape = (nr_intp*)malloc(sizeof(nr_intp) * new_ndim);
-        node->strides = (nr_intp*)malloc(sizeof(nr_intp) * new_ndim);
-        if (!node->shape || !node->strides){
-            NError_RaiseMemoryError();
+        if (Node_AllocDims(node, new_ndim) != 0){
+            node->ndim = 0;
             return; /* caller must detect allocation failure separately if needed */
         }
     }
     memcpy(node->shape, new_shape, sizeof(nr_intp) * new_ndim);
     NTools_CalculateStrides(new_ndim, new_shape, NODE_ITEMSIZE(node), node->strides);
     node->ndim = new_ndim;
+    Node_UpdateContiguity(node);
 }
 
 NR_STATIC_INLINE Node* _new_view(Node* src, int ndim, nr_intp* shape, nr_intp* strides){
@@ -90,10 +91,6 @@ NR_PUBLIC Node* Node_Ravel(Node* node, int copy){
     if (!node){ NError_RaiseError(NError_ValueError, "ravel: NULL node"); return NULL; }
     nr_intp nitems = Node_NItems(node);
     nr_intp shape1[1] = { nitems };
-    if (_can_inplace(node, copy)){
-        _apply_inplace(node, 1, shape1);
-        return node;
-    }
     if (!NODE_IS_CONTIGUOUS(node)){
         /* Fallback: create a contiguous copy */
         Node* out = Node_NewEmpty(1, shape1, NODE_DTYPE(node));
@@ -101,6 +98,10 @@ NR_PUBLIC Node* Node_Ravel(Node* node, int copy){
         Node_Copy(out, node);
         return out;
     }
+    if (_can_inplace(node, copy)){
+        _apply_inplace(node, 1, shape1);
+        return node;
+    }
     nr_intp strides[1]; _build_strides(1, shape1, NODE_ITEMSIZE(node), strides);
     return _new_view(node, 1, shape1, strides);
 }
@@ -130,6 +131,7 @@ NR_PUBLIC Node* Node_SwapAxes(Node* node, int axis1, int axis2, int copy){
     if (_can_inplace(node, copy)){
         _apply_inplace(node, node->ndim, new_shape);
         memcpy(node->strides, new_strides, sizeof(nr_intp)*node->ndim);
+        Node_UpdateContiguity(node);
         return node;
     }
     return Node_NewChild(node, node->ndim, new_shape, new_strides, 0);
@@ -147,6 +149,7 @@ NR_PUBLIC Node* Node_Transpose(Node* node, int copy){
     if (_can_inplace(node, copy)){
         _apply_inplace(node, node->ndim, new_shape);
         memcpy(node->strides, new_strides, sizeof(nr_intp)*node->ndim);
+        Node_UpdateContiguity(node);
         return node;
     }
     return Node_NewChild(node, node->ndim, new_shape, new_strides, 0);
@@ -166,6 +169,7 @@ NR_PUBLIC Node* Node_PermuteDims(Node* node, const int* order, int copy){
     if (_can_inplace(node, copy)){
         _apply_inplace(node, ndim, new_shape);
         memcpy(node->strides, new_strides, sizeof(nr_intp)*ndim);
+        Node_UpdateContiguity(node);
         return node;
     }
     return Node_NewChild(node, ndim, new_shape, new_strides, 0);
@@ -248,6 +252,7 @@ NR_PUBLIC Node* Node_ExpandDims(Node* node, int axis, int copy){
     if (_can_inplace(node, copy)){
         _apply_inplace(node, ndim+1, new_shape);
         memcpy(node->strides, new_strides, sizeof(nr_intp)*(ndim+1));
+        Node_UpdateContiguity(node);
         return node;
     }
     return Node_NewChild(node, ndim+1, new_shape, new_strides, 0);
@@ -265,12 +270,13 @@ NR_PUBLIC Node* Node_Squeeze(Node* node, int copy){
     if (new_ndim == node->ndim){ return copy ? node : _new_view(node, node->ndim, node->shape, node->strides); }
     if (new_ndim == 0){ /* becomes scalar */
         if (_can_inplace(node, copy)){
-            free(node->shape); free(node->strides); node->shape=NULL; node->strides=NULL; node->ndim=0; return node; }
+            Node_FreeDims(node); node->ndim=0; return node; }
         return Node_NewChild(node, 0, NULL, NULL, 0);
     }
     if (_can_inplace(node, copy)){
         _apply_inplace(node, new_ndim, new_shape);
         memcpy(node->strides, new_strides, sizeof(nr_intp)*new_ndim);
+        Node_UpdateContiguity(node);
         return node;
     }
     return Node_NewChild(node, new_ndim, new_shape, new_strides, 0);
@@ -282,10 +288,11 @@ NR_PUBLIC Node* Node_Squeeze(Node* node, int copy){
 NR_PUBLIC Node* Node_Resize(Node* node, nr_intp* new_shape, int new_ndim, int copy){
     if (!node){ NError_RaiseError(NError_ValueError, "resize: NULL node"); return NULL; }
     if (new_ndim < 0 || new_ndim > NR_NODE_MAX_NDIM){ NError_RaiseError(NError_ValueError, "resize: invalid ndim %d", new_ndim); return NULL; }
+    if (Node_Materialize(node) < 0){ return NULL; }
     nr_intp new_items = NR_NItems(new_ndim, new_shape);
     nr_intp itemsize = NODE_ITEMSIZE(node);
-    void* new_data = malloc(new_items * itemsize);
-    if (!new_data){ NError_RaiseMemoryError(); return NULL; }
+    void* new_data = NMem_Alloc(new_items * itemsize);
+    if (!new_data){ return NULL; }
     /* copy min(old_items, new_items) */
     nr_intp old_items = Node_NItems(node);
     nr_intp to_copy = old_items < new_items ? old_items : new_items;
@@ -301,11 +308,11 @@ NR_PUBLIC Node* Node_Resize(Node* node, nr_intp* new_shape, int new_ndim, int co
     /* zero-fill remainder */
     if (to_copy < new_items){ memset((char*)new_data + to_copy*itemsize, 0, (new_items - to_copy)*itemsize); }
     if (_can_inplace(node, copy)){
-        if (NODE_IS_OWNDATA(node)){ free(node->data); }
-        node->data = new_data; node->flags |= NR_NODE_OWNDATA;
+        Node_ReleaseData(node);
+        node->data = new_data; node->flags |= NR_NODE_OWNDATA | NR_NODE_NMEMDATA;
         _apply_inplace(node, new_ndim, new_shape);
         return node;
     }
-    Node* out = Node_New(new_data, 1, new_ndim, new_shape, NODE_DTYPE(node));
+    Node* out = Node_New(new_data, NR_OWNDATA_NMEM, new_ndim, new_shape, NODE_DTYPE(node));
     return out;
 }
@@ -56,4 +56,9 @@ Node_ToType(Node* dst, const Node* src, NR_DTYPE dtype){
     int idx = dtype * NR_NUM_NUMIRC_DT + src->dtype.dtype;
     Node2NodeFunc func = __NODE_TC_METHODS_ARRAY__[idx];
     return func(dst, src);
-}
\ No newline at end of file
+}
+
+NR_PUBLIC NDtype_CastFunc
+NDtype_GetCastFunc(NR_DTYPE src, NR_DTYPE dst){
+    return __NODE_TC_CAST_ARRAY__[dst * NR_NUM_NUMIRC_DT + src];
+}
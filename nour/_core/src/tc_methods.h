@@ -3,11 +3,25 @@
 
 #include "nour/nour.h"
 
+/*
+ * Converts `n` items starting at `src`, `stride` bytes apart, into the
+ * contiguous buffer `dst`.
+ */
+typedef void (*NDtype_CastFunc)(const void* src, nr_intp stride, void* dst, nr_intp n);
+
 extern Node2NodeFunc __NODE_TC_METHODS_ARRAY__[];
+extern NDtype_CastFunc __NODE_TC_CAST_ARRAY__[];
 
 NR_PUBLIC Node*
 Node_ToType(Node* dst, const Node* src, NR_DTYPE dtype);
 
+/*
+ * Strided cast loop from `src` to `dst` dtype, for kernels that convert
+ * their inputs a block at a time. NULL when both dtypes are the same.
+ */
+NR_PUBLIC NDtype_CastFunc
+NDtype_GetCastFunc(NR_DTYPE src, NR_DTYPE dst);
+
 /* Scalar extraction helpers.
  * Each function returns the requested C type converted from the node's single value.
  * Requirements: node must be a scalar (ndim==0) OR have exactly one item (total size == 1).
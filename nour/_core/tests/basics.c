@@ -1,4 +1,7 @@
 #include "main.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 int test_basic_1(){
     Node* n1;
@@ -16,9 +19,312 @@ int test_basic_1(){
     return 1;
 }
 
+int test_basic_inline_dims(){
+    nr_intp shp2[2] = {4, 8};
+    nr_intp shp8[8] = {2, 1, 2, 1, 2, 1, 2, 2};
+    Node* small = Node_NewEmpty(2, shp2, NR_INT32);
+    Node* big = Node_NewEmpty(8, shp8, NR_INT32);
+    if (!small || !big) {
+        return 0;
+    }
+
+    int ok = small->shape == small->inline_dims && small->strides == small->shape + 2
+          && big->shape != big->inline_dims && big->strides == big->shape + 8
+          && small->strides[0] == 32 && big->strides[0] == 64 && big->strides[7] == 4;
+
+    // in-place reshape moves between inline and heap storage
+    nr_intp flat[1] = {32};
+    if (Node_Reshape(big, flat, 1, 1) != big || big->shape != big->inline_dims
+        || big->shape[0] != 32 || big->strides[0] != 4) {
+        ok = 0;
+    }
+    if (Node_Reshape(small, shp8, 8, 1) != small || small->shape == small->inline_dims
+        || small->shape[7] != 2 || small->strides[0] != 64) {
+        ok = 0;
+    }
+
+    Node_Free(small);
+    Node_Free(big);
+    return ok;
+}
+
+int test_basic_node_pool_reuse(){
+    NodePool_Clear();
+    nr_intp shp[1] = {3};
+    nr_int32 data[3] = {1, 2, 3};
+    Node* a = Node_New(data, 0, 1, shp, NR_INT32);
+    Node* first = a;
+    Node_Free(a);
+    if (NodePool_Cached() != 1) {
+        return 0;
+    }
+
+    Node* b = Node_New(data, 0, 1, shp, NR_INT32);
+    int ok = b == first && NodePool_Cached() == 0 && b->ref_count == 1
+          && b->base == NULL && ((nr_int32*)NODE_DATA(b))[2] == 3;
+
+    // a view returns both headers, the cache stays bounded
+    Node* views[NODE_POOL_MAX_CACHED + 8];
+    for (int i = 0; i < NODE_POOL_MAX_CACHED + 8; i++) {
+        views[i] = Node_NewChild(b, 1, shp, NODE_STRIDES(b), 0);
+    }
+    for (int i = 0; i < NODE_POOL_MAX_CACHED + 8; i++) {
+        Node_Free(views[i]);
+    }
+    if (b->ref_count != 1 || NodePool_Cached() != NODE_POOL_MAX_CACHED) {
+        ok = 0;
+    }
+    Node_Free(b);
+    NodePool_Clear();
+    return ok && NodePool_Cached() == 0;
+}
+
+/* Allocator that checks every free against the size it handed out */
+typedef struct { nr_size_t live; int mismatched; int misaligned; } size_check;
+
+static void* checked_alloc(void* ctx, nr_size_t size, nr_size_t alignment) {
+    size_check* c = (size_check*)ctx;
+    nr_size_t* block = (nr_size_t*)malloc(size + 64);
+    if (!block) {
+        return NULL;
+    }
+    block[0] = size;
+    c->live += size;
+    c->misaligned |= alignment != NMEM_ALIGNMENT;
+    return (char*)block + 64;
+}
+
+static void checked_free(void* ctx, void* ptr, nr_size_t size) {
+    size_check* c = (size_check*)ctx;
+    nr_size_t* block = (nr_size_t*)((char*)ptr - 64);
+    c->mismatched |= block[0] != size;
+    c->live -= block[0];
+    free(block);
+}
+
+static void* checked_realloc(void* ctx, void* ptr, nr_size_t old_size,
+                             nr_size_t new_size, nr_size_t alignment) {
+    void* out = checked_alloc(ctx, new_size, alignment);
+    if (out) {
+        memcpy(out, ptr, old_size < new_size ? old_size : new_size);
+        checked_free(ctx, ptr, old_size);
+    }
+    return out;
+}
+
+int test_basic_nmem_aligned(){
+    NMem_Stats before, after;
+    NMem_GetStats(&before);
+    void* p = NMem_Alloc(100);
+    Node* a = Node_NewEmpty(2, (nr_intp[]){3, 5}, NR_FLOAT64);
+    if (!p || !a) {
+        return 0;
+    }
+    int ok = ((nr_uintp)p % NMEM_ALIGNMENT) == 0 && ((nr_uintp)NODE_DATA(a) % NMEM_ALIGNMENT) == 0;
+    p = NMem_Realloc(p, 100, 300);
+    ok = ok && p && ((nr_uintp)p % NMEM_ALIGNMENT) == 0;
+
+    NMem_GetStats(&after);
+    if (after.bytes_in_use != before.bytes_in_use + 300 + 120
+        || after.nallocs != before.nallocs + 2 || after.nreallocs != before.nreallocs + 1) {
+        printf("Unexpected allocation stats\n");
+        ok = 0;
+    }
+    NMem_Free(p, 300);
+    Node_Free(a);
+    NMem_GetStats(&after);
+    return ok && after.bytes_in_use == before.bytes_in_use && after.nfrees == before.nfrees + 2
+           && after.peak_bytes >= before.bytes_in_use + 420;
+}
+
+int test_basic_nmem_foreign_owned(){
+    NMem_Stats before, after;
+    NMem_GetStats(&before);
+    nr_int32* buf = (nr_int32*)malloc(25 * sizeof(nr_int32));
+    Node* a = Node_New(buf, 1, 1, (nr_intp[]){25}, NR_INT32);
+    if (!a || !NODE_IS_OWNDATA(a) || NODE_IS_NMEMDATA(a)) {
+        return 0;
+    }
+    Node* b = Node_NewEmpty(1, (nr_intp[]){25}, NR_INT32);
+    int ok = b && NODE_IS_NMEMDATA(b);
+    Node_Free(a);
+    Node_Free(b);
+
+    // the caller's buffer went to free(), NMem only saw its own block
+    NMem_GetStats(&after);
+    if (after.bytes_in_use != before.bytes_in_use || after.nfrees != before.nfrees + 1) {
+        printf("Foreign buffer reached NMem: %llu bytes in use, %llu frees\n",
+               after.bytes_in_use, after.nfrees - before.nfrees);
+        ok = 0;
+    }
+    return ok;
+}
+
+int test_basic_nmem_custom_allocator(){
+    size_check c = {0, 0, 0};
+    NMem_Allocator mine = {&c, checked_alloc, checked_realloc, checked_free};
+    NMem_Allocator prev;
+    NMem_SetAllocator(&mine, &prev);
+
+    nr_intp shp[2] = {4, 6};
+    Node* a = Node_NewEmpty(2, shp, NR_FLOAT32);
+    for (int i = 0; i < 24; i++) {
+        ((nr_float32*)NODE_DATA(a))[i] = (nr_float32)i;
+    }
+    Node* s = NMath_Sum(NULL, a, (int[]){0}, 1);
+    Node* mx = NMath_Argmax(NULL, a, (int[]){1}, 1);
+    Node* nm = NMath_NanMean(NULL, a, (int[]){1}, 1);
+    Node* t = Node_MatrixTranspose(a, 0);
+    Node* c2 = Node_Copy(NULL, t);
+    Node* r = Node_Resize(c2, (nr_intp[]){5, 5}, 2, 1);
+    int ok = s && mx && nm && t && r && c.live > 0;
+    Node_Free(s);
+    Node_Free(mx);
+    Node_Free(nm);
+    Node_Free(t);
+    Node_Free(r);
+    Node_Free(a);
+
+    NMem_SetAllocator(NULL, NULL);
+    NMem_Allocator restored;
+    NMem_GetAllocator(&restored);
+    NMem_SetAllocator(&prev, NULL);
+    if (c.live != 0 || c.mismatched || c.misaligned || restored.alloc == checked_alloc) {
+        printf("Custom allocator saw %lld live bytes, mismatched %d\n", (long long)c.live, c.mismatched);
+        ok = 0;
+    }
+    return ok;
+}
+
+int test_basic_nmem_cache_reuse(){
+    nr_size_t prev = NMem_SetCacheLimit(1 << 20);
+    NMem_TrimCache(0);
+    NMem_ResetStats();
+
+    nr_intp shp[2] = {16, 16};
+    Node* a = Node_NewEmpty(2, shp, NR_FLOAT32);
+    Node* b = Node_NewEmpty(2, shp, NR_FLOAT32);
+    void* first = NULL;
+    int ok = a && b;
+    for (int i = 0; i < 4 && ok; i++) {
+        Node* c = NMath_Add(NULL, a, b);
+        if (!c) {
+            return 0;
+        }
+        if (i == 0) {
+            first = NODE_DATA(c);
+        }
+        ok = NODE_DATA(c) == first;
+        Node_Free(c);
+    }
+    NMem_Stats st;
+    NMem_GetStats(&st);
+    if (!ok || st.cache_hits != 3 || st.cache_misses != 3 || st.cached_bytes != 1024) {
+        printf("Cache hits %llu misses %llu cached %llu\n", st.cache_hits, st.cache_misses, st.cached_bytes);
+        ok = 0;
+    }
+
+    // same class reallocs stay in place, blocks of another class move
+    void* p = NMem_Alloc(1100);
+    void* q = NMem_Realloc(p, 1100, 1250);
+    void* r = NMem_Realloc(q, 1250, 1300);
+    if (q != p || !r || r == q) {
+        printf("Realloc ignored the size classes\n");
+        ok = 0;
+    }
+    NMem_Free(r, 1300);
+
+    Node_Free(a);
+    Node_Free(b);
+    NMem_GetStats(&st);
+    nr_uint64 cached = st.cached_bytes;
+    NMem_TrimCache(1024);
+    NMem_GetStats(&st);
+    ok = ok && cached > 1024 && st.cached_bytes <= 1024;
+
+    NMem_SetCacheLimit(0);
+    NMem_GetStats(&st);
+    nr_uint64 hits = st.cache_hits;
+    Node* c = Node_NewEmpty(2, shp, NR_FLOAT32);
+    Node_Free(c);
+    NMem_GetStats(&st);
+    ok = ok && st.cached_bytes == 0 && st.cache_hits == hits && NMem_GetCacheLimit() == 0;
+    NMem_SetCacheLimit(prev);
+    return ok;
+}
+
+int test_basic_nmem_cache_skips_foreign(){
+    nr_size_t prev = NMem_SetCacheLimit(1 << 20);
+    NMem_TrimCache(0);
+
+    // a 100 byte malloc block would fall in the 128 byte class
+    nr_int8* buf = (nr_int8*)malloc(100);
+    Node* a = Node_New(buf, 1, 1, (nr_intp[]){100}, NR_INT8);
+    Node_Free(a);
+    NMem_Stats st;
+    NMem_GetStats(&st);
+    Node* b = Node_NewEmpty(1, (nr_intp[]){128}, NR_INT8);
+    int ok = b && st.cached_bytes == 0 && (void*)NODE_DATA(b) != (void*)buf
+             && ((nr_uintp)NODE_DATA(b) % NMEM_ALIGNMENT) == 0;
+    if (b) {
+        memset(NODE_DATA(b), 1, 128);
+    }
+    Node_Free(b);
+    NMem_SetCacheLimit(prev);
+    return ok;
+}
+
+typedef struct { int calls; void* data; } deleter_log;
+
+static void log_deleter(void* data, void* ctx) {
+    deleter_log* log = (deleter_log*)ctx;
+    log->calls++;
+    log->data = data;
+    free(data);
+}
+
+int test_basic_external_deleter(){
+    deleter_log log = {0, NULL};
+    nr_float64* buf = (nr_float64*)malloc(12 * sizeof(nr_float64));
+    for (int i = 0; i < 12; i++) {
+        buf[i] = i;
+    }
+    Node* a = Node_NewExternal(buf, 2, (nr_intp[]){3, 4}, NULL, NR_FLOAT64, log_deleter, &log);
+    if (!a || NODE_DATA(a) != buf || !NODE_IS_CONTIGUOUS(a)) {
+        return 0;
+    }
+
+    // the view keeps the buffer alive after the wrapping node is dropped
+    Node* row = Node_NewChild(a, 1, (nr_intp[]){4}, (nr_intp[]){8}, 2 * 4 * 8);
+    Node_Free(a);
+    int ok = log.calls == 0 && ((nr_float64*)NODE_DATA(row))[3] == 11.;
+    Node_Free(row);
+    ok = ok && log.calls == 1 && log.data == buf;
+
+    // replacing the buffer in place hands the old one to the deleter
+    nr_float64* buf2 = (nr_float64*)malloc(4 * sizeof(nr_float64));
+    Node* b = Node_NewExternal(buf2, 1, (nr_intp[]){4}, NULL, NR_FLOAT64, log_deleter, &log);
+    Node* r = Node_Resize(b, (nr_intp[]){6}, 1, 1);
+    ok = ok && r == b && log.calls == 2 && log.data == buf2 && NODE_IS_OWNDATA(r);
+    Node_Free(r);
+
+    // failed construction leaves the buffer with the caller
+    nr_float64 stack_buf[2];
+    Node* bad = Node_NewExternal(stack_buf, -1, NULL, NULL, NR_FLOAT64, log_deleter, &log);
+    NError_Clear();
+    return ok && !bad && log.calls == 2;
+}
 
 void test_basic() {
     run_all_tests((TestFunc[]){
         test_basic_1,
-    }, "Basic", 1);
+        test_basic_inline_dims,
+        test_basic_node_pool_reuse,
+        test_basic_nmem_aligned,
+        test_basic_nmem_foreign_owned,
+        test_basic_nmem_custom_allocator,
+        test_basic_nmem_cache_reuse,
+        test_basic_nmem_cache_skips_foreign,
+        test_basic_external_deleter,
+    }, "Basic", 9);
 }
\ No newline at end of file
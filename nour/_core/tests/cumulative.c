@@ -83,6 +83,10 @@ int test_nancumprod_float64(){ nr_intp shape[1]={4}; double data[4]={2.0,NAN,3.0
 int test_nancummin_behavior(){ nr_intp shape[1]={5}; double data[5]={NAN,5.0,3.0,NAN,2.0}; Node* n=make_node_f64(data,1,shape); Node* r=NMath_NanCummin(NULL,n,0); if(!r){ printf("NanCummin failed\n"); Node_Free(n); return 0;} VERIFY_ARRAY_FLOAT64_APPROX(r,5,1e-9,0.0,5.0,3.0,3.0,2.0); Node_Free(n); Node_Free(r); return 1; }
 int test_nancummax_behavior(){ nr_intp shape[1]={5}; double data[5]={NAN,5.0,3.0,NAN,7.0}; Node* n=make_node_f64(data,1,shape); Node* r=NMath_NanCummax(NULL,n,0); if(!r){ printf("NanCummax failed\n"); Node_Free(n); return 0;} VERIFY_ARRAY_FLOAT64_APPROX(r,5,1e-9,0.0,5.0,5.0,5.0,7.0); Node_Free(n); Node_Free(r); return 1; }
 
+int test_cumsum_float64_compensated(){ const nr_intp n=1<<20; double* data=(double*)malloc(n*sizeof(double)); for(nr_intp i=0;i<n;i++) data[i]=0.1; nr_intp shape[1]={n}; Node* a=make_node_f64(data,1,shape); Node* r=NMath_Cumsum(NULL,a,0); if(!r){ printf("Cumsum float64 failed\n"); Node_Free(a); free(data); return 0;} double* d=(double*)NODE_DATA(r); int ok = fabs(d[n-1]-(double)n*0.1) < 1e-9 && fabs(d[n/2-1]-(double)(n/2)*0.1) < 1e-9; if(!ok) printf("Cumsum float64 inaccurate: %.17g\n", d[n-1]); Node_Free(r); Node_Free(a); free(data); return ok; }
+static int check_layout(Node* v, const int* d, const nr_intp* sh, const nr_intp* st, int axis){ Node* cs=NMath_Cumsum(NULL,v,axis); Node* cm=NMath_Cummin(NULL,v,axis); Node* df=NMath_Diff(NULL,v,axis); Node* gr=NMath_Gradient(NULL,v,axis); if(!cs||!cm||!df||!gr){ printf("Strided scan failed on axis %d\n",axis); return 0; } int ok=1; nr_intp len=sh[axis]; nr_intp dsh[3]={sh[0],sh[1],sh[2]}; dsh[axis]--; for(nr_intp i=0;i<sh[0]&&ok;i++) for(nr_intp j=0;j<sh[1]&&ok;j++) for(nr_intp k=0;k<sh[2]&&ok;k++){ nr_intp c[3]={i,j,k}; nr_intp pos=c[axis]; nr_int64 sum=0; int mn=0; int val[64]; for(nr_intp t=0;t<len;t++){ c[axis]=t; val[t]=d[c[0]*st[0]+c[1]*st[1]+c[2]*st[2]]; } for(nr_intp t=0;t<=pos;t++){ sum+=val[t]; if(t==0||val[t]<mn) mn=val[t]; } c[axis]=pos; nr_intp lin=(i*sh[1]+j)*sh[2]+k; double g=pos==0?val[1]-val[0]:pos==len-1?val[len-1]-val[len-2]:(val[pos+1]-val[pos-1])/2.0; if(((nr_int64*)NODE_DATA(cs))[lin]!=sum||((nr_int32*)NODE_DATA(cm))[lin]!=mn||((double*)NODE_DATA(gr))[lin]!=g) ok=0; if(pos<len-1&&((nr_int64*)NODE_DATA(df))[(c[0]*dsh[1]+c[1])*dsh[2]+c[2]]!=val[pos+1]-val[pos]) ok=0; if(!ok) printf("Strided scan mismatch at (%lld,%lld,%lld) axis %d\n",(long long)i,(long long)j,(long long)k,axis); } Node_Free(cs); Node_Free(cm); Node_Free(df); Node_Free(gr); return ok; }
+int test_cumulative_strided_layouts(){ enum{A=4,B=5,C=6}; int d[A*B*C]; for(int i=0;i<A*B*C;i++) d[i]=(i*37)%23-11; nr_intp sh[3]={A,B,C}; Node* n=make_node_i32(d,3,sh); nr_intp tsh[3]={C,B,A}; nr_intp tst[3]={4,4*C,4*B*C}; Node* t=Node_NewChild(n,3,tsh,tst,0); nr_intp st[3]={B*C,C,1}, tsti[3]={1,C,B*C}; int ok=1; for(int ax=0;ax<3&&ok;ax++) ok=check_layout(n,d,sh,st,ax)&&check_layout(t,d,tsh,tsti,ax); Node_Free(t); Node_Free(n); return ok; }
+int test_nancum_lanes_axis0(){ enum{R=3,L=300}; double d[R*L]; for(int j=0;j<L;j++){ d[j]=j%3==0?NAN:1.0; d[L+j]=j; d[2*L+j]=L-j; } nr_intp shape[2]={R,L}; Node* n=make_node_f64(d,2,shape); Node* mx=NMath_NanCummax(NULL,n,0); Node* sm=NMath_NanCumsum(NULL,n,0); if(!mx||!sm){ printf("NaN scan over axis 0 failed\n"); return 0; } double* m=(double*)NODE_DATA(mx); double* s=(double*)NODE_DATA(sm); for(int j=0;j<L;j++){ int nan0=j%3==0; double m1=nan0?j:(j>1?j:1), m2=m1>L-j?m1:L-j, s2=(nan0?0:1)+j+(L-j); if(m[j]!=(nan0?0:1)||m[L+j]!=m1||m[2*L+j]!=m2||s[2*L+j]!=s2){ printf("NaN lane %d mismatch: %f %f %f / %f\n",j,m[j],m[L+j],m[2*L+j],s[2*L+j]); return 0; } } Node_Free(mx); Node_Free(sm); nr_intp one[2]={1,L}; Node* row=make_node_f64(d,2,one); Node* g=NMath_Gradient(NULL,row,0); int ok=!g&&NERROR_TYPE==NError_ValueError; NError_Clear(); if(!ok) printf("Gradient over a length-1 axis not rejected\n"); Node_Free(g); Node_Free(row); Node_Free(n); return ok; }
 void test_cumulative(){ TestFunc tests[]={
     test_cumsum_int32_default_axis,
     test_cumsum_int32_axis0,
@@ -99,5 +103,7 @@ void test_cumulative(){ TestFunc tests[]={
     test_nancumsum_float32,
     test_nancumprod_float64,
     test_nancummin_behavior,
-    test_nancummax_behavior
+    test_nancummax_behavior,
+    test_cumsum_float64_compensated,
+    test_cumulative_strided_layouts, test_nancum_lanes_axis0
 }; int num=sizeof(tests)/sizeof(tests[0]); run_all_tests(tests, "Cumulative Tests", num); }
@@ -0,0 +1,64 @@
+#include "main.h"
+#include "../src/cnour.h"
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+/* Runs the body once per SIMD level available on this machine, scalar loops included. */
+#define FOR_EACH_SIMD_LEVEL(...) do { \
+    NSimd_Level __prev = NSimd_GetLevel(); \
+    for (int __lvl = NSIMD_LEVEL_NONE; __lvl <= (int)NSimd_GetHardwareLevel(); __lvl++) { \
+        NSimd_SetLevel((NSimd_Level)__lvl); \
+        __VA_ARGS__ \
+    } \
+    NSimd_SetLevel(__prev); \
+} while(0)
+
+#define FAIL_AT_LEVEL(msg, i) do { printf("%s at %d (simd level %d)\n", msg, (int)(i), __lvl); NSimd_SetLevel(__prev); return 0; } while(0)
+
+int test_ewise_add_f32_tail(){ enum{N=37}; nr_float32 a[N], b[N]; for(int i=0;i<N;i++){ a[i]=(nr_float32)i*0.5f; b[i]=(nr_float32)(N-i); } nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT32); Node* nb=Node_New(b,0,1,shape,NR_FLOAT32); FOR_EACH_SIMD_LEVEL({ Node* r=NMath_Add(NULL,na,nb); if(!r) FAIL_AT_LEVEL("Add failed",0); nr_float32* d=(nr_float32*)NODE_DATA(r); for(int i=0;i<N;i++){ if(d[i]!=a[i]+b[i]){ Node_Free(r); FAIL_AT_LEVEL("Add f32 mismatch",i);} } Node_Free(r); }); Node_Free(na); Node_Free(nb); return 1; }
+int test_ewise_mul_f64_out(){ enum{N=21}; nr_float64 a[N], b[N]; for(int i=0;i<N;i++){ a[i]=i-10.0; b[i]=0.25*i; } nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT64); Node* nb=Node_New(b,0,1,shape,NR_FLOAT64); Node* out=Node_NewEmpty(1,shape,NR_FLOAT64); FOR_EACH_SIMD_LEVEL({ Node* r=NMath_Mul(out,na,nb); if(r!=out) FAIL_AT_LEVEL("Mul did not use out",0); nr_float64* d=(nr_float64*)NODE_DATA(out); for(int i=0;i<N;i++){ if(d[i]!=a[i]*b[i]) FAIL_AT_LEVEL("Mul f64 mismatch",i); } }); Node_Free(na); Node_Free(nb); Node_Free(out); return 1; }
+int test_ewise_sub_scalar_first(){ enum{N=19}; nr_float32 a[N]; for(int i=0;i<N;i++) a[i]=(nr_float32)i; nr_float32 s=100.0f; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT32); Node* ns=Node_New(&s,0,0,NULL,NR_FLOAT32); FOR_EACH_SIMD_LEVEL({ Node* r1=NMath_Sub(NULL,ns,na); Node* r2=NMath_Sub(NULL,na,ns); if(!r1||!r2) FAIL_AT_LEVEL("Sub failed",0); nr_float32* d1=(nr_float32*)NODE_DATA(r1); nr_float32* d2=(nr_float32*)NODE_DATA(r2); for(int i=0;i<N;i++){ if(d1[i]!=s-a[i]||d2[i]!=a[i]-s){ Node_Free(r1); Node_Free(r2); FAIL_AT_LEVEL("Scalar sub order mismatch",i);} } Node_Free(r1); Node_Free(r2); }); Node_Free(na); Node_Free(ns); return 1; }
+int test_ewise_sub_scalar_first_int32(){ enum{N=13}; nr_int32 a[N]; for(int i=0;i<N;i++) a[i]=i*3; nr_int32 s=7; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_INT32); Node* ns=Node_New(&s,0,0,NULL,NR_INT32); FOR_EACH_SIMD_LEVEL({ Node* r=NMath_Sub(NULL,ns,na); if(!r) FAIL_AT_LEVEL("Sub int failed",0); nr_int32* d=(nr_int32*)NODE_DATA(r); for(int i=0;i<N;i++){ if(d[i]!=s-a[i]){ Node_Free(r); FAIL_AT_LEVEL("Int scalar sub mismatch",i);} } Node_Free(r); }); Node_Free(na); Node_Free(ns); return 1; }
+int test_ewise_int8_add_wraps(){ enum{N=40}; nr_int8 a[N], b[N]; for(int i=0;i<N;i++){ a[i]=(nr_int8)(100+i); b[i]=(nr_int8)(50); } nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_INT8); Node* nb=Node_New(b,0,1,shape,NR_INT8); FOR_EACH_SIMD_LEVEL({ Node* r=NMath_Add(NULL,na,nb); if(!r) FAIL_AT_LEVEL("Add int8 failed",0); nr_int8* d=(nr_int8*)NODE_DATA(r); for(int i=0;i<N;i++){ if(d[i]!=(nr_int8)(a[i]+b[i])){ Node_Free(r); FAIL_AT_LEVEL("Int8 add mismatch",i);} } Node_Free(r); }); Node_Free(na); Node_Free(nb); return 1; }
+int test_ewise_bitxor_uint16_scalar(){ enum{N=35}; nr_uint16 a[N]; for(int i=0;i<N;i++) a[i]=(nr_uint16)(i*977); nr_uint16 s=0xF0F0; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_UINT16); Node* ns=Node_New(&s,0,0,NULL,NR_UINT16); FOR_EACH_SIMD_LEVEL({ Node* r=NMath_BitXor(NULL,na,ns); if(!r) FAIL_AT_LEVEL("BitXor failed",0); nr_uint16* d=(nr_uint16*)NODE_DATA(r); for(int i=0;i<N;i++){ if(d[i]!=(nr_uint16)(a[i]^s)){ Node_Free(r); FAIL_AT_LEVEL("BitXor mismatch",i);} } Node_Free(r); }); Node_Free(na); Node_Free(ns); return 1; }
+int test_ewise_compare_f32_nan(){ enum{N=27}; nr_float32 a[N], b[N]; for(int i=0;i<N;i++){ a[i]=(nr_float32)(i%5); b[i]=(nr_float32)(i%3); } a[4]=NAN; b[17]=NAN; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT32); Node* nb=Node_New(b,0,1,shape,NR_FLOAT32); FOR_EACH_SIMD_LEVEL({ Node* bg=NMath_Bg(NULL,na,nb); Node* ne=NMath_Neq(NULL,na,nb); Node* le=NMath_Lse(NULL,na,nb); if(!bg||!ne||!le) FAIL_AT_LEVEL("Compare failed",0); nr_bool* d1=(nr_bool*)NODE_DATA(bg); nr_bool* d2=(nr_bool*)NODE_DATA(ne); nr_bool* d3=(nr_bool*)NODE_DATA(le); for(int i=0;i<N;i++){ if(d1[i]!=(a[i]>b[i])||d2[i]!=(a[i]!=b[i])||d3[i]!=(a[i]<=b[i])){ Node_Free(bg); Node_Free(ne); Node_Free(le); FAIL_AT_LEVEL("Compare mismatch",i);} } Node_Free(bg); Node_Free(ne); Node_Free(le); }); Node_Free(na); Node_Free(nb); return 1; }
+int test_ewise_compare_f64_scalar(){ enum{N=11}; nr_float64 a[N]; for(int i=0;i<N;i++) a[i]=i*0.5; nr_float64 s=2.0; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT64); Node* ns=Node_New(&s,0,0,NULL,NR_FLOAT64); FOR_EACH_SIMD_LEVEL({ Node* r=NMath_Ls(NULL,ns,na); if(!r) FAIL_AT_LEVEL("Ls failed",0); nr_bool* d=(nr_bool*)NODE_DATA(r); for(int i=0;i<N;i++){ if(d[i]!=(s<a[i])){ Node_Free(r); FAIL_AT_LEVEL("Scalar compare mismatch",i);} } Node_Free(r); }); Node_Free(na); Node_Free(ns); return 1; }
+int test_ewise_simd_level_clamped(){ NSimd_Level prev=NSimd_GetLevel(); NSimd_Level got=NSimd_SetLevel(NSIMD_LEVEL_AVX512); if(got>NSimd_GetHardwareLevel()){ printf("Level not clamped to hardware\n"); NSimd_SetLevel(prev); return 0;} got=NSimd_SetLevel(NSIMD_LEVEL_NONE); if(got!=NSIMD_LEVEL_NONE||NSimd_BinaryFunc(NSIMD_OP_Add,NR_FLOAT32,NSIMD_BIN_VV)!=NULL){ printf("Level none still dispatches vector loops\n"); NSimd_SetLevel(prev); return 0;} NSimd_SetLevel(prev); return 1; }
+
+/* Error check used by the transcendental tests, in ULP of the type (eps / tiny: epsilon and smallest normal). */
+static int close_ulp(double got, double want, double eps, double tiny, double max_ulp){ if(isnan(want)) return isnan(got); if(isinf(want)) return got==want; return fabs(got-want)<=max_ulp*eps*fmax(fabs(want), tiny); }
+
+int test_ewise_exp_log_f32(){ enum{N=203}; nr_float32 a[N]; for(int i=0;i<N;i++) a[i]=-100.0f+i*0.985f; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT32); FOR_EACH_SIMD_LEVEL({ Node* e=NMath_Exp(NULL,na); if(!e) FAIL_AT_LEVEL("Exp failed",0); Node* l=NMath_Log(NULL,e); if(!l){ Node_Free(e); FAIL_AT_LEVEL("Log failed",0);} nr_float32* de=(nr_float32*)NODE_DATA(e); nr_float32* dl=(nr_float32*)NODE_DATA(l); for(int i=0;i<N;i++){ if(!close_ulp(de[i],(nr_float32)exp((double)a[i]),FLT_EPSILON,FLT_MIN,3)||(de[i]>FLT_MIN&&!close_ulp(dl[i],log((double)de[i]),FLT_EPSILON,FLT_MIN,2))){ Node_Free(e); Node_Free(l); FAIL_AT_LEVEL("Exp/Log f32 mismatch",i);} } Node_Free(e); Node_Free(l); }); Node_Free(na); return 1; }
+int test_ewise_expm1_tanh_f64(){ enum{N=157}; nr_float64 a[N]; for(int i=0;i<N;i++) a[i]=(i-78)*0.37+1e-3*i; a[0]=1e-9; a[1]=-1e-12; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT64); FOR_EACH_SIMD_LEVEL({ Node* m=NMath_Expm1(NULL,na); Node* t=NMath_Tanh(NULL,na); if(!m||!t) FAIL_AT_LEVEL("Expm1/Tanh failed",0); nr_float64* dm=(nr_float64*)NODE_DATA(m); nr_float64* dt=(nr_float64*)NODE_DATA(t); for(int i=0;i<N;i++){ if(!close_ulp(dm[i],expm1(a[i]),DBL_EPSILON,DBL_MIN,3)||!close_ulp(dt[i],tanh(a[i]),DBL_EPSILON,DBL_MIN,4)){ Node_Free(m); Node_Free(t); FAIL_AT_LEVEL("Expm1/Tanh f64 mismatch",i);} } Node_Free(m); Node_Free(t); }); Node_Free(na); return 1; }
+int test_ewise_math_special_values(){ enum{N=10}; nr_float32 a[N]={0.0f,-0.0f,INFINITY,-INFINITY,NAN,-1.0f,1e-40f,100.0f,-200.0f,1.0f}; nr_float64 b[N]={0.0,-0.0,INFINITY,-INFINITY,NAN,-1.0,1e-310,1000.0,-2000.0,1.0}; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT32); Node* nb=Node_New(b,0,1,shape,NR_FLOAT64); int fast=NSimd_SetFastMath(0); FOR_EACH_SIMD_LEVEL({ Node* r[6]={NMath_Exp(NULL,na),NMath_Log(NULL,na),NMath_Tanh(NULL,na),NMath_Exp(NULL,nb),NMath_Log(NULL,nb),NMath_Tanh(NULL,nb)}; for(int k=0;k<6;k++) if(!r[k]){ NSimd_SetFastMath(fast); FAIL_AT_LEVEL("Special value op failed",k);} for(int i=0;i<N;i++){ double w[6]={expf(a[i]),logf(a[i]),tanhf(a[i]),exp(b[i]),log(b[i]),tanh(b[i])}; for(int k=0;k<6;k++){ double g=k<3?((nr_float32*)NODE_DATA(r[k]))[i]:((nr_float64*)NODE_DATA(r[k]))[i]; if(!close_ulp(g,w[k],k<3?FLT_EPSILON:DBL_EPSILON,k<3?FLT_MIN:DBL_MIN,4)||(w[k]==0&&signbit(g)!=signbit(w[k]))){ for(int j=0;j<6;j++) Node_Free(r[j]); NSimd_SetFastMath(fast); FAIL_AT_LEVEL("Special value mismatch",i*10+k);} } } for(int k=0;k<6;k++) Node_Free(r[k]); }); NSimd_SetFastMath(fast); Node_Free(na); Node_Free(nb); return 1; }
+int test_ewise_fast_math_mode(){ enum{N=67}; nr_float32 a[N]; for(int i=0;i<N;i++) a[i]=(i-33)*0.61f; nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT32); int prev=NSimd_SetFastMath(1); if(!NSimd_GetFastMath()){ printf("Fast math not enabled\n"); NSimd_SetFastMath(prev); Node_Free(na); return 0;} Node* e=NMath_Exp(NULL,na); Node* t=NMath_Tanh(NULL,na); NSimd_SetFastMath(prev); if(!e||!t||NODE_DTYPE(t)!=NR_FLOAT32){ printf("Fast math ops failed or promoted float32\n"); Node_Free(na); return 0;} nr_float32* de=(nr_float32*)NODE_DATA(e); nr_float32* dt=(nr_float32*)NODE_DATA(t); for(int i=0;i<N;i++){ if(!close_ulp(de[i],(nr_float32)exp((double)a[i]),FLT_EPSILON,FLT_MIN,16)||!close_ulp(dt[i],tanh((double)a[i]),FLT_EPSILON,FLT_MIN,16)){ printf("Fast math mismatch at %d\n",i); Node_Free(e); Node_Free(t); Node_Free(na); return 0;} } Node_Free(e); Node_Free(t); Node_Free(na); return 1; }
+int test_ewise_sin_cos_f32(){ enum{N=215}; nr_float32 a[N]; for(int i=0;i<N-8;i++) a[i]=(i-103)*0.7379f; nr_float32 sp[8]={0.0f,-0.0f,INFINITY,NAN,1e-30f,6543.9375f,1e4f,-3e5f}; memcpy(a+N-8,sp,sizeof(sp)); nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT32); int prev=NSimd_SetFastMath(0); for(int fast=0;fast<2;fast++){ NSimd_SetFastMath(fast); FOR_EACH_SIMD_LEVEL({ Node* s=NMath_Sin(NULL,na); Node* c=NMath_Cos(NULL,na); if(!s||!c){ NSimd_SetFastMath(prev); FAIL_AT_LEVEL("Sin/Cos f32 failed",fast);} nr_float32* ds=(nr_float32*)NODE_DATA(s); nr_float32* dc=(nr_float32*)NODE_DATA(c); for(int i=0;i<N;i++){ double ws=sin((double)a[i]), wc=cos((double)a[i]); if(!close_ulp(ds[i],ws,FLT_EPSILON,FLT_MIN,2)||!close_ulp(dc[i],wc,FLT_EPSILON,FLT_MIN,2)||(a[i]==0&&signbit(ds[i])!=signbit(a[i]))){ Node_Free(s); Node_Free(c); NSimd_SetFastMath(prev); FAIL_AT_LEVEL("Sin/Cos f32 mismatch",i);} } Node_Free(s); Node_Free(c); }); } NSimd_SetFastMath(prev); Node_Free(na); return 1; }
+int test_ewise_sin_cos_f64(){ enum{N=157}; nr_float64 a[N]; for(int i=0;i<N-8;i++) a[i]=(i-74)*1.2345+1e-3*i; nr_float64 sp[8]={0.0,-0.0,-INFINITY,NAN,1e-300,236540.1877260489,-5e5,1e7}; memcpy(a+N-8,sp,sizeof(sp)); nr_intp shape[1]={N}; Node* na=Node_New(a,0,1,shape,NR_FLOAT64); int prev=NSimd_SetFastMath(0); for(int fast=0;fast<2;fast++){ NSimd_SetFastMath(fast); FOR_EACH_SIMD_LEVEL({ Node* s=NMath_Sin(NULL,na); Node* c=NMath_Cos(NULL,na); if(!s||!c){ NSimd_SetFastMath(prev); FAIL_AT_LEVEL("Sin/Cos f64 failed",fast);} nr_float64* ds=(nr_float64*)NODE_DATA(s); nr_float64* dc=(nr_float64*)NODE_DATA(c); for(int i=0;i<N;i++){ if(!close_ulp(ds[i],sin(a[i]),DBL_EPSILON,DBL_MIN,3)||!close_ulp(dc[i],cos(a[i]),DBL_EPSILON,DBL_MIN,3)||(a[i]==0&&signbit(ds[i])!=signbit(a[i]))){ Node_Free(s); Node_Free(c); NSimd_SetFastMath(prev); FAIL_AT_LEVEL("Sin/Cos f64 mismatch",i);} } Node_Free(s); Node_Free(c); }); } NSimd_SetFastMath(prev); Node_Free(na); return 1; }
+int test_ewise_add_broadcast_rank(){ nr_float64 a[3]={0.0,10.0,20.0}; nr_float64 b[4]={1.0,2.0,3.0,4.0}; Node* na=Node_New(a,0,2,(nr_intp[]){3,1},NR_FLOAT64); Node* nb=Node_New(b,0,1,(nr_intp[]){4},NR_FLOAT64); Node* r=NMath_Add(NULL,na,nb); if(!r||r->ndim!=2||r->shape[0]!=3||r->shape[1]!=4){ printf("Broadcast add has wrong shape\n"); return 0;} nr_float64* d=(nr_float64*)NODE_DATA(r); for(int i=0;i<12;i++){ if(d[i]!=a[i/4]+b[i%4]){ printf("Broadcast add mismatch at %d\n",i); Node_Free(r); return 0;} } Node_Free(r); Node_Free(na); Node_Free(nb); return 1; }
+int test_ewise_add_strided_out(){ enum{R=7,C=9}; nr_float32 a[R*C], b[R*C]; for(int i=0;i<R*C;i++){ a[i]=(nr_float32)i; b[i]=(nr_float32)(2*i+1); } Node* na=Node_New(a,0,2,(nr_intp[]){R,C},NR_FLOAT32); Node* nb=Node_New(b,0,2,(nr_intp[]){R,C},NR_FLOAT32); Node* base=Node_NewEmpty(2,(nr_intp[]){C,R},NR_FLOAT32); Node* out=Node_Transpose(base,0); nr_float32* d=(nr_float32*)NODE_DATA(base); FOR_EACH_SIMD_LEVEL({ memset(d,0,sizeof(nr_float32)*R*C); if(NMath_Add(out,na,nb)!=out) FAIL_AT_LEVEL("Add did not use strided out",0); for(int i=0;i<R;i++) for(int j=0;j<C;j++){ if(d[j*R+i]!=a[i*C+j]+b[i*C+j]) FAIL_AT_LEVEL("Strided out mismatch",i*C+j); } }); Node_Free(out); Node_Free(base); Node_Free(na); Node_Free(nb); return 1; }
+int test_ewise_transposed_inputs(){ enum{R=5,C=6}; nr_int32 a[R*C], b[R*C]; for(int i=0;i<R*C;i++){ a[i]=i*3; b[i]=100-i; } Node* na=Node_New(a,0,2,(nr_intp[]){R,C},NR_INT32); Node* nb=Node_New(b,0,2,(nr_intp[]){R,C},NR_INT32); Node* ta=Node_Transpose(na,0); Node* tb=Node_Transpose(nb,0); FOR_EACH_SIMD_LEVEL({ Node* r1=NMath_Sub(NULL,ta,tb); Node* r3=NMath_Neg(NULL,ta); if(!r1||!r3) FAIL_AT_LEVEL("Transposed op failed",0); nr_int32* d1=(nr_int32*)NODE_DATA(r1); nr_int32* d3=(nr_int32*)NODE_DATA(r3); for(int j=0;j<C;j++) for(int i=0;i<R;i++){ int k=j*R+i; if(d1[k]!=a[i*C+j]-b[i*C+j]||d3[k]!=-a[i*C+j]){ Node_Free(r1); Node_Free(r3); FAIL_AT_LEVEL("Transposed op mismatch",k);} } Node_Free(r1); Node_Free(r3); }); Node_Free(ta); Node_Free(tb); Node_Free(na); Node_Free(nb); return 1; }
+int test_ewise_broadcast_row_col(){ enum{R=5,C=33}; nr_float32 m[R*C], row[C], col[R]; for(int i=0;i<R*C;i++) m[i]=(nr_float32)i*0.5f; for(int j=0;j<C;j++) row[j]=(nr_float32)(j-16); for(int i=0;i<R;i++) col[i]=(nr_float32)(i+1)*100.0f; Node* nm=Node_New(m,0,2,(nr_intp[]){R,C},NR_FLOAT32); Node* nr=Node_New(row,0,1,(nr_intp[]){C},NR_FLOAT32); Node* nc=Node_New(col,0,2,(nr_intp[]){R,1},NR_FLOAT32); FOR_EACH_SIMD_LEVEL({ Node* r1=NMath_Add(NULL,nm,nr); Node* r2=NMath_Sub(NULL,nc,nm); Node* r3=NMath_Sub(NULL,nm,nc); if(!r1||!r2||!r3) FAIL_AT_LEVEL("Broadcast op failed",0); nr_float32* d1=(nr_float32*)NODE_DATA(r1); nr_float32* d2=(nr_float32*)NODE_DATA(r2); nr_float32* d3=(nr_float32*)NODE_DATA(r3); for(int i=0;i<R;i++) for(int j=0;j<C;j++){ int k=i*C+j; if(d1[k]!=m[k]+row[j]||d2[k]!=col[i]-m[k]||d3[k]!=m[k]-col[i]){ Node_Free(r1); Node_Free(r2); Node_Free(r3); FAIL_AT_LEVEL("Broadcast row/col mismatch",k);} } Node_Free(r1); Node_Free(r2); Node_Free(r3); }); Node_Free(nm); Node_Free(nr); Node_Free(nc); return 1; }
+int test_ewise_mixed_dtype_cast(){ enum{N=1100,R=9,C=70}; static nr_int32 a[N]; static nr_float64 b[N]; for(int i=0;i<N;i++){ a[i]=i*7-3000; b[i]=0.25*i-11.0; } Node* na=Node_New(a,0,1,(nr_intp[]){N},NR_INT32); Node* nb=Node_New(b,0,1,(nr_intp[]){N},NR_FLOAT64); Node* ma=Node_New(a,0,2,(nr_intp[]){R,C},NR_INT32); Node* ta=Node_Transpose(ma,0); Node* col=Node_New(b,0,2,(nr_intp[]){C,1},NR_FLOAT64); nr_int8 s8=-5; nr_float32 s32=2.5f; Node* ns8=Node_New(&s8,0,0,NULL,NR_INT8); Node* ns32=Node_New(&s32,0,0,NULL,NR_FLOAT32); Node* base=Node_NewEmpty(2,(nr_intp[]){R,C},NR_FLOAT64); Node* out=Node_Transpose(base,0); nr_float64* bd=(nr_float64*)NODE_DATA(base); FOR_EACH_SIMD_LEVEL({ Node* r1=NMath_Add(NULL,na,nb); Node* r2=NMath_Mul(NULL,ta,col); Node* r3=NMath_Sub(NULL,ns8,nb); Node* r4=NMath_Ls(NULL,na,nb); Node* r5=NMath_Add(NULL,ns8,ns32); Node* r6=NMath_Sub(out,ta,col); if(!r1||!r2||!r3||!r4||!r5||r6!=out) FAIL_AT_LEVEL("Mixed dtype op failed",0); if(NODE_DTYPE(r1)!=NR_FLOAT64||NODE_DTYPE(r2)!=NR_FLOAT64||NODE_DTYPE(r3)!=NR_FLOAT64||NODE_DTYPE(r4)!=NR_BOOL||NODE_DTYPE(r5)!=NR_FLOAT32) FAIL_AT_LEVEL("Mixed dtype result has wrong dtype",0); nr_float64* d1=(nr_float64*)NODE_DATA(r1); nr_float64* d2=(nr_float64*)NODE_DATA(r2); nr_float64* d3=(nr_float64*)NODE_DATA(r3); nr_bool* d4=(nr_bool*)NODE_DATA(r4); for(int i=0;i<N;i++){ if(d1[i]!=(nr_float64)a[i]+b[i]||d3[i]!=s8-b[i]||d4[i]!=((nr_float64)a[i]<b[i])) FAIL_AT_LEVEL("Mixed dtype mismatch",i); } for(int j=0;j<C;j++) for(int i=0;i<R;i++){ if(d2[j*R+i]!=a[i*C+j]*b[j]||bd[i*C+j]!=a[i*C+j]-b[j]) FAIL_AT_LEVEL("Mixed dtype broadcast mismatch",j*R+i); } if(*(nr_float32*)NODE_DATA(r5)!=s8+s32) FAIL_AT_LEVEL("Mixed dtype scalars mismatch",0); Node_Free(r1); Node_Free(r2); Node_Free(r3); Node_Free(r4); Node_Free(r5); }); Node_Free(out); Node_Free(base); Node_Free(ns8); Node_Free(ns32); Node_Free(col); Node_Free(ta); Node_Free(ma); Node_Free(na); Node_Free(nb); return 1; }
+int test_ewise_totype_strided_dst(){ enum{R=4,C=7}; nr_int32 a[R*C]; for(int i=0;i<R*C;i++) a[i]=i*5-40; Node* na=Node_New(a,0,2,(nr_intp[]){R,C},NR_INT32); Node* ta=Node_Transpose(na,0); Node* base=Node_NewEmpty(2,(nr_intp[]){C,R},NR_FLOAT32); Node* dst=Node_Transpose(base,0); nr_float32* d=(nr_float32*)NODE_DATA(base); if(Node_ToType(dst,na,NR_FLOAT32)!=dst){ printf("ToType into strided dst failed\n"); return 0; } for(int i=0;i<R;i++) for(int j=0;j<C;j++){ if(d[j*R+i]!=(nr_float32)a[i*C+j]){ printf("ToType contiguous src mismatch at %d\n",i*C+j); return 0; } } Node* base2=Node_NewEmpty(2,(nr_intp[]){R,C},NR_FLOAT64); Node* dst2=Node_Transpose(base2,0); nr_float64* d2=(nr_float64*)NODE_DATA(base2); if(Node_ToType(dst2,ta,NR_FLOAT64)!=dst2){ printf("ToType strided to strided failed\n"); return 0; } for(int i=0;i<R*C;i++){ if(d2[i]!=(nr_float64)a[i]){ printf("ToType strided src mismatch at %d\n",i); return 0; } } Node_Free(dst2); Node_Free(base2); Node_Free(dst); Node_Free(base); Node_Free(ta); Node_Free(na); return 1; }
+
+int test_ewise_dispatch_signatures(){ nr_int32 v[3]={1,2,3}; Node* src=Node_New(v,0,1,(nr_intp[]){3},NR_INT32); Node* typed[NR_NUM_NUMIRC_DT]; for(int t=NR_INT8;t<NR_NUM_NUMIRC_DT;t++) typed[t]=Node_ToType(NULL,src,(NR_DTYPE)t); for(int rep=0;rep<2;rep++) for(int i=NR_INT8;i<NR_NUM_NUMIRC_DT;i++) for(int j=NR_INT8;j<NR_NUM_NUMIRC_DT;j++){ Node* r=NMath_Add(NULL,typed[i],typed[j]); if(!r||NODE_DTYPE(r)!=NTools_BroadcastDtypes((NR_DTYPE)i,(NR_DTYPE)j)){ printf("Add signature %d,%d gave a wrong dtype\n",i,j); return 0; } Node* f=Node_ToType(NULL,r,NR_FLOAT64); nr_float64* d=(nr_float64*)NODE_DATA(f); for(int k=0;k<3;k++){ if(d[k]!=2.0*v[k]){ printf("Add signature %d,%d mismatch at %d\n",i,j,k); return 0; } } Node_Free(f); Node_Free(r); } for(int t=NR_INT8;t<NR_NUM_NUMIRC_DT;t++){ Node* r=NMath_Neg(NULL,typed[t]); if(!r||NODE_DTYPE(r)!=t){ printf("Neg signature %d gave a wrong dtype\n",t); return 0; } Node_Free(r); Node_Free(typed[t]); } Node_Free(src); return 1; }
+int test_ewise_tracked_out_keeps_args(){ nr_float64 a[4]={1,2,3,4}, b[4]={4,3,2,1}; Node* na=Node_New(a,0,1,(nr_intp[]){4},NR_FLOAT64); Node* nb=Node_New(b,0,1,(nr_intp[]){4},NR_FLOAT64); Node* c=Node_NewEmpty(1,(nr_intp[]){4},NR_FLOAT64); c->flags|=NR_NODE_TRACK; if(NMath_Mul(c,na,nb)!=c||!c->nfunc_info){ printf("Tracked out node has no function info\n"); return 0; } NFuncFuncInfo* info=(NFuncFuncInfo*)c->nfunc_info; int ok=strcmp(info->nfunc->name,"mul")==0&&info->args->nin==2&&info->args->in_nodes[0]==na&&info->args->in_nodes[1]==nb&&info->args->out_nodes[0]==c&&((nr_float64*)NODE_DATA(c))[1]==6.0; _NFuncFuncInfo_Free(info); c->nfunc_info=NULL; Node_Free(c); Node_Free(na); Node_Free(nb); if(!ok){ printf("Tracked out node has wrong function info\n"); return 0; } return 1; }
+
+int test_ewise_lazy_fused_expr(){ enum{R=40,C=150,N=R*C}; static nr_float64 a[N], b[N], d[N]; static nr_float32 c[C]; static nr_int32 e[N]; for(int i=0;i<N;i++){ a[i]=(i%97)*0.01; b[i]=((i%13)-6)*0.1; d[i]=i*1e-3; e[i]=i%7-3; } for(int j=0;j<C;j++) c[j]=(nr_float32)(j*0.002f); nr_intp sh[2]={R,C}; Node* na=Node_New(a,0,2,sh,NR_FLOAT64); Node* nb=Node_New(b,0,2,sh,NR_FLOAT64); Node* nc=Node_New(c,0,1,(nr_intp[]){C},NR_FLOAT32); Node* nd=Node_New(d,0,2,(nr_intp[]){C,R},NR_FLOAT64); Node* td=Node_Transpose(nd,0); Node* ne=Node_New(e,0,2,sh,NR_INT32); Node* want=NULL; Node* got=NULL; for(int lazy=0;lazy<2;lazy++){ int prev=NLazy_SetEnabled(lazy); Node* ab=NMath_Mul(NULL,na,nb); Node* abc=NMath_Add(NULL,ab,nc); Node* ex=NMath_Exp(NULL,abc); Node* sub=NMath_Sub(NULL,ex,td); Node* r=NMath_Mul(NULL,sub,ne); NLazy_SetEnabled(prev); if(!r){ printf("Expression failed (lazy %d)\n",lazy); return 0; } if(lazy){ if(!NODE_IS_LAZY(r)||NODE_DATA(r)||!NODE_IS_LAZY(ab)||r->shape[0]!=R||r->shape[1]!=C||NODE_DTYPE(r)!=NR_FLOAT64){ printf("Lazy mode did not defer the expression\n"); return 0; } } Node_Free(ab); Node_Free(abc); Node_Free(ex); Node_Free(sub); if(lazy){ if(Node_Evaluate(r)!=0||NODE_IS_LAZY(r)||!NODE_DATA(r)||r->nfunc_info){ printf("Node_Evaluate failed\n"); return 0; } got=r; } else want=r; } nr_float64* w=(nr_float64*)NODE_DATA(want); nr_float64* g=(nr_float64*)NODE_DATA(got); for(int i=0;i<N;i++){ if(w[i]!=g[i]){ printf("Lazy result mismatch at %d: %g vs %g\n",i,g[i],w[i]); return 0; } } Node_Free(want); Node_Free(got); Node_Free(ne); Node_Free(td); Node_Free(nd); Node_Free(nc); Node_Free(nb); Node_Free(na); return 1; }
+int test_ewise_lazy_forcing_and_sharing(){ enum{N=1000,CHAIN=100}; static nr_float64 a[N]; for(int i=0;i<N;i++) a[i]=i*0.5; Node* na=Node_New(a,0,1,(nr_intp[]){N},NR_FLOAT64); int prev=NLazy_SetEnabled(1); Node* x=NMath_Mul(NULL,na,na); Node* y=NMath_Add(NULL,x,x); Node* s=NMath_Sum(NULL,y,NULL,0); Node* z=NMath_Sqrt(NULL,y); Node* acc=NMath_Add(NULL,na,na); for(int k=1;k<CHAIN;k++){ Node* t=NMath_Add(NULL,acc,na); Node_Free(acc); acc=t; } Node* cmp=NMath_Ls(NULL,z,na); NLazy_SetEnabled(prev); if(!s||NODE_IS_LAZY(s)||NODE_IS_LAZY(y)||!NODE_IS_LAZY(x)||!NODE_IS_LAZY(z)||!NODE_IS_LAZY(acc)||!NODE_IS_LAZY(cmp)){ printf("Lazy forcing state is wrong\n"); return 0; } nr_float64 want=0; for(int i=0;i<N;i++) want+=2*a[i]*a[i]; if(fabs(*(nr_float64*)NODE_DATA(s)-want)>1e-9*want){ printf("Sum of lazy input mismatch\n"); return 0; } if(Node_Evaluate(acc)!=0||Node_Evaluate(cmp)!=0||Node_Evaluate(z)!=0){ printf("Evaluate failed\n"); return 0; } nr_float64* ad=(nr_float64*)NODE_DATA(acc); nr_float64* zd=(nr_float64*)NODE_DATA(z); nr_bool* cd=(nr_bool*)NODE_DATA(cmp); for(int i=0;i<N;i++){ if(ad[i]!=(CHAIN+1)*a[i]||zd[i]!=sqrt(2*a[i]*a[i])||cd[i]!=(sqrt(2*a[i]*a[i])<a[i])){ printf("Lazy chain mismatch at %d\n",i); return 0; } } Node_Free(cmp); Node_Free(acc); Node_Free(z); Node_Free(s); Node_Free(y); Node_Free(x); Node_Free(na); return 1; }
+int test_ewise_lazy_views(){ nr_float64 a[6]={1,2,3,4,5,6}, b[6]={0.5,-1,2,0,3,-2}; nr_intp shape[2]={2,3}; Node* na=Node_New(a,0,2,shape,NR_FLOAT64); Node* nb=Node_New(b,0,2,shape,NR_FLOAT64); int prev=NLazy_SetEnabled(1); Node* c=NMath_Add(NULL,na,nb); Node* t=Node_Transpose(c,0); Node* s=t?NMath_Mul(NULL,t,t):NULL; Node* d=NMath_Sub(NULL,na,nb); Node* r=Node_Reshape(d,(nr_intp[]){3,2},2,1); Node* e=NMath_Mul(NULL,na,nb); Node* cp=Node_Copy(NULL,e); Node* f=NMath_Add(NULL,na,na); NLazy_SetEnabled(prev); if(!c||!t||!s||!r||r==d||!cp||NODE_IS_LAZY(c)||NODE_IS_LAZY(d)||NODE_IS_LAZY(e)||!NODE_IS_LAZY(f)||Node_Evaluate(s)!=0){ printf("Views of lazy nodes failed\n"); return 0; } char buf[256]; Node_ToString(f,buf); if(NODE_IS_LAZY(f)||strstr(buf,"12")==NULL){ printf("ToString of lazy node failed: %s\n",buf); return 0; } nr_float64* sd=(nr_float64*)NODE_DATA(s); nr_float64* rd=(nr_float64*)NODE_DATA(r); nr_float64* cd=(nr_float64*)NODE_DATA(cp); for(int i=0;i<3;i++) for(int j=0;j<2;j++){ nr_float64 v=a[j*3+i]+b[j*3+i]; if(sd[i*2+j]!=v*v){ printf("Transposed lazy mismatch at %d,%d\n",i,j); return 0; } } for(int i=0;i<6;i++){ if(rd[i]!=a[i]-b[i]||cd[i]!=a[i]*b[i]){ printf("Reshape/Copy of lazy mismatch at %d\n",i); return 0; } } Node_Free(s); Node_Free(t); Node_Free(c); Node_Free(r); Node_Free(d); Node_Free(cp); Node_Free(e); Node_Free(f); Node_Free(na); Node_Free(nb); return 1; }
+/* Longer than the stack allows if deep lazy DAGs were evaluated by recursion */
+#define LAZY_DEEP_N 200000
+int test_ewise_lazy_deep_chain(){ nr_float64 a[3]={1,-2,0.5}; Node* na=Node_New(a,0,1,(nr_intp[]){3},NR_FLOAT64); int prev=NLazy_SetEnabled(1); Node* y=na; NODE_INCREF(y); for(int i=0;i<LAZY_DEEP_N;i++){ Node* next=NMath_Add(NULL,y,na); Node_Free(y); if(!next){ NLazy_SetEnabled(prev); return 0; } y=next; } NLazy_SetEnabled(prev); if(!NODE_IS_LAZY(y)||Node_Evaluate(y)!=0){ printf("Deep lazy chain failed\n"); return 0; } nr_float64* d=(nr_float64*)NODE_DATA(y); int ok=1; for(int i=0;i<3;i++) ok=ok&&d[i]==(LAZY_DEEP_N+1)*a[i]; if(!ok) printf("Deep lazy chain mismatch %g\n",d[0]); Node_Free(y); Node_Free(na); return ok; }
+
+void test_elementwise(){ TestFunc tests[]={
+    test_ewise_add_f32_tail, test_ewise_mul_f64_out, test_ewise_sub_scalar_first, test_ewise_sub_scalar_first_int32,
+    test_ewise_int8_add_wraps, test_ewise_bitxor_uint16_scalar, test_ewise_compare_f32_nan, test_ewise_compare_f64_scalar,
+    test_ewise_simd_level_clamped, test_ewise_exp_log_f32, test_ewise_expm1_tanh_f64, test_ewise_math_special_values,
+    test_ewise_fast_math_mode, test_ewise_sin_cos_f32, test_ewise_sin_cos_f64, test_ewise_add_broadcast_rank, test_ewise_add_strided_out, test_ewise_transposed_inputs,
+    test_ewise_broadcast_row_col, test_ewise_mixed_dtype_cast, test_ewise_totype_strided_dst,
+    test_ewise_dispatch_signatures, test_ewise_tracked_out_keeps_args, test_ewise_lazy_fused_expr,
+    test_ewise_lazy_forcing_and_sharing, test_ewise_lazy_views,
+    test_ewise_lazy_deep_chain
+}; int num_tests=sizeof(tests)/sizeof(tests[0]); run_all_tests(tests, "Elementwise Tests", num_tests); }
@@ -0,0 +1,38 @@
+#include "main.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define GRAD_DEEP_N 200000
+#define GRAD_CKPT_LAYERS 24
+
+static Node* tracked_f64(nr_float64* data, int ndim, nr_intp* shape){ Node* n=Node_New(data,0,ndim,shape,NR_FLOAT64); n->flags|=NR_NODE_TRACK; return n; }
+static int close_to(const char* what, const nr_float64* got, const nr_float64* want, int n, double tol){ for(int i=0;i<n;i++) if((isnan(got[i])&&!isnan(want[i]))||fabs(got[i]-want[i])>tol*(1+fabs(want[i]))){ printf("%s[%d]: got %.12g, want %.12g\n",what,i,got[i],want[i]); return 0; } return 1; }
+static Node* sum_and_free(Node* y){ Node* s=NMath_Sum(NULL,y,NULL,0); Node_Free(y); return s; }
+
+int test_grad_elementwise_chain(){ nr_float64 a[4]={0.5,-1.0,1.5,2.0}, b[4]={1.5,0.25,-0.5,1.0}; Node* na=tracked_f64(a,1,(nr_intp[]){4}); Node* nb=tracked_f64(b,1,(nr_intp[]){4}); Node* ab=NMath_Mul(NULL,na,nb); Node* e=NMath_Exp(NULL,ab); Node* s=NMath_Sin(NULL,na); Node* q=NMath_Div(NULL,na,nb); Node* t=NMath_Add(NULL,e,s); Node* y=NMath_Sub(NULL,t,q); Node_Free(ab); Node_Free(e); Node_Free(s); Node_Free(q); Node_Free(t); Node* l=sum_and_free(y); if(!l||!NODE_IS_TRACK(l)||!l->nfunc_info){ printf("Loss not recorded\n"); return 0; } if(Node_Backward(l,NULL,0)<0||!na->grad||!nb->grad) return 0; nr_float64 ga[4], gb[4]; for(int i=0;i<4;i++){ double x=exp(a[i]*b[i]); ga[i]=b[i]*x+cos(a[i])-1/b[i]; gb[i]=a[i]*x+a[i]/(b[i]*b[i]); } int ok=close_to("grad a",(nr_float64*)NODE_DATA(na->grad),ga,4,1e-12)&&close_to("grad b",(nr_float64*)NODE_DATA(nb->grad),gb,4,1e-12); if(l->nfunc_info||NODE_IS_TRACK(l)){ printf("Consumed graph still recorded on the loss\n"); ok=0; } Node_Free(l); Node_Free(na); Node_Free(nb); return ok; }
+
+int test_grad_broadcast_float32(){ nr_float32 a[6]={1,2,3,4,5,6}, b[3]={0.5f,-1,2}; Node* na=Node_New(a,0,2,(nr_intp[]){2,3},NR_FLOAT32); Node* nb=Node_New(b,0,1,(nr_intp[]){3},NR_FLOAT32); na->flags|=NR_NODE_TRACK; nb->flags|=NR_NODE_TRACK; Node* y=NMath_Mul(NULL,na,nb); Node* l=sum_and_free(NMath_Tanh(NULL,y)); Node_Free(y); if(!l||Node_Backward(l,NULL,0)<0) return 0; if(NODE_DTYPE(na->grad)!=NR_FLOAT32||NODE_DTYPE(nb->grad)!=NR_FLOAT32||NODE_NDIM(nb->grad)!=1||NODE_SHAPE(nb->grad)[0]!=3){ printf("Gradient lost the input's dtype or shape\n"); return 0; } nr_float32* ga=(nr_float32*)NODE_DATA(na->grad); nr_float32* gb=(nr_float32*)NODE_DATA(nb->grad); int ok=1; for(int j=0;j<3&&ok;j++){ double col=0; for(int i=0;i<2;i++){ double t=tanh((double)a[i*3+j]*b[j]), d=1-t*t; col+=d*a[i*3+j]; if(fabs(ga[i*3+j]-d*b[j])>1e-5){ printf("grad a[%d] = %g\n",i*3+j,ga[i*3+j]); ok=0; } } if(fabs(gb[j]-col)>1e-5){ printf("grad b[%d] = %g, want %g\n",j,gb[j],col); ok=0; } } Node_Free(l); Node_Free(na); Node_Free(nb); return ok; }
+
+int test_grad_reductions(){ nr_float64 x[6]={1,4,2,3,0,5}; Node* nx=tracked_f64(x,2,(nr_intp[]){2,3}); Node* mx=NMath_Max(NULL,nx,(int[]){1},1); Node* mn=NMath_Mean(NULL,nx,(int[]){0},1); Node* v=NMath_Var(NULL,nx,NULL,0); Node* p=NMath_Prod(NULL,nx,(int[]){0},1); Node* s1=NMath_Sum(NULL,mx,NULL,0); Node* s2=NMath_Sum(NULL,mn,NULL,0); Node* s3=NMath_Sum(NULL,p,NULL,0); Node* t=NMath_Add(NULL,s1,s2); Node* u=NMath_Add(NULL,t,v); Node* l=NMath_Add(NULL,u,s3); Node_Free(mx); Node_Free(mn); Node_Free(v); Node_Free(p); Node_Free(s1); Node_Free(s2); Node_Free(s3); Node_Free(t); Node_Free(u); if(!l||Node_Backward(l,NULL,0)<0) return 0; nr_float64 want[6]; for(int i=0;i<6;i++) want[i]=0.5+2*(x[i]-2.5)/6+x[(i+3)%6]; want[1]+=1; want[5]+=1; int ok=close_to("reduction grad",(nr_float64*)NODE_DATA(nx->grad),want,6,1e-12); Node_Free(l); Node_Free(nx); return ok; }
+int test_grad_ties_and_zeros(){ nr_float64 x[3]={2,2,1}, z[6]={0,3,0,2,0,4}; Node* nx=tracked_f64(x,1,(nr_intp[]){3}); Node* nz=tracked_f64(z,2,(nr_intp[]){2,3}); Node* mx=NMath_Max(NULL,nx,NULL,0); Node* p=NMath_Prod(NULL,nz,(int[]){1},1); Node* l=p?sum_and_free(p):NULL; if(!mx||!l||Node_Backward(mx,NULL,0)<0||Node_Backward(l,NULL,0)<0) return 0; nr_float64 wx[3]={0.5,0.5,0}, wz[6]={0,0,0,0,8,0}; int ok=close_to("max ties grad",(nr_float64*)NODE_DATA(nx->grad),wx,3,1e-15)&&close_to("prod zeros grad",(nr_float64*)NODE_DATA(nz->grad),wz,6,1e-15); Node_Free(mx); Node_Free(l); Node_Free(nx); Node_Free(nz); return ok; }
+
+int test_grad_getitem(){ nr_float64 x[6]={1,2,3,4,5,6}; nr_int64 idx[4]={2,0,2,2}; Node* nx=tracked_f64(x,1,(nr_intp[]){6}); Node* ni=Node_New(idx,0,1,(nr_intp[]){4},NR_INT64); NIndexRuleSet rs=NIndexRuleSet_New(); NIndexRuleSet_AddSlice(&rs,1,6,2); Node* sl=Node_Get(nx,&rs); NIndexRuleSet fs=NIndexRuleSet_New(); NIndexRuleSet_AddNode(&fs,ni); Node* fa=Node_Get(nx,&fs); if(!sl||!fa||!NODE_IS_TRACK(sl)||!NODE_IS_TRACK(fa)){ printf("Indexing not recorded\n"); return 0; } Node* sq=NMath_Mul(NULL,sl,sl); Node* s1=NMath_Sum(NULL,sq,NULL,0); Node* s2=NMath_Sum(NULL,fa,NULL,0); Node* l=NMath_Add(NULL,s1,s2); Node_Free(sq); Node_Free(s1); Node_Free(s2); Node_Free(sl); Node_Free(sl); Node_Free(fa); Node_Free(fa); if(!l||Node_Backward(l,NULL,0)<0) return 0; nr_float64 want[6]={1,4,3,8,0,12}; int ok=close_to("getitem grad",(nr_float64*)NODE_DATA(nx->grad),want,6,1e-12); Node_Free(l); Node_Free(ni); Node_Free(nx); return ok; }
+
+int test_grad_getitem_2d(){ nr_float64 x[12]; for(int i=0;i<12;i++) x[i]=i+1; nr_int64 idx[3]={2,0,2}; Node* nx=tracked_f64(x,2,(nr_intp[]){3,4}); Node* ni=Node_New(idx,0,1,(nr_intp[]){3},NR_INT64); NIndexRuleSet rs=NIndexRuleSet_New(); NIndexRuleSet_AddInt(&rs,1); NIndexRuleSet_AddSlice(&rs,3,0,-2); Node* sl=Node_Get(nx,&rs); NIndexRuleSet fs=NIndexRuleSet_New(); NIndexRuleSet_AddNode(&fs,ni); Node* fa=Node_Get(nx,&fs); if(!sl||!fa){ printf("Indexing failed\n"); return 0; } Node* sq=NMath_Mul(NULL,sl,sl); Node* s1=NMath_Sum(NULL,sq,NULL,0); Node* s2=NMath_Sum(NULL,fa,NULL,0); Node* l=NMath_Add(NULL,s1,s2); Node_Free(sq); Node_Free(s1); Node_Free(s2); Node_Free(sl); Node_Free(sl); Node_Free(fa); Node_Free(fa); if(!l||Node_Backward(l,NULL,0)<0) return 0; nr_float64 want[12]={1,1,1,1,0,12,0,16,2,2,2,2}; int ok=close_to("2-d getitem grad",(nr_float64*)NODE_DATA(nx->grad),want,12,1e-12); Node_Free(l); Node_Free(ni); Node_Free(nx); return ok; }
+int test_grad_accumulate_and_retain(){ nr_float64 x[3]={1,-2,3}, seed[3]={1,2,-1}; Node* nx=tracked_f64(x,1,(nr_intp[]){3}); Node* ns=Node_New(seed,0,1,(nr_intp[]){3},NR_FLOAT64); Node* sq=NMath_Mul(NULL,nx,nx); Node* y=NMath_Add(NULL,sq,nx); Node_Free(sq); if(!y||Node_Backward(y,ns,1)<0) return 0; nr_float64 want[3]; for(int i=0;i<3;i++) want[i]=(2*x[i]+1)*seed[i]; int ok=close_to("first pass",(nr_float64*)NODE_DATA(nx->grad),want,3,1e-12); if(!y->nfunc_info||!NODE_IS_TRACK(y)){ printf("Retained graph was dropped\n"); ok=0; } if(Node_Backward(y,ns,0)<0) return 0; for(int i=0;i<3;i++) want[i]*=2; ok=ok&&close_to("accumulated",(nr_float64*)NODE_DATA(nx->grad),want,3,1e-12); if(y->nfunc_info||NODE_IS_TRACK(y)){ printf("Graph kept without retain_graph\n"); ok=0; } if(Node_Backward(y,NULL,0)==0||!NError_IsError()){ printf("Backward through a consumed graph did not fail\n"); ok=0; } NError_Clear(); Node_Free(y); Node_Free(ns); Node_Free(nx); return ok; }
+
+int test_grad_deep_chain(){ nr_float64 x=0.5, c=1e-6; Node* nx=tracked_f64(&x,0,NULL); Node* nc=Node_New(&c,0,0,NULL,NR_FLOAT64); Node* y=nx; NODE_INCREF(y); for(int i=0;i<GRAD_DEEP_N;i++){ Node* next=(i%2)?NMath_Add(NULL,y,nc):NMath_Neg(NULL,y); Node_Free(y); if(!next) return 0; y=next; } if(Node_Backward(y,NULL,1)<0) return 0; nr_float64 g=*(nr_float64*)NODE_DATA(nx->grad); Node_Free(y); Node* z=NMath_Mul(NULL,nx,nx); if(!z||Node_Backward(z,NULL,0)<0) return 0; int ok=g==1.0&&*(nr_float64*)NODE_DATA(nx->grad)==2.0; if(!ok) printf("Deep chain gradient %g then %g\n",g,*(nr_float64*)NODE_DATA(nx->grad)); Node_Free(z); Node_Free(nc); Node_Free(nx); return ok; }
+
+int test_grad_recording_rules(){ nr_float64 a[2]={1,2}; nr_int32 k[2]={1,2}; Node* na=tracked_f64(a,1,(nr_intp[]){2}); Node* nk=Node_New(k,0,1,(nr_intp[]){2},NR_INT32); nk->flags|=NR_NODE_TRACK; int ok=1; Node* r=NMath_Add(NULL,nk,nk); if(!r||NODE_IS_TRACK(r)||r->nfunc_info){ printf("Integer inputs were recorded\n"); ok=0; } Node_Free(r); int prev=NGrad_SetEnabled(0); r=NMath_Mul(NULL,na,na); NGrad_SetEnabled(prev); if(!r||NODE_IS_TRACK(r)||r->nfunc_info){ printf("Recorded while disabled\n"); ok=0; } Node_Free(r); int lazy=NLazy_SetEnabled(1); r=NMath_Exp(NULL,na); NLazy_SetEnabled(lazy); if(!r||NODE_IS_LAZY(r)||!NODE_IS_TRACK(r)){ printf("Recorded call was deferred\n"); ok=0; } Node_Free(r); if(NMath_Add(na,na,na)||!NError_IsError()){ printf("In-place call on a tracked input was recorded\n"); ok=0; } NError_Clear(); if(a[0]!=1){ printf("Rejected in-place call wrote its output\n"); ok=0; } Node_Free(na); Node_Free(nk); return ok; }
+
+static Node* checkpoint_net(Node* x, Node* w){ Node* y=x; NODE_INCREF(y); for(int i=0;i<GRAD_CKPT_LAYERS;i++){ Node* t=NMath_Mul(NULL,y,w); Node_Free(y); y=NMath_Sin(NULL,t); Node_Free(t); if(i%8==3){ Node* m=NMath_Mean(NULL,y,(int[]){0},1); Node* z=NMath_Add(NULL,y,m); Node_Free(m); Node_Free(y); y=z; } } return sum_and_free(y); }
+int test_grad_checkpoint_chain(){ static nr_float64 x[16*32], w[16*32]; for(int i=0;i<16*32;i++){ x[i]=0.01*(i%37)-0.2; w[i]=1.0+0.001*(i%11); } Node* nx=tracked_f64(x,2,(nr_intp[]){16,32}); Node* nw=tracked_f64(w,2,(nr_intp[]){16,32}); Node* l=checkpoint_net(nx,nw); if(!l||Node_Backward(l,NULL,0)<0) return 0; Node_Free(l); Node* gx=nx->grad; Node* gw=nw->grad; nx->grad=NULL; nw->grad=NULL; nr_intp layer=16*32*sizeof(nr_float64); l=checkpoint_net(nx,nw); nr_intp all=Node_Checkpoint(l,(nr_intp)1<<40); nr_intp kept=Node_Checkpoint(l,8*layer); int ok=1; if(all<GRAD_CKPT_LAYERS*2*layer||kept<0||kept>8*layer){ printf("Checkpoint kept %lld of %lld bytes\n",(long long)kept,(long long)all); ok=0; } if(Node_Backward(l,NULL,0)<0) return 0; if(memcmp(NODE_DATA(gx),NODE_DATA(nx->grad),layer)||memcmp(NODE_DATA(gw),NODE_DATA(nw->grad),layer)){ printf("Replayed graph gave different gradients\n"); ok=0; } Node_Free(gx); Node_Free(gw); Node_Free(l); Node_Free(nx); Node_Free(nw); return ok; }
+
+int test_grad_checkpoint_rules(){ nr_float64 x[4]={-1,0.25,0.5,2}; Node* nx=tracked_f64(x,1,(nr_intp[]){4}); Node* a=NMath_Exp(NULL,nx); Node* b=NMath_Sin(NULL,a); Node* c=NMath_Mul(NULL,b,b); Node* l=NMath_Sum(NULL,c,NULL,0); Node_Free(b); Node_Free(c); nr_intp kept=Node_Checkpoint(l,0); int ok=1; if(kept!=4*(nr_intp)sizeof(nr_float64)||NODE_IS_RECOMPUTE(a)||!NODE_IS_RECOMPUTE(b)||b->data||!NODE_IS_RECOMPUTE(c)||NODE_IS_RECOMPUTE(l)){ printf("Checkpoint released the wrong nodes (kept %lld bytes)\n",(long long)kept); ok=0; } if(Node_Checkpoint(l,1024)!=12*(nr_intp)sizeof(nr_float64)||NODE_IS_RECOMPUTE(b)||((nr_float64*)NODE_DATA(b))[3]!=sin(exp(2.0))){ printf("Raising the budget did not restore the results\n"); ok=0; } if(Node_Checkpoint(l,0)<0||Node_Backward(l,NULL,1)<0) return 0; nr_float64 want[4]; for(int i=0;i<4;i++){ double e=exp(x[i]); want[i]=2*sin(e)*cos(e)*e; } ok=ok&&close_to("retained pass",(nr_float64*)NODE_DATA(nx->grad),want,4,1e-12); if(!NODE_IS_RECOMPUTE(b)||!NODE_IS_RECOMPUTE(c)){ printf("Retained graph left its budget\n"); ok=0; } if(Node_Backward(l,NULL,0)<0) return 0; for(int i=0;i<4;i++) want[i]*=2; ok=ok&&close_to("second pass",(nr_float64*)NODE_DATA(nx->grad),want,4,1e-12); Node_Free(l); Node_Free(a); Node_Free(nx); return ok; }
+
+void test_grad(){ TestFunc tests[]={
+    test_grad_elementwise_chain, test_grad_broadcast_float32, test_grad_reductions, test_grad_getitem,
+    test_grad_accumulate_and_retain, test_grad_deep_chain, test_grad_recording_rules, test_grad_ties_and_zeros,
+    test_grad_checkpoint_chain, test_grad_checkpoint_rules, test_grad_getitem_2d
+}; int num_tests=sizeof(tests)/sizeof(tests[0]); run_all_tests(tests, "Grad Tests", num_tests); }
@@ -0,0 +1,37 @@
+#include "main.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Writes `n` float64 ramp values after a `header`-byte prefix, returns the path */
+static char* write_ramp_file(nr_intp header, nr_intp n){ static char path[64]; strcpy(path, "/tmp/nr_io_test_XXXXXX"); int fd=mkstemp(path); if(fd<0) return NULL; FILE* f=fdopen(fd,"wb"); for(nr_intp i=0;i<header;i++) fputc('h',f); for(nr_intp i=0;i<n;i++){ nr_float64 v=(nr_float64)i; fwrite(&v,sizeof(v),1,f);} fclose(f); return path; }
+static nr_float64 read_file_item(const char* path, nr_intp header, nr_intp i){ nr_float64 v=-1; FILE* f=fopen(path,"rb"); fseek(f,(long)(header+i*8),SEEK_SET); if(fread(&v,8,1,f)!=1) v=-1; fclose(f); return v; }
+
+/* Compares two nodes item by item through C-ordered copies */
+static int same_items(Node* a, Node* b){ if(!a||!b||a->ndim!=b->ndim||NODE_DTYPE(a)!=NODE_DTYPE(b)) return 0; for(int i=0;i<a->ndim;i++) if(a->shape[i]!=b->shape[i]) return 0; Node* ca=Node_Copy(NULL,a); Node* cb=Node_Copy(NULL,b); int ok=ca&&cb&&memcmp(NODE_DATA(ca),NODE_DATA(cb),Node_NItems(a)*NODE_ITEMSIZE(a))==0; Node_Free(ca); Node_Free(cb); return ok; }
+static char* temp_path(void){ static char path[64]; strcpy(path, "/tmp/nr_npy_test_XXXXXX"); int fd=mkstemp(path); if(fd<0) return NULL; close(fd); return path; }
+
+int test_io_mmap_readonly_slice(){ char* path=write_ramp_file(24,5000); if(!path) return 0; Node* a=Node_MapFile(path,24,2,(nr_intp[]){50,100},NR_FLOAT64,NMAP_READONLY,NMAP_ADVICE_RANDOM); if(!a){ unlink(path); return 0;} NIndexRuleSet rs=NIndexRuleSet_New(); NIndexRuleSet_AddSlice(&rs,10,40,3); Node* rows=Node_Get(a,&rs); NIndexRuleSet_Cleanup(&rs); Node_Free(a); int ok=rows&&rows->ndim==2&&rows->shape[0]==10&&rows->base!=NULL&&NMap_Advise(rows,NMAP_ADVICE_WILLNEED)==0; for(int i=0;i<10&&ok;i++) ok=*(nr_float64*)((char*)NODE_DATA(rows)+i*rows->strides[0]+7*8)==(nr_float64)((10+3*i)*100+7); if(!ok) printf("Mapped slice has wrong values\n"); Node_Free(rows); unlink(path); return ok; }
+int test_io_mmap_whole_file_and_modes(){ char* path=write_ramp_file(3,1000); if(!path) return 0; Node* flat=Node_MapFile(path,3,0,NULL,NR_FLOAT64,NMAP_COPYONWRITE,NMAP_ADVICE_SEQUENTIAL); int ok=flat&&flat->ndim==1&&flat->shape[0]==1000&&((nr_float64*)NODE_DATA(flat))[999]==999.; if(ok){ ((nr_float64*)NODE_DATA(flat))[5]=-3.; ok=read_file_item(path,3,5)==5.; if(!ok) printf("Copy-on-write reached the file\n"); } Node_Free(flat); Node* rw=Node_MapFile(path,3,1,(nr_intp[]){10},NR_FLOAT64,NMAP_READWRITE,NMAP_ADVICE_NORMAL); if(!rw) ok=0; else { ((nr_float64*)NODE_DATA(rw))[5]=-3.; Node_Free(rw); if(read_file_item(path,3,5)!=-3.){ printf("Read-write mapping did not reach the file\n"); ok=0;} } unlink(path); return ok; }
+int test_io_mmap_errors(){ char* path=write_ramp_file(0,10); if(!path) return 0; Node* big=Node_MapFile(path,0,1,(nr_intp[]){11},NR_FLOAT64,NMAP_READONLY,NMAP_ADVICE_NORMAL); int ok=!big&&NERROR_TYPE==NError_ValueError; NError_Clear(); Node* missing=Node_MapFile("/nonexistent/nr_io_test",0,0,NULL,NR_FLOAT64,NMAP_READONLY,NMAP_ADVICE_NORMAL); ok=ok&&!missing&&NERROR_TYPE==NError_IOError; NError_Clear(); nr_float64 d[2]={0,1}; Node* plain=Node_New(d,0,1,(nr_intp[]){2},NR_FLOAT64); ok=ok&&NMap_Advise(plain,NMAP_ADVICE_RANDOM)==-1; NError_Clear(); Node_Free(plain); unlink(path); return ok; }
+
+int test_io_npy_roundtrip_dtypes(){ char* path=temp_path(); if(!path) return 0; int ok=1; for(int dt=0;dt<NR_NUM_NUMIRC_DT&&ok;dt++){ nr_intp shape[3]={3,4,5}; Node* a=Node_NewEmpty(3,shape,(NR_DTYPE)dt); for(nr_intp i=0;i<60*NODE_ITEMSIZE(a);i++) ((nr_uint8*)NODE_DATA(a))[i]=(nr_uint8)(i*7+dt); if(dt==NR_BOOL) for(int i=0;i<60;i++) ((nr_bool*)NODE_DATA(a))[i]=i%3==0; Node* b=NULL; ok=Node_SaveNpy(a,path)==0&&(b=Node_LoadNpy(path,NNPY_LOAD_READ))!=NULL&&same_items(a,b); if(!ok) printf("npy round trip failed for dtype %d\n",dt); Node_Free(a); Node_Free(b); } FILE* f=fopen(path,"rb"); unsigned char pre[10]={0}; ok=ok&&f&&fread(pre,1,10,f)==10&&memcmp(pre,"\x93NUMPY\x01\x00",8)==0&&(10+pre[8]+(pre[9]<<8))%64==0; if(f) fclose(f); if(!ok) printf("npy preamble is not version 1.0 padded to 64 bytes\n"); unlink(path); return ok; }
+int test_io_npy_layouts(){ char* path=temp_path(); if(!path) return 0; enum{R=6,C=7}; nr_float64 d[R*C]; for(int i=0;i<R*C;i++) d[i]=i*1.5; Node* a=Node_New(d,0,2,(nr_intp[]){R,C},NR_FLOAT64); Node* t=Node_Transpose(a,0); NIndexRuleSet rs=NIndexRuleSet_New(); NIndexRuleSet_AddSlice(&rs,1,6,2); Node* s=Node_Get(t,&rs); NIndexRuleSet_Cleanup(&rs); Node* views[2]={t,s}; int ok=s!=NULL; for(int k=0;k<2&&ok;k++){ Node* b=NULL; ok=Node_SaveNpy(views[k],path)==0&&(b=Node_LoadNpy(path,NNPY_LOAD_READ))!=NULL&&same_items(views[k],b); if(ok&&k==0) ok=!NODE_IS_CONTIGUOUS(b)&&b->strides[0]==8; if(!ok) printf("npy layout %d failed\n",k); Node_Free(b); } Node_Free(s); Node_Free(t); Node_Free(a); unlink(path); return ok; }
+int test_io_npy_mmap_and_byteswap(){ char* path=temp_path(); if(!path) return 0; enum{N=300}; nr_int32 d[N]; for(int i=0;i<N;i++) d[i]=i*1000-7; Node* a=Node_New(d,0,2,(nr_intp[]){20,15},NR_INT32); int ok=Node_SaveNpy(a,path)==0; Node* m=ok?Node_LoadNpy(path,NNPY_LOAD_MMAP_COPYONWRITE):NULL; ok=m&&m->base!=NULL&&same_items(a,m); if(!ok) printf("Mapped npy load failed\n"); Node_Free(m); Node_Free(a); char hdr[128]; int n=sprintf(hdr,"\x93NUMPY\x01%c%c%c{'descr': '>i4', 'fortran_order': False, 'shape': (3,), }",0,118,0); memset(hdr+n,' ',127-n); hdr[127]='\n'; unsigned char be[12]={0,0,0,1, 0xFF,0xFF,0xFF,0xFE, 0,1,0,0}; FILE* f=fopen(path,"wb"); fwrite(hdr,1,128,f); fwrite(be,1,12,f); fclose(f); Node* s=Node_LoadNpy(path,NNPY_LOAD_READ); nr_int32* v=s?(nr_int32*)NODE_DATA(s):NULL; if(!v||s->ndim!=1||v[0]!=1||v[1]!=-2||v[2]!=65536){ printf("Big-endian npy not swapped\n"); ok=0; } Node_Free(s); ok=ok&&!Node_LoadNpy(path,NNPY_LOAD_MMAP_READONLY)&&NERROR_TYPE==NError_ValueError; NError_Clear(); unlink(path); return ok; }
+int test_io_npz_roundtrip(){ char* path=temp_path(); if(!path) return 0; nr_float32 x[12]; nr_uint8 y[5]={1,2,3,4,5}; for(int i=0;i<12;i++) x[i]=i*0.25f; Node* a=Node_New(x,0,2,(nr_intp[]){3,4},NR_FLOAT32); Node* b=Node_New(y,0,1,(nr_intp[]){5},NR_UINT8); Node* t=Node_Transpose(a,0); const Node* nodes[3]={a,b,t}; const char* names[3]={"x","y","xt"}; int ok=Node_SaveNpz(path,nodes,names,3)==0; Node* la=Node_LoadNpz(path,"x",NNPY_LOAD_READ); Node* lb=Node_LoadNpz(path,"y.npy",NNPY_LOAD_MMAP_READONLY); Node* lt=Node_LoadNpz(path,"xt",NNPY_LOAD_READ); ok=ok&&same_items(a,la)&&same_items(b,lb)&&same_items(t,lt); if(!ok) printf("npz round trip failed\n"); Node_Free(la); Node_Free(lb); Node_Free(lt); Node* missing=Node_LoadNpz(path,"z",NNPY_LOAD_READ); ok=ok&&!missing&&NERROR_TYPE==NError_KeyError; NError_Clear(); Node* bad=Node_LoadNpy(path,NNPY_LOAD_READ); ok=ok&&!bad&&NERROR_TYPE==NError_ValueError; NError_Clear(); Node_Free(t); Node_Free(a); Node_Free(b); unlink(path); return ok; }
+/* Writes a version 1.0 .npy file with header `dict` and `ndata` zero bytes of data */
+static void write_raw_npy(const char* path, const char* dict, nr_intp ndata){ char hdr[128]; int n=snprintf(hdr,sizeof(hdr),"%-117s\n",dict); FILE* f=fopen(path,"wb"); fwrite("\x93NUMPY\x01\x00",1,8,f); fputc(n&0xff,f); fputc(n>>8,f); fwrite(hdr,1,n,f); for(nr_intp i=0;i<ndata;i++) fputc(0,f); fclose(f); }
+int test_io_npy_corrupt_shape(){ char* path=temp_path(); if(!path) return 0; write_raw_npy(path,"{'descr': '|u1', 'fortran_order': False, 'shape': (4611686018427387904, 4), }",16); NError_Clear(); Node* a=Node_LoadNpy(path,NNPY_LOAD_READ); int ok=!a&&NERROR_TYPE==NError_ValueError; NError_Clear(); write_raw_npy(path,"{'descr': '<f8', 'fortran_order': False, 'shape': (1152921504606846976,), }",16); Node* b=Node_LoadNpy(path,NNPY_LOAD_MMAP_READONLY); ok=ok&&!b&&NERROR_TYPE==NError_ValueError; NError_Clear(); write_raw_npy(path,"{'descr': '<f8', 'fortran_order': False, 'shape': (1000000000, 0, 3), }",0); Node* c=Node_LoadNpy(path,NNPY_LOAD_READ); ok=ok&&c&&Node_NItems(c)==0; Node_Free(c); NError_Clear(); write_raw_npy(path,"{'descr': '<f8', 'fortran_order': False, 'shape': (100000000,), }",16); Node* d=Node_LoadNpy(path,NNPY_LOAD_READ); ok=ok&&!d&&NERROR_TYPE==NError_ValueError; NError_Clear(); unlink(path); if(!ok) printf("Corrupt npy shapes were not rejected\n"); return ok; }
+
+/* 2-D float64 ramp with runs of equal values, so both stored forms show up */
+static Node* chunk_source(nr_intp r, nr_intp c){ Node* a=Node_NewEmpty(2,(nr_intp[]){r,c},NR_FLOAT64); nr_float64* d=(nr_float64*)NODE_DATA(a); for(nr_intp i=0;i<r*c;i++) d[i]=i<r*c/2?(nr_float64)(i/64):(nr_float64)i*1.37; return a; }
+int test_io_chunked_roundtrip(){ char* path=temp_path(); if(!path) return 0; Node* a=chunk_source(37,53); int ok=1; for(int codec=0;codec<2&&ok;codec++){ ok=Node_SaveChunked(a,path,(nr_intp[]){8,16},(NChunk_Codec)codec)==0; NChunkFile* cf=ok?NChunk_Open(path):NULL; ok=cf&&cf->nchunks==5*4&&cf->codec==(NChunk_Codec)codec&&(codec==0||cf->sizes[0]<8*16*8/4)&&cf->sizes[19]<=5*5*8; NIndexRuleSet rs=NIndexRuleSet_New(); NIndexRuleSet_AddFullSlice(&rs); Node* b=ok?NChunk_Get(cf,&rs):NULL; ok=ok&&same_items(a,b); Node* last=ok?NChunk_ReadChunk(cf,19):NULL; ok=ok&&last&&last->shape[0]==5&&last->shape[1]==5&&((nr_float64*)NODE_DATA(last))[0]==(nr_float64)(32*53+48)*1.37; if(!ok) printf("Chunked round trip failed for codec %d\n",codec); Node_Free(last); Node_Free(b); NChunk_Close(cf); } Node* t=Node_Transpose(a,0); ok=ok&&Node_SaveChunked(t,path,NULL,NCHUNK_CODEC_SHUFFLE_RLE)==0; NChunkFile* cf=ok?NChunk_Open(path):NULL; Node* tb=cf?NChunk_ReadChunk(cf,0):NULL; ok=ok&&cf->nchunks==1&&same_items(t,tb); Node_Free(tb); NChunk_Close(cf); Node_Free(t); Node_Free(a); unlink(path); return ok; }
+int test_io_chunked_get_reads_only_touched(){ char* path=temp_path(); if(!path) return 0; Node* a=chunk_source(40,30); NChunkFile* cf=NChunk_Create(path,2,a->shape,NR_FLOAT64,(nr_intp[]){10,10},NCHUNK_CODEC_SHUFFLE_RLE); int ok=cf!=NULL; for(nr_intp k=0;ok&&k<cf->nchunks;k++){ if(k==0) continue; nr_intp shape[2], origin[2]; NChunk_ChunkShape(cf,k,shape,origin); Node* v=Node_NewChild(a,2,shape,a->strides,origin[0]*a->strides[0]+origin[1]*a->strides[1]); ok=NChunk_WriteChunk(cf,k,v)==0; Node_Free(v); } ok=ok&&NChunk_Close(cf)==0; cf=ok?NChunk_Open(path):NULL; ok=cf!=NULL; if(cf) cf->sizes[11]=1; NIndexRuleSet rs=NIndexRuleSet_New(); NIndexRuleSet_AddSlice(&rs,-3,12,-4); NIndexRuleSet_AddInt(&rs,-18); Node* g=ok?NChunk_Get(cf,&rs):NULL; Node* want=Node_Get(a,&rs); NIndexRuleSet_Cleanup(&rs); ok=ok&&same_items(g,want); if(!ok) printf("Chunked get read the wrong items or an untouched chunk\n"); Node_Free(g); Node_Free(want); NIndexRuleSet zs=NIndexRuleSet_New(); NIndexRuleSet_AddSlice(&zs,2,4,1); Node* z=NChunk_Get(cf,&zs); nr_float64* zd=z?(nr_float64*)NODE_DATA(z):NULL; ok=ok&&zd&&z->shape[0]==2&&zd[0]==0&&zd[45]==((nr_float64*)NODE_DATA(a))[105]; if(!ok) printf("Unwritten chunk does not read as zeros\n"); Node_Free(z); Node* bad=NChunk_ReadChunk(cf,11); ok=ok&&!bad&&NERROR_TYPE==NError_ValueError; NError_Clear(); NChunk_Close(cf); Node_Free(a); unlink(path); return ok; }
+int test_io_chunked_sum(){ char* path=temp_path(); if(!path) return 0; enum{R=45,C=38,P=7}; nr_int32 d[R*C*P]; for(int i=0;i<R*C*P;i++) d[i]=(i*7919)%1000-500; Node* a=Node_New(d,0,3,(nr_intp[]){R,C,P},NR_INT32); int ok=Node_SaveChunked(a,path,(nr_intp[]){8,16,3},NCHUNK_CODEC_SHUFFLE_RLE)==0; NChunkFile* cf=ok?NChunk_Open(path):NULL; int axes[3][2]={{0,0},{1,-1},{2,0}}; int nas[3]={0,2,1}; for(int k=0;k<3&&ok;k++){ Node* got=NChunk_Sum(cf,axes[k],nas[k]); Node* want=NMath_Sum(NULL,a,axes[k],nas[k]); ok=same_items(got,want); if(!ok) printf("Chunked sum %d differs\n",k); Node_Free(got); Node_Free(want); } ok=ok&&!NChunk_Sum(cf,(int[]){3},1)&&NERROR_TYPE==NError_ValueError; NError_Clear(); NChunk_Close(cf); Node_Free(a); unlink(path); return ok; }
+
+void test_io(){ TestFunc tests[]={
+    test_io_mmap_readonly_slice, test_io_mmap_whole_file_and_modes, test_io_mmap_errors,
+    test_io_npy_roundtrip_dtypes, test_io_npy_layouts, test_io_npy_mmap_and_byteswap, test_io_npz_roundtrip, test_io_npy_corrupt_shape,
+    test_io_chunked_roundtrip, test_io_chunked_get_reads_only_touched, test_io_chunked_sum
+}; int num_tests=sizeof(tests)/sizeof(tests[0]); run_all_tests(tests, "IO Tests", num_tests); }
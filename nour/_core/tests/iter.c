@@ -0,0 +1,34 @@
+#include "main.h"
+#include <stdio.h>
+
+/* Walks `it` and checks it visits the int32 items of `base` at `expected` offsets. */
+#define VERIFY_ITER_VISITS(it, base, n, ...) do { \
+    nr_int32 expected[] = {__VA_ARGS__}; \
+    int _k = 0; \
+    NIter_ITER(&(it)); \
+    while (NIter_NOTDONE(&(it))) { \
+        if (_k >= (n) || *(nr_int32*)NIter_ITEM(&(it)) != (base)[expected[_k]]) { printf("Iter visit mismatch at %d\n", _k); return 0; } \
+        _k++; \
+        NIter_NEXT(&(it)); \
+    } \
+    if (_k != (n)) { printf("Iter visited %d items, expected %d\n", _k, (int)(n)); return 0; } \
+} while(0)
+
+int test_iter_contiguous_collapses(){ nr_int32 d[24]; for(int i=0;i<24;i++) d[i]=i; nr_intp shape[3]={2,3,4}; nr_intp strides[3]={48,16,4}; NIter it; NIter_New(&it,d,3,shape,strides,NITER_MODE_STRIDED); if(it.nd_m1!=0||it.strides[0]!=4){ printf("Contiguous iter not collapsed: nd_m1=%d\n",it.nd_m1); return 0;} VERIFY_ITER_VISITS(it,d,24,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23); return 1; }
+int test_iter_sliced_inner_merge(){ nr_int32 d[48]; for(int i=0;i<48;i++) d[i]=i; nr_intp shape[3]={2,3,2}; nr_intp strides[3]={96,16,4}; NIter it; NIter_New(&it,d,3,shape,strides,NITER_MODE_STRIDED); if(it.nd_m1!=2){ printf("Sliced inner axes wrongly merged: nd_m1=%d\n",it.nd_m1); return 0;} VERIFY_ITER_VISITS(it,d,12,0,1,4,5,8,9,24,25,28,29,32,33); nr_intp shape2[3]={2,3,4}; NIter it2; NIter_New(&it2,d,3,shape2,strides,NITER_MODE_STRIDED); if(it2.nd_m1!=1||it2.shape_m1[1]!=11){ printf("Inner contiguous axes not merged: nd_m1=%d\n",it2.nd_m1); return 0;} VERIFY_ITER_VISITS(it2,d,24,0,1,2,3,4,5,6,7,8,9,10,11,24,25,26,27,28,29,30,31,32,33,34,35); return 1; }
+int test_iter_drops_unit_axes(){ nr_int32 d[10]; for(int i=0;i<10;i++) d[i]=i; nr_intp shape[4]={1,5,1,1}; nr_intp strides[4]={40,8,4,4}; NIter it; NIter_New(&it,d,4,shape,strides,NITER_MODE_NONE); if(it.nd_m1!=0||it.iter_mode!=NITER_MODE_CONTIGUOUS||it.step!=8){ printf("Unit axes not dropped: nd_m1=%d\n",it.nd_m1); return 0;} VERIFY_ITER_VISITS(it,d,5,0,2,4,6,8); return 1; }
+int test_iter_empty_and_scalar(){ nr_int32 d[4]={7,8,9,10}; nr_intp shape[2]={3,0}; nr_intp strides[2]={0,4}; NIter it; NIter_New(&it,d,2,shape,strides,NITER_MODE_STRIDED); NIter_ITER(&it); if(NIter_NOTDONE(&it)){ printf("Empty iter visits items\n"); return 0;} NIter it0; NIter_New(&it0,d,0,NULL,NULL,NITER_MODE_STRIDED); VERIFY_ITER_VISITS(it0,d,1,0); return 1; }
+int test_multiiter_broadcast_c_order(){ nr_int32 a[3]={0,10,20}; nr_int32 b[4]={1,2,3,4}; Node* na=Node_New(a,0,2,(nr_intp[]){3,1},NR_INT32); Node* nb=Node_New(b,0,2,(nr_intp[]){1,4},NR_INT32); Node* nodes[2]={na,nb}; NMultiIter mit; if(NMultiIter_FromNodes(nodes,2,&mit)!=0) return 0; if(mit.out_ndim!=2||mit.out_shape[0]!=3||mit.out_shape[1]!=4){ printf("Broadcast shape changed by coalescing\n"); return 0;} int k=0; NMultiIter_ITER(&mit); while(NMultiIter_NOTDONE(&mit)){ nr_int32 s=*(nr_int32*)NMultiIter_ITEM(&mit,0)+*(nr_int32*)NMultiIter_ITEM(&mit,1); if(s!=a[k/4]+b[k%4]){ printf("Broadcast visit mismatch at %d\n",k); return 0;} k++; NMultiIter_NEXT2(&mit);} Node_Free(na); Node_Free(nb); return k==12; }
+int test_multiiter_order_k_transposed(){ nr_int32 a[12], b[12]; for(int i=0;i<12;i++){ a[i]=i; b[i]=100+i; } Node* na=Node_New(a,0,2,(nr_intp[]){3,4},NR_INT32); Node* nb=Node_New(b,0,2,(nr_intp[]){3,4},NR_INT32); Node* ta=Node_Transpose(na,0); Node* tb=Node_Transpose(nb,0); Node* nodes[2]={ta,tb}; NMultiIter mc, mk; if(NMultiIter_FromNodes(nodes,2,&mc)!=0||NMultiIter_FromNodesOrder(nodes,2,NITER_ORDER_K,&mk)!=0) return 0; if(mc.iters[0].nd_m1!=1||mk.iters[0].nd_m1!=0){ printf("Unexpected coalescing: C nd_m1=%d K nd_m1=%d\n",mc.iters[0].nd_m1,mk.iters[0].nd_m1); return 0;} int k=0; NMultiIter_ITER(&mc); while(NMultiIter_NOTDONE(&mc)){ if(*(nr_int32*)NMultiIter_ITEM(&mc,0)!=a[(k%3)*4+k/3]){ printf("C order visit mismatch at %d\n",k); return 0;} k++; NMultiIter_NEXT2(&mc);} k=0; NMultiIter_ITER(&mk); while(NMultiIter_NOTDONE(&mk)){ nr_int32 va=*(nr_int32*)NMultiIter_ITEM(&mk,0), vb=*(nr_int32*)NMultiIter_ITEM(&mk,1); if(va!=k||vb!=100+k){ printf("K order visit mismatch at %d\n",k); return 0;} k++; NMultiIter_NEXT2(&mk);} Node_Free(ta); Node_Free(tb); Node_Free(na); Node_Free(nb); return k==12; }
+int test_inner_iter_rows(){ nr_int32 d[48]; for(int i=0;i<48;i++) d[i]=i; Node* n=Node_New(d,0,3,(nr_intp[]){2,3,2},NR_INT32); n->strides[0]=96; n->strides[1]=16; n->strides[2]=4; Node* nodes[1]={n}; NInnerIter iit; if(NInnerIter_FromNodes(&iit,nodes,1,NITER_ORDER_C)!=0) return 0; if(iit.end!=6||NInnerIter_COUNT(&iit)!=2||NInnerIter_STRIDES(&iit)[0]!=4){ printf("Unexpected rows: end=%d count=%d\n",(int)iit.end,(int)NInnerIter_COUNT(&iit)); return 0;} nr_int32 expected[12]={0,1,4,5,8,9,24,25,28,29,32,33}; int k=0; NInnerIter_ITER(&iit); while(NInnerIter_NOTDONE(&iit)){ char* p=NInnerIter_PTRS(&iit)[0]; for(nr_intp j=0;j<NInnerIter_COUNT(&iit);j++,p+=NInnerIter_STRIDES(&iit)[0]){ if(*(nr_int32*)p!=expected[k]){ printf("Row visit mismatch at %d\n",k); return 0;} k++; } NInnerIter_NEXT(&iit);} Node_Free(n); return k==12; }
+int test_inner_iter_broadcast(){ nr_int32 a[3]={0,10,20}; nr_int32 b[4]={1,2,3,4}; Node* na=Node_New(a,0,2,(nr_intp[]){3,1},NR_INT32); Node* nb=Node_New(b,0,1,(nr_intp[]){4},NR_INT32); Node* nodes[2]={na,nb}; NInnerIter iit; if(NInnerIter_FromNodes(&iit,nodes,2,NITER_ORDER_C)!=0) return 0; if(iit.out_ndim!=2||iit.out_shape[0]!=3||iit.out_shape[1]!=4||iit.end!=3||NInnerIter_COUNT(&iit)!=4||NInnerIter_STRIDES(&iit)[0]!=0||NInnerIter_STRIDES(&iit)[1]!=4){ printf("Unexpected broadcast rows\n"); return 0;} int k=0; NInnerIter_ITER(&iit); while(NInnerIter_NOTDONE(&iit)){ char** p=NInnerIter_PTRS(&iit); for(nr_intp j=0;j<NInnerIter_COUNT(&iit);j++,k++){ nr_int32 s=*(nr_int32*)(p[0]+j*NInnerIter_STRIDES(&iit)[0])+*(nr_int32*)(p[1]+j*NInnerIter_STRIDES(&iit)[1]); if(s!=a[k/4]+b[k%4]){ printf("Broadcast row mismatch at %d\n",k); return 0;} } NInnerIter_NEXT(&iit);} Node* bad=Node_New(b,0,1,(nr_intp[]){2},NR_INT32); Node* bad_nodes[2]={nb,bad}; int rc=NInnerIter_FromNodes(&iit,bad_nodes,2,NITER_ORDER_C); NError_Clear(); if(rc==0){ printf("Mismatched shapes accepted\n"); return 0;} Node_Free(bad); Node_Free(na); Node_Free(nb); return k==12; }
+int test_inner_iter_empty_and_scalar(){ nr_int32 d[4]={7,8,9,10}; Node* e=Node_NewEmpty(2,(nr_intp[]){3,0},NR_INT32); Node* nodes[1]={e}; NInnerIter iit; if(NInnerIter_FromNodes(&iit,nodes,1,NITER_ORDER_K)!=0) return 0; NInnerIter_ITER(&iit); if(NInnerIter_NOTDONE(&iit)){ printf("Empty inner iter has rows\n"); return 0;} Node_Free(e); Node* sc=Node_New(d,0,0,NULL,NR_INT32); nodes[0]=sc; if(NInnerIter_FromNodes(&iit,nodes,1,NITER_ORDER_K)!=0) return 0; int rows=0; NInnerIter_ITER(&iit); while(NInnerIter_NOTDONE(&iit)){ if(NInnerIter_COUNT(&iit)!=1||*(nr_int32*)NInnerIter_PTRS(&iit)[0]!=7){ printf("Scalar inner iter mismatch\n"); return 0;} rows++; NInnerIter_NEXT(&iit);} Node_Free(sc); return rows==1; }
+int test_node_contiguity_flags(){ nr_int32 d[12]={0}; Node* n=Node_New(d,0,2,(nr_intp[]){3,4},NR_INT32); Node* t=Node_Transpose(n,0); Node* e=Node_ExpandDims(n,0,0); Node* row=Node_NewChild(n,2,(nr_intp[]){1,4},(nr_intp[]){999,4},16); Node* col=Node_NewChild(n,2,(nr_intp[]){3,1},(nr_intp[]){16,4},0); int ok=NODE_IS_CONTIGUOUS(n)&&!NODE_IS_CONTIGUOUS(t)&&NODE_IS_STRIDED(t)&&NODE_IS_CONTIGUOUS(e)&&NODE_IS_CONTIGUOUS(row)&&!NODE_IS_CONTIGUOUS(col); if(!ok) printf("Wrong contiguity flags\n"); Node_Free(t); Node_Free(e); Node_Free(row); Node_Free(col); Node* own=Node_NewEmpty(2,(nr_intp[]){2,5},NR_FLOAT64); Node* same=Node_Transpose(own,1); if(same!=own||NODE_IS_CONTIGUOUS(own)){ printf("In-place transpose kept contiguous flag\n"); ok=0;} Node_Free(own); Node_Free(n); return ok; }
+int test_multiiter_layout_modes(){ nr_int32 a[12], b[4]; for(int i=0;i<12;i++) a[i]=i; for(int i=0;i<4;i++) b[i]=i; Node* na=Node_New(a,0,2,(nr_intp[]){3,4},NR_INT32); Node* nb=Node_New(b,0,1,(nr_intp[]){4},NR_INT32); Node* nc=Node_New(a,0,2,(nr_intp[]){3,4},NR_INT32); Node* ta=Node_Transpose(na,0); Node* tb=Node_Transpose(nc,0); NMultiIter mit; Node* same[2]={na,nc}; if(NMultiIter_FromNodes(same,2,&mit)!=0) return 0; if(mit.iter_mode!=NITER_MODE_CONTIGUOUS||mit.iters[0].iter_mode!=NITER_MODE_CONTIGUOUS||mit.inner_size!=12){ printf("Same-shape operands not contiguous: mode=%d\n",mit.iter_mode); return 0;} Node* rowb[2]={na,nb}; if(NMultiIter_FromNodes(rowb,2,&mit)!=0) return 0; if(mit.iter_mode!=NITER_MODE_INNER_CONTIGUOUS||mit.inner_size!=4||mit.iters[0].iter_mode!=NITER_MODE_CONTIGUOUS){ printf("Row broadcast not inner contiguous: mode=%d\n",mit.iter_mode); return 0;} NInnerIter iit; if(NInnerIter_FromNodes(&iit,rowb,2,NITER_ORDER_C)!=0||iit.iter_mode!=NITER_MODE_INNER_CONTIGUOUS){ printf("Row broadcast inner iter not inner contiguous\n"); return 0;} Node* nb3=Node_New(b,0,1,(nr_intp[]){3},NR_INT32); Node* tr[2]={ta,nb3}; if(NMultiIter_FromNodes(tr,2,&mit)!=0||mit.iter_mode!=NITER_MODE_STRIDED){ printf("Transposed operand not strided\n"); return 0;} Node_Free(nb3); Node* tt[2]={ta,tb}; if(NMultiIter_FromNodesOrder(tt,2,NITER_ORDER_K,&mit)!=0||mit.iter_mode!=NITER_MODE_CONTIGUOUS){ printf("Transposed pair in K order not contiguous\n"); return 0;} Node_Free(ta); Node_Free(tb); Node_Free(na); Node_Free(nb); Node_Free(nc); return 1; }
+
+void test_iter(){ TestFunc tests[]={
+    test_iter_contiguous_collapses, test_iter_sliced_inner_merge, test_iter_drops_unit_axes, test_iter_empty_and_scalar,
+    test_multiiter_broadcast_c_order, test_multiiter_order_k_transposed,
+    test_inner_iter_rows, test_inner_iter_broadcast, test_inner_iter_empty_and_scalar,
+    test_node_contiguity_flags, test_multiiter_layout_modes
+}; int num_tests=sizeof(tests)/sizeof(tests[0]); run_all_tests(tests, "Iterator Tests", num_tests); }
@@ -44,6 +44,11 @@ int main() {
     test_reduce();
     test_cumulative();
     test_shape();
+    test_elementwise();
+    test_iter();
+    test_thread();
+    test_io();
+    test_grad();
     // Add calls to other test suites here as needed
     return 0;
 }
\ No newline at end of file
@@ -22,6 +22,11 @@ void test_getset();
 void test_reduce();
 void test_cumulative();
 void test_shape();
+void test_elementwise();
+void test_iter();
+void test_thread();
+void test_io();
+void test_grad();
 
 
 #endif // NOUR__CORE_TESTS_MAIN_H
\ No newline at end of file
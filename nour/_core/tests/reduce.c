@@ -1,6 +1,7 @@
 #include "main.h"
 #include "../src/cnour.h"
 #include <math.h>
+#include <string.h>
 
 #define VERIFY_SCALAR_INT64(node, expected) do { \
     if (NODE_NDIM(node) != 0) { printf("Expected scalar ndim=0 got %d\n", NODE_NDIM(node)); return 0; } \
@@ -83,6 +84,23 @@ int test_reduce_nanstd_full(){ nr_intp shape[1]={5}; double data[5]={1.0,NAN,3.0
 int test_reduce_empty_sum(){ nr_intp shape[1]={0}; Node* n=Node_NewEmpty(1,shape,NR_INT32); if(!n){ printf("Empty node alloc failed\n"); return 0;} Node* r=NMath_Sum(NULL,n,NULL,0); if(!r){ printf("Sum empty failed\n"); Node_Free(n); return 0;} VERIFY_SCALAR_INT64(r,0); Node_Free(n); Node_Free(r); return 1; }
 int test_reduce_empty_min(){ nr_intp shape[1]={0}; Node* n=Node_NewEmpty(1,shape,NR_INT32); if(!n) return 0; Node* r=NMath_Min(NULL,n,NULL,0); if(!r){ printf("Min empty failed\n"); Node_Free(n); return 0;} nr_int32 v=*(nr_int32*)NODE_DATA(r); if(v!=0){ printf("Min empty expected 0 got %d\n",(int)v); Node_Free(n); Node_Free(r); return 0;} Node_Free(n); Node_Free(r); return 1; }
 int test_reduce_small_var_axis(){ nr_intp shape[2]={1,4}; double data[4]={2.0,2.0,2.0,2.0}; Node* n=make_node_f64(data,2,shape); int ax[1]={0}; Node* r=NMath_Var(NULL,n,ax,1); if(!r){ printf("Var axis failed\n"); Node_Free(n); return 0;} VERIFY_SHAPE(r,1,4); VERIFY_ARRAY_FLOAT64_APPROX(r,4,1e-12,0.0,0.0,0.0,0.0); Node_Free(n); Node_Free(r); return 1; }
+int test_reduce_transposed_full(){ nr_intp shape[2]={2,3}; int data[6]={1,5,3,9,2,4}; double fdata[6]={1,5,3,9,2,4}; Node* n=make_node_i32(data,2,shape); Node* f=make_node_f64(fdata,2,shape); Node* t=Node_Transpose(n,0); Node* ft=Node_Transpose(f,0); Node* s=NMath_Sum(NULL,t,NULL,0); Node* am=NMath_Argmax(NULL,t,NULL,0); Node* v=NMath_Var(NULL,ft,NULL,0); if(!s||!am||!v){ printf("Transposed full reduce failed\n"); return 0;} VERIFY_SCALAR_INT64(s,24); VERIFY_SCALAR_INT64(am,1); VERIFY_SCALAR_FLOAT64_APPROX(v,40.0/6.0,1e-12); Node_Free(s); Node_Free(am); Node_Free(v); Node_Free(t); Node_Free(ft); Node_Free(n); Node_Free(f); return 1; }
+
+int test_reduce_axis_transposed(){ nr_intp shape[2]={2,3}; int data[6]={1,5,3,9,2,4}; Node* n=make_node_i32(data,2,shape); Node* t=Node_Transpose(n,0); int a0[1]={0}, a1[1]={1}; Node* s0=NMath_Sum(NULL,t,a0,1); Node* s1=NMath_Sum(NULL,t,a1,1); Node* am0=NMath_Argmax(NULL,t,a0,1); Node* am1=NMath_Argmin(NULL,t,a1,1); Node* mx=NMath_Max(NULL,t,a0,1); if(!s0||!s1||!am0||!am1||!mx){ printf("Transposed axis reduce failed\n"); return 0;} VERIFY_ARRAY_INT64(s0,2,9,15); VERIFY_ARRAY_INT64(s1,3,10,7,7); VERIFY_ARRAY_INT64(am0,2,1,0); VERIFY_ARRAY_INT64(am1,3,0,1,0); nr_int32* m=(nr_int32*)NODE_DATA(mx); if(m[0]!=5||m[1]!=9){ printf("Transposed max axis0 got [%d,%d]\n",m[0],m[1]); return 0;} Node_Free(s0); Node_Free(s1); Node_Free(am0); Node_Free(am1); Node_Free(mx); Node_Free(t); Node_Free(n); return 1; }
+int test_reduce_multi_axis(){ nr_intp shape[3]={2,3,4}; int data[24]; for(int i=0;i<24;i++) data[i]=i; Node* n=make_node_i32(data,3,shape); int ax[2]={0,2}; Node* s=NMath_Sum(NULL,n,ax,2); Node* am=NMath_Argmax(NULL,n,ax,2); Node* mn=NMath_Mean(NULL,n,ax,2); if(!s||!am||!mn){ printf("Multi-axis reduce failed\n"); return 0;} VERIFY_SHAPE(s,1,3); VERIFY_ARRAY_INT64(s,3,60,92,124); VERIFY_ARRAY_INT64(am,3,7,7,7); VERIFY_ARRAY_FLOAT64_APPROX(mn,3,1e-12,7.5,11.5,15.5); Node_Free(s); Node_Free(am); Node_Free(mn); Node_Free(n); return 1; }
+int test_reduce_nan_axis(){ nr_intp shape[2]={2,3}; double data[6]={NAN,1,2,NAN,NAN,5}; Node* n=make_node_f64(data,2,shape); int a0[1]={0}, a1[1]={1}; Node* mx=NMath_NanMax(NULL,n,a0,1); Node* mn=NMath_NanMean(NULL,n,a0,1); Node* mi=NMath_NanMin(NULL,n,a1,1); if(!mx||!mn||!mi){ printf("NaN axis reduce failed\n"); return 0;} VERIFY_ARRAY_FLOAT64_APPROX(mx,3,1e-12,NAN,1.0,5.0); VERIFY_ARRAY_FLOAT64_APPROX(mn,3,1e-12,NAN,1.0,3.5); VERIFY_ARRAY_FLOAT64_APPROX(mi,2,1e-12,1.0,5.0); Node_Free(mx); Node_Free(mn); Node_Free(mi); Node_Free(n); return 1; }
+int test_reduce_axis_strided_out(){ nr_intp shape[3]={2,3,4}; int data[24]; for(int i=0;i<24;i++) data[i]=i; Node* n=make_node_i32(data,3,shape); nr_intp bshape[2]={3,2}; Node* b=Node_NewEmpty(2,bshape,NR_INT64); Node* ot=Node_Transpose(b,0); int ax[1]={2}; Node* r=NMath_Sum(ot,n,ax,1); if(r!=ot){ printf("Strided output sum failed\n"); return 0;} VERIFY_ARRAY_INT64(b,6,6,54,22,70,38,86); Node_Free(ot); Node_Free(b); Node_Free(n); return 1; }
+int test_reduce_sum_modes(){ const nr_intp n=1<<20; double* data=(double*)malloc(n*sizeof(double)); for(nr_intp i=0;i<n;i++) data[i]=0.1; double exact=(double)n*0.1; nr_intp shape1[1]={n}; nr_intp shape2[2]={2,n/2}; Node* v=make_node_f64(data,1,shape1); Node* m=make_node_f64(data,2,shape2); Node* mt=Node_Transpose(m,0); int a1[1]={1}, a0[1]={0}; NMath_SumMode modes[2]={NMATH_SUM_PAIRWISE,NMATH_SUM_KAHAN}; NMath_SumMode prev=NMath_GetSumMode(); int ok=1; for(int k=0;k<2&&ok;k++){ NMath_SetSumMode(modes[k]); Node* s=NMath_Sum(NULL,v,NULL,0); Node* mn=NMath_Mean(NULL,v,NULL,0); Node* rs=NMath_Sum(NULL,m,a1,1); Node* cs=NMath_Sum(NULL,mt,a0,1); if(!s||!mn||!rs||!cs){ printf("Sum mode %d failed\n",k); ok=0; } else { double* r=(double*)NODE_DATA(rs); double* c=(double*)NODE_DATA(cs); if(fabs(*(double*)NODE_DATA(s)-exact)>1e-9||fabs(*(double*)NODE_DATA(mn)-0.1)>1e-15||fabs(r[0]-exact/2)>1e-9||fabs(c[1]-exact/2)>1e-9){ printf("Sum mode %d inaccurate: %.17g %.17g %.17g %.17g\n",k,*(double*)NODE_DATA(s),*(double*)NODE_DATA(mn),r[0],c[1]); ok=0; } } Node_Free(s); Node_Free(mn); Node_Free(rs); Node_Free(cs); } NMath_SetSumMode(NMATH_SUM_NAIVE); Node* s=NMath_Sum(NULL,v,NULL,0); if(!s||fabs(*(double*)NODE_DATA(s)-exact)>1e-3){ printf("Naive sum failed\n"); ok=0; } Node_Free(s); NMath_SetSumMode(prev); Node_Free(mt); Node_Free(m); Node_Free(v); free(data); return ok; }
+int test_reduce_nansum_axis_modes(){ nr_intp shape[2]={2,3}; double data[6]={1,NAN,2,NAN,NAN,5}; Node* n=make_node_f64(data,2,shape); int a0[1]={0}, a1[1]={1}; NMath_SumMode prev=NMath_SetSumMode(NMATH_SUM_KAHAN); Node* s0=NMath_NanSum(NULL,n,a0,1); Node* m1=NMath_NanMean(NULL,n,a1,1); NMath_SetSumMode(prev); if(!s0||!m1){ printf("NanSum axis failed\n"); return 0;} VERIFY_ARRAY_FLOAT64_APPROX(s0,3,1e-12,1.0,0.0,7.0); VERIFY_ARRAY_FLOAT64_APPROX(m1,2,1e-12,1.5,5.0); Node_Free(s0); Node_Free(m1); Node_Free(n); return 1; }
+int test_reduce_var_ddof(){ nr_intp shape[1]={4}; double data[4]={1.0,2.0,3.0,4.0}; Node* n=make_node_f64(data,1,shape); Node* v1=NMath_VarDdof(NULL,n,NULL,0,1); Node* s1=NMath_StdDdof(NULL,n,NULL,0,1); Node* v4=NMath_VarDdof(NULL,n,NULL,0,4); if(!v1||!s1||!v4){ printf("Var ddof failed\n"); return 0;} VERIFY_SCALAR_FLOAT64_APPROX(v1,5.0/3.0,1e-12); VERIFY_SCALAR_FLOAT64_APPROX(s1,sqrt(5.0/3.0),1e-12); VERIFY_SCALAR_FLOAT64_APPROX(v4,NAN,0); NMath_VarState a={2,1.5,0.5}, b={2,3.5,0.5}; NMath_VarStateMerge(&a,&b); if(a.count!=4||fabs(NMath_VarStateGet(&a,0)-1.25)>1e-12){ printf("VarState merge mismatch\n"); return 0;} Node_Free(v1); Node_Free(s1); Node_Free(v4); Node_Free(n); return 1; }
+int test_reduce_var_stability(){ double v[4]={4,7,13,16}; nr_intp shape[2]={4,70}; double data[280]; for(int i=0;i<4;i++) for(int j=0;j<70;j++) data[i*70+j]=1e9+v[i]+j; Node* n=make_node_f64(data,2,shape); Node* t=Node_Transpose(n,0); int a0[1]={0}, a1[1]={1}; Node* c=NMath_Var(NULL,n,a0,1); Node* r=NMath_Var(NULL,n,a1,1); Node* ct=NMath_Var(NULL,t,a1,1); if(!c||!r||!ct){ printf("Var stability failed\n"); return 0;} double* cd=(double*)NODE_DATA(c); double* rd=(double*)NODE_DATA(r); double* td=(double*)NODE_DATA(ct); for(int j=0;j<70;j++){ if(fabs(cd[j]-22.5)>1e-6||fabs(td[j]-22.5)>1e-6){ printf("Var axis0 at %d got %.9f / %.9f\n",j,cd[j],td[j]); return 0;} } for(int i=0;i<4;i++){ if(fabs(rd[i]-408.25)>1e-6){ printf("Var axis1 at %d got %.9f\n",i,rd[i]); return 0;} } Node_Free(c); Node_Free(r); Node_Free(ct); Node_Free(t); Node_Free(n); return 1; }
+int test_reduce_nanvar_axis_ddof(){ nr_intp shape[2]={2,3}; double data[6]={1,NAN,3,2,4,NAN}; Node* n=make_node_f64(data,2,shape); int a0[1]={0}, a1[1]={1}; Node* r1=NMath_NanVarDdof(NULL,n,a1,1,1); Node* r0=NMath_NanVar(NULL,n,a0,1); if(!r1||!r0){ printf("NanVar axis ddof failed\n"); return 0;} VERIFY_ARRAY_FLOAT64_APPROX(r1,2,1e-12,2.0,2.0); VERIFY_ARRAY_FLOAT64_APPROX(r0,3,1e-12,0.25,0.0,0.0); Node_Free(r1); Node_Free(r0); Node_Free(n); return 1; }
+/* Same shape and dtype, float64 items within a relative 1e-12, others exact */
+static int same_result(Node* a, Node* b){ if(!a||!b||a->ndim!=b->ndim||NODE_DTYPE(a)!=NODE_DTYPE(b)) return 0; for(int i=0;i<a->ndim;i++) if(a->shape[i]!=b->shape[i]) return 0; nr_intp n=Node_NItems(a); if(NODE_DTYPE(a)!=NR_FLOAT64) return memcmp(NODE_DATA(a),NODE_DATA(b),n*NODE_ITEMSIZE(a))==0; for(nr_intp i=0;i<n;i++){ double x=((double*)NODE_DATA(a))[i], y=((double*)NODE_DATA(b))[i]; if(fabs(x-y)>1e-12*fmax(1.0,fabs(y))) return 0; } return 1; }
+/* Feeds `whole` to a state in batches of `sizes` rows along axis 0 */
+static Node* stream_reduce(Node* whole, NReduce_Op op, int* axis, int na, int ddof, const nr_intp* sizes, int nb){ NReduceState* st=NReduceState_NewDdof(op,axis,na,ddof); nr_intp row=0; for(int k=0;k<nb&&st;k++){ NIndexRuleSet rs=NIndexRuleSet_New(); NIndexRuleSet_AddSlice(&rs,row,row+sizes[k],1); Node* b=Node_Get(whole,&rs); row+=sizes[k]; if(!b||NReduceState_Update(st,b)!=0){ Node_Free(b); NReduceState_Free(st); return NULL; } Node_Free(b); } Node* r=st?NReduceState_Finalize(st):NULL; NReduceState_Free(st); return r; }
+int test_reduce_state_matches_whole(){ enum{R=25,C=4,P=3}; double d[R*C*P]; for(int i=0;i<R*C*P;i++) d[i]=sin(i*0.7)*100+(i%7==0?1e6:0); nr_intp shape[3]={R,C,P}; Node* n=make_node_f64(d,3,shape); nr_intp sizes[4]={7,0,10,8}; int axes[3][2]={{0,0},{0,2},{-3,1}}; int nas[3]={1,2,0}; NReduce_Op ops[8]={NREDUCE_SUM,NREDUCE_MIN,NREDUCE_MAX,NREDUCE_MEAN,NREDUCE_VAR,NREDUCE_STD,NREDUCE_ARGMIN,NREDUCE_ARGMAX}; for(int a=0;a<3;a++) for(int o=0;o<8;o++){ int* ax=nas[a]?axes[a]:NULL; Node* got=stream_reduce(n,ops[o],axes[a],nas[a],1,sizes,4); Node* want=NULL; switch(ops[o]){ case NREDUCE_SUM: want=NMath_Sum(NULL,n,ax,nas[a]); break; case NREDUCE_MIN: want=NMath_Min(NULL,n,ax,nas[a]); break; case NREDUCE_MAX: want=NMath_Max(NULL,n,ax,nas[a]); break; case NREDUCE_MEAN: want=NMath_Mean(NULL,n,ax,nas[a]); break; case NREDUCE_VAR: want=NMath_VarDdof(NULL,n,ax,nas[a],1); break; case NREDUCE_STD: want=NMath_StdDdof(NULL,n,ax,nas[a],1); break; case NREDUCE_ARGMIN: want=(nas[a]==1||nas[a]==0)?NMath_Argmin(NULL,n,ax,nas[a]):NULL; break; case NREDUCE_ARGMAX: want=(nas[a]==1||nas[a]==0)?NMath_Argmax(NULL,n,ax,nas[a]):NULL; break; default: break; } if(want&&!same_result(got,want)){ printf("Streamed op %d over axes set %d differs\n",o,a); Node_Free(got); Node_Free(want); Node_Free(n); return 0; } Node_Free(got); Node_Free(want); } Node_Free(n); return 1; }
+int test_reduce_state_ints_and_errors(){ enum{R=9,C=5}; int d[R*C]; for(int i=0;i<R*C;i++) d[i]=(i*37)%23-11; nr_intp shape[2]={R,C}; Node* n=make_node_i32(d,2,shape); nr_intp sizes[3]={4,4,1}; int a0[1]={0}; Node* got=stream_reduce(n,NREDUCE_SUM,a0,1,0,sizes,3); Node* want=NMath_Sum(NULL,n,a0,1); Node* gp=stream_reduce(n,NREDUCE_PROD,a0,1,0,sizes,3); Node* wp=NMath_Prod(NULL,n,a0,1); int ok=same_result(got,want)&&same_result(gp,wp); if(!ok) printf("Streamed int sum/prod differs\n"); Node_Free(got); Node_Free(want); Node_Free(gp); Node_Free(wp); int a1[1]={1}; NReduceState* st=NReduceState_New(NREDUCE_SUM,a1,1); ok=ok&&NReduceState_Update(st,n)==-1&&NERROR_TYPE==NError_ValueError; NError_Clear(); NReduceState_Free(st); st=NReduceState_New(NREDUCE_MAX,NULL,0); ok=ok&&!NReduceState_Finalize(st); NError_Clear(); Node* e=Node_NewEmpty(2,(nr_intp[]){0,C},NR_INT32); Node* fe=NReduceState_Update(st,e)==0?NReduceState_Finalize(st):NULL; Node* we=NMath_Max(NULL,e,NULL,0); ok=ok&&fe&&same_result(fe,we); Node_Free(fe); Node_Free(we); Node* bad=Node_NewEmpty(2,(nr_intp[]){2,C+1},NR_INT32); ok=ok&&NReduceState_Update(st,bad)==-1&&NReduceState_Update(st,n)==0&&NReduceState_Rows(st)==R; NError_Clear(); Node* mx=NReduceState_Finalize(st); Node* wmx=NMath_Max(NULL,n,NULL,0); ok=ok&&same_result(mx,wmx); if(!ok) printf("Reduce state errors not raised\n"); Node_Free(mx); Node_Free(wmx); Node_Free(bad); Node_Free(e); NReduceState_Free(st); Node_Free(n); return ok; }
 
 void test_reduce(){ TestFunc tests[]={
     test_reduce_sum_full_int32, test_reduce_sum_axis0, test_reduce_sum_axis1, test_reduce_sum_negative_axis, test_reduce_sum_all_axes_list, test_reduce_sum_duplicate_axes, test_reduce_sum_axis_out_of_bounds, test_reduce_sum_user_output_correct, test_reduce_sum_user_output_wrong_shape, test_reduce_sum_user_output_dtype_downcast,
@@ -92,5 +110,9 @@ void test_reduce(){ TestFunc tests[]={
     test_reduce_argmin_full, test_reduce_argmax_full, test_reduce_argmin_axis,
     test_reduce_all_full, test_reduce_any_full, test_reduce_count_nonzero_axis,
     test_reduce_nansum_full, test_reduce_nanmean_full, test_reduce_nanmin_full, test_reduce_nanmax_full, test_reduce_nanvar_full, test_reduce_nanstd_full,
-    test_reduce_empty_sum, test_reduce_empty_min, test_reduce_small_var_axis
+    test_reduce_empty_sum, test_reduce_empty_min, test_reduce_small_var_axis, test_reduce_transposed_full,
+    test_reduce_axis_transposed, test_reduce_multi_axis, test_reduce_nan_axis, test_reduce_axis_strided_out,
+    test_reduce_sum_modes, test_reduce_nansum_axis_modes,
+    test_reduce_var_ddof, test_reduce_var_stability, test_reduce_nanvar_axis_ddof,
+    test_reduce_state_matches_whole, test_reduce_state_ints_and_errors
 }; int num_tests=sizeof(tests)/sizeof(tests[0]); run_all_tests(tests, "Reduce Tests", num_tests); }
@@ -0,0 +1,40 @@
+#include "main.h"
+#include "../src/nthread.h"
+#include "../src/nmath/cumulative.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#define THREAD_TEST_N 300007
+
+typedef struct{ char* seen; nr_intp grain; int misaligned; int nested_ok; }range_check;
+
+static void mark_range(void* ctx, nr_intp start, nr_intp end){ range_check* c=(range_check*)ctx; if(start%c->grain) __atomic_store_n(&c->misaligned,1,__ATOMIC_RELAXED); for(nr_intp i=start;i<end;i++) c->seen[i]++; }
+static void nested_range(void* ctx, nr_intp start, nr_intp end){ range_check* c=(range_check*)ctx; range_check inner={c->seen+start,1,0,0}; NThread_ParallelFor(end-start,1,mark_range,&inner); if(inner.misaligned) __atomic_store_n(&c->misaligned,1,__ATOMIC_RELAXED); }
+
+static Node* make_seq_f64(nr_intp n){ Node* a=Node_NewEmpty(1,(nr_intp[]){n},NR_FLOAT64); nr_float64* d=(nr_float64*)NODE_DATA(a); for(nr_intp i=0;i<n;i++) d[i]=1e6+(nr_float64)((i*7919)%1000)*0.001; return a; }
+
+int test_thread_set_get(){ int prev=NThread_SetNumThreads(3); if(NThread_GetNumThreads()!=3){ printf("Thread count not applied\n"); return 0;} int p2=NThread_SetNumThreads(prev); if(p2!=3||NThread_GetNumThreads()!=prev){ printf("Previous thread count not returned\n"); return 0;} NThread_SetNumThreads(100000); if(NThread_GetNumThreads()!=NTHREAD_MAX_THREADS){ printf("Thread count not clamped\n"); return 0;} NThread_SetNumThreads(prev); return 1; }
+int test_thread_parallel_for_covers(){ int prev=NThread_SetNumThreads(4); char* seen=calloc(THREAD_TEST_N,1); range_check c={seen,1000,0,0}; NThread_ParallelFor(THREAD_TEST_N,1000,mark_range,&c); int ok=!c.misaligned; for(nr_intp i=0;i<THREAD_TEST_N&&ok;i++) if(seen[i]!=1){ printf("Item %lld visited %d times\n",(long long)i,seen[i]); ok=0;} memset(seen,0,THREAD_TEST_N); NThread_ParallelFor(5,1000,mark_range,&c); for(int i=0;i<5&&ok;i++) ok=seen[i]==1; NThread_ParallelFor(0,1000,mark_range,&c); free(seen); NThread_SetNumThreads(prev); if(c.misaligned) printf("Range not aligned to the grain\n"); return ok; }
+int test_thread_nested_runs_inline(){ int prev=NThread_SetNumThreads(4); char* seen=calloc(THREAD_TEST_N,1); range_check c={seen,1000,0,0}; NThread_ParallelFor(THREAD_TEST_N,1000,nested_range,&c); int ok=!c.misaligned; for(nr_intp i=0;i<THREAD_TEST_N&&ok;i++) if(seen[i]!=1){ printf("Nested loop visited item %lld %d times\n",(long long)i,seen[i]); ok=0;} free(seen); NThread_SetNumThreads(prev); return ok; }
+int test_thread_reductions_match_serial(){ Node* a=make_seq_f64(THREAD_TEST_N); int prev=NThread_SetNumThreads(1); Node* s1=NMath_Sum(NULL,a,NULL,0); Node* v1=NMath_Var(NULL,a,NULL,0); Node* m1=NMath_Min(NULL,a,NULL,0); NThread_SetNumThreads(4); Node* s4=NMath_Sum(NULL,a,NULL,0); Node* v4=NMath_Var(NULL,a,NULL,0); Node* m4=NMath_Min(NULL,a,NULL,0); NThread_SetNumThreads(prev); if(!s1||!v1||!m1||!s4||!v4||!m4) return 0; double ds1=*(double*)NODE_DATA(s1), ds4=*(double*)NODE_DATA(s4), dv1=*(double*)NODE_DATA(v1), dv4=*(double*)NODE_DATA(v4); int ok=ds1==ds4&&dv1==dv4&&*(double*)NODE_DATA(m1)==1e6&&*(double*)NODE_DATA(m4)==1e6; if(!ok) printf("Results depend on the thread count: sum %.17g/%.17g var %.17g/%.17g\n",ds1,ds4,dv1,dv4); if(fabs(dv1-0.083333)>1e-3){ printf("Unexpected var %.9f\n",dv1); ok=0;} Node_Free(s1); Node_Free(v1); Node_Free(m1); Node_Free(s4); Node_Free(v4); Node_Free(m4); Node_Free(a); return ok; }
+int test_thread_minmax_nan_blocks(){ Node* a=make_seq_f64(THREAD_TEST_N); nr_float64* d=(nr_float64*)NODE_DATA(a); d[65536]=NAN; d[65537]=-5.; int prev=NThread_SetNumThreads(4); Node* m=NMath_Min(NULL,a,NULL,0); d[65536]=1e6; d[0]=NAN; Node* mn=NMath_Min(NULL,a,NULL,0); NThread_SetNumThreads(prev); if(!m||!mn) return 0; int ok=*(double*)NODE_DATA(m)==-5.&&isnan(*(double*)NODE_DATA(mn)); if(!ok) printf("Block seeding changed min: %f %f\n",*(double*)NODE_DATA(m),*(double*)NODE_DATA(mn)); Node_Free(m); Node_Free(mn); Node_Free(a); return ok; }
+int test_thread_elementwise_and_cast(){ Node* a=make_seq_f64(THREAD_TEST_N); int prev=NThread_SetNumThreads(4); Node* s=NMath_Add(NULL,a,a); Node* c=Node_ToType(NULL,a,NR_INT32); NThread_SetNumThreads(prev); if(!s||!c) return 0; nr_float64* da=(nr_float64*)NODE_DATA(a); nr_float64* ds=(nr_float64*)NODE_DATA(s); nr_int32* dc=(nr_int32*)NODE_DATA(c); int ok=1; for(nr_intp i=0;i<THREAD_TEST_N&&ok;i++) if(ds[i]!=2*da[i]||dc[i]!=(nr_int32)da[i]){ printf("Parallel elementwise/cast mismatch at %lld\n",(long long)i); ok=0;} Node_Free(s); Node_Free(c); Node_Free(a); return ok; }
+
+static void fail_range(void* ctx, nr_intp start, nr_intp NR_UNUSED(end)){ if(start>=*(nr_intp*)ctx) NError_RaiseError(NError_ValueError,"range %lld failed",(long long)start); }
+static void* raise_on_thread(void* arg){ NError* err=(NError*)arg; if(NError_IsError()) return NULL; NError_RaiseError(NError_IndexError,"worker says %d",7); NError_Fetch(err); return NError_IsError() ? NULL : arg; }
+static void* run_independent(void* arg){ int* ok=(int*)arg; Node* a=make_seq_f64(70001); Node* b=Node_NewEmpty(1,(nr_intp[]){3},NR_FLOAT64); for(int r=0;r<20&&*ok;r++){ Node* s=NMath_Add(NULL,a,a); if(!s||NError_IsError()||((nr_float64*)NODE_DATA(s))[70000]!=2*((nr_float64*)NODE_DATA(a))[70000]) *ok=0; Node_Free(s); Node* bad=NMath_Add(NULL,a,b); if(bad||!NError_IsError()) *ok=0; NError_Clear(); } Node_Free(a); Node_Free(b); return NULL; }
+
+int test_thread_cumulative_scans(){ Node* a=make_seq_f64(THREAD_TEST_N); nr_float64* d=(nr_float64*)NODE_DATA(a); Node* ai=Node_ToType(NULL,a,NR_INT32); long double want=0; for(nr_intp i=0;i<THREAD_TEST_N;i++) want+=d[i]; int prev=NThread_SetNumThreads(1); Node* s1=NMath_Cumsum(NULL,a,0); NThread_SetNumThreads(4); Node* s4=NMath_Cumsum(NULL,a,0); Node* si=NMath_Cumsum(NULL,ai,0); d[131072]=NAN; d[131073]=-5.; Node* mn=NMath_Cummin(NULL,a,0); Node* m2=Node_NewEmpty(2,(nr_intp[]){1000,300},NR_INT32); memcpy(NODE_DATA(m2),NODE_DATA(ai),1000*300*sizeof(nr_int32)); Node* s2=NMath_Cumsum(NULL,m2,0); nr_float64 d0=d[0]; d[0]=NAN; Node* mx=NMath_Cummax(NULL,a,0); NThread_SetNumThreads(prev); if(!s1||!s4||!si||!mn||!s2||!mx) return 0; int ok=memcmp(NODE_DATA(s1),NODE_DATA(s4),THREAD_TEST_N*sizeof(nr_float64))==0; if(!ok) printf("Cumsum depends on the thread count\n"); nr_float64 last=((nr_float64*)NODE_DATA(s4))[THREAD_TEST_N-1]; if(fabs(last-(double)want)>1e-6){ printf("Blocked cumsum drifted: %.17g vs %.17g\n",last,(double)want); ok=0;} nr_int32* di=(nr_int32*)NODE_DATA(ai); nr_int64* dsi=(nr_int64*)NODE_DATA(si); nr_float64* dmn=(nr_float64*)NODE_DATA(mn); nr_int64 acc=0; nr_float64 m=1e7; for(nr_intp i=0;i<THREAD_TEST_N&&ok;i++){ acc+=di[i]; nr_float64 v=i?d[i]:d0; if(v<m) m=v; if(dsi[i]!=acc||dmn[i]!=m){ printf("Scan mismatch at %lld: %lld/%lld %f/%f\n",(long long)i,(long long)dsi[i],(long long)acc,dmn[i],m); ok=0;} } nr_int64* ds2=(nr_int64*)NODE_DATA(s2); for(int j=0;j<300&&ok;j++){ nr_int64 col=0; for(int i=0;i<1000;i++) col+=di[i*300+j]; if(ds2[999*300+j]!=col){ printf("Slice-parallel cumsum mismatch in column %d\n",j); ok=0;} } if(!isnan(((nr_float64*)NODE_DATA(mx))[THREAD_TEST_N-1])){ printf("Leading NaN lost in cummax\n"); ok=0;} Node_Free(s1); Node_Free(s4); Node_Free(si); Node_Free(mn); Node_Free(s2); Node_Free(mx); Node_Free(m2); Node_Free(ai); Node_Free(a); return ok; }
+
+int test_thread_error_is_per_thread(){ NError_RaiseError(NError_ValueError,"main"); NError err={NError_NoError,""}; pthread_t t; if(pthread_create(&t,NULL,raise_on_thread,&err)!=0) return 0; void* r; pthread_join(t,&r); int ok=r!=NULL&&NERROR_TYPE==NError_ValueError&&strcmp(NERROR_CONTEXT,"main")==0; if(!ok) printf("Error state shared between threads\n"); NError_Restore(&err); if(NERROR_TYPE!=NError_IndexError||strcmp(NERROR_CONTEXT,"worker says 7")!=0){ printf("Fetched error not restored\n"); ok=0;} NError_Restore(NULL); if(NError_IsError()){ printf("Restore(NULL) did not clear\n"); ok=0;} return ok; }
+int test_thread_parallel_for_error(){ int prev=NThread_SetNumThreads(4); nr_intp fail_from=200000; NThread_ParallelFor(THREAD_TEST_N,1000,fail_range,&fail_from); int ok=NERROR_TYPE==NError_ValueError&&strncmp(NERROR_CONTEXT,"range ",6)==0; NError_Clear(); fail_from=THREAD_TEST_N; NThread_ParallelFor(THREAD_TEST_N,1000,fail_range,&fail_from); if(NError_IsError()){ printf("Error left over from the previous loop\n"); ok=0;} NThread_SetNumThreads(prev); if(!ok) printf("Worker error not propagated to the caller\n"); return ok; }
+int test_thread_concurrent_calls(){ int prev=NThread_SetNumThreads(4); pthread_t t[4]; int ok[4]={1,1,1,1}; for(int i=0;i<4;i++) if(pthread_create(&t[i],NULL,run_independent,&ok[i])!=0) return 0; for(int i=0;i<4;i++) pthread_join(t[i],NULL); NThread_SetNumThreads(prev); for(int i=0;i<4;i++) if(!ok[i]){ printf("Concurrent caller %d saw a wrong result or error\n",i); return 0;} return !NError_IsError(); }
+
+void test_thread(){ TestFunc tests[]={
+    test_thread_set_get, test_thread_parallel_for_covers, test_thread_nested_runs_inline,
+    test_thread_reductions_match_serial, test_thread_minmax_nan_blocks, test_thread_elementwise_and_cast, test_thread_cumulative_scans,
+    test_thread_error_is_per_thread, test_thread_parallel_for_error, test_thread_concurrent_calls
+}; int num_tests=sizeof(tests)/sizeof(tests[0]); run_all_tests(tests, "Thread Tests", num_tests); }